@@ -1,6 +1,7 @@
 #include "src/sdi12Wrapper.h"
 
-SDI12Measurement measurement = SDI12Measurement();
+Sdi12Bus bus = Sdi12Bus(DATA_PIN);
+SDI12Measurement measurement = SDI12Measurement(&bus);
 char responseBfr[256] = { 0 };
 
 void setup() {
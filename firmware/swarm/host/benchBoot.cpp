@@ -0,0 +1,130 @@
+/*
+ *  Time from power-on to the first readings, full boot against fast boot
+ *
+ *  - setup() of swarm.ino against the simulated tile and SDI-12 bus, nobody
+ *    presses a button so every screen waits its full time
+ *  - full boot: the screens, all ten addresses probed with aI!, aI! per
+ *    sensor, tile reset and GPS fix, then the first cycle of the loop takes
+ *    the readings
+ *  - fast boot: one aI! per known sensor to verify the inventory, readings
+ *    taken while the tile boots
+ *  - a replaced sensor has to fail the verification
+ *
+ *  usage: benchBoot [tileBootMs=8000]
+ */
+#include <Arduino.h>
+#include "simulatedTile.h"
+#include "simulatedSdi12Bus.h"
+#include "swarmNode.h"
+#include "sdi12Wrapper.h"
+#include "messages.h"
+
+
+const unsigned long tileTimeFrequency = 20;
+
+
+typedef struct {
+  unsigned long firstSample;
+  unsigned long loop;
+  unsigned long sdi12Commands;
+} BootTimes;
+
+
+/*
+ *  Readings of all channels like collectMessage of swarm.ino
+ */
+void sample(SDI12Measurement &measurement, const char *channels, const uint8_t n) {
+  Message message = {0};
+  measurement.startMeasurements(channels, n);
+  int8_t i;
+  while ((i = measurement.waitForNextReady()) > -1) {
+    measurement.collectData(
+      i, message.payloads[i].payload, &message.payloads[i].values);
+  }
+}
+
+void addSensors(SimulatedSdi12Bus &bus) {
+  bus.addAtmos41('3');
+  bus.addTeros12('5');
+  bus.addTeros12('6');
+}
+
+BootTimes fullBoot(const unsigned long tileBootMs, char *channels, uint32_t *ids) {
+  VirtualClock::reset();
+  SimulatedTile sim;
+  sim.bootTime = tileBootMs;
+  SimulatedSdi12Bus bus;
+  addSensors(bus);
+  DisplayWrapperBase dspl;
+  SwarmNode tile(&dspl, &sim, false);
+  SDI12Measurement measurement(&bus);
+  BootTimes ret;
+  char bfr[128];
+  // welcome and frequency screens
+  delay(3000 + 3000);
+  const uint8_t n = measurement.getChannels(channels);
+  delay(2000);
+  for (uint8_t i=0; i<n; i++) {
+    ids[i] = SDI12Measurement::identity(bfr, measurement.getInfo(bfr, channels[i]));
+    delay(2000);
+  }
+  // address screen
+  delay(3000);
+  tile.begin(tileTimeFrequency);
+  delay(3000);
+  ret.loop = millis();
+  tile.waitForTimeStamp();
+  sample(measurement, channels, n);
+  ret.firstSample = millis();
+  ret.sdi12Commands = bus.commandsReceived;
+  return ret;
+}
+
+BootTimes fastBoot(
+  const unsigned long tileBootMs, const char *channels, const uint32_t *ids,
+  const uint8_t n, boolean &verified
+) {
+  VirtualClock::reset();
+  SimulatedTile sim;
+  sim.bootTime = tileBootMs;
+  SimulatedSdi12Bus bus;
+  addSensors(bus);
+  DisplayWrapperBase dspl;
+  SwarmNode tile(&dspl, &sim, false);
+  SDI12Measurement measurement(&bus);
+  BootTimes ret;
+  verified = measurement.verifyChannels(channels, ids, n);
+  tile.reset();
+  sample(measurement, channels, n);
+  ret.firstSample = millis();
+  tile.begin(tileTimeFrequency);
+  ret.loop = millis();
+  ret.sdi12Commands = bus.commandsReceived;
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  const unsigned long tileBootMs = argc > 1 ? strtoul(argv[1], NULL, 10) : 8000;
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  char channels[10] = {0};
+  uint32_t ids[10] = {0};
+  const BootTimes full = fullBoot(tileBootMs, channels, ids);
+  const uint8_t n = strlen(channels);
+  boolean verified;
+  const BootTimes fast = fastBoot(tileBootMs, channels, ids, n, verified);
+  // a TEROS 12 was swapped for another one with a different serial number
+  ids[1] ^= 1;
+  boolean replacedVerified;
+  fastBoot(tileBootMs, channels, ids, n, replacedVerified);
+
+  printf("%u sensors, tile boot %lu ms\n", n, tileBootMs);
+  printf("                first sample        loop   SDI-12 commands\n");
+  printf("  full boot    %10lu ms %10lu ms %8lu\n",
+    full.firstSample, full.loop, full.sdi12Commands);
+  printf("  fast boot    %10lu ms %10lu ms %8lu\n",
+    fast.firstSample, fast.loop, fast.sdi12Commands);
+  printf("  inventory verified %s, replaced sensor detected %s\n",
+    verified ? "yes" : "NO", replacedVerified ? "NO" : "yes");
+  return verified && !replacedVerified && fast.firstSample < full.firstSample ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+/*
+ *  Monthly message budget against a fixed send schedule
+ *
+ *  - replays the readings in tools/extract.csv as samples every 15 minutes,
+ *    over and over, for two and a half months of tile time
+ *  - a fixed schedule spreads the quota evenly over the rest of the month,
+ *    MessageBudget (../src/budget.h) decides on every sample
+ *  - reports messages per month and how far the last message was off the
+ *    current readings, normalized by the range of every value in the data
+ *  - fails if a month goes over the quota
+ *
+ *  usage: benchBudget [extract.csv]
+ */
+#include <Arduino.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "budget.h"
+
+#ifndef EXTRACT_CSV
+#define EXTRACT_CSV "../../../tools/extract.csv"
+#endif
+
+#define SAMPLE_INTERVAL 900
+// 2021-10-15 00:00 UTC
+#define START 1634256000UL
+#define DAYS 75
+
+
+/*
+ *  Rows are index,time,SC,channel,payload,...,voltage or, later,
+ *  index,time,voltage,SC,channel,payload,...; the payload starts with the
+ *  SDI-12 address
+ */
+boolean parseRow(const std::string &line, Message &message) {
+  std::vector<std::string> fields;
+  size_t start = 0;
+  size_t comma;
+  while ((comma = line.find(',', start)) != std::string::npos) {
+    fields.push_back(line.substr(start, comma - start));
+    start = comma + 1;
+  }
+  fields.push_back(line.substr(start));
+  size_t sc = std::find(fields.begin(), fields.end(), "SC") - fields.begin();
+  uint8_t n = 0;
+  for (size_t i=sc + 2; i<fields.size() && n<5; i+=2) {
+    const std::string &payload = fields[i];
+    if (payload.size() < 2 || (payload[1] != '+' && payload[1] != '-')) break;
+    message.payloads[n].channel = payload[0];
+    strncpy(
+      message.payloads[n].payload, payload.c_str(),
+      sizeof(message.payloads[n].payload) - 1);
+    n++;
+  }
+  return n > 0;
+}
+
+class Replay {
+  private:
+    const std::vector<Message> &_readings;
+    std::vector<float> _min;
+    std::vector<float> _max;
+  public:
+    float meanError = 0;
+    float p95Error = 0;
+    unsigned long sent = 0;
+    unsigned long maxPerMonth = 0;
+    std::vector<unsigned long> perMonth;
+
+    Replay(const std::vector<Message> &readings): _readings(readings) {
+      float values[BUDGET_MAX_VALUES];
+      float resolution[BUDGET_MAX_VALUES];
+      for (size_t i=0; i<readings.size(); i++) {
+        uint8_t count = MessageBudget::flatten(readings[i], values, resolution);
+        if (count > _min.size()) {
+          _min.resize(count, 1e30);
+          _max.resize(count, -1e30);
+        }
+        for (uint8_t j=0; j<count; j++) {
+          _min[j] = std::min(_min[j], values[j]);
+          _max[j] = std::max(_max[j], values[j]);
+        }
+      }
+    };
+
+    /*
+     *  Mean difference of the values in units of their range
+     */
+    float error(const Message &current, const Message &last) {
+      float a[BUDGET_MAX_VALUES];
+      float b[BUDGET_MAX_VALUES];
+      float resolution[BUDGET_MAX_VALUES];
+      uint8_t count = MessageBudget::flatten(current, a, resolution);
+      if (MessageBudget::flatten(last, b, resolution) != count) return 1;
+      float ret = 0;
+      for (uint8_t j=0; j<count; j++) {
+        float range = _max[j] - _min[j];
+        if (range > 0) ret += std::fabs(a[j] - b[j]) / range;
+      }
+      return ret / count;
+    };
+
+    /*
+     *  With quota 0 for the fixed schedule
+     */
+    void run(const uint32_t quota, const boolean adaptive) {
+      MessageBudget budget;
+      budget.quota = quota;
+      budget.minInterval = SAMPLE_INTERVAL;
+      std::vector<float> errors;
+      const Message *last = NULL;
+      unsigned long nextScheduled = 0;
+      uint32_t month = MessageBudget::monthOf(START);
+      perMonth.assign(1, 0);
+      for (unsigned long t=START; t<START + DAYS * 86400UL; t+=SAMPLE_INTERVAL) {
+        const Message &reading = _readings[(t - START) / SAMPLE_INTERVAL % _readings.size()];
+        if (MessageBudget::monthOf(t) != month) {
+          month = MessageBudget::monthOf(t);
+          perMonth.push_back(0);
+        }
+        boolean send;
+        if (adaptive) {
+          send = budget.due(t, reading);
+          if (send) budget.spend(t, reading);
+        } else {
+          send = t >= nextScheduled && budget.remaining(t) > 0;
+          if (send) {
+            nextScheduled = t + budget.pace(t);
+            budget.spend(t, reading);
+          }
+        }
+        if (send) {
+          last = &reading;
+          perMonth.back()++;
+          sent++;
+        }
+        errors.push_back(last == NULL ? 1 : error(reading, *last));
+      }
+      std::sort(errors.begin(), errors.end());
+      for (size_t i=0; i<errors.size(); i++) meanError += errors[i];
+      meanError /= errors.size();
+      p95Error = errors[errors.size() * 95 / 100];
+      for (size_t i=0; i<perMonth.size(); i++) {
+        maxPerMonth = std::max(maxPerMonth, perMonth[i]);
+      }
+    };
+
+    void print(const char *name) {
+      printf("  %-10s %5lu sent, per month", name, sent);
+      for (size_t i=0; i<perMonth.size(); i++) printf(" %4lu", perMonth[i]);
+      printf(", error mean %.4f p95 %.4f\n", meanError, p95Error);
+    };
+};
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : EXTRACT_CSV;
+  std::ifstream csv(path);
+  std::vector<Message> readings;
+  std::string line;
+  float values[BUDGET_MAX_VALUES];
+  float resolution[BUDGET_MAX_VALUES];
+  uint8_t layout = 0;
+  while (std::getline(csv, line)) {
+    Message message = {0};
+    if (!parseRow(line, message)) continue;
+    // the few rows with a different set of values are test readings
+    uint8_t count = MessageBudget::flatten(message, values, resolution);
+    if (layout == 0) layout = count;
+    if (count == layout) readings.push_back(message);
+  }
+  if (readings.empty()) {
+    printf("no readings in %s\n", path);
+    return 1;
+  }
+  int ret = 0;
+  printf(
+    "%u readings replayed every %d s for %d days from 2021-10-15\n",
+    static_cast<unsigned int>(readings.size()), SAMPLE_INTERVAL, DAYS);
+  const uint32_t quotas[] = {720, 240, 60};
+  for (size_t i=0; i<sizeof(quotas) / sizeof(quotas[0]); i++) {
+    printf("quota %lu\n", static_cast<unsigned long>(quotas[i]));
+    Replay fixed(readings);
+    fixed.run(quotas[i], false);
+    fixed.print("fixed");
+    Replay adaptive(readings);
+    adaptive.run(quotas[i], true);
+    adaptive.print("budget");
+    if (adaptive.maxPerMonth > quotas[i]) {
+      printf("  over quota\n");
+      ret = 1;
+    }
+  }
+  return ret;
+}
@@ -0,0 +1,131 @@
+/*
+ *  Micro-benchmark of building the $TD command for a message
+ *
+ *  - the chain before CommandWriter: toHexString with a sprintf per byte
+ *    into a temporary buffer, copied behind the prefix, copied again by
+ *    cleanCommand to add the checksum in a second pass
+ *  - SwarmNode::messageCommand hex-encodes straight into the command
+ *    buffer and computes the checksum on the way
+ *  - reports bytes written per message and time, in TSC cycles on x86
+ *
+ *  usage: benchCommand [iterations=200000]
+ */
+#include <Arduino.h>
+#include <chrono>
+#include "swarmNode.h"
+#include "messages.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+volatile unsigned long sink;
+// bytes written by the legacy chain
+unsigned long legacyBytes = 0;
+
+
+double wallNanos() {
+  return std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+unsigned long long cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/*
+ *  SwarmNode::formatMessage, toHexString and queueCommand's cleanCommand as
+ *  they were implemented before CommandWriter
+ */
+size_t legacyCommand(SwarmNode &node, const char *message, const size_t len, char *bfr) {
+  char convertedMessage[512];
+  char prefix[] = "$TD HD=86400,";
+  size_t commandIdx = sizeof(prefix) - 1;
+  char formatted[512];
+  memcpy(formatted, prefix, commandIdx);
+  char smallBfr[3];
+  for (size_t i=0; i<len; i++) {
+    sprintf(smallBfr, "%02x", message[i]);
+    memcpy(convertedMessage+i*2, smallBfr, 2);
+  }
+  size_t convertedLen = len * 2;
+  memcpy(formatted + commandIdx, convertedMessage, convertedLen);
+  const size_t formattedLen = commandIdx + convertedLen;
+  // cleanCommand
+  char hexbfr[3];
+  memcpy(bfr, formatted, formattedLen);
+  bfr[formattedLen] = '*';
+  sprintf(hexbfr, "%02x", node.nmeaChecksum(formatted, formattedLen));
+  memcpy(bfr+formattedLen+1, hexbfr, 2);
+  memcpy(bfr+formattedLen+3, "\n", 1);
+  legacyBytes += 3 * len + 2 * len + commandIdx + convertedLen + formattedLen + 7;
+  return formattedLen + 4;
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+  DisplayWrapperBase dspl;
+  SerialWrapperBase serial;
+  SwarmNode node(&dspl, &serial);
+  // a text message with an ATMOS 41 and a binary frame of the same message
+  Message message = {0};
+  message.index = 12;
+  message.timeStamp = 1638633600;
+  message.batteryVoltage = 3.59;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = 51;
+  strcpy(message.payloads[0].payload,
+    "3+552+0.000+0+0+0.67+109.1+1.79+28.3+1.68+101.28+0.446+36.3+1.2+0.4+0"
+    "-0.22+0.64+1.79");
+  message.payloads[1].channel = 53;
+  strcpy(message.payloads[1].payload, "5+2038.84+16.1+39");
+  char messages[2][MAX_MESSAGE_LENGTH];
+  size_t lengths[2];
+  lengths[0] = MessageHelpers::formatMessage(message, messages[0]);
+  lengths[1] = MessageHelpers::encodeMessage(message, messages[1]);
+  const char *names[] = {"text", "binary"};
+
+  int ret = 0;
+  for (uint8_t m=0; m<2; m++) {
+    char legacyBfr[512];
+    char currentBfr[512];
+    const size_t len = lengths[m];
+    const size_t legacyLen = legacyCommand(node, messages[m], len, legacyBfr);
+    const size_t currentLen = node.messageCommand(messages[m], len, currentBfr);
+    if (legacyLen != currentLen || memcmp(legacyBfr, currentBfr, legacyLen) != 0) {
+      printf("%s message: commands differ\n", names[m]);
+      ret = 1;
+      continue;
+    }
+    legacyBytes = 0;
+    double start = wallNanos();
+    unsigned long long startCycles = cycles();
+    for (unsigned long i=0; i<iterations; i++) {
+      sink = legacyCommand(node, messages[m], len, legacyBfr);
+    }
+    const double legacyCycles = static_cast<double>(cycles() - startCycles) / iterations;
+    const double legacy = (wallNanos() - start) / iterations;
+
+    start = wallNanos();
+    startCycles = cycles();
+    for (unsigned long i=0; i<iterations; i++) {
+      sink = node.messageCommand(messages[m], len, currentBfr);
+    }
+    const double currentCycles = static_cast<double>(cycles() - startCycles) / iterations;
+    const double current = (wallNanos() - start) / iterations;
+
+    printf("%s message, %u bytes, %u bytes command, %lu iterations\n",
+      names[m], static_cast<unsigned>(len), static_cast<unsigned>(currentLen), iterations);
+    printf("  legacy (sprintf, 3 copies)  %6lu bytes written %8.1f ns %8.0f cycles\n",
+      legacyBytes / iterations, legacy, legacyCycles);
+    printf("  CommandWriter               %6u bytes written %8.1f ns %8.0f cycles\n",
+      static_cast<unsigned>(currentLen), current, currentCycles);
+    printf("  speedup                                            %8.1f x\n",
+      legacy / current);
+  }
+  return ret;
+}
@@ -0,0 +1,150 @@
+/*
+ *  End-to-end benchmark of the main loop against the simulated tile
+ *
+ *  - runs SwarmNode::begin() and then the tile related part of loop() in
+ *    swarm.ino: wait for a time report, send a message when scheduled, and
+ *    light sleep for tileTimeFrequency
+ *  - reports simulated awake time, host wall-clock time, and UART bytes per
+ *    cycle, for idle cycles and sending cycles separately
+ *
+ *  usage: benchCycle [cycles=500] [sendFrequency=3600]
+ */
+#include <Arduino.h>
+#include <chrono>
+#include "simulatedTile.h"
+#include "swarmNode.h"
+#include "messages.h"
+
+
+const unsigned long tileTimeFrequency = 20;
+
+
+/*
+ *  min/mean/max of a series of samples
+ */
+class Stats {
+  private:
+    double _min = 0;
+    double _max = 0;
+    double _sum = 0;
+    unsigned long _count = 0;
+  public:
+    void add(double value) {
+      if (_count == 0 || value < _min) _min = value;
+      if (_count == 0 || value > _max) _max = value;
+      _sum += value;
+      _count++;
+    };
+    void print(const char *name, const char *unit) {
+      printf(
+        "  %-22s n=%-5lu min=%10.2f mean=%10.2f max=%10.2f %s\n", name, _count,
+        _min, _count ? _sum / _count : 0, _max, unit);
+    };
+};
+
+
+class CycleStats {
+  public:
+    Stats awake;
+    Stats wall;
+    Stats bytesIn;
+    Stats bytesOut;
+    void print(const char *title) {
+      printf("%s\n", title);
+      awake.print("simulated awake time", "ms");
+      wall.print("host wall time", "us");
+      bytesIn.print("UART bytes from tile", "bytes");
+      bytesOut.print("UART bytes to tile", "bytes");
+    };
+};
+
+
+double wallMicros() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ *  Same sensor payloads as the example in the README
+ */
+size_t getMessage(char *bfr, const int idx, const unsigned long tme) {
+  Message message = {0};
+  message.index = idx;
+  message.timeStamp = tme;
+  message.batteryVoltage = 3.85;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = '3';
+  strcpy(
+    message.payloads[0].payload,
+    "+26+0.000+0+0+0.93+246.3+2.65+11.0+1.18+100.83+0.900+10.8+0.2+1.7+0-0.38"
+    "-0.86+2.65");
+  message.payloads[1].channel = '4';
+  strcpy(message.payloads[1].payload, "+0.00");
+  message.payloads[2].channel = '5';
+  strcpy(message.payloads[2].payload, "+2038.84+16.1+39");
+  return MessageHelpers::formatMessage(message, bfr);
+}
+
+int main(int argc, char **argv) {
+  unsigned long cycles = argc > 1 ? strtoul(argv[1], NULL, 10) : 500;
+  unsigned long sendFrequency = argc > 2 ? strtoul(argv[2], NULL, 10) : 3600;
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  SimulatedTile sim;
+  DisplayWrapperBase dspl;
+  SwarmNode tile(&dspl, &sim, false);
+  CycleStats idle;
+  CycleStats sending;
+  char messageBfr[256];
+  unsigned long nextScheduled = 0;
+  int messageCounter = 0;
+
+  double wallStart = wallMicros();
+  tile.begin(tileTimeFrequency);
+  printf("begin()\n");
+  printf("  simulated boot latency %10.2f s\n", VirtualClock::now() / 1e6);
+  printf("  host wall time         %10.2f us\n", wallMicros() - wallStart);
+  printf("  UART bytes from tile   %10lu\n", sim.bytesFromTile);
+  printf("  UART bytes to tile     %10lu\n", sim.bytesToTile);
+
+  Profiler::global().reset();
+  for (unsigned long i=0; i<cycles; i++) {
+    Profiler::global().beginCycle();
+    uint64_t simStart = VirtualClock::now();
+    unsigned long bytesIn = sim.bytesFromTile;
+    unsigned long bytesOut = sim.bytesToTile;
+    boolean sent = false;
+    wallStart = wallMicros();
+    unsigned long tileTime = tile.waitForTimeStamp();
+    if (tileTime > nextScheduled) {
+      size_t len = getMessage(messageBfr, messageCounter, tileTime);
+      tile.queueMessage(messageBfr, len);
+      nextScheduled = MessageHelpers::getNextScheduled(tileTime, sendFrequency);
+      messageCounter++;
+      sent = true;
+    }
+    tile.waitForCommands();
+    CycleStats &stats = sent ? sending : idle;
+    stats.wall.add(wallMicros() - wallStart);
+    stats.awake.add((VirtualClock::now() - simStart) / 1e3);
+    stats.bytesIn.add(sim.bytesFromTile - bytesIn);
+    stats.bytesOut.add(sim.bytesToTile - bytesOut);
+    // esp_light_sleep_start(), the UART keeps receiving into its FIFO
+    {
+      ProfileScope scope(PHASE_SLEEP);
+      delay(tileTimeFrequency * 1000);
+    }
+    Profiler::global().endCycle();
+  }
+  idle.print("idle cycles");
+  sending.print("sending cycles");
+  printf(
+    "messages queued %lu, sent %lu, UART bytes dropped %lu\n",
+    sim.messagesQueued, sim.messagesSent, sim.bytesDropped);
+  // the simulated tile is not a SerialWrapper, UART bytes are counted above
+  char report[256];
+  Profiler::global().report(report, sizeof(report));
+  printf("profile\n%s", report);
+  // a run that does not get a single message through is broken
+  return sim.messagesQueued > 0 ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+/*
+ *  Bulk decoding of hive messages, see payloadDecoder.h
+ *
+ *  - builds a corpus of JSON lines in memory with the encoders of the
+ *    firmware: text messages, binary frames, batches, and summaries of an
+ *    ATMOS 41, leaf wetness, a TEROS 12, and an unknown sensor
+ *  - decodes it into wide CSV without writing it out and reports messages,
+ *    rows, and input bytes per second
+ *  - fails if text and binary encoding of the same message decode to
+ *    different values or a batch does not give a row per epoch
+ *
+ *  usage: benchDecode [messages]
+ */
+#include <Arduino.h>
+#include <chrono>
+#include <string>
+#include "payloadDecoder.h"
+
+#define BATCH_EPOCHS 4
+
+
+std::string base64(const char *bytes, const size_t len) {
+  static const char *alphabet =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::string ret;
+  for (size_t i=0; i<len; i+=3) {
+    uint32_t bits = static_cast<uint8_t>(bytes[i]) << 16;
+    if (i + 1 < len) bits |= static_cast<uint8_t>(bytes[i+1]) << 8;
+    if (i + 2 < len) bits |= static_cast<uint8_t>(bytes[i+2]);
+    ret += alphabet[bits >> 18 & 0x3F];
+    ret += alphabet[bits >> 12 & 0x3F];
+    ret += i + 1 < len ? alphabet[bits >> 6 & 0x3F] : '=';
+    ret += i + 2 < len ? alphabet[bits & 0x3F] : '=';
+  }
+  return ret;
+}
+
+void appendLine(std::string &corpus, const char *bytes, const size_t len, const unsigned long id) {
+  char head[128];
+  snprintf(head, sizeof(head),
+    "{\"packetId\":%lu,\"deviceType\":1,\"deviceId\":%lu,\"userApplicationId\":0,"
+    "\"organizationId\":65,\"data\":\"", id, 3000 + id % 7);
+  corpus += head;
+  corpus += base64(bytes, len);
+  snprintf(head, sizeof(head),
+    "\",\"len\":%u,\"status\":0,\"hiveRxTime\":\"2021-12-04T16:%02lu:00\"}\n",
+    static_cast<unsigned>(len), id % 60);
+  corpus += head;
+}
+
+/*
+ *  Readings that wander like real ones
+ */
+void fillMessage(Message &message, const unsigned long i) {
+  message = {0};
+  message.index = i;
+  message.timeStamp = 1638633600 + 900 * i;
+  message.batteryVoltage = 3.5 + (i % 50) * 0.01;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = 51;
+  snprintf(message.payloads[0].payload, sizeof(message.payloads[0].payload),
+    "3+%lu+%.3f+%lu+0+%.2f+%.1f+1.79%+.1f+1.68+101.28+0.446+36.3+1.2+0.4+0"
+    "-0.22+0.64+1.79", (i * 37) % 1200, (i % 9) * 0.127, i % 3,
+    (i % 400) * 0.01, (i * 7 % 3600) * 0.1, -5 + (i % 300) * 0.1);
+  message.payloads[1].channel = 52;
+  snprintf(message.payloads[1].payload, sizeof(message.payloads[1].payload),
+    "4+%.2f", (i % 10000) * 0.01);
+  message.payloads[2].channel = 53;
+  snprintf(message.payloads[2].payload, sizeof(message.payloads[2].payload),
+    "5+%.2f%+.1f+%lu", 2000 + (i % 500) * 0.37, 10 + (i % 90) * 0.1, i % 300);
+  message.payloads[3].channel = 60;
+  snprintf(message.payloads[3].payload, sizeof(message.payloads[3].payload),
+    "<+%.3f-%lu", (i % 1000) * 0.001, i % 17);
+}
+
+
+/*
+ *  Keeps the rows of one message
+ */
+class Capture {
+  public:
+    DecodedRow rows[8];
+    size_t numberOfRows = 0;
+
+    void operator()(const DecodedRow &row) {
+      if (numberOfRows < 8) rows[numberOfRows] = row;
+      numberOfRows++;
+    };
+};
+
+boolean sameValues(const DecodedRow &a, const DecodedRow &b) {
+  if (a.present != b.present || a.timeStamp != b.timeStamp) return false;
+  if (a.batteryVoltage != b.batteryVoltage) return false;
+  for (size_t i=0; i<DECODED_COLUMNS; i++) {
+    if ((a.present & (1ULL << i)) == 0) continue;
+    const uint8_t decimals = a.decimals[i] > b.decimals[i] ? a.decimals[i] : b.decimals[i];
+    if (Sdi12Parser::rescale(a.mantissas[i], a.decimals[i], decimals) !=
+      Sdi12Parser::rescale(b.mantissas[i], b.decimals[i], decimals)
+    ) return false;
+  }
+  return true;
+}
+
+/*
+ *  Text and binary frames of the same message, a batch, and a summary
+ */
+boolean roundTrip(const unsigned long n) {
+  Capture text, binary, batched, summary;
+  PayloadDecoder<Capture> textDecoder(text);
+  PayloadDecoder<Capture> binaryDecoder(binary);
+  PayloadDecoder<Capture> batchDecoder(batched);
+  PayloadDecoder<Capture> summaryDecoder(summary);
+  Message message;
+  MessageBatch batch;
+  MessageAggregate aggregate;
+  char bfr[MAX_MESSAGE_LENGTH + 8];
+  for (unsigned long i=0; i<n; i++) {
+    fillMessage(message, i);
+    text.numberOfRows = 0;
+    binary.numberOfRows = 0;
+    size_t len = MessageHelpers::formatMessage(message, bfr);
+    const boolean textOk = textDecoder.decodePayload(reinterpret_cast<uint8_t *>(bfr), len);
+    len = MessageHelpers::encodeMessage(message, bfr);
+    const boolean binaryOk = binaryDecoder.decodePayload(reinterpret_cast<uint8_t *>(bfr), len);
+    if (!textOk || !binaryOk || text.numberOfRows != 1 || binary.numberOfRows != 1 ||
+      !sameValues(text.rows[0], binary.rows[0]) ||
+      text.rows[0].otherLength != binary.rows[0].otherLength
+    ) {
+      printf("message %lu: text and binary frame differ\n", i);
+      return false;
+    }
+    if (!batch.add(message)) {
+      batched.numberOfRows = 0;
+      len = batch.encode(bfr, i);
+      batchDecoder.decodePayload(reinterpret_cast<uint8_t *>(bfr), len);
+      if (batched.numberOfRows != batch.numberOfEpochs) {
+        printf("message %lu: %u epochs but %u rows\n",
+          i, batch.numberOfEpochs, static_cast<unsigned>(batched.numberOfRows));
+        return false;
+      }
+      batch.reset();
+      batch.add(message);
+    }
+    aggregate.add(message);
+  }
+  summary.numberOfRows = 0;
+  const size_t len = aggregate.encode(bfr, n);
+  if (len == 0 || !summaryDecoder.decodePayload(reinterpret_cast<uint8_t *>(bfr), len) ||
+    summary.numberOfRows != 5 ||
+    summary.rows[0].samples != aggregate.numberOfSamples
+  ) {
+    printf("summary of %lu messages not decoded\n", n);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const unsigned long n = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+  if (!roundTrip(n < 1000 ? n : 1000)) return 1;
+
+  std::string corpus;
+  corpus.reserve(n * 400);
+  Message message;
+  MessageBatch batch;
+  MessageAggregate aggregate;
+  char bfr[MAX_MESSAGE_LENGTH + 8];
+  unsigned long lines = 0;
+  for (unsigned long i=0; i<n; i++) {
+    fillMessage(message, i);
+    // every fourth message is a batch or a summary of four readings
+    batch.add(message);
+    aggregate.add(message);
+    size_t len;
+    switch (i % BATCH_EPOCHS) {
+      case 0:
+        len = MessageHelpers::formatMessage(message, bfr);
+        break;
+      case 1:
+        len = MessageHelpers::encodeMessage(message, bfr);
+        break;
+      case 2:
+        len = batch.encode(bfr, i);
+        batch.reset();
+        break;
+      default:
+        len = aggregate.encode(bfr, i);
+        aggregate.reset();
+    }
+    appendLine(corpus, bfr, len, lines++);
+  }
+
+  WideCsvWriter writer(NULL);
+  PayloadDecoder<WideCsvWriter> decoder(writer);
+  writer.header();
+  const auto start = std::chrono::steady_clock::now();
+  const char *line = corpus.data();
+  const char *end = line + corpus.size();
+  while (line < end) {
+    const char *newline = static_cast<const char *>(memchr(line, '\n', end - line));
+    decoder.decodeLine(line, newline - line);
+    line = newline + 1;
+  }
+  writer.flush();
+  const double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  printf("%lu lines, %.1f MB JSON in %.3f s\n", lines, corpus.size() / 1e6, seconds);
+  printf("%10.0f messages/s\n%10.0f rows/s\n%10.1f MB/s in\n%10.1f MB/s out\n",
+    decoder.messages / seconds, decoder.rows / seconds,
+    corpus.size() / 1e6 / seconds, writer.bytes / 1e6 / seconds);
+  if (decoder.failed > 0 || decoder.messages != lines) {
+    printf("%lu of %lu messages failed\n", decoder.failed, decoder.messages);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ *  I2C traffic of the display over a day of the main loop
+ *
+ *  - every cycle shows $DT @ and the response like tileCommand does, once
+ *    an hour a message is sent; the text is the same for both displays
+ *  - the display wrapper as it was before TextConsole sent a frame for every
+ *    printBuffer and cleared the screen when it was full
+ *  - DisplayWrapper redraws changed lines only, at most once per
+ *    DISPLAY_FRAME_INTERVAL and once at the end of the cycle like in
+ *    swarm.ino; once with a button pressed every cycle so the display stays
+ *    on, once untouched so it blanks
+ *
+ *  usage: benchDisplay [hours=24] [tileTimeFrequency=60]
+ */
+#include <Arduino.h>
+#include "displayWrapper.h"
+
+
+/*
+ *  printBuffer and shortPrintBuffer of the wrapper before TextConsole
+ */
+class LegacyDisplay {
+  public:
+    Adafruit_SH1107 oled = Adafruit_SH1107(64, 128, &Wire);
+
+    LegacyDisplay() {
+      oled.setRotation(1);
+    };
+
+    void printBuffer(const char *bfr, size_t len) {
+      if (oled.getCursorY() > 60) {
+        oled.clearDisplay();
+        oled.setCursor(0, 0);
+      }
+      for (size_t i=0; i<len; i++) oled.print(bfr[i]);
+      oled.display();
+    };
+
+    void shortPrintBuffer(const char *bfr, size_t len) {
+      if (len > 20) {
+        printBuffer(bfr, 21);
+        oled.print('\n');
+      } else {
+        printBuffer(bfr, len);
+      }
+    };
+};
+
+
+/*
+ *  Text of one cycle of swarm.ino, returns the lines printed
+ */
+template <class Display>
+unsigned long cycle(Display &display, const unsigned long tileTime, const boolean send) {
+  // fits the $TD command below
+  char bfr[96];
+  size_t len = snprintf(bfr, sizeof(bfr), "$DT @*70\n");
+  display.shortPrintBuffer(bfr, len);
+  delay(30);
+  len = snprintf(bfr, sizeof(bfr), "$DT %lu,V*41\n", tileTime);
+  display.shortPrintBuffer(bfr, len);
+  if (!send) return 2;
+  len = snprintf(bfr, sizeof(bfr), "SENDING AT %lu", tileTime);
+  display.printBuffer(bfr, len);
+  len = snprintf(bfr, sizeof(bfr),
+    "$TD HD=86400,3030303030312c313633383633333630302c332e35392c5343*1a\n");
+  display.shortPrintBuffer(bfr, len);
+  delay(40);
+  len = snprintf(bfr, sizeof(bfr), "$TD OK,5354468575916*2c\n");
+  display.shortPrintBuffer(bfr, len);
+  return 5;
+}
+
+int main(int argc, char **argv) {
+  const unsigned long hours = argc > 1 ? strtoul(argv[1], NULL, 10) : 24;
+  const unsigned long tileTimeFrequency = argc > 2 ? strtoul(argv[2], NULL, 10) : 60;
+  const unsigned long cycles = hours * 3600 / tileTimeFrequency;
+  const unsigned long start = 1638633600;
+
+  LegacyDisplay legacy;
+  unsigned long lines = 0;
+  for (unsigned long i=0; i<cycles; i++) {
+    const unsigned long tileTime = start + i * tileTimeFrequency;
+    lines += cycle(legacy, tileTime, tileTime % 3600 < tileTimeFrequency);
+    delay(tileTimeFrequency * 1000);
+  }
+
+  unsigned long frames[2];
+  unsigned long bytes[2];
+  for (uint8_t blanking=0; blanking<2; blanking++) {
+    VirtualClock::reset();
+    DisplayWrapper display;
+    display.begin();
+    for (unsigned long i=0; i<cycles; i++) {
+      const unsigned long tileTime = start + i * tileTimeFrequency;
+      cycle(display, tileTime, tileTime % 3600 < tileTimeFrequency);
+      if (!blanking) {
+        HostPins::setDigital(BUTTON_B, LOW);
+        display.button(BUTTON_B);
+        HostPins::setDigital(BUTTON_B, HIGH);
+      }
+      display.display();
+      display.update();
+      delay(tileTimeFrequency * 1000);
+    }
+    frames[blanking] = display.frames;
+    bytes[blanking] = display.linesSent * DISPLAY_WIDTH;
+  }
+
+  printf("%lu cycles of %lu s, %lu lines of text\n", cycles, tileTimeFrequency, lines);
+  printf("  legacy (frame per print)     %6lu frames %9lu bytes\n",
+    legacy.oled.displayCount, legacy.oled.bytesTransferred);
+  printf("  TextConsole, display on      %6lu frames %9lu bytes\n", frames[0], bytes[0]);
+  printf("  TextConsole, blanks when idle%6lu frames %9lu bytes\n", frames[1], bytes[1]);
+  printf("  I2C bytes saved, display on  %8.1f %%\n",
+    100. * (1 - static_cast<double>(bytes[0]) / legacy.oled.bytesTransferred));
+  // the console has to send less, never more
+  return bytes[0] < legacy.oled.bytesTransferred && bytes[1] <= bytes[0] ? 0 : 1;
+}
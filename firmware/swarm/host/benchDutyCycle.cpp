@@ -0,0 +1,214 @@
+/*
+ *  Light sleep against deep sleep duty cycling of the main loop
+ *
+ *  - runs the loop of swarm.ino against the simulated tile and SDI-12 bus
+ *    for a number of days, once waking every tileTimeFrequency with light
+ *    sleep and once with deep sleep between scheduled messages
+ *  - after every deep sleep the firmware starts over with fresh objects and
+ *    clobbered globals, the state has to come back from RTC memory exactly
+ *    as it was saved, through the LoopState of swarm.ino
+ *  - reports wake-ups and awake time per day and the messages sent
+ *
+ *  usage: benchDutyCycle [days=7] [sendFrequency=3600]
+ */
+#include <Arduino.h>
+#include "simulatedTile.h"
+#include "simulatedSdi12Bus.h"
+#include "simulatedSleep.h"
+#include "swarmNode.h"
+#include "sdi12Wrapper.h"
+#include "messages.h"
+#include "loopState.h"
+
+
+#define DEEP_SLEEP_LEAD 5
+
+const unsigned long tileTimeFrequency = 20;
+
+// globals of swarm.ino that are lost in deep sleep
+int messageCounter;
+unsigned long nextScheduled;
+unsigned long nextSample;
+unsigned long measurementFrequencyS;
+char availableChannels[10];
+int numberOfChannels;
+MessageBatch batch;
+MessageBudget budget;
+MessageAggregate aggregate;
+TileSleep tileSleep;
+LocalClock localClock;
+// saved and restored like in swarm.ino
+LoopState loopState = LoopState(
+  messageCounter, nextScheduled, nextSample, measurementFrequencyS,
+  availableChannels, numberOfChannels, batch, budget, aggregate, tileSleep,
+  localClock);
+
+
+void clobberGlobals() {
+  messageCounter = -1;
+  nextScheduled = 12345;
+  nextSample = 12345;
+  measurementFrequencyS = 0;
+  memset(availableChannels, '?', sizeof(availableChannels));
+  numberOfChannels = -1;
+  memset(&batch, 0xa5, sizeof(batch));
+  memset(&budget, 0xa5, sizeof(budget));
+  memset(&aggregate, 0xa5, sizeof(aggregate));
+  tileSleep.asleep = true;
+  memset(&localClock, 0xa5, sizeof(localClock));
+}
+
+
+class DutyCycle {
+  private:
+    SimulatedTile &_sim;
+    SimulatedSdi12Bus &_bus;
+    SimulatedSleep &_sleeper;
+    boolean _deepSleep;
+    uint64_t _end;
+
+    /*
+     *  Globals are what was saved before deep sleep
+     */
+    boolean restored() {
+      return messageCounter == saved.messageCounter
+        && nextScheduled == saved.nextScheduled
+        && nextSample == saved.nextSample
+        && measurementFrequencyS == saved.measurementFrequencyS
+        && numberOfChannels == saved.numberOfChannels
+        && memcmp(availableChannels, saved.availableChannels, 10) == 0
+        && memcmp(&batch, saved.batch, sizeof(batch)) == 0
+        && memcmp(&budget, saved.budget, sizeof(budget)) == 0
+        && memcmp(&aggregate, saved.aggregate, sizeof(aggregate)) == 0
+        && tileSleep.asleep == saved.tileAsleep
+        && memcmp(&localClock, saved.clock, sizeof(localClock)) == 0
+        && _sleeper.retained()->wakeups == saved.wakeups + 1;
+    };
+
+    /*
+     *  setup() and loop() until deep sleep or the end of the simulation,
+     *  returns true if it went to deep sleep
+     */
+    boolean run() {
+      DisplayWrapperBase dspl;
+      SwarmNode tile(&dspl, &_sim, false);
+      SDI12Measurement measurement(&_bus);
+      char bfr[MAX_MESSAGE_LENGTH];
+      if (_deepSleep && loopState.restore(_sleeper)) {
+        if (!restored()) roundTripErrors++;
+      } else {
+        coldStarts++;
+        messageCounter = 0;
+        nextScheduled = 0;
+        nextSample = 0;
+        measurementFrequencyS = sendFrequency;
+        memset(availableChannels, 0, sizeof(availableChannels));
+        numberOfChannels = measurement.getChannels(availableChannels);
+        batch.reset();
+        budget = MessageBudget();
+        aggregate = MessageAggregate();
+        tileSleep = TileSleep();
+        localClock = LocalClock();
+        tile.begin(tileTimeFrequency);
+      }
+      while (true) {
+        unsigned long tileTime = tile.waitForTimeStamp();
+        if (tileTime > nextScheduled) {
+          Message message = {0};
+          message.index = messageCounter;
+          message.timeStamp = tileTime;
+          message.batteryVoltage = 3.85;
+          memcpy(message.type, "SC", 2);
+          measurement.startMeasurements(availableChannels, numberOfChannels);
+          for (int i=0; i<numberOfChannels; i++) {
+            message.payloads[i].channel = availableChannels[i];
+          }
+          int8_t i;
+          while ((i = measurement.waitForNextReady()) > -1) {
+            measurement.collectData(
+              i, message.payloads[i].payload, &message.payloads[i].values);
+          }
+          tile.queueMessage(bfr, MessageHelpers::encodeMessage(message, bfr));
+          nextScheduled = MessageHelpers::getNextScheduled(
+            tileTime, measurementFrequencyS);
+          messageCounter++;
+        }
+        tile.waitForCommands();
+        if (VirtualClock::now() >= _end) return false;
+        if (_deepSleep) {
+          unsigned long duration = SleepWrapperBase::sleepDuration(
+            tileTime, nextScheduled, tileTimeFrequency, DEEP_SLEEP_LEAD);
+          if (duration > tileTimeFrequency) {
+            loopState.save(_sleeper);
+            saved = *_sleeper.retained();
+            _sleeper.deepSleep(duration);
+            _sim.resetUart();
+            return true;
+          }
+        }
+        _sleeper.lightSleep(tileTimeFrequency);
+      }
+    };
+
+  public:
+    unsigned long sendFrequency;
+    unsigned long coldStarts = 0;
+    unsigned long roundTripErrors = 0;
+    RetainedState saved;
+
+    DutyCycle(
+      SimulatedTile &sim, SimulatedSdi12Bus &bus, SimulatedSleep &sleeper,
+      const boolean deepSleep, const unsigned long sendFrequency
+    ): _sim(sim), _bus(bus), _sleeper(sleeper) {
+      _deepSleep = deepSleep;
+      this->sendFrequency = sendFrequency;
+    };
+
+    void simulate(const unsigned long days) {
+      _end = VirtualClock::now() + days * 86400000000ULL;
+      while (run()) clobberGlobals();
+    };
+};
+
+int main(int argc, char **argv) {
+  unsigned long days = argc > 1 ? strtoul(argv[1], NULL, 10) : 7;
+  unsigned long sendFrequency = argc > 2 ? strtoul(argv[2], NULL, 10) : 3600;
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  int ret = 0;
+  unsigned long messages[2];
+  printf("%lu days, sending every %lu s\n", days, sendFrequency);
+  for (int deep=0; deep<2; deep++) {
+    VirtualClock::reset();
+    SimulatedTile sim;
+    SimulatedSdi12Bus bus;
+    bus.addAtmos41('3');
+    bus.addTeros12('5');
+    bus.addTeros12('6');
+    SimulatedSleep sleeper;
+    DutyCycle cycle(sim, bus, sleeper, deep, sendFrequency);
+    cycle.simulate(days);
+    double total = VirtualClock::now() / 1e6;
+    double perDay = 86400 / total;
+    messages[deep] = sim.messagesQueued;
+    printf("%s\n", deep ? "deep sleep" : "light sleep");
+    printf(
+      "  wake-ups per day       %10.1f (%lu deep)\n",
+      (sleeper.lightSleeps + sleeper.deepSleeps) * perDay, sleeper.deepSleeps);
+    printf(
+      "  awake time per day     %10.1f s\n",
+      (total - sleeper.sleepTime / 1e6) * perDay);
+    printf("  cold starts            %10lu\n", cycle.coldStarts);
+    printf(
+      "  messages queued, sent  %10lu %lu\n", sim.messagesQueued,
+      sim.messagesSent);
+    if (deep) {
+      printf("  state round trips      %10lu, errors %lu\n",
+        sleeper.deepSleeps, cycle.roundTripErrors);
+      if (cycle.roundTripErrors > 0 || cycle.coldStarts != 1) ret = 1;
+    }
+  }
+  // deep sleep must not cost messages
+  if (messages[1] + 1 < messages[0]) ret = 1;
+  return ret;
+}
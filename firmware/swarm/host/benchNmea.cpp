@@ -0,0 +1,108 @@
+/*
+ *  Micro-benchmark of decoding tile sentences
+ *
+ *  - SwarmNode::parseTime before NmeaDecoder (parseLine scans, strtol, and
+ *    mktime) against the current implementation
+ *  - NmeaDecoder::decode on a mix of all sentence types
+ *
+ *  usage: benchNmea [iterations=1000000]
+ */
+#include <Arduino.h>
+#include <chrono>
+#include <time.h>
+#include "swarmNode.h"
+#include "nmeaDecoder.h"
+
+
+volatile unsigned long sink;
+
+
+double wallNanos() {
+  return std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ *  SwarmNode::parseTime as it was implemented before NmeaDecoder
+ */
+unsigned long legacyParseTime(
+  SwarmNode &node, const char *timeResponse, const size_t len
+) {
+  char part[5];
+  struct tm time = {0};
+  if (!node.checkNmeaChecksum(timeResponse, len)) { return 0; }
+  if (node.parseLine(timeResponse, len, ",V*", 3) < 0 ) { return 0; }
+  if (len > 18 && node.parseLine(timeResponse, len, "$DT 2", 5) > -1) {
+    memcpy(part, timeResponse + 4, 4);
+    part[4] = '\0';
+    time.tm_year = strtol(part, NULL, 10) - 1900;
+    memcpy(part, timeResponse + 8, 2);
+    part[2] = '\0';
+    time.tm_mon = strtol(part, NULL, 10) - 1;
+    memcpy(part, timeResponse + 10, 2);
+    time.tm_mday = strtol(part, NULL, 10);
+    memcpy(part, timeResponse + 12, 2);
+    time.tm_hour = strtol(part, NULL, 10);
+    memcpy(part, timeResponse + 14, 2);
+    time.tm_min = strtol(part, NULL, 10);
+    memcpy(part, timeResponse + 16, 2);
+    time.tm_sec = strtol(part, NULL, 10);
+    if (validateTimeStruct(time)) { return mktime(&time); };
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  DisplayWrapperBase dspl;
+  SerialWrapperBase serial;
+  SwarmNode node(&dspl, &serial);
+  const char timeResponse[] = "$DT 20220913120000,V*40\n";
+  const size_t timeLen = sizeof(timeResponse) - 1;
+  const char *sentences[] = {
+    "$DT 20220913120000,V*40\n", "$GN 37.8000,-122.2700,12,0,0*3f\n",
+    "$GS 109,214,10,0,G3*7e\n", "$RT RSSI=-104*18\n", "$MT 5*0c\n",
+    "$TD OK,5354468575916*2c\n",
+    "$TD SENT,RSSI=-110,SNR=6,FDEV=0,5354468575901*6d\n",
+    "$M138 BOOT,RUNNING*2a\n"};
+  const size_t numberOfSentences = sizeof(sentences) / sizeof(sentences[0]);
+  size_t lengths[numberOfSentences];
+  for (size_t i=0; i<numberOfSentences; i++) lengths[i] = strlen(sentences[i]);
+
+  if (legacyParseTime(node, timeResponse, timeLen) != node.parseTime(timeResponse, timeLen)) {
+    printf("parseTime results differ\n");
+    return 1;
+  }
+
+  double start = wallNanos();
+  for (unsigned long i=0; i<iterations; i++) {
+    sink = legacyParseTime(node, timeResponse, timeLen);
+  }
+  const double legacy = (wallNanos() - start) / iterations;
+
+  start = wallNanos();
+  for (unsigned long i=0; i<iterations; i++) {
+    sink = node.parseTime(timeResponse, timeLen);
+  }
+  const double current = (wallNanos() - start) / iterations;
+
+  NmeaSentence sentence;
+  unsigned long decoded = 0;
+  start = wallNanos();
+  for (unsigned long i=0; i<iterations; i++) {
+    const size_t idx = i % numberOfSentences;
+    decoded += NmeaDecoder::decode(sentences[idx], lengths[idx], &sentence);
+    sink = sentence.type;
+  }
+  const double mixed = (wallNanos() - start) / iterations;
+
+  printf("parseTime, %lu iterations\n", iterations);
+  printf("  legacy (parseLine, strtol, mktime) %8.1f ns\n", legacy);
+  printf("  NmeaDecoder                        %8.1f ns\n", current);
+  printf("  speedup                            %8.1f x\n", legacy / current);
+  printf("NmeaDecoder::decode, mixed sentences %8.1f ns\n", mixed);
+  // every sentence in the mix carries a valid checksum
+  return decoded == iterations ? 0 : 1;
+}
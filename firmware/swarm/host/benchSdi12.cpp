@@ -0,0 +1,256 @@
+/*
+ *  Benchmark of SDI12Measurement against the simulated SDI-12 bus
+ *
+ *  - an ATMOS 41 on address 3 and TEROS 12 on addresses 5 and 6
+ *  - channel discovery with getChannels, getPayload on every channel one
+ *    after the other, concurrent measurements, and the loop_once state
+ *    machine
+ *  - discovery and getPayload with fixed 300 ms delays around every command
+ *    like before response driven transactions, for comparison
+ *  - concurrent measurements on a bus that drops responses and garbles bytes
+ *  - address changes to free and taken addresses
+ *  - reports simulated bus time, host wall-clock time, and the transaction
+ *    statistics per command type
+ *
+ *  usage: benchSdi12 [rounds=20]
+ */
+#include <Arduino.h>
+#include <chrono>
+#include "simulatedSdi12Bus.h"
+#include "sdi12Wrapper.h"
+
+
+/*
+ *  Simulated and host time of a series of runs
+ */
+class Timing {
+  private:
+    double _simulated = 0;
+    double _wall = 0;
+    unsigned long _count = 0;
+    uint64_t _simStart;
+    double _wallStart;
+    static double wallMicros() {
+      return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+  public:
+    void start() {
+      _simStart = VirtualClock::now();
+      _wallStart = wallMicros();
+    };
+    void stop() {
+      _simulated += (VirtualClock::now() - _simStart) / 1e3;
+      _wall += wallMicros() - _wallStart;
+      _count++;
+    };
+    double simulated() { return _count ? _simulated / _count : 0; };
+    void print(const char *name) {
+      printf(
+        "  %-34s %10.1f ms %10.1f us\n", name, simulated(),
+        _count ? _wall / _count : 0);
+    };
+};
+
+
+/*
+ *  SDI12Measurement::sendSDI12 before response driven transactions
+ */
+size_t legacySendSDI12(Sdi12BusBase &bus, const char *cmd, char *bfr) {
+  size_t i = 0;
+  bus.clearBuffer();
+  delay(300);
+  bus.sendCommand(cmd);
+  delay(300);
+  bfr[0] = 0;
+  while (bus.available()) {
+    char c = bus.read();
+    if ((c != '\n') && (c != '\r') && (i < SDI12_BUFFER_SIZE - 1)) {
+      bfr[i] = c;
+    } else {
+      bfr[i] = 0;
+      break;
+    }
+    i++;
+  }
+  return i;
+}
+
+size_t legacyGetChannels(Sdi12BusBase &bus, char *bfr) {
+  size_t idx = 0;
+  char rspns[SDI12_BUFFER_SIZE];
+  for (char i='0'; i<='9'; i++) {
+    char cmd[] = {i, 'I', '!', 0};
+    if (legacySendSDI12(bus, cmd, rspns) > 1) bfr[idx++] = i;
+  }
+  return idx;
+}
+
+size_t legacyGetPayload(Sdi12BusBase &bus, const char addr, char *bfr) {
+  char rspns[SDI12_BUFFER_SIZE];
+  char cmd[] = {addr, 'C', '!', 0, 0};
+  char address;
+  uint16_t seconds = 0;
+  uint8_t numberOfValues = 0;
+  size_t len = legacySendSDI12(bus, cmd, rspns);
+  size_t resIndex = 0;
+  uint16_t valuesReceived = 0;
+  Sdi12Parser::parseMeasurementResponse(
+    rspns, len, &address, &seconds, &numberOfValues);
+  delay(seconds * 1000UL);
+  bfr[0] = 0;
+  for (char i='0'; i<'8' && valuesReceived < numberOfValues; i++) {
+    char data[] = {addr, 'D', i, '!', 0};
+    len = legacySendSDI12(bus, data, rspns);
+    if (len == 0) break;
+    memcpy(bfr + resIndex, rspns + 1, len);
+    resIndex += len - 1;
+    valuesReceived += Sdi12Parser::count(rspns, len);
+  }
+  return resIndex;
+}
+
+void printStats(Sdi12Stats &stats) {
+  const char *names[] = {"a!", "aI!", "aM!", "aC!", "aDn!", "other"};
+  printf("  command  transactions  attempts  failures    mean time\n");
+  for (uint8_t i=0; i<SDI12_COMMAND_TYPES; i++) {
+    const Sdi12CommandStats &command = stats.commands[i];
+    if (command.transactions == 0) continue;
+    printf(
+      "  %-7s %13lu %9lu %9lu %9lu ms\n", names[i],
+      static_cast<unsigned long>(command.transactions),
+      static_cast<unsigned long>(command.attempts),
+      static_cast<unsigned long>(command.failures),
+      static_cast<unsigned long>(stats.averageTime(i)));
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned long rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 20;
+  SimulatedSdi12Bus bus;
+  bus.addAtmos41('3');
+  bus.addTeros12('5');
+  bus.addTeros12('6');
+  SDI12Measurement measurement(&bus);
+  Timing discovery, legacyDiscovery, sequential, legacySequential, concurrent;
+  Timing stateMachine;
+  char channels[10];
+  char bfr[256];
+  Sdi12Values values;
+  unsigned long errors = 0;
+  size_t n = 0;
+
+  for (unsigned long r=0; r<rounds; r++) {
+    discovery.start();
+    n = measurement.getChannels(channels);
+    discovery.stop();
+    if (n != 3 || memcmp(channels, "356", 3) != 0) errors++;
+
+    legacyDiscovery.start();
+    if (legacyGetChannels(bus, channels) != n) errors++;
+    legacyDiscovery.stop();
+
+    sequential.start();
+    for (size_t i=0; i<n; i++) {
+      measurement.getPayload(bfr, channels[i], &values);
+      if (strcmp(bfr, bus.values(channels[i])) != 0) errors++;
+    }
+    sequential.stop();
+
+    legacySequential.start();
+    for (size_t i=0; i<n; i++) {
+      legacyGetPayload(bus, channels[i], bfr);
+      if (strcmp(bfr, bus.values(channels[i])) != 0) errors++;
+    }
+    legacySequential.stop();
+
+    concurrent.start();
+    measurement.startMeasurements(channels, n);
+    int8_t idx;
+    while ((idx = measurement.waitForNextReady()) > -1) {
+      measurement.collectData(idx, bfr, &values);
+      if (strcmp(bfr, bus.values(channels[idx])) != 0) errors++;
+    }
+    concurrent.stop();
+
+    stateMachine.start();
+    measurement.takeMeasurement('3');
+    while (!measurement.measurementReady) measurement.loop_once();
+    stateMachine.stop();
+    if (strcmp(measurement.measurementBfr, bus.values('3')) != 0) errors++;
+  }
+
+  printf("%lu rounds, %u sensors                     simulated       host\n", rounds,
+    static_cast<unsigned int>(n));
+  discovery.print("getChannels");
+  legacyDiscovery.print("getChannels, fixed delays");
+  sequential.print("getPayload on every channel");
+  legacySequential.print("getPayload, fixed delays");
+  concurrent.print("concurrent measurements");
+  stateMachine.print("loop_once, address 3");
+  printf(
+    "  speedup discovery %.1f x, sequential %.1f x, concurrent %.1f x\n",
+    legacyDiscovery.simulated() / discovery.simulated(),
+    legacySequential.simulated() / sequential.simulated(),
+    legacySequential.simulated() / concurrent.simulated());
+  printStats(measurement.stats);
+
+  // address changes are confirmed, also if the confirmation got lost
+  const boolean moved = measurement.setChannel('6', '7');
+  const boolean taken = measurement.setChannel('7', '5');
+  const boolean missing = measurement.setChannel('9', '8');
+  bus.dropNext = 1;
+  const boolean lost = measurement.setChannel('7', '8');
+  printf(
+    "address changes: free %d, taken %d, no sensor %d, confirmation lost %d\n",
+    moved, taken, missing, lost);
+  if (!moved || taken || missing || !lost || measurement.getInfo(bfr, '8') == 0) {
+    errors++;
+  }
+
+  // the same bus with faults
+  SimulatedSdi12Bus faulty;
+  faulty.addAtmos41('3');
+  faulty.addTeros12('5');
+  faulty.addTeros12('6');
+  faulty.seed = 42;
+  faulty.dropRate = 0.05;
+  faulty.garbleRate = 0.002;
+  SDI12Measurement faultyMeasurement(&faulty);
+  Timing faultyConcurrent;
+  unsigned long complete = 0;
+  unsigned long corrupted = 0;
+  unsigned long incomplete = 0;
+  for (unsigned long r=0; r<rounds; r++) {
+    faultyConcurrent.start();
+    faultyMeasurement.startMeasurements("356", 3);
+    int8_t idx;
+    boolean collected[3] = {false, false, false};
+    while ((idx = faultyMeasurement.waitForNextReady()) > -1) {
+      faultyMeasurement.collectData(idx, bfr, &values);
+      collected[idx] = true;
+      if (strcmp(bfr, faulty.values("356"[idx])) == 0) {
+        complete++;
+      } else if (values.count == faultyMeasurement.concurrent[idx].numberOfValues) {
+        corrupted++;
+      } else {
+        incomplete++;
+      }
+    }
+    for (size_t i=0; i<3; i++) if (!collected[i]) incomplete++;
+    faultyConcurrent.stop();
+  }
+  printf(
+    "faulty bus, %.0f%% responses dropped, %.1f%% bytes garbled\n",
+    faulty.dropRate * 100, faulty.garbleRate * 100);
+  faultyConcurrent.print("concurrent measurements");
+  printf(
+    "  readings complete %lu, corrupted %lu, incomplete %lu\n", complete,
+    corrupted, incomplete);
+  printf(
+    "  responses dropped %lu, bytes garbled %lu, measurements aborted %lu\n",
+    faulty.responsesDropped, faulty.bytesGarbled, faulty.measurementsAborted);
+  printStats(faultyMeasurement.stats);
+  if (errors > 0) printf("%lu checks failed on the fault free bus\n", errors);
+  return errors == 0 ? 0 : 1;
+}
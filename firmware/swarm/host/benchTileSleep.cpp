@@ -0,0 +1,158 @@
+/*
+ *  Awake time of the tile with and without $SL between acquisition windows
+ *
+ *  - runs the loop of swarm.ino against the simulated tile and SDI-12 bus
+ *    for a number of days, once with the tile always awake and sending time
+ *    reports, once put to sleep by TileSleep whenever it has nothing to send
+ *  - a sleeping tile does not send, messages wait for the next satellite
+ *    pass while it is awake
+ *  - reports tile-awake seconds per day, the time reports received, the
+ *    $DT @ queries per sleep and wake-up and the messages sent
+ *
+ *  usage: benchTileSleep [days=7] [sendFrequency=3600]
+ */
+#include <Arduino.h>
+#include "simulatedTile.h"
+#include "simulatedSdi12Bus.h"
+#include "simulatedSleep.h"
+#include "swarmNode.h"
+#include "sdi12Wrapper.h"
+#include "messages.h"
+#include "tileSleep.h"
+
+
+#define DEEP_SLEEP_LEAD 5
+
+const unsigned long tileTimeFrequency = 20;
+
+
+typedef struct {
+  double tileAwakePerDay;
+  unsigned long timeReports;
+  unsigned long timeQueries;
+  unsigned long sleeps;
+  unsigned long wakeUps;
+  unsigned long failedWakeUps;
+  unsigned long messagesQueued;
+  unsigned long messagesSent;
+  unsigned long late;
+} Result;
+
+
+/*
+ *  setup() and loop() of swarm.ino with light sleep, the tile sleeps if
+ *  useTileSleep
+ */
+Result simulate(const unsigned long days, const unsigned long sendFrequency,
+  const boolean useTileSleep
+) {
+  VirtualClock::reset();
+  SimulatedTile sim;
+  SimulatedSdi12Bus bus;
+  bus.addAtmos41('3');
+  bus.addTeros12('5');
+  SimulatedSleep sleeper;
+  DisplayWrapperBase dspl;
+  SwarmNode tile(&dspl, &sim, false);
+  SDI12Measurement measurement(&bus);
+  TileSleep tileSleep;
+  Result result = {0};
+  char bfr[MAX_MESSAGE_LENGTH];
+  char availableChannels[10] = {0};
+  const int numberOfChannels = measurement.getChannels(availableChannels);
+  int messageCounter = 0;
+  unsigned long nextScheduled = 0;
+  unsigned long timeReports = 0;
+  tile.begin(tileTimeFrequency);
+  const uint64_t start = VirtualClock::now();
+  const uint64_t end = start + days * 86400000000ULL;
+  while (VirtualClock::now() < end) {
+    unsigned long tileTime = 0;
+    if (tileSleep.asleep) {
+      tileTime = tile.queryTime();
+      tileSleep.woke();
+      result.wakeUps++;
+      if (tileTime == 0) result.failedWakeUps++;
+    }
+    if (tileTime == 0) {
+      tileTime = tile.waitForTimeStamp();
+      timeReports++;
+    }
+    if (tileTime > nextScheduled) {
+      // later than the time report after the schedule
+      if (nextScheduled > 0 && tileTime > nextScheduled + tileTimeFrequency) result.late++;
+      Message message = {0};
+      message.index = messageCounter;
+      message.timeStamp = tileTime;
+      message.batteryVoltage = 3.85;
+      memcpy(message.type, "SC", 2);
+      measurement.startMeasurements(availableChannels, numberOfChannels);
+      for (int i=0; i<numberOfChannels; i++) {
+        message.payloads[i].channel = availableChannels[i];
+      }
+      int8_t i;
+      while ((i = measurement.waitForNextReady()) > -1) {
+        measurement.collectData(
+          i, message.payloads[i].payload, &message.payloads[i].values);
+      }
+      tile.queueMessage(bfr, MessageHelpers::encodeMessage(message, bfr));
+      nextScheduled = MessageHelpers::getNextScheduled(tileTime, sendFrequency);
+      messageCounter++;
+    }
+    tile.waitForCommands();
+    unsigned long sleepS = 0;
+    if (useTileSleep) {
+      // sleepTile() of swarm.ino, the messages go to the tile right away
+      if (TileSleep::duration(
+          tileTime, nextScheduled, tileTimeFrequency, DEEP_SLEEP_LEAD) > 0
+        && tile.unsentMessages() == 0
+      ) {
+        const unsigned long duration = TileSleep::duration(
+          tile.queryTime(), nextScheduled, tileTimeFrequency, DEEP_SLEEP_LEAD);
+        if (duration > 0 && tile.sleep(duration)) sleepS = tileSleep.slept(duration);
+      }
+    }
+    sleeper.lightSleep(sleepS > 0 ? sleepS : tileTimeFrequency);
+  }
+  const double total = (VirtualClock::now() - start) / 1e6;
+  result.tileAwakePerDay = (total - sim.sleepTime / 1e6) * 86400 / total;
+  result.timeReports = timeReports;
+  result.timeQueries = sim.timeQueries;
+  result.sleeps = sim.sleeps;
+  result.messagesQueued = sim.messagesQueued;
+  result.messagesSent = sim.messagesSent;
+  return result;
+}
+
+void print(const char *name, const Result &result, const unsigned long days) {
+  printf("%s\n", name);
+  printf("  tile awake per day     %10.1f s\n", result.tileAwakePerDay);
+  printf("  time reports per day   %10.1f\n", static_cast<double>(result.timeReports) / days);
+  printf("  sleeps, wake-ups, $DT @ %9lu %lu %lu (%lu failed)\n",
+    result.sleeps, result.wakeUps, result.timeQueries, result.failedWakeUps);
+  printf("  messages queued, sent  %10lu %lu, %lu late\n",
+    result.messagesQueued, result.messagesSent, result.late);
+}
+
+int main(int argc, char **argv) {
+  const unsigned long days = argc > 1 ? strtoul(argv[1], NULL, 10) : 7;
+  const unsigned long sendFrequency = argc > 2 ? strtoul(argv[2], NULL, 10) : 3600;
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  printf("%lu days, sending every %lu s\n", days, sendFrequency);
+  const Result awake = simulate(days, sendFrequency, false);
+  print("tile always awake", awake, days);
+  const Result sleeping = simulate(days, sendFrequency, true);
+  print("tile sleeps between windows", sleeping, days);
+  printf("  tile awake time saved  %10.1f %%\n",
+    100. * (1 - sleeping.tileAwakePerDay / awake.tileAwakePerDay));
+  // one $DT @ per sleep and wake-up, no message lost or late, and less
+  // awake time
+  int ret = 0;
+  if (sleeping.timeQueries != sleeping.sleeps + sleeping.wakeUps) ret = 1;
+  if (sleeping.failedWakeUps > 0) ret = 1;
+  if (sleeping.messagesQueued != awake.messagesQueued || sleeping.late > 0) ret = 1;
+  if (sleeping.messagesSent + 1 < sleeping.messagesQueued) ret = 1;
+  if (sleeping.tileAwakePerDay >= awake.tileAwakePerDay) ret = 1;
+  return ret;
+}
@@ -0,0 +1,103 @@
+/*
+ *  Decode stored messages in bulk into one wide CSV, e.g. to backfill a
+ *  database with months of data; see payloadDecoder.h for the formats
+ *
+ *  - reads hive messages as JSON lines or text messages like
+ *    tools/extract.csv, from files or stdin
+ *  - writes the rows to stdout or the file given with -o, statistics of
+ *    the run go to stderr
+ *  - fails if a message can't be decoded
+ *
+ *  usage: decodeMessages [-o out.csv] [input ...]
+ */
+#include <Arduino.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "payloadDecoder.h"
+
+#define READ_BUFFER 1048576
+
+
+/*
+ *  Hand every line of a file to the decoder, lines are decoded in place
+ */
+template <class Decoder>
+boolean decodeFile(FILE *in, Decoder &decoder, unsigned long &lines) {
+  static char bfr[READ_BUFFER];
+  size_t len = 0;
+  size_t n;
+  while ((n = fread(bfr + len, 1, sizeof(bfr) - len, in)) > 0) {
+    len += n;
+    size_t start = 0;
+    const char *newline;
+    while ((newline = static_cast<const char *>(
+      memchr(bfr + start, '\n', len - start))) != NULL
+    ) {
+      decoder.decodeLine(bfr + start, newline - (bfr + start));
+      lines++;
+      start = newline - bfr + 1;
+    }
+    if (start == 0 && len == sizeof(bfr)) {
+      fprintf(stderr, "line longer than %d bytes\n", READ_BUFFER);
+      return false;
+    }
+    memmove(bfr, bfr + start, len - start);
+    len -= start;
+  }
+  if (len > 0) {
+    decoder.decodeLine(bfr, len);
+    lines++;
+  }
+  return !ferror(in);
+}
+
+int main(int argc, char **argv) {
+  const char *output = NULL;
+  std::vector<const char *> inputs;
+  for (int i=1; i<argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (argv[i][0] == '-' && argv[i][1] != 0) {
+      fprintf(stderr, "usage: decodeMessages [-o out.csv] [input ...]\n");
+      return 1;
+    } else {
+      inputs.push_back(argv[i]);
+    }
+  }
+  if (inputs.empty()) inputs.push_back("-");
+  FILE *out = output == NULL ? stdout : fopen(output, "w");
+  if (out == NULL) {
+    fprintf(stderr, "can't write %s\n", output);
+    return 1;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  unsigned long lines = 0;
+  boolean ok = true;
+  {
+    WideCsvWriter writer(out);
+    PayloadDecoder<WideCsvWriter> decoder(writer);
+    writer.header();
+    for (const char *input : inputs) {
+      FILE *in = strcmp(input, "-") == 0 ? stdin : fopen(input, "r");
+      if (in == NULL) {
+        fprintf(stderr, "can't read %s\n", input);
+        ok = false;
+        continue;
+      }
+      ok = decodeFile(in, decoder, lines) && ok;
+      if (in != stdin) fclose(in);
+    }
+    writer.flush();
+    const double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr,
+      "%lu lines, %lu messages, %lu failed, %lu skipped, %lu rows, %.1f MB "
+      "in %.3f s, %.0f messages/s\n",
+      lines, decoder.messages, decoder.failed, decoder.skipped, decoder.rows,
+      writer.bytes / 1e6, seconds, decoder.messages / seconds);
+    ok = ok && decoder.failed == 0;
+  }
+  if (out != stdout) fclose(out);
+  return ok ? 0 : 1;
+}
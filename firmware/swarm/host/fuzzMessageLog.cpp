@@ -0,0 +1,247 @@
+/*
+ *  Power loss fuzzing of the store-and-forward log (../src/messageLog.h)
+ *
+ *  - runs a workload of appends and acknowledgements on a small simulated
+ *    flash that wraps several times, once without faults to record the
+ *    messages pending after every step, then again for every single write
+ *    offset and erase with power cut right there
+ *  - after every power cut the log is mounted again and must hold exactly
+ *    the messages pending before or after the interrupted step, nothing
+ *    corrupted and nothing that was already safe lost; it must take new
+ *    messages and still have them after another restart
+ *  - wear of the segments with the default partition size
+ *  - replay through the simulated tile with a full queue, and with an
+ *    outage longer than the hold duration of $TD, with and without the log
+ *
+ *  usage: fuzzMessageLog [steps=120]
+ */
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "simulatedFlash.h"
+#include "simulatedTile.h"
+#include "swarmNode.h"
+#include "messageLog.h"
+#include "messages.h"
+
+
+#define FUZZ_SEGMENTS 4
+#define FUZZ_SECTOR_SIZE 512
+
+// pending messages by sequence number
+typedef std::map<uint32_t, std::string> Snapshot;
+
+
+std::string message(const uint32_t i) {
+  char bfr[LOG_MAX_RECORD_LENGTH + 1];
+  size_t len = 8 + (i * 37) % (LOG_MAX_RECORD_LENGTH - 8);
+  snprintf(bfr, sizeof(bfr), "%07lu,", static_cast<unsigned long>(i));
+  for (size_t j=8; j<len; j++) bfr[j] = 'a' + (i + j) % 26;
+  return std::string(bfr, len);
+}
+
+/*
+ *  Appends with the two oldest messages acknowledged every fourth step, the
+ *  log falls behind and has to drop messages when it wraps
+ */
+void step(MessageLog &log, const uint32_t i) {
+  if (i % 4 == 3) {
+    char bfr[LOG_MAX_RECORD_LENGTH];
+    LogRecord record;
+    for (uint8_t j=0; j<2 && log.readPending(record, bfr); j++) {
+      if (!log.acknowledge(record)) return;
+    }
+  } else {
+    std::string text = message(i);
+    log.append(text.data(), text.size());
+  }
+}
+
+Snapshot pending(MessageLog &log) {
+  Snapshot ret;
+  char bfr[LOG_MAX_RECORD_LENGTH];
+  LogRecord record;
+  uint32_t after = 0;
+  while (log.readPending(record, bfr, after)) {
+    ret[record.sequence] = std::string(bfr, record.len);
+    after = record.sequence;
+  }
+  return ret;
+}
+
+/*
+ *  Power cut after the given number of flash operations, returns the
+ *  number of violated expectations
+ */
+unsigned long fuzz(
+  const uint64_t operations, const uint32_t steps,
+  const std::vector<Snapshot> &snapshots
+) {
+  unsigned long errors = 0;
+  SimulatedFlash flash(FUZZ_SEGMENTS * FUZZ_SECTOR_SIZE, FUZZ_SECTOR_SIZE);
+  MessageLog log(&flash);
+  log.begin();
+  flash.losePowerAfter(operations, operations + 1);
+  uint32_t i = 0;
+  for (; i<steps; i++) {
+    step(log, i);
+    if (flash.powerLost) break;
+  }
+  if (!flash.powerLost) return 1;
+  flash.powerOn();
+  MessageLog recovered(&flash);
+  if (!recovered.begin()) return 1;
+  Snapshot found = pending(recovered);
+  if (found.size() != recovered.numberOfPending) errors++;
+  const Snapshot &before = snapshots[i];
+  const Snapshot &after = snapshots[i + 1];
+  // nothing that was not there
+  for (Snapshot::const_iterator it=found.begin(); it!=found.end(); it++) {
+    Snapshot::const_iterator b = before.find(it->first);
+    Snapshot::const_iterator a = after.find(it->first);
+    if (!(b != before.end() && b->second == it->second) &&
+      !(a != after.end() && a->second == it->second)
+    ) {
+      errors++;
+    }
+  }
+  // nothing lost that was not touched by the step
+  for (Snapshot::const_iterator it=before.begin(); it!=before.end(); it++) {
+    if (after.count(it->first) && !found.count(it->first)) errors++;
+  }
+  // and it goes on
+  std::string text = message(1000000 + operations);
+  if (!recovered.append(text.data(), text.size())) errors++;
+  MessageLog restarted(&flash);
+  restarted.begin();
+  Snapshot again = pending(restarted);
+  if (again.empty() || again.rbegin()->second != text) errors++;
+  if (again.size() != found.size() + 1 - recovered.numberOfDropped) errors++;
+  return errors;
+}
+
+/*
+ *  Messages faster than the tile sends them, one per satellite pass, and it
+ *  holds at most queueLimit; the rejected ones are tried again every cycle.
+ *  With an outage the tile sees no satellite for that many hours at the
+ *  start and drops what it held longer than the hold duration.
+ */
+void replay(
+  const boolean useLog, const unsigned long hours,
+  const unsigned long outageHours, unsigned long &produced,
+  unsigned long &sent, unsigned long &rejected, unsigned long &left
+) {
+  const unsigned long sendFrequency = outageHours > 0 ? 3600 : 450;
+  VirtualClock::reset();
+  SimulatedTile sim;
+  sim.queueLimit = outageHours > 0 ? 0 : 4;
+  sim.satellitesVisible = outageHours == 0;
+  DisplayWrapperBase dspl;
+  SwarmNode tile(&dspl, &sim, false);
+  SimulatedFlash flash;
+  MessageLog log(&flash);
+  log.begin();
+  tile.begin(20);
+  unsigned long nextScheduled = 0;
+  produced = 0;
+  const uint64_t end = VirtualClock::now() + hours * 3600000000ULL;
+  // messages for the first half, the second half catches up
+  const uint64_t stop = VirtualClock::now() + hours * 1800000000ULL;
+  const uint64_t visible = VirtualClock::now() + outageHours * 3600000000ULL;
+  while (VirtualClock::now() < end) {
+    unsigned long tileTime = tile.waitForTimeStamp();
+    if (VirtualClock::now() >= visible) sim.satellitesVisible = true;
+    if (tileTime > nextScheduled && VirtualClock::now() < stop) {
+      std::string text = message(produced++);
+      if (useLog) {
+        log.append(text.data(), text.size());
+      } else {
+        tile.queueMessage(text.data(), text.size());
+      }
+      nextScheduled = MessageHelpers::getNextScheduled(tileTime, sendFrequency);
+    }
+    if (useLog) tile.forwardMessages(log, 4, tileTime);
+    tile.waitForCommands();
+    delay(20000);
+  }
+  sent = sim.messagesSent;
+  rejected = sim.messagesRejected;
+  left = log.numberOfPending;
+}
+
+int main(int argc, char **argv) {
+  uint32_t steps = argc > 1 ? strtoul(argv[1], NULL, 10) : 120;
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  int ret = 0;
+
+  // pending messages before every step without faults
+  std::vector<Snapshot> snapshots;
+  SimulatedFlash reference(FUZZ_SEGMENTS * FUZZ_SECTOR_SIZE, FUZZ_SECTOR_SIZE);
+  MessageLog log(&reference);
+  log.begin();
+  snapshots.push_back(pending(log));
+  for (uint32_t i=0; i<steps; i++) {
+    step(log, i);
+    snapshots.push_back(pending(log));
+  }
+  // one more, power is never cut after the last step
+  snapshots.push_back(snapshots.back());
+  printf(
+    "%lu steps, %lu flash operations, %lu pending, %lu dropped\n",
+    static_cast<unsigned long>(steps), reference.operations,
+    static_cast<unsigned long>(log.numberOfPending),
+    static_cast<unsigned long>(log.numberOfDropped));
+  unsigned long failed = 0;
+  for (uint64_t n=0; n<reference.operations; n++) {
+    if (fuzz(n, steps, snapshots) > 0) {
+      if (failed == 0) printf("  first failure with power cut after %llu\n",
+        static_cast<unsigned long long>(n));
+      failed++;
+    }
+  }
+  printf("  power cuts %lu, failed %lu\n", reference.operations, failed);
+  if (failed > 0) ret = 1;
+
+  // wear, a year of hourly messages
+  SimulatedFlash flash;
+  MessageLog wear(&flash);
+  wear.begin();
+  for (uint32_t i=0; i<8760; i++) {
+    std::string text = message(i);
+    LogRecord record;
+    char bfr[LOG_MAX_RECORD_LENGTH];
+    wear.append(text.data(), text.size());
+    if (wear.readPending(record, bfr)) wear.acknowledge(record);
+  }
+  unsigned long minErases = flash.erases(0);
+  unsigned long maxErases = 0;
+  for (uint32_t i=0; i<LOG_MAX_SEGMENTS; i++) {
+    if (flash.erases(i) < minErases) minErases = flash.erases(i);
+    if (flash.erases(i) > maxErases) maxErases = flash.erases(i);
+  }
+  printf("8760 messages, erases per segment %lu to %lu\n", minErases, maxErases);
+  if (maxErases - minErases > 1 || wear.numberOfDropped > 0) ret = 1;
+
+  unsigned long produced, sent, rejected, left;
+  printf("replay, tile queue of 4 messages, 24 hours\n");
+  replay(false, 24, 0, produced, sent, rejected, left);
+  printf(
+    "  without log  messages %4lu, sent %4lu, rejected by the tile %4lu\n",
+    produced, sent, rejected);
+  replay(true, 24, 0, produced, sent, rejected, left);
+  printf(
+    "  with log     messages %4lu, sent %4lu, rejected by the tile %4lu\n",
+    produced, sent, rejected);
+  if (sent != produced || left > 0) ret = 1;
+  printf("replay, hourly messages, no satellite for 30 of 72 hours\n");
+  replay(false, 72, 30, produced, sent, rejected, left);
+  printf("  without log  messages %4lu, sent %4lu\n", produced, sent);
+  replay(true, 72, 30, produced, sent, rejected, left);
+  printf(
+    "  with log     messages %4lu, sent %4lu, left in the log %lu\n",
+    produced, sent, left);
+  if (sent != produced || left > 0) ret = 1;
+  return ret;
+}
@@ -0,0 +1,151 @@
+/*
+ *  Generate the sensor tables of payload_decoder/decoder.js from
+ *  ../src/sensorSchema.h so that encoder and decoder can't drift apart
+ *
+ *  - replaces everything between SCHEMA_BEGIN and SCHEMA_END in decoder.js
+ *  - with --check nothing is written, it fails if decoder.js is not up to
+ *    date; this runs as a test
+ *
+ *  usage: generateSchema [--check] decoder.js
+ */
+#include <Arduino.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "sensorSchema.h"
+
+#define SCHEMA_BEGIN "// BEGIN generated by firmware/swarm/host/generateSchema.cpp"
+#define SCHEMA_END "// END generated by firmware/swarm/host/generateSchema.cpp"
+// eslint google style
+#define LINE_LENGTH 80
+
+
+/*
+ *  One entry of a table like '51': [...], wrapped like the rest of
+ *  decoder.js
+ */
+std::string entry(const uint8_t channel, const std::vector<std::string> &items) {
+  std::string head = "  '" + std::to_string(channel) + "': [";
+  std::string joined;
+  for (size_t i=0; i<items.size(); i++) {
+    joined += (i > 0 ? ", " : "") + items[i];
+  }
+  if (head.size() + joined.size() + 2 <= LINE_LENGTH) {
+    return head + joined + "],\n";
+  }
+  std::string ret = head + "\n";
+  std::string line = "   ";
+  for (size_t i=0; i<items.size(); i++) {
+    std::string item = " " + items[i] + (i + 1 < items.size() ? "," : "],");
+    if (line.size() + item.size() > LINE_LENGTH) {
+      ret += line + "\n";
+      line = "   ";
+    }
+    line += item;
+  }
+  return ret + line + "\n";
+}
+
+std::string quoted(const char *text) {
+  return "'" + std::string(text) + "'";
+}
+
+std::string number(const float value) {
+  std::ostringstream out;
+  out << value;
+  return out.str();
+}
+
+std::string generate() {
+  std::string names;
+  std::string decimals;
+  std::string units;
+  std::string ranges;
+  std::string accumulators;
+  std::string directions;
+  for (size_t i=0; i<NUMBER_OF_SENSOR_SCHEMAS; i++) {
+    const SensorSchema &schema = sensorSchemas[i];
+    std::vector<std::string> n, d, u, r, a, w;
+    for (uint8_t j=0; j<schema.numberOfFields; j++) {
+      const FieldSchema &field = schema.fields[j];
+      n.push_back(quoted(field.name));
+      d.push_back(std::to_string(field.decimals));
+      u.push_back(quoted(field.unit));
+      r.push_back("[" + number(field.min) + ", " + number(field.max) + "]");
+      if (field.aggregation == FIELD_ACCUMULATOR) a.push_back(quoted(field.name));
+      if (field.aggregation == FIELD_DIRECTION) w.push_back(quoted(field.name));
+    }
+    names += entry(schema.channel, n);
+    decimals += entry(schema.channel, d);
+    units += entry(schema.channel, u);
+    ranges += entry(schema.channel, r);
+    if (!a.empty()) accumulators += entry(schema.channel, a);
+    if (!w.empty()) directions += entry(schema.channel, w);
+  }
+  return std::string(SCHEMA_BEGIN) + "\n"
+    "// from firmware/swarm/src/sensorSchema.h, do not edit\n"
+    "/**\n"
+    "    * Field names by SDI-12 address\n"
+    "*/\n"
+    "const tncSpecificLookup = {\n" + names + "};\n\n"
+    "/**\n"
+    "    * Precision of the fields in tncSpecificLookup, used to decode binary\n"
+    "    * messages\n"
+    "*/\n"
+    "const tncSpecificDecimals = {\n" + decimals + "};\n\n"
+    "/**\n"
+    "    * Units of the fields in tncSpecificLookup\n"
+    "*/\n"
+    "const tncSpecificUnits = {\n" + units + "};\n\n"
+    "/**\n"
+    "    * Valid range of the fields in tncSpecificLookup, readings outside\n"
+    "    * of it are sensor errors\n"
+    "*/\n"
+    "const tncSpecificRanges = {\n" + ranges + "};\n\n"
+    "/**\n"
+    "    * Fields that count or sum up since the last reading, aggregated as\n"
+    "    * sum and max\n"
+    "*/\n"
+    "const tncSpecificAccumulators = {\n" + accumulators + "};\n\n"
+    "/**\n"
+    "    * Angles in degrees, aggregated as circular mean and standard\n"
+    "    * deviation\n"
+    "*/\n"
+    "const tncSpecificDirections = {\n" + directions + "};\n" +
+    SCHEMA_END;
+}
+
+int main(int argc, char **argv) {
+  const boolean check = argc > 2 && std::string(argv[1]) == "--check";
+  if (argc < 2 || (argc > 2 && !check)) {
+    printf("usage: generateSchema [--check] decoder.js\n");
+    return 1;
+  }
+  const char *path = argv[argc - 1];
+  std::ifstream in(path);
+  std::stringstream bfr;
+  bfr << in.rdbuf();
+  std::string text = bfr.str();
+  size_t begin = text.find(SCHEMA_BEGIN);
+  size_t end = text.find(SCHEMA_END);
+  if (begin == std::string::npos || end == std::string::npos || end < begin) {
+    printf("no generated section in %s\n", path);
+    return 1;
+  }
+  end += strlen(SCHEMA_END);
+  const std::string generated = generate();
+  if (text.compare(begin, end - begin, generated) == 0) {
+    printf("%s is up to date\n", path);
+    return 0;
+  }
+  if (check) {
+    printf("%s differs from sensorSchema.h, run generateSchema %s\n", path, path);
+    return 1;
+  }
+  text.replace(begin, end - begin, generated);
+  std::ofstream out(path);
+  out << text;
+  printf("%s updated\n", path);
+  return 0;
+}
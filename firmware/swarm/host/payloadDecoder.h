@@ -0,0 +1,760 @@
+/*
+ *  Decoding of stored messages on the host, e.g. to reprocess months of
+ *  data at once; the formats of payload_decoder/decoder.js
+ *
+ *  - input lines are either hive API messages as JSON, one per line, with
+ *    the message as base64 in "data", or messages as text like in
+ *    tools/extract.csv
+ *  - a message becomes one or more rows: one per epoch of a batch, one per
+ *    statistic of a summary
+ *  - every field of ../src/sensorSchema.h has its own column, values of other
+ *    channels go into one text column as channel:value;value
+ *  - nothing is allocated per line, rows are handed to a sink as they are
+ *    decoded and the CSV is written through a fixed buffer
+ */
+#ifndef _PAYLOAD_DECODER_H_
+#define _PAYLOAD_DECODER_H_
+
+#include <Arduino.h>
+#include <stdio.h>
+#include "sensorSchema.h"
+#include "sdi12Parser.h"
+#include "messages.h"
+#include "batch.h"
+#include "aggregate.h"
+#include "downlink.h"
+
+#define DECODER_MAX_OTHER 512
+#define DECODER_OUTPUT_BUFFER 65536
+
+
+constexpr size_t schemaColumns(const size_t i) {
+  return i == NUMBER_OF_SENSOR_SCHEMAS
+    ? 0 : sensorSchemas[i].numberOfFields + schemaColumns(i + 1);
+}
+
+constexpr size_t firstColumn(const size_t i) {
+  return i == 0 ? 0 : firstColumn(i - 1) + sensorSchemas[i - 1].numberOfFields;
+}
+
+#define DECODED_COLUMNS schemaColumns(0)
+static_assert(DECODED_COLUMNS <= 64, "present is a 64 bit mask");
+
+
+typedef struct {
+  // of hive messages, empty for text input
+  const char *device;
+  size_t deviceLength;
+  const char *rxTime;
+  size_t rxTimeLength;
+  unsigned long index;
+  unsigned long timeStamp;
+  // 0.01V
+  int32_t batteryVoltage;
+  // NULL for readings, otherwise min, mean, max, stdDev or sum
+  const char *statistic;
+  // readings a summary was made of, 1 otherwise
+  uint32_t samples;
+  // readings left out of a summary for values out of range
+  uint32_t rejected;
+  // bit i is set if column i has a value
+  uint64_t present;
+  int64_t mantissas[DECODED_COLUMNS];
+  uint8_t decimals[DECODED_COLUMNS];
+  // channels not in sensorSchema.h
+  char other[DECODER_MAX_OTHER];
+  size_t otherLength;
+} DecodedRow;
+
+
+/*
+ *  Sink is called as sink(row) for every decoded row
+ */
+template <class Sink>
+class PayloadDecoder {
+  private:
+    Sink &_sink;
+    DecodedRow _row;
+    uint8_t _bytes[256];
+
+    static boolean readVarint(
+      const uint8_t *bytes, const size_t len, size_t &pos, uint64_t &value
+    ) {
+      value = 0;
+      for (uint8_t shift=0; shift<64 && pos<len; shift+=7) {
+        const uint8_t byte = bytes[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+      }
+      return false;
+    };
+
+    static int64_t unzigzag(const uint64_t value) {
+      return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    };
+
+    static boolean readUint32(
+      const uint8_t *bytes, const size_t len, size_t &pos, unsigned long &value
+    ) {
+      if (pos + 4 > len) return false;
+      value = 0;
+      for (uint8_t i=0; i<4; i++) value |= static_cast<unsigned long>(bytes[pos++]) << (8 * i);
+      return true;
+    };
+
+    /*
+     *  Digits of a number like 3.59, -12, or 000549 as fixed point
+     */
+    static boolean parseFixed(
+      const char *text, const size_t len, int64_t &mantissa, uint8_t &decimals
+    ) {
+      size_t idx = 0;
+      boolean negative = false;
+      boolean fraction = false;
+      uint8_t digits = 0;
+      mantissa = 0;
+      decimals = 0;
+      if (idx < len && (text[idx] == '+' || text[idx] == '-')) {
+        negative = text[idx++] == '-';
+      }
+      for (; idx<len; idx++) {
+        const char c = text[idx];
+        if (c >= '0' && c <= '9') {
+          if (++digits > 18) return false;
+          mantissa = mantissa * 10 + (c - '0');
+          if (fraction) decimals++;
+        } else if (c == '.' && !fraction) {
+          fraction = true;
+        } else {
+          return false;
+        }
+      }
+      if (negative) mantissa = -mantissa;
+      return digits > 0;
+    };
+
+    void appendOther(const char *text, const size_t len) {
+      if (_row.otherLength + len >= DECODER_MAX_OTHER) return;
+      memcpy(_row.other + _row.otherLength, text, len);
+      _row.otherLength += len;
+    };
+
+    void appendOther(const int64_t mantissa, const uint8_t decimals) {
+      char bfr[24];
+      appendOther(bfr, formatFixed(mantissa, decimals, bfr));
+    };
+
+    void emit() {
+      rows++;
+      _sink(_row);
+    };
+
+    void beginRow() {
+      _row.statistic = NULL;
+      _row.samples = 1;
+      _row.rejected = 0;
+      _row.present = 0;
+      _row.otherLength = 0;
+    };
+
+    void setValue(const size_t column, const int64_t mantissa, const uint8_t decimals) {
+      _row.mantissas[column] = mantissa;
+      _row.decimals[column] = decimals;
+      _row.present |= 1ULL << column;
+    };
+
+    /*
+     *  Values of one channel, count and decimals as encoded. Values of known
+     *  sensors go into their columns, a value i is left out if it has no
+     *  bit of mask in has[i].
+     */
+    void setChannel(
+      const uint8_t channel, const boolean known, const uint8_t count,
+      const int64_t *mantissas, const uint8_t *decimals,
+      const uint8_t *has = NULL, const uint8_t mask = 0
+    ) {
+      const SensorSchema *schema = known ? findSensorSchema(channel) : NULL;
+      if (schema != NULL && schema->numberOfFields == count) {
+        const size_t first = firstColumn(channel - SENSOR_FIRST_CHANNEL);
+        for (uint8_t i=0; i<count; i++) {
+          if (has != NULL && (has[i] & mask) == 0) continue;
+          setValue(first + i, mantissas[i], decimals[i]);
+        }
+        return;
+      }
+      if (has != NULL) {
+        uint8_t any = 0;
+        for (uint8_t i=0; i<count; i++) any |= has[i];
+        if ((any & mask) == 0) return;
+      }
+      char bfr[8];
+      if (_row.otherLength > 0) appendOther(" ", 1);
+      appendOther(bfr, snprintf(bfr, sizeof(bfr), "%u:", channel));
+      for (uint8_t i=0; i<count; i++) {
+        if (i > 0) appendOther(";", 1);
+        if (has != NULL && (has[i] & mask) == 0) continue;
+        appendOther(mantissas[i], decimals[i]);
+      }
+    };
+
+    /*
+     *  index,timeStamp,batteryVoltage,SC,channel,payload,... or the layout
+     *  of the first firmware index,timeStamp,SC,channel,payload,battery
+     */
+    boolean decodeText(const char *text, const size_t len) {
+      const char *fields[16];
+      size_t lengths[16];
+      uint8_t n = 0;
+      size_t start = 0;
+      for (size_t i=0; i<=len && n<16; i++) {
+        if (i == len || text[i] == ',') {
+          fields[n] = text + start;
+          lengths[n] = i - start;
+          n++;
+          start = i + 1;
+        }
+      }
+      // trailing spaces and empty fields
+      while (n > 0 && (lengths[n-1] == 0 || fields[n-1][0] == ' ')) n--;
+      if (n < 4) return false;
+      int64_t mantissa;
+      uint8_t decimals;
+      beginRow();
+      if (!parseFixed(fields[0], lengths[0], mantissa, decimals)) return false;
+      _row.index = mantissa;
+      if (!parseFixed(fields[1], lengths[1], mantissa, decimals)) return false;
+      _row.timeStamp = mantissa;
+      // channel and payload pairs follow SC up to last
+      uint8_t type = 3;
+      uint8_t last = n;
+      const char *battery = fields[2];
+      size_t batteryLength = lengths[2];
+      if (lengths[2] == 2 && memcmp(fields[2], "SC", 2) == 0) {
+        type = 2;
+        last = n - 1;
+        battery = fields[n-1];
+        batteryLength = lengths[n-1];
+      } else if (lengths[3] != 2 || memcmp(fields[3], "SC", 2) != 0) {
+        return false;
+      }
+      if (!parseFixed(battery, batteryLength, mantissa, decimals)) return false;
+      _row.batteryVoltage = Sdi12Parser::rescale(mantissa, decimals, 2);
+      for (uint8_t i=type+1; i+1<last; i+=2) {
+        if (!parseFixed(fields[i], lengths[i], mantissa, decimals)) return false;
+        const uint8_t channel = mantissa;
+        Sdi12Values values;
+        if (!Sdi12Parser::parse(fields[i+1], lengths[i+1], values)) {
+          // a sensor error like 0ERROR+0.21 is kept as it is
+          char bfr[8];
+          if (_row.otherLength > 0) appendOther(" ", 1);
+          appendOther(bfr, snprintf(bfr, sizeof(bfr), "%u:", channel));
+          appendOther(fields[i+1], lengths[i+1]);
+          continue;
+        }
+        int64_t mantissas[SDI12_MAX_VALUES];
+        for (uint8_t j=0; j<values.count; j++) mantissas[j] = values.mantissas[j];
+        setChannel(channel, true, values.count, mantissas, values.decimals);
+      }
+      emit();
+      return true;
+    };
+
+    /*
+     *  Layout of a batch or summary: channel, count, decimals; the
+     *  CHANNEL_OUT_OF_RANGE flag is kept apart from the count
+     */
+    typedef struct {
+      uint8_t numberOfChannels;
+      uint8_t channels[5];
+      uint8_t counts[5];
+      boolean outOfRange[5];
+      uint8_t numberOfValues;
+      uint8_t decimals[MAX_MESSAGE_VALUES];
+    } Layout;
+
+    boolean readLayout(const uint8_t *bytes, const size_t len, size_t &pos, Layout &layout) {
+      if (pos >= len) return false;
+      layout.numberOfChannels = bytes[pos++];
+      layout.numberOfValues = 0;
+      if (layout.numberOfChannels > 5) return false;
+      for (uint8_t i=0; i<layout.numberOfChannels; i++) {
+        if (pos + 2 > len) return false;
+        layout.channels[i] = bytes[pos++];
+        layout.counts[i] = bytes[pos] & ~CHANNEL_OUT_OF_RANGE;
+        layout.outOfRange[i] = (bytes[pos++] & CHANNEL_OUT_OF_RANGE) != 0;
+        const uint8_t count = layout.counts[i] & ~CHANNEL_SELF_DESCRIBING;
+        if (layout.numberOfValues + count > MAX_MESSAGE_VALUES) return false;
+        const SensorSchema *schema = findSensorSchema(layout.channels[i]);
+        for (uint8_t j=0; j<count; j++) {
+          uint8_t &decimals = layout.decimals[layout.numberOfValues + j];
+          if (layout.counts[i] & CHANNEL_SELF_DESCRIBING) {
+            if (pos >= len) return false;
+            decimals = bytes[pos++];
+          } else {
+            decimals = schema != NULL && j < schema->numberOfFields
+              ? schema->fields[j].decimals : 0;
+          }
+        }
+        layout.numberOfValues += count;
+      }
+      return true;
+    };
+
+    void setValues(
+      const Layout &layout, const int64_t *mantissas, const uint8_t *has = NULL,
+      const uint8_t mask = 0
+    ) {
+      uint8_t idx = 0;
+      for (uint8_t i=0; i<layout.numberOfChannels; i++) {
+        const uint8_t count = layout.counts[i] & ~CHANNEL_SELF_DESCRIBING;
+        setChannel(
+          layout.channels[i], (layout.counts[i] & CHANNEL_SELF_DESCRIBING) == 0,
+          count, mantissas + idx, layout.decimals + idx,
+          has == NULL ? NULL : has + idx, mask);
+        idx += count;
+      }
+    };
+
+    boolean decodeBinary(const uint8_t *bytes, const size_t len) {
+      size_t pos = 1;
+      uint64_t value;
+      beginRow();
+      if (!readVarint(bytes, len, pos, value)) return false;
+      _row.index = value;
+      if (!readUint32(bytes, len, pos, _row.timeStamp)) return false;
+      if (!readVarint(bytes, len, pos, value)) return false;
+      _row.batteryVoltage = value;
+      while (pos + 1 < len) {
+        const uint8_t channel = bytes[pos++];
+        const uint8_t count = bytes[pos++] & ~CHANNEL_OUT_OF_RANGE;
+        const uint8_t n = count & ~CHANNEL_SELF_DESCRIBING;
+        const SensorSchema *schema = findSensorSchema(channel);
+        int64_t mantissas[CHANNEL_OUT_OF_RANGE];
+        uint8_t decimals[CHANNEL_OUT_OF_RANGE];
+        uint8_t has[CHANNEL_OUT_OF_RANGE];
+        uint64_t outOfRange = 0;
+        if ((bytes[pos-1] & CHANNEL_OUT_OF_RANGE) &&
+          !readVarint(bytes, len, pos, outOfRange)
+        ) {
+          return false;
+        }
+        for (uint8_t i=0; i<n; i++) {
+          has[i] = (outOfRange & (1ULL << i)) ? 0 : 1;
+          decimals[i] = 0;
+          if (!has[i]) continue;
+          if (!readVarint(bytes, len, pos, value)) return false;
+          if (count & CHANNEL_SELF_DESCRIBING) {
+            mantissas[i] = unzigzag(value >> 3);
+            decimals[i] = value & 0x07;
+          } else {
+            mantissas[i] = unzigzag(value);
+            decimals[i] = schema != NULL && i < schema->numberOfFields
+              ? schema->fields[i].decimals : 0;
+          }
+        }
+        setChannel(
+          channel, (count & CHANNEL_SELF_DESCRIBING) == 0, n, mantissas, decimals,
+          has, 1);
+      }
+      emit();
+      return true;
+    };
+
+    boolean decodeBatch(const uint8_t *bytes, const size_t len) {
+      size_t pos = 1;
+      uint64_t value;
+      unsigned long index;
+      unsigned long timeStamp;
+      int64_t battery;
+      Layout layout;
+      int64_t values[MAX_MESSAGE_VALUES];
+      uint8_t has[MAX_MESSAGE_VALUES];
+      if (!readVarint(bytes, len, pos, value)) return false;
+      index = value;
+      if (!readUint32(bytes, len, pos, timeStamp)) return false;
+      if (!readVarint(bytes, len, pos, value)) return false;
+      battery = value;
+      if (pos >= len) return false;
+      const uint8_t numberOfEpochs = bytes[pos++];
+      if (!readLayout(bytes, len, pos, layout)) return false;
+      for (uint8_t e=0; e<numberOfEpochs; e++) {
+        if (e > 0) {
+          if (!readVarint(bytes, len, pos, value)) return false;
+          timeStamp += value;
+          if (!readVarint(bytes, len, pos, value)) return false;
+          battery += unzigzag(value);
+        }
+        uint8_t idx = 0;
+        for (uint8_t c=0; c<layout.numberOfChannels; c++) {
+          const uint8_t count = layout.counts[c] & ~CHANNEL_SELF_DESCRIBING;
+          uint64_t outOfRange = 0;
+          if (layout.outOfRange[c] && !readVarint(bytes, len, pos, outOfRange)) {
+            return false;
+          }
+          for (uint8_t j=0; j<count; j++, idx++) {
+            if (e == 0) values[idx] = 0;
+            // left out, the next delta refers to the value before
+            has[idx] = (outOfRange & (1ULL << j)) ? 0 : 1;
+            if (!has[idx]) continue;
+            if (!readVarint(bytes, len, pos, value)) return false;
+            values[idx] += unzigzag(value);
+          }
+        }
+        beginRow();
+        _row.index = index;
+        _row.timeStamp = timeStamp;
+        _row.batteryVoltage = battery;
+        setValues(layout, values, has, 1);
+        emit();
+      }
+      return true;
+    };
+
+    boolean decodeSummary(const uint8_t *bytes, const size_t len) {
+      static const char *statistics[] = {"min", "mean", "max", "stdDev", "sum"};
+      size_t pos = 1;
+      uint64_t value;
+      uint64_t duration;
+      uint64_t samples;
+      uint64_t rejected;
+      unsigned long index;
+      unsigned long timeStamp;
+      int32_t battery;
+      Layout layout;
+      // min, mean, max, stdDev, sum of every value
+      int64_t stats[5][MAX_MESSAGE_VALUES];
+      uint8_t has[MAX_MESSAGE_VALUES];
+      if (!readVarint(bytes, len, pos, value)) return false;
+      index = value;
+      if (!readUint32(bytes, len, pos, timeStamp)) return false;
+      if (!readVarint(bytes, len, pos, duration)) return false;
+      if (!readVarint(bytes, len, pos, samples)) return false;
+      if (!readVarint(bytes, len, pos, rejected)) return false;
+      if (!readVarint(bytes, len, pos, value)) return false;
+      battery = value;
+      if (!readLayout(bytes, len, pos, layout)) return false;
+      uint8_t idx = 0;
+      for (uint8_t i=0; i<layout.numberOfChannels; i++) {
+        const uint8_t count = layout.counts[i] & ~CHANNEL_SELF_DESCRIBING;
+        const SensorSchema *schema = layout.counts[i] & CHANNEL_SELF_DESCRIBING
+          ? NULL : findSensorSchema(layout.channels[i]);
+        for (uint8_t j=0; j<count; j++, idx++) {
+          // the samples a value was left out of only show in the rejected
+          // column of the row, values left out of all have no statistics
+          uint64_t left = 0;
+          if (layout.outOfRange[i] && !readVarint(bytes, len, pos, left)) return false;
+          if (layout.outOfRange[i] && left == samples) {
+            has[idx] = 0;
+            continue;
+          }
+          if (schema != NULL && j < schema->numberOfFields &&
+            schema->fields[j].aggregation == FIELD_ACCUMULATOR
+          ) {
+            uint64_t sum, max;
+            if (!readVarint(bytes, len, pos, sum)) return false;
+            if (!readVarint(bytes, len, pos, max)) return false;
+            stats[4][idx] = unzigzag(sum);
+            stats[2][idx] = unzigzag(max);
+            // max and sum
+            has[idx] = 0x14;
+          } else if (schema != NULL && j < schema->numberOfFields &&
+            schema->fields[j].aggregation == FIELD_DIRECTION
+          ) {
+            uint64_t mean, stdDev;
+            if (!readVarint(bytes, len, pos, mean)) return false;
+            if (!readVarint(bytes, len, pos, stdDev)) return false;
+            stats[1][idx] = static_cast<int64_t>(mean);
+            stats[3][idx] = static_cast<int64_t>(stdDev);
+            // circular mean and stdDev
+            has[idx] = 0x0A;
+          } else {
+            uint64_t min, mean, range, stdDev;
+            if (!readVarint(bytes, len, pos, min)) return false;
+            if (!readVarint(bytes, len, pos, mean)) return false;
+            if (!readVarint(bytes, len, pos, range)) return false;
+            if (!readVarint(bytes, len, pos, stdDev)) return false;
+            stats[0][idx] = unzigzag(min);
+            stats[1][idx] = stats[0][idx] + static_cast<int64_t>(mean);
+            stats[2][idx] = stats[0][idx] + static_cast<int64_t>(range);
+            stats[3][idx] = static_cast<int64_t>(stdDev);
+            has[idx] = 0x0F;
+          }
+        }
+      }
+      for (uint8_t s=0; s<5; s++) {
+        beginRow();
+        _row.index = index;
+        _row.timeStamp = timeStamp;
+        _row.batteryVoltage = battery;
+        _row.statistic = statistics[s];
+        _row.samples = samples;
+        _row.rejected = rejected;
+        setValues(layout, stats[s], has, 1 << s);
+        emit();
+      }
+      return true;
+    };
+
+  public:
+    unsigned long messages = 0;
+    unsigned long rows = 0;
+    unsigned long failed = 0;
+    // other applications than 0 and lines without data
+    unsigned long skipped = 0;
+    // acknowledgements of remote configuration commands, no readings
+    unsigned long configAcks = 0;
+
+    PayloadDecoder(Sink &sink): _sink(sink) {
+      _row.deviceLength = 0;
+      _row.rxTimeLength = 0;
+    };
+
+    /*
+     *  Write a fixed point number like -12.345, returns its length
+     */
+    static size_t formatFixed(int64_t mantissa, const uint8_t decimals, char *bfr) {
+      char digits[24];
+      size_t n = 0;
+      size_t idx = 0;
+      if (mantissa < 0) {
+        bfr[idx++] = '-';
+        mantissa = -mantissa;
+      }
+      do {
+        digits[n++] = '0' + mantissa % 10;
+        mantissa /= 10;
+      } while (mantissa > 0 || n <= decimals);
+      while (n > 0) {
+        if (n == decimals) bfr[idx++] = '.';
+        bfr[idx++] = digits[--n];
+      }
+      return idx;
+    };
+
+    /*
+     *  Standard base64 as in hive messages, returns the number of bytes or
+     *  -1 if it is not base64
+     */
+    static int decodeBase64(
+      const char *text, const size_t len, uint8_t *bytes, const size_t maxLen
+    ) {
+      static int8_t table[256];
+      static boolean initialized = false;
+      if (!initialized) {
+        const char *alphabet =
+          "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        memset(table, -1, sizeof(table));
+        for (uint8_t i=0; i<64; i++) table[static_cast<uint8_t>(alphabet[i])] = i;
+        initialized = true;
+      }
+      uint32_t bits = 0;
+      uint8_t numberOfBits = 0;
+      size_t n = 0;
+      for (size_t i=0; i<len; i++) {
+        const uint8_t c = text[i];
+        if (c == '=') break;
+        // JSON escapes / as \/
+        if (c == '\\') continue;
+        if (table[c] < 0) return -1;
+        bits = bits << 6 | table[c];
+        numberOfBits += 6;
+        if (numberOfBits >= 8) {
+          numberOfBits -= 8;
+          if (n == maxLen) return -1;
+          bytes[n++] = bits >> numberOfBits;
+        }
+      }
+      return n;
+    };
+
+    /*
+     *  Value of a key in a flat JSON object, without quotes for strings
+     */
+    static boolean jsonValue(
+      const char *line, const size_t len, const char *key, const char *&value,
+      size_t &valueLength
+    ) {
+      const size_t keyLength = strlen(key);
+      const char *end = line + len;
+      for (const char *p=line; p + keyLength + 2 < end; p++) {
+        p = static_cast<const char *>(memchr(p, '"', end - p));
+        if (p == NULL || p + keyLength + 2 > end) return false;
+        if (memcmp(p + 1, key, keyLength) != 0 || p[keyLength + 1] != '"') continue;
+        const char *v = p + keyLength + 2;
+        while (v < end && *v == ' ') v++;
+        // a string value that happens to be the key
+        if (v == end || *v != ':') continue;
+        for (v++; v < end && *v == ' '; v++);
+        if (v < end && *v == '"') {
+          const char *close = ++v;
+          while (close < end && *close != '"') close += *close == '\\' ? 2 : 1;
+          if (close > end) return false;
+          value = v;
+          valueLength = close - v;
+          return true;
+        }
+        const char *close = v;
+        while (close < end && *close != ',' && *close != '}' && *close != ' ') close++;
+        value = v;
+        valueLength = close - v;
+        return true;
+      }
+      return false;
+    };
+
+    /*
+     *  A decoded message: binary frames start with their type, everything
+     *  else is text
+     */
+    boolean decodePayload(const uint8_t *bytes, const size_t len) {
+      boolean ret = false;
+      if (len == 0) {
+        ret = false;
+      } else if (bytes[0] == FRAME_SC_BINARY) {
+        ret = decodeBinary(bytes, len);
+      } else if (bytes[0] == FRAME_SC_BATCH) {
+        ret = decodeBatch(bytes, len);
+      } else if (bytes[0] == FRAME_SC_SUMMARY) {
+        ret = decodeSummary(bytes, len);
+      } else if (bytes[0] == FRAME_CONFIG_ACK) {
+        ret = len >= 3;
+        configAcks++;
+      } else {
+        ret = decodeText(reinterpret_cast<const char *>(bytes), len);
+      }
+      messages++;
+      if (!ret) failed++;
+      return ret;
+    };
+
+    /*
+     *  A line of input, JSON or text
+     */
+    boolean decodeLine(const char *line, size_t len) {
+      while (len > 0 && (line[len-1] == '\r' || line[len-1] == '\n')) len--;
+      if (len > 0 && line[0] == '{') {
+        const char *value;
+        size_t valueLength;
+        if (jsonValue(line, len, "userApplicationId", value, valueLength) &&
+          !(valueLength == 1 && value[0] == '0')
+        ) {
+          skipped++;
+          return false;
+        }
+        if (!jsonValue(line, len, "data", value, valueLength)) {
+          skipped++;
+          return false;
+        }
+        int n = decodeBase64(value, valueLength, _bytes, sizeof(_bytes));
+        if (!jsonValue(line, len, "deviceId", _row.device, _row.deviceLength)) {
+          _row.deviceLength = 0;
+        }
+        if (!jsonValue(line, len, "hiveRxTime", _row.rxTime, _row.rxTimeLength)) {
+          _row.rxTimeLength = 0;
+        }
+        if (n < 0) {
+          messages++;
+          failed++;
+          return false;
+        }
+        return decodePayload(_bytes, n);
+      }
+      _row.deviceLength = 0;
+      _row.rxTimeLength = 0;
+      if (len == 0 || line[0] < '0' || line[0] > '9') {
+        skipped++;
+        return false;
+      }
+      return decodePayload(reinterpret_cast<const uint8_t *>(line), len);
+    };
+};
+
+
+
+/*
+ *  Rows as CSV with a column per field of sensorSchema.h, written through a
+ *  fixed buffer
+ */
+class WideCsvWriter {
+  private:
+    FILE *_out;
+    char _bfr[DECODER_OUTPUT_BUFFER];
+    size_t _len = 0;
+
+    void put(const char *text, const size_t len) {
+      memcpy(_bfr + _len, text, len);
+      _len += len;
+    };
+
+    void put(const char *text) {
+      put(text, strlen(text));
+    };
+
+    void putUnsigned(unsigned long value) {
+      _len += PayloadDecoder<WideCsvWriter>::formatFixed(value, 0, _bfr + _len);
+    };
+
+  public:
+    unsigned long bytes = 0;
+
+    WideCsvWriter(FILE *out): _out(out) {};
+
+    ~WideCsvWriter() {
+      flush();
+    };
+
+    void flush() {
+      if (_len > 0 && _out != NULL) fwrite(_bfr, 1, _len, _out);
+      bytes += _len;
+      _len = 0;
+    };
+
+    /*
+     *  Column names like 51.airTmp_c
+     */
+    void header() {
+      put("deviceId,hiveRxTime,index,timeStamp,batteryVoltage,statistic,samples,rejected");
+      for (size_t i=0; i<NUMBER_OF_SENSOR_SCHEMAS; i++) {
+        const SensorSchema &schema = sensorSchemas[i];
+        for (uint8_t j=0; j<schema.numberOfFields; j++) {
+          put(",");
+          putUnsigned(schema.channel);
+          put(".");
+          put(schema.fields[j].name);
+        }
+      }
+      put(",other\n");
+    };
+
+    void operator()(const DecodedRow &row) {
+      // a row is much shorter, see DECODER_MAX_OTHER
+      if (_len + 4096 > DECODER_OUTPUT_BUFFER) flush();
+      put(row.device, row.deviceLength);
+      put(",");
+      put(row.rxTime, row.rxTimeLength);
+      put(",");
+      putUnsigned(row.index);
+      put(",");
+      putUnsigned(row.timeStamp);
+      put(",");
+      _len += PayloadDecoder<WideCsvWriter>::formatFixed(
+        row.batteryVoltage, 2, _bfr + _len);
+      put(",");
+      if (row.statistic != NULL) put(row.statistic);
+      put(",");
+      putUnsigned(row.samples);
+      put(",");
+      putUnsigned(row.rejected);
+      for (size_t i=0; i<DECODED_COLUMNS; i++) {
+        put(",");
+        if ((row.present & (1ULL << i)) == 0) continue;
+        _len += PayloadDecoder<WideCsvWriter>::formatFixed(
+          row.mantissas[i], row.decimals[i], _bfr + _len);
+      }
+      put(",");
+      put(row.other, row.otherLength);
+      put("\n");
+    };
+};
+
+#endif
@@ -0,0 +1,148 @@
+/*
+ *  Host replacement for https://github.com/bxparks/AUnit
+ *
+ *  - implements the subset of AUnit used by the sketches in ../../tests so
+ *    that the same test files run on the device and on the host
+ *  - assertEqual overloads follow AUnit, i.e. arguments of different types
+ *    need explicit casts just like on the device
+ *  - TestRunner::run() runs all tests at once, prints a summary, and exits
+ *    the process with a non-zero status if a test failed
+ */
+#ifndef _HOST_AUNIT_H_
+#define _HOST_AUNIT_H_
+
+#include <Arduino.h>
+
+
+namespace aunit {
+
+class Test {
+  private:
+    const char *_name;
+    boolean _failed = false;
+    Test *_next = nullptr;
+  public:
+    static Test **getRoot() {
+      static Test *root = nullptr;
+      return &root;
+    };
+    Test(const char *name) : _name(name) {
+      // keep declaration order
+      Test **ref = getRoot();
+      while (*ref) ref = &(*ref)->_next;
+      *ref = this;
+    };
+    virtual ~Test() {};
+    virtual void once() = 0;
+    const char *getName() { return _name; };
+    Test *getNext() { return _next; };
+    boolean isFailed() { return _failed; };
+    void fail(const char *file, int line, const char *assertion) {
+      _failed = true;
+      printf("Assertion failed: %s, file %s, line %d.\n", assertion, file, line);
+    };
+};
+
+namespace internal {
+inline bool compareEqual(bool a, bool b) { return a == b; }
+inline bool compareEqual(char a, char b) { return a == b; }
+inline bool compareEqual(int a, int b) { return a == b; }
+inline bool compareEqual(unsigned int a, unsigned int b) { return a == b; }
+inline bool compareEqual(long a, long b) { return a == b; }
+inline bool compareEqual(unsigned long a, unsigned long b) { return a == b; }
+inline bool compareEqual(long long a, long long b) { return a == b; }
+inline bool compareEqual(unsigned long long a, unsigned long long b) {
+  return a == b;
+}
+inline bool compareEqual(double a, double b) { return a == b; }
+inline bool compareEqual(const char *a, const char *b) {
+  return strcmp(a, b) == 0;
+}
+inline bool compareEqual(const String &a, const String &b) { return a == b; }
+
+inline bool compareLess(int a, int b) { return a < b; }
+inline bool compareLess(unsigned int a, unsigned int b) { return a < b; }
+inline bool compareLess(long a, long b) { return a < b; }
+inline bool compareLess(unsigned long a, unsigned long b) { return a < b; }
+inline bool compareLess(long long a, long long b) { return a < b; }
+inline bool compareLess(unsigned long long a, unsigned long long b) {
+  return a < b;
+}
+inline bool compareLess(double a, double b) { return a < b; }
+
+inline bool compareNear(double a, double b, double error) {
+  return fabs(a - b) <= error;
+}
+}
+
+class TestRunner {
+  private:
+    static const char *&includePattern() {
+      static const char *pattern = "*";
+      return pattern;
+    };
+    static bool matches(const char *pattern, const char *name) {
+      size_t len = strlen(pattern);
+      if (len > 0 && pattern[len-1] == '*') return strncmp(pattern, name, len-1) == 0;
+      return strcmp(pattern, name) == 0;
+    };
+  public:
+    static void exclude(const char *pattern) { includePattern() = ""; };
+    static void include(const char *pattern) { includePattern() = pattern; };
+    static void run() {
+      int passed = 0;
+      int failed = 0;
+      int skipped = 0;
+      for (Test *test = *Test::getRoot(); test; test = test->getNext()) {
+        if (!matches(includePattern(), test->getName())) {
+          skipped++;
+          continue;
+        }
+        test->once();
+        if (test->isFailed()) {
+          failed++;
+          printf("Test %s failed.\n", test->getName());
+        } else {
+          passed++;
+          printf("Test %s passed.\n", test->getName());
+        }
+      }
+      printf(
+        "TestRunner summary: %d passed, %d failed, %d skipped, out of %d "
+        "test(s).\n", passed, failed, skipped, passed + failed + skipped);
+      fflush(stdout);
+      exit(failed > 0 ? 1 : 0);
+    };
+};
+
+}
+
+#define test(name) \
+  class test_##name : public aunit::Test { \
+    public: \
+      test_##name() : aunit::Test(#name) {}; \
+      void once(); \
+  } test_##name##_instance; \
+  void test_##name::once()
+
+#define AUNIT_ASSERT(condition, text) \
+  do { if (!(condition)) { fail(__FILE__, __LINE__, text); return; } } while (0)
+
+#define assertEqual(a, b) \
+  AUNIT_ASSERT(aunit::internal::compareEqual((a), (b)), "assertEqual(" #a ", " #b ")")
+#define assertNotEqual(a, b) \
+  AUNIT_ASSERT(!aunit::internal::compareEqual((a), (b)), "assertNotEqual(" #a ", " #b ")")
+#define assertLess(a, b) \
+  AUNIT_ASSERT(aunit::internal::compareLess((a), (b)), "assertLess(" #a ", " #b ")")
+#define assertMore(a, b) \
+  AUNIT_ASSERT(aunit::internal::compareLess((b), (a)), "assertMore(" #a ", " #b ")")
+#define assertLessOrEqual(a, b) \
+  AUNIT_ASSERT(!aunit::internal::compareLess((b), (a)), "assertLessOrEqual(" #a ", " #b ")")
+#define assertMoreOrEqual(a, b) \
+  AUNIT_ASSERT(!aunit::internal::compareLess((a), (b)), "assertMoreOrEqual(" #a ", " #b ")")
+#define assertNear(a, b, error) \
+  AUNIT_ASSERT(aunit::internal::compareNear((a), (b), (error)), "assertNear(" #a ", " #b ")")
+#define assertTrue(condition) AUNIT_ASSERT((condition), "assertTrue(" #condition ")")
+#define assertFalse(condition) AUNIT_ASSERT(!(condition), "assertFalse(" #condition ")")
+
+#endif
@@ -0,0 +1,9 @@
+/*
+ *  Host stub, the GFX base class is covered by Adafruit_SH110X.h
+ */
+#ifndef _HOST_ADAFRUIT_GFX_H_
+#define _HOST_ADAFRUIT_GFX_H_
+
+#include <Arduino.h>
+
+#endif
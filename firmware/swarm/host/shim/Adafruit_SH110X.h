@@ -0,0 +1,115 @@
+/*
+ *  Host stub for the SH1107 OLED driver
+ *
+ *  - tracks the text cursor like the GFX library does (6x8 pixel font at
+ *    text size 1) since the display wrapper depends on getCursorY
+ *  - counts display() calls and the bytes they would push over I2C; like
+ *    the driver only the 8 pixel rows between the first and the last one
+ *    drawn since the last display() are sent
+ */
+#ifndef _HOST_ADAFRUIT_SH110X_H_
+#define _HOST_ADAFRUIT_SH110X_H_
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define SH110X_BLACK 0
+#define SH110X_WHITE 1
+#define SH110X_DISPLAYOFF 0xAE
+#define SH110X_DISPLAYON 0xAF
+
+
+class Adafruit_SH1107 {
+  private:
+    int16_t _width;
+    int16_t _height;
+    int16_t _cursorX = 0;
+    int16_t _cursorY = 0;
+    uint8_t _textSize = 1;
+    // 8 pixel rows drawn since the last display()
+    int16_t _firstPage = 0;
+    int16_t _lastPage = -1;
+
+    void draw(int16_t y, int16_t h) {
+      if (h <= 0) return;
+      int16_t first = y / 8;
+      int16_t last = (y + h - 1) / 8;
+      if (first < 0) first = 0;
+      if (last >= _height / 8) last = _height / 8 - 1;
+      if (_lastPage < _firstPage) {
+        _firstPage = first;
+        _lastPage = last;
+        return;
+      }
+      if (first < _firstPage) _firstPage = first;
+      if (last > _lastPage) _lastPage = last;
+    };
+  public:
+    // statistics, a full SH1107 frame is width * height / 8 bytes
+    unsigned long displayCount = 0;
+    unsigned long bytesTransferred = 0;
+    boolean on = true;
+    Adafruit_SH1107(uint16_t w, uint16_t h, TwoWire *twi) {
+      _width = w;
+      _height = h;
+    };
+    bool begin(uint8_t addr, bool reset) { return true; };
+    void clearDisplay() { draw(0, _height); };
+    void display() {
+      displayCount++;
+      if (_lastPage >= _firstPage) {
+        bytesTransferred += (_lastPage - _firstPage + 1) * _width;
+      }
+      _firstPage = 0;
+      _lastPage = -1;
+    };
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+      draw(y, h);
+    };
+    void oled_command(uint8_t c) {
+      if (c == SH110X_DISPLAYOFF) on = false;
+      if (c == SH110X_DISPLAYON) on = true;
+    };
+    int16_t getCursorX() { return _cursorX; };
+    int16_t getCursorY() { return _cursorY; };
+    void setCursor(int16_t x, int16_t y) {
+      _cursorX = x;
+      _cursorY = y;
+    };
+    void setRotation(uint8_t rotation) {
+      if (rotation % 2 == 1 && _width < _height) {
+        int16_t tmp = _width;
+        _width = _height;
+        _height = tmp;
+      }
+    };
+    void setTextColor(uint16_t color) {};
+    void setTextSize(uint8_t size) { _textSize = size; };
+    size_t write(uint8_t c) {
+      if (c == '\n') {
+        _cursorX = 0;
+        _cursorY += 8 * _textSize;
+      } else if (c != '\r') {
+        if (_cursorX + 6 * _textSize > _width) {
+          _cursorX = 0;
+          _cursorY += 8 * _textSize;
+        }
+        draw(_cursorY, 8 * _textSize);
+        _cursorX += 6 * _textSize;
+      }
+      return 1;
+    };
+    size_t print(char c) { return write(c); };
+    size_t print(int number, int format=DEC) {
+      char bfr[16];
+      int len = snprintf(bfr, sizeof(bfr), format == HEX ? "%x" : "%d", number);
+      for (int i=0; i<len; i++) write(bfr[i]);
+      return len;
+    };
+    size_t println(String line) {
+      for (size_t i=0; i<line.length(); i++) write(line.c_str()[i]);
+      return write('\n') + line.length();
+    };
+};
+
+#endif
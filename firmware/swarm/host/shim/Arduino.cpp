@@ -0,0 +1,157 @@
+/*
+ *  Host implementation of the Arduino shim, see Arduino.h
+ */
+#include "Arduino.h"
+#include "Wire.h"
+#include "esp_sleep.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+
+
+HardwareSerial Serial;
+HardwareSerial Serial2;
+TwoWire Wire;
+
+static uint64_t clockUs = 0;
+static uint32_t pollCostUs = 1;
+static int digitalPins[64];
+static uint16_t analogPins[64];
+static bool pinsInitialized = false;
+static void (*pinHandlers[64])(void);
+static int pinModes[64];
+static uint64_t sleepTimerUs = 0;
+
+
+static void initPins() {
+  if (pinsInitialized) return;
+  for (size_t i=0; i<64; i++) {
+    digitalPins[i] = HIGH;
+    // roughly 3.8V on the battery pin of a Feather HUZZAH
+    analogPins[i] = 2360;
+  }
+  pinsInitialized = true;
+}
+
+uint64_t VirtualClock::now() { return clockUs; }
+
+void VirtualClock::advance(uint64_t us) { clockUs += us; }
+
+void VirtualClock::setPollCost(uint32_t us) { pollCostUs = us; }
+
+void VirtualClock::reset() {
+  clockUs = 0;
+  pollCostUs = 1;
+}
+
+void HostPins::setDigital(uint8_t pin, int value) {
+  initPins();
+  const int previous = digitalPins[pin % 64];
+  digitalPins[pin % 64] = value;
+  void (*handler)(void) = pinHandlers[pin % 64];
+  if (handler == NULL || previous == value) return;
+  const int mode = pinModes[pin % 64];
+  if (mode == CHANGE || (mode == RISING && value) || (mode == FALLING && !value)) {
+    handler();
+  }
+}
+
+void HostPins::setAnalog(uint8_t pin, uint16_t value) {
+  initPins();
+  analogPins[pin % 64] = value;
+}
+
+unsigned long millis() {
+  clockUs += pollCostUs;
+  return static_cast<unsigned long>(clockUs / 1000);
+}
+
+unsigned long micros() {
+  clockUs += pollCostUs;
+  return static_cast<unsigned long>(clockUs);
+}
+
+int64_t esp_timer_get_time() {
+  clockUs += pollCostUs;
+  return static_cast<int64_t>(clockUs);
+}
+
+void delay(unsigned long ms) { clockUs += static_cast<uint64_t>(ms) * 1000; }
+
+void delayMicroseconds(unsigned int us) { clockUs += us; }
+
+void pinMode(uint8_t pin, uint8_t mode) { initPins(); }
+
+int digitalRead(uint8_t pin) {
+  initPins();
+  return digitalPins[pin % 64];
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  initPins();
+  digitalPins[pin % 64] = value;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  initPins();
+  return analogPins[pin % 64];
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  pinHandlers[pin % 64] = handler;
+  pinModes[pin % 64] = mode;
+}
+
+void detachInterrupt(uint8_t pin) { pinHandlers[pin % 64] = NULL; }
+
+void btStop() {}
+
+int esp_sleep_enable_timer_wakeup(uint64_t us) {
+  sleepTimerUs = us;
+  return 0;
+}
+
+int esp_light_sleep_start() {
+  clockUs += sleepTimerUs;
+  return 0;
+}
+
+void esp_deep_sleep_start() { clockUs += sleepTimerUs; }
+
+int gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type) { return 0; }
+
+int gpio_wakeup_disable(gpio_num_t pin) { return 0; }
+
+int esp_sleep_enable_gpio_wakeup() { return 0; }
+
+int esp_sleep_disable_wakeup_source(esp_sleep_source_t source) {
+  if (source == ESP_SLEEP_WAKEUP_TIMER) sleepTimerUs = 0;
+  return 0;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+  return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+const esp_partition_t *esp_partition_find_first(
+  esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label
+) {
+  return NULL;
+}
+
+esp_err_t esp_partition_read(
+  const esp_partition_t *partition, size_t offset, void *dst, size_t size
+) {
+  return ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(
+  const esp_partition_t *partition, size_t offset, const void *src, size_t size
+) {
+  return ESP_FAIL;
+}
+
+esp_err_t esp_partition_erase_range(
+  const esp_partition_t *partition, size_t offset, size_t size
+) {
+  return ESP_FAIL;
+}
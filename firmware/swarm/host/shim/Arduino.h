@@ -0,0 +1,146 @@
+/*
+ *  Minimal Arduino core for building the firmware on a Linux host
+ *
+ *  - provides just enough of the Arduino/ESP32 API to compile the code in
+ *    ../../src and the AUnit sketches in ../../tests
+ *  - time is virtual: millis() and micros() read a simulated clock that only
+ *    moves when delay() is called, when a simulator advances it or by a small
+ *    poll cost on every clock read (this models busy-wait loops, otherwise
+ *    they would spin forever on the host)
+ *  - NOT used on the device
+ */
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+// there is no RTC memory, see esp_sleep.h
+#define RTC_DATA_ATTR
+// nor instruction RAM for interrupt handlers
+#define IRAM_ATTR
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define DEC 10
+#define HEX 16
+#define A13 15
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define digitalPinToInterrupt(pin) (pin)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+uint16_t analogRead(uint8_t pin);
+// the handler runs synchronously when HostPins changes the level
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t pin);
+void btStop();
+
+
+/*
+ *  Virtual clock driving millis(), micros() and delay()
+ */
+class VirtualClock {
+  public:
+    // current simulated time in micro seconds since start
+    static uint64_t now();
+    // let simulated time pass, e.g. while a simulated device is sleeping
+    static void advance(uint64_t us);
+    // simulated cost of a single millis()/micros() call, default 1us
+    static void setPollCost(uint32_t us);
+    static void reset();
+};
+
+
+/*
+ *  Simulated pin levels for digitalRead and analogRead, all digital pins
+ *  read HIGH (pulled up, buttons not pressed) unless set otherwise; setting
+ *  a digital level calls the interrupt handler attached to the pin
+ */
+class HostPins {
+  public:
+    static void setDigital(uint8_t pin, int value);
+    static void setAnalog(uint8_t pin, uint16_t value);
+};
+
+
+/*
+ *  Subset of the Arduino String class used by the display wrapper
+ */
+class String {
+  private:
+    std::string _str;
+  public:
+    String() {};
+    String(const char *str) : _str(str ? str : "") {};
+    String(const std::string &str) : _str(str) {};
+    size_t length() const { return _str.length(); };
+    const char *c_str() const { return _str.c_str(); };
+    String substring(size_t from, size_t to) const {
+      return String(_str.substr(from, to - from));
+    };
+    void toCharArray(char *bfr, size_t len) const {
+      if (len == 0) return;
+      size_t n = _str.length() < len - 1 ? _str.length() : len - 1;
+      memcpy(bfr, _str.data(), n);
+      bfr[n] = 0;
+    };
+    bool operator==(const String &other) const { return _str == other._str; };
+};
+
+
+/*
+ *  Serial port writing to stdout, reading nothing
+ */
+class HardwareSerial {
+  public:
+    void begin(uint32_t speed) {};
+    int available() { return 0; };
+    int read() { return -1; };
+    size_t write(uint8_t character) { return fwrite(&character, 1, 1, stdout); };
+    size_t write(const char *bfr, size_t len) { return fwrite(bfr, 1, len, stdout); };
+    size_t write(const char *str) { return write(str, strlen(str)); };
+    size_t print(const char *str) { return write(str); };
+    size_t print(const String &str) { return write(str.c_str()); };
+    size_t print(char character) { return write(static_cast<uint8_t>(character)); };
+    size_t print(int number, int format=DEC) { return print(static_cast<long>(number), format); };
+    size_t print(unsigned int number, int format=DEC) {
+      return print(static_cast<unsigned long>(number), format);
+    };
+    size_t print(long number, int format=DEC) {
+      return printf(format == HEX ? "%lx" : "%ld", number);
+    };
+    size_t print(unsigned long number, int format=DEC) {
+      return printf(format == HEX ? "%lx" : "%lu", number);
+    };
+    size_t print(double number, int digits=2) { return printf("%.*f", digits, number); };
+    size_t println() { return write("\r\n"); };
+    template <typename T> size_t println(T value) { return print(value) + println(); };
+    template <typename T> size_t println(T value, int format) {
+      return print(value, format) + println();
+    };
+    operator bool() { return true; };
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial2;
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ *  Host EEPROM emulation, see EEPROM.h
+ */
+#include "EEPROM.h"
+
+
+EEPROMClass EEPROM;
+
+
+EEPROMClass::EEPROMClass() { reset(); }
+
+bool EEPROMClass::begin(size_t size) {
+  beginCount++;
+  _size = size < HOST_EEPROM_SIZE ? size : HOST_EEPROM_SIZE;
+  return true;
+}
+
+uint8_t EEPROMClass::read(int address) {
+  readCount++;
+  if (address < 0 || static_cast<size_t>(address) >= _size) return 0;
+  return _data[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  writeCount++;
+  if (address < 0 || static_cast<size_t>(address) >= _size) return;
+  _data[address] = value;
+}
+
+bool EEPROMClass::commit() {
+  commitCount++;
+  return true;
+}
+
+void EEPROMClass::reset() {
+  // erased flash reads 0xFF
+  memset(_data, 0xFF, HOST_EEPROM_SIZE);
+  _size = 0;
+  beginCount = 0;
+  commitCount = 0;
+  readCount = 0;
+  writeCount = 0;
+}
@@ -0,0 +1,46 @@
+/*
+ *  Host EEPROM emulation, RAM backed and counting flash operations
+ */
+#ifndef _HOST_EEPROM_H_
+#define _HOST_EEPROM_H_
+
+#include <Arduino.h>
+
+#define HOST_EEPROM_SIZE 4096
+
+
+class EEPROMClass {
+  private:
+    uint8_t _data[HOST_EEPROM_SIZE];
+    size_t _size;
+  public:
+    // statistics to evaluate flash access patterns
+    unsigned long beginCount;
+    unsigned long commitCount;
+    unsigned long readCount;
+    unsigned long writeCount;
+    EEPROMClass();
+    bool begin(size_t size);
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    bool commit();
+    size_t length() { return _size; };
+    // erase to the state of a new device and reset statistics
+    void reset();
+    template <typename T> T &get(int address, T &value) {
+      for (size_t i=0; i<sizeof(T); i++) {
+        reinterpret_cast<uint8_t*>(&value)[i] = read(address + i);
+      }
+      return value;
+    };
+    template <typename T> const T &put(int address, const T &value) {
+      for (size_t i=0; i<sizeof(T); i++) {
+        write(address + i, reinterpret_cast<const uint8_t*>(&value)[i]);
+      }
+      return value;
+    };
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
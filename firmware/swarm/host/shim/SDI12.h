@@ -0,0 +1,25 @@
+/*
+ *  Host stub for the Arduino SDI12 library, a bus without sensors
+ *
+ *  - host builds use a SimulatedSdi12Bus (../simulatedSdi12Bus.h) instead
+ */
+#ifndef _HOST_SDI12_H_
+#define _HOST_SDI12_H_
+
+#include <Arduino.h>
+
+// size of the receive buffer of the library
+#define SDI12_BUFFER_SIZE 81
+
+
+class SDI12 {
+  public:
+    SDI12(int8_t dataPin) {};
+    void begin() {};
+    int available() { return 0; };
+    int read() { return -1; };
+    void clearBuffer() {};
+    void sendCommand(const char *cmd) {};
+};
+
+#endif
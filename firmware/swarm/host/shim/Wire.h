@@ -0,0 +1,17 @@
+/*
+ *  Host stub for the Arduino I2C library
+ */
+#ifndef _HOST_WIRE_H_
+#define _HOST_WIRE_H_
+
+#include <Arduino.h>
+
+
+class TwoWire {
+  public:
+    void begin() {};
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ *  Host stub for the ESP32 sleep API
+ *
+ *  - light and deep sleep let the virtual clock pass by the configured timer
+ *    and return, the host cannot restart the program; simulations of deep
+ *    sleep use a SimulatedSleep (../simulatedSleep.h) instead
+ *  - there is never a wake-up cause, i.e. every start is a cold start
+ *  - GPIO wake-up is accepted but never happens, the host cannot press a
+ *    button while the program sleeps
+ */
+#ifndef _HOST_ESP_SLEEP_H_
+#define _HOST_ESP_SLEEP_H_
+
+#include <Arduino.h>
+
+typedef enum {
+  ESP_SLEEP_WAKEUP_UNDEFINED,
+  ESP_SLEEP_WAKEUP_ALL,
+  ESP_SLEEP_WAKEUP_EXT0,
+  ESP_SLEEP_WAKEUP_EXT1,
+  ESP_SLEEP_WAKEUP_TIMER,
+  ESP_SLEEP_WAKEUP_TOUCHPAD,
+  ESP_SLEEP_WAKEUP_ULP,
+  ESP_SLEEP_WAKEUP_GPIO
+} esp_sleep_wakeup_cause_t;
+
+typedef esp_sleep_wakeup_cause_t esp_sleep_source_t;
+
+// driver/gpio.h
+typedef int gpio_num_t;
+typedef enum {
+  GPIO_INTR_DISABLE,
+  GPIO_INTR_POSEDGE,
+  GPIO_INTR_NEGEDGE,
+  GPIO_INTR_ANYEDGE,
+  GPIO_INTR_LOW_LEVEL,
+  GPIO_INTR_HIGH_LEVEL
+} gpio_int_type_t;
+
+int esp_sleep_enable_timer_wakeup(uint64_t us);
+int esp_light_sleep_start();
+void esp_deep_sleep_start();
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+int gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t type);
+int gpio_wakeup_disable(gpio_num_t pin);
+int esp_sleep_enable_gpio_wakeup();
+int esp_sleep_disable_wakeup_source(esp_sleep_source_t source);
+
+#endif
@@ -0,0 +1,14 @@
+/*
+ *  Host stub for the ESP32 high resolution timer
+ *
+ *  - esp_timer_get_time() reads the virtual clock like micros(), as on the
+ *    device it does not wrap
+ */
+#ifndef _HOST_ESP_TIMER_H_
+#define _HOST_ESP_TIMER_H_
+
+#include <Arduino.h>
+
+int64_t esp_timer_get_time();
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ *  Sign a remote configuration command for the nodes, see src/downlink.h
+ *
+ *  - the key is the downlinkKey of swarm.ino as 32 hex digits
+ *  - prints the command with its tag, to be sent to the node as the data
+ *    of a message to its tile
+ *  - the sequence has to be higher than the one of the last command the
+ *    node took
+ *
+ *  usage: signCommand <key> <sequence>,<KEY=value>,...
+ *  e.g.   signCommand 000102030405060708090a0b0c0d0e0f 12,MF=1800,BD=4
+ */
+#include <Arduino.h>
+#include "downlink.h"
+
+
+int main(int argc, char **argv) {
+  uint8_t key[SIP_HASH_KEY_LENGTH];
+  char bfr[DOWNLINK_MAX_LENGTH];
+  if (argc != 3 || strlen(argv[1]) != 2 * SIP_HASH_KEY_LENGTH) {
+    fprintf(stderr, "usage: signCommand <key as 32 hex digits> <command>\n");
+    return 2;
+  }
+  for (uint8_t i=0; i<SIP_HASH_KEY_LENGTH; i++) {
+    char digits[3] = {argv[1][2 * i], argv[1][2 * i + 1], 0};
+    char *end;
+    key[i] = strtoul(digits, &end, 16);
+    if (*end != 0) {
+      fprintf(stderr, "the key is not hex\n");
+      return 2;
+    }
+  }
+  const size_t len = strlen(argv[2]);
+  if (len + DOWNLINK_TAG_LENGTH + 1 > sizeof(bfr)) {
+    fprintf(stderr, "the command is longer than %d characters\n",
+      DOWNLINK_MAX_LENGTH - DOWNLINK_TAG_LENGTH - 1);
+    return 2;
+  }
+  const size_t signedLen = Downlink::sign(key, argv[2], len, bfr);
+  // the node has to take it like this, apart from the sequence
+  NodeConfig config;
+  DownlinkCommand command;
+  PersistentMemory::defaults(config);
+  if (Downlink::process(key, bfr, signedLen, config, command) == DOWNLINK_BAD_TAG ||
+    command.status == DOWNLINK_BAD_FORMAT
+  ) {
+    fprintf(stderr, "not a valid command\n");
+    return 1;
+  }
+  fwrite(bfr, 1, signedLen, stdout);
+  printf("\n");
+  return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ *  Simulated NOR flash, see simulatedFlash.h
+ */
+#include "simulatedFlash.h"
+
+
+SimulatedFlash::SimulatedFlash(uint32_t size, uint32_t sectorSize) {
+  _sectorSize = sectorSize;
+  // a new chip comes erased
+  _data.assign(size - size % sectorSize, 0xFF);
+  _erases.assign(size / sectorSize, 0);
+}
+
+/*
+ *  xorshift32, reproducible across platforms
+ */
+uint32_t SimulatedFlash::random() {
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return _random;
+}
+
+boolean SimulatedFlash::spend() {
+  if (_budget == 0) {
+    powerLost = true;
+    return true;
+  }
+  if (_budget > 0) _budget--;
+  operations++;
+  return false;
+}
+
+void SimulatedFlash::losePowerAfter(uint64_t n, uint32_t seed) {
+  _budget = n;
+  _random = seed ? seed : 1;
+}
+
+void SimulatedFlash::powerOn() {
+  _budget = -1;
+  powerLost = false;
+}
+
+unsigned long SimulatedFlash::erases(uint32_t sector) {
+  return sector < _erases.size() ? _erases[sector] : 0;
+}
+
+void SimulatedFlash::corrupt(uint32_t address, uint8_t mask) {
+  if (address < _data.size()) _data[address] ^= mask;
+}
+
+uint32_t SimulatedFlash::size() { return _data.size(); }
+
+uint32_t SimulatedFlash::sectorSize() { return _sectorSize; }
+
+boolean SimulatedFlash::read(uint32_t address, void *bfr, size_t len) {
+  if (address + len > _data.size()) return false;
+  memcpy(bfr, &_data[address], len);
+  return true;
+}
+
+boolean SimulatedFlash::write(uint32_t address, const void *data, size_t len) {
+  const uint8_t *bytes = static_cast<const uint8_t*>(data);
+  if (powerLost || address + len > _data.size()) return false;
+  for (size_t i=0; i<len; i++) {
+    if (spend()) {
+      // some of the bits made it
+      _data[address + i] &= bytes[i] | static_cast<uint8_t>(random());
+      return false;
+    }
+    _data[address + i] &= bytes[i];
+    bytesWritten++;
+  }
+  return true;
+}
+
+boolean SimulatedFlash::erase(uint32_t sector) {
+  if (powerLost || sector >= _erases.size()) return false;
+  uint8_t *start = &_data[sector * _sectorSize];
+  if (spend()) {
+    memset(start, 0xFF, random() % _sectorSize);
+    return false;
+  }
+  memset(start, 0xFF, _sectorSize);
+  _erases[sector]++;
+  return true;
+}
@@ -0,0 +1,51 @@
+/*
+ *  Simulated NOR flash for host builds
+ *
+ *  - implements FlashWrapperBase so it can be used instead of FlashWrapper
+ *  - erasing sets a sector to 0xFF, writing can only clear bits
+ *  - power can be cut after any number of bytes written or sectors erased.
+ *    The byte being written when power is lost gets a random part of its
+ *    bits programmed, an interrupted erase erases the sector only up to a
+ *    random offset. Nothing is written after that until powerOn().
+ */
+#ifndef _SIMULATED_FLASH_H_
+#define _SIMULATED_FLASH_H_
+
+#include <Arduino.h>
+#include <vector>
+#ifndef _FLASH_WRAPPER_H_
+#include "../src/flashWrapper.h"
+#endif
+
+
+class SimulatedFlash: public FlashWrapperBase {
+  private:
+    std::vector<uint8_t> _data;
+    std::vector<unsigned long> _erases;
+    uint32_t _sectorSize;
+    // bytes written or sectors erased until power is lost, -1 for never
+    int64_t _budget = -1;
+    uint32_t _random = 1;
+    uint32_t random();
+    // true if power is lost with this operation
+    boolean spend();
+  public:
+    boolean powerLost = false;
+    // statistics, every written byte and erased sector is an operation
+    unsigned long operations = 0;
+    unsigned long bytesWritten = 0;
+    SimulatedFlash(uint32_t size=16 * FLASH_SECTOR_SIZE, uint32_t sectorSize=FLASH_SECTOR_SIZE);
+    // cut power after the next n operations, seed for the partial ones
+    void losePowerAfter(uint64_t n, uint32_t seed=1);
+    void powerOn();
+    unsigned long erases(uint32_t sector);
+    // flip bits, e.g. to simulate bit rot
+    void corrupt(uint32_t address, uint8_t mask);
+    uint32_t size();
+    uint32_t sectorSize();
+    boolean read(uint32_t address, void *bfr, size_t len);
+    boolean write(uint32_t address, const void *data, size_t len);
+    boolean erase(uint32_t sector);
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ *  Simulated SDI-12 bus, see simulatedSdi12Bus.h
+ */
+#include "simulatedSdi12Bus.h"
+
+
+SimulatedSdi12Bus::SimulatedSdi12Bus() {
+  _random = seed;
+}
+
+void SimulatedSdi12Bus::addSensor(const SimulatedSensor &sensor) {
+  SensorState state;
+  state.sensor = sensor;
+  state.readyAt = 0;
+  state.measuring = false;
+  _sensors.push_back(state);
+}
+
+/*
+ *  Timing is typical for the sensors, not taken from a data sheet
+ */
+void SimulatedSdi12Bus::addAtmos41(const char addr) {
+  addSensor({
+    addr, "13METER   ATM41 426",
+    "+26+0.000+0+0+0.93+246.3+2.65+11.0+1.18+100.83+0.900+10.8+0.2+1.7+0"
+    "-0.38-0.86+2.65",
+    5, 2000, 10});
+}
+
+void SimulatedSdi12Bus::addTeros12(const char addr) {
+  addSensor({addr, "13METER   TER12 112", "+2038.84+16.1+39", 3, 1000, 12});
+}
+
+const char *SimulatedSdi12Bus::values(const char addr) {
+  SensorState *state = find(addr);
+  return state == NULL ? "" : state->sensor.values.c_str();
+}
+
+SimulatedSdi12Bus::SensorState *SimulatedSdi12Bus::find(const char addr) {
+  for (size_t i=0; i<_sensors.size(); i++) {
+    if (_sensors[i].sensor.addr == addr) return &_sensors[i];
+  }
+  return NULL;
+}
+
+/*
+ *  xorshift32, reproducible across platforms
+ */
+boolean SimulatedSdi12Bus::chance(float probability) {
+  if (probability <= 0) return false;
+  _random ^= _random << 13;
+  _random ^= _random >> 17;
+  _random ^= _random << 5;
+  return (_random & 0xffffff) < probability * 0x1000000;
+}
+
+/*
+ *  Put a response on the wire after the latency of the sensor
+ */
+void SimulatedSdi12Bus::respond(
+  const SensorState &state, const std::string &response
+) {
+  if (dropNext > 0 || chance(dropRate)) {
+    if (dropNext > 0) dropNext--;
+    responsesDropped++;
+    return;
+  }
+  std::string line = state.sensor.addr + response + "\r\n";
+  uint64_t time = VirtualClock::now() + state.sensor.latency * 1000;
+  for (size_t i=0; i<line.size(); i++) {
+    char c = line[i];
+    if (chance(garbleRate)) {
+      c = static_cast<char>(_random & 0x7f);
+      bytesGarbled++;
+    }
+    time += SDI12_CHARACTER_TIME;
+    _wire.push_back({time, c});
+  }
+  responsesSent++;
+}
+
+void SimulatedSdi12Bus::startMeasurement(SensorState &state, const boolean concurrent) {
+  char bfr[8];
+  size_t numberOfValues = 0;
+  const std::string &values = state.sensor.values;
+  for (size_t i=0; i<values.size(); i++) {
+    if (values[i] == '+' || values[i] == '-') numberOfValues++;
+  }
+  // a measurement that does not fit into the response is cut short
+  if (numberOfValues > (concurrent ? 99 : 9)) numberOfValues = concurrent ? 99 : 9;
+  unsigned long seconds = (state.sensor.measurementTime + 999) / 1000;
+  snprintf(
+    bfr, sizeof(bfr), concurrent ? "%03lu%02u" : "%03lu%01u", seconds,
+    static_cast<unsigned int>(numberOfValues));
+  respond(state, bfr);
+  state.pages.clear();
+  state.measuring = true;
+  state.readyAt = VirtualClock::now() + state.sensor.measurementTime * 1000;
+}
+
+/*
+ *  Split the values of a finished measurement into aDn! pages
+ */
+void SimulatedSdi12Bus::update(SensorState &state) {
+  if (!state.measuring || VirtualClock::now() < state.readyAt) return;
+  const std::string &values = state.sensor.values;
+  std::string page;
+  uint8_t count = 0;
+  for (size_t i=0; i<values.size(); i++) {
+    if ((values[i] == '+' || values[i] == '-') && i > 0) {
+      if (++count == state.sensor.valuesPerPage) {
+        state.pages.push_back(page);
+        page.clear();
+        count = 0;
+      }
+    }
+    page += values[i];
+  }
+  if (!page.empty()) state.pages.push_back(page);
+  state.measuring = false;
+}
+
+void SimulatedSdi12Bus::handleCommand(const std::string &command) {
+  commandsReceived++;
+  if (command.size() < 2 || command[command.size() - 1] != '!') return;
+  // address query, only works with a single sensor on the bus
+  if (command == "?!") {
+    if (!_sensors.empty()) respond(_sensors[0], "");
+    return;
+  }
+  SensorState *state = find(command[0]);
+  if (state == NULL) return;
+  std::string body = command.substr(1, command.size() - 2);
+  update(*state);
+  // any command to a sensor aborts its measurement
+  if (state->measuring) {
+    state->measuring = false;
+    measurementsAborted++;
+  }
+  if (body.empty()) {
+    respond(*state, "");
+  } else if (body == "I") {
+    respond(*state, state->sensor.identity);
+  } else if (body == "M" || body == "C") {
+    startMeasurement(*state, body == "C");
+  } else if (body.size() == 2 && body[0] == 'D' && body[1] >= '0' && body[1] <= '9') {
+    size_t page = body[1] - '0';
+    respond(*state, page < state->pages.size() ? state->pages[page] : "");
+  } else if (body.size() == 2 && body[0] == 'A' && find(body[1]) == NULL) {
+    state->sensor.addr = body[1];
+    respond(*state, "");
+  }
+}
+
+void SimulatedSdi12Bus::begin() {
+  _random = seed ? seed : 1;
+}
+
+int SimulatedSdi12Bus::available() {
+  uint64_t now = VirtualClock::now();
+  int ret = 0;
+  for (size_t i=0; i<_wire.size() && _wire[i].time <= now; i++) ret++;
+  return ret;
+}
+
+int SimulatedSdi12Bus::read() {
+  if (_wire.empty() || _wire.front().time > VirtualClock::now()) return -1;
+  char c = _wire.front().character;
+  _wire.pop_front();
+  return static_cast<uint8_t>(c);
+}
+
+void SimulatedSdi12Bus::clearBuffer() {
+  uint64_t now = VirtualClock::now();
+  while (!_wire.empty() && _wire.front().time <= now) _wire.pop_front();
+}
+
+/*
+ *  The break of a command interrupts responses still on the wire
+ */
+void SimulatedSdi12Bus::sendCommand(const char *cmd) {
+  uint64_t now = VirtualClock::now();
+  while (!_wire.empty() && _wire.back().time > now) _wire.pop_back();
+  VirtualClock::advance(SDI12_WAKE_TIME + strlen(cmd) * SDI12_CHARACTER_TIME);
+  handleCommand(cmd);
+}
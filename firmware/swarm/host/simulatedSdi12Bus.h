@@ -0,0 +1,98 @@
+/*
+ *  Simulated SDI-12 bus with several sensors for host builds
+ *
+ *  - implements Sdi12BusBase so it can be passed to SDI12Measurement instead
+ *    of Sdi12Bus
+ *  - runs on the virtual clock of the Arduino shim: sending a command takes
+ *    the break, the marking and the characters at 1200 baud, responses
+ *    arrive character by character after the latency of the sensor
+ *  - sensors answer a!, aI!, aM!, aC!, aDn! and aAb!, a command to a sensor
+ *    that is still measuring aborts the measurement like the spec says
+ *  - faults: responses can be dropped and bytes garbled, randomly but
+ *    reproducible from seed
+ */
+#ifndef _SIMULATED_SDI12_BUS_H_
+#define _SIMULATED_SDI12_BUS_H_
+
+#include <Arduino.h>
+#include <deque>
+#include <string>
+#include <vector>
+#ifndef _SDI12_BUS_H_
+#include "../src/sdi12Bus.h"
+#endif
+
+// 10 bits per character at 1200 baud in us
+#define SDI12_CHARACTER_TIME 8333
+// break and marking before every command in us
+#define SDI12_WAKE_TIME 20400
+
+
+typedef struct {
+  char addr;
+  // aI! response without the address
+  std::string identity;
+  // aDn! responses concatenated without addresses, e.g. +1.2-3
+  std::string values;
+  uint8_t valuesPerPage;
+  // ms until data is ready, announced rounded up to seconds
+  unsigned long measurementTime;
+  // ms between the end of a command and the response
+  unsigned long latency;
+} SimulatedSensor;
+
+
+class SimulatedSdi12Bus: public Sdi12BusBase {
+  private:
+    typedef struct {
+      uint64_t time;
+      char character;
+    } TimedByte;
+    typedef struct {
+      SimulatedSensor sensor;
+      // aDn! pages of the last complete measurement
+      std::vector<std::string> pages;
+      uint64_t readyAt;
+      boolean measuring;
+    } SensorState;
+    std::vector<SensorState> _sensors;
+    // bytes on their way from the sensors to the MCU
+    std::deque<TimedByte> _wire;
+    uint32_t _random;
+    SensorState *find(const char addr);
+    boolean chance(float probability);
+    void respond(const SensorState &state, const std::string &response);
+    void handleCommand(const std::string &command);
+    void startMeasurement(SensorState &state, const boolean concurrent);
+    void update(SensorState &state);
+  public:
+    // configuration
+    uint32_t seed = 1;
+    // probability that a response is not sent at all
+    float dropRate = 0;
+    // probability that a byte is replaced by a random one
+    float garbleRate = 0;
+    // drop the next n responses regardless of dropRate
+    unsigned long dropNext = 0;
+    // statistics
+    unsigned long commandsReceived = 0;
+    unsigned long responsesSent = 0;
+    unsigned long responsesDropped = 0;
+    unsigned long bytesGarbled = 0;
+    unsigned long measurementsAborted = 0;
+    SimulatedSdi12Bus();
+    void addSensor(const SimulatedSensor &sensor);
+    // Meter ATMOS 41 with the 18 values in the README example
+    void addAtmos41(const char addr);
+    // Meter TEROS 12
+    void addTeros12(const char addr);
+    // values a sensor reports, e.g. to compare with what was received
+    const char *values(const char addr);
+    void begin();
+    int available();
+    int read();
+    void clearBuffer();
+    void sendCommand(const char *cmd);
+};
+
+#endif
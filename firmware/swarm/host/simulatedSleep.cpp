@@ -0,0 +1,31 @@
+/*
+ *  Simulated ESP32 sleep modes, see simulatedSleep.h
+ */
+#include "simulatedSleep.h"
+
+
+SimulatedSleep::SimulatedSleep() {
+  powerOn();
+}
+
+void SimulatedSleep::powerOn() {
+  memset(&_rtc, 0x5a, sizeof(_rtc));
+  _woke = false;
+}
+
+boolean SimulatedSleep::wokeFromDeepSleep() { return _woke; }
+
+void SimulatedSleep::lightSleep(unsigned long seconds) {
+  VirtualClock::advance(seconds * 1000000ULL);
+  sleepTime += seconds * 1000000ULL;
+  lightSleeps++;
+}
+
+void SimulatedSleep::deepSleep(unsigned long seconds) {
+  VirtualClock::advance(seconds * 1000000ULL);
+  sleepTime += seconds * 1000000ULL;
+  deepSleeps++;
+  _woke = true;
+}
+
+RetainedState *SimulatedSleep::retained() { return &_rtc; }
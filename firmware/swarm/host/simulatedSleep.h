@@ -0,0 +1,37 @@
+/*
+ *  Simulated ESP32 sleep modes for host builds
+ *
+ *  - implements SleepWrapperBase so it can be used instead of SleepWrapper
+ *  - sleeping lets the virtual clock pass; deep sleep returns as well, the
+ *    caller has to start over like the firmware does with setup()
+ *  - RTC memory survives deep sleep but holds garbage after power on
+ */
+#ifndef _SIMULATED_SLEEP_H_
+#define _SIMULATED_SLEEP_H_
+
+#include <Arduino.h>
+#ifndef _SLEEP_WRAPPER_H_
+#include "../src/sleepWrapper.h"
+#endif
+
+
+class SimulatedSleep: public SleepWrapperBase {
+  private:
+    RetainedState _rtc;
+    boolean _woke;
+  public:
+    // statistics
+    unsigned long lightSleeps = 0;
+    unsigned long deepSleeps = 0;
+    // us
+    uint64_t sleepTime = 0;
+    SimulatedSleep();
+    // power on or reset
+    void powerOn();
+    boolean wokeFromDeepSleep();
+    void lightSleep(unsigned long seconds);
+    void deepSleep(unsigned long seconds);
+    RetainedState *retained();
+};
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ *  Scripted SWARM tile simulator, see simulatedTile.h
+ */
+#include "simulatedTile.h"
+
+
+/*
+ *  Tile starts up the moment it is powered, i.e. at construction
+ */
+SimulatedTile::SimulatedTile(unsigned long startEpoch) {
+  _startEpoch = startEpoch;
+  _nextPass = 0;
+  _messageId = 5354468575900;
+  boot();
+}
+
+/*
+ *  (Re)start the tile, reports resume after booting with retained rates
+ */
+void SimulatedTile::boot() {
+  _bootedAt = VirtualClock::now() + bootTime * 1000;
+  _sleepUntil = 0;
+  emitAt("$TILE BOOT,RUNNING", _bootedAt);
+  schedule(_nextDateTime, dateTimeRate);
+  schedule(_nextRssi, rssiRate);
+  schedule(_nextGeospatial, geospatialRate);
+  schedule(_nextGpsStatus, gpsStatusRate);
+}
+
+unsigned long SimulatedTile::epoch() {
+  return _startEpoch + VirtualClock::now() / 1000000;
+}
+
+/*
+ *  Put a sentence on the wire at time, but after the bytes already in transit
+ */
+void SimulatedTile::emitAt(const char *sentence, uint64_t time) {
+  char bfr[512];
+  uint8_t cs = 0;
+  size_t len = strlen(sentence);
+  for (size_t i=1; i<len; i++) cs ^= static_cast<uint8_t>(sentence[i]);
+  len = snprintf(bfr, sizeof(bfr), "%s*%02x\n", sentence, cs);
+  uint64_t byteTime = 10000000 / baudRate;
+  if (!_wire.empty() && _wire.back().time > time) time = _wire.back().time;
+  for (size_t i=0; i<len; i++) {
+    time += byteTime;
+    _wire.push_back({time, bfr[i]});
+  }
+}
+
+void SimulatedTile::emit(const char *sentence, uint64_t latencyUs) {
+  emitAt(sentence, VirtualClock::now() + latencyUs);
+}
+
+void SimulatedTile::emitDateTime(uint64_t time) {
+  char bfr[32];
+  time_t tme = _startEpoch + time / 1000000;
+  struct tm parts;
+  gmtime_r(&tme, &parts);
+  strftime(bfr, sizeof(bfr), "$DT %Y%m%d%H%M%S", &parts);
+  strcat(bfr, time - _bootedAt > gpsFixTime * 1000 ? ",V" : ",I");
+  emitAt(bfr, time);
+}
+
+void SimulatedTile::inject(const char *sentence) { emit(sentence); }
+
+void SimulatedTile::resetUart() {
+  // catch up with the reports sent in the meantime, they are lost rather
+  // than dropped by a full FIFO
+  unsigned long dropped = bytesDropped;
+  update();
+  bytesDropped = dropped;
+  _fifo.clear();
+}
+
+/*
+ *  Start a periodic report aligned to the tile clock like the tile does
+ */
+void SimulatedTile::schedule(uint64_t &next, unsigned long rate) {
+  uint64_t start = VirtualClock::now();
+  if (start < _bootedAt) start = _bootedAt;
+  next = rate ? (start / (rate * 1000000) + 1) * rate * 1000000 : 0;
+}
+
+/*
+ *  Generate everything that happened until now in chronological order and
+ *  move arrived bytes into the receive FIFO
+ */
+void SimulatedTile::update() {
+  char bfr[128];
+  uint64_t now = VirtualClock::now();
+  if (_nextPass == 0) _nextPass = now + passInterval * 1000;
+  while (true) {
+    uint64_t *next = NULL;
+    uint64_t *candidates[] = {
+      &_nextDateTime, &_nextRssi, &_nextGeospatial, &_nextGpsStatus, &_nextPass};
+    for (size_t i=0; i<5; i++) {
+      uint64_t value = *candidates[i];
+      if (value && value <= now && (next == NULL || value < *next)) {
+        next = candidates[i];
+      }
+    }
+    if (next == NULL) break;
+    uint64_t time = *next;
+    // a sleeping or booting tile is quiet
+    boolean awake = time >= _bootedAt && time >= _sleepUntil;
+    if (_sleepUntil && time >= _sleepUntil) {
+      emitAt("$SL WAKE,TIMER", _sleepUntil);
+      _sleepUntil = 0;
+    }
+    if (next == &_nextDateTime) {
+      if (awake) emitDateTime(time);
+      *next += dateTimeRate * 1000000;
+    } else if (next == &_nextRssi) {
+      if (awake) emitAt("$RT RSSI=-104", time);
+      *next += rssiRate * 1000000;
+    } else if (next == &_nextGeospatial) {
+      if (awake) emitAt("$GN 37.8000,-122.2700,12,0,0", time);
+      *next += geospatialRate * 1000000;
+    } else if (next == &_nextGpsStatus) {
+      if (awake) emitAt("$GS 109,214,10,0,G3", time);
+      *next += gpsStatusRate * 1000000;
+    } else {
+      expire(time);
+      if (awake && satellitesVisible && !_unsent.empty()) {
+        snprintf(
+          bfr, sizeof(bfr), "$TD SENT,RSSI=-110,SNR=6,FDEV=0,%llu",
+          static_cast<unsigned long long>(_unsent.front().id));
+        _unsent.pop_front();
+        messagesSent++;
+        emitAt(bfr, time);
+      }
+      *next += passInterval * 1000;
+    }
+  }
+  if (_sleepUntil && now >= _sleepUntil) {
+    emitAt("$SL WAKE,TIMER", _sleepUntil);
+    _sleepUntil = 0;
+  }
+  while (!_wire.empty() && _wire.front().time <= now) {
+    if (_fifo.size() < fifoSize) {
+      _fifo.push_back(_wire.front().character);
+    } else {
+      bytesDropped++;
+    }
+    _wire.pop_front();
+  }
+}
+
+/*
+ *  Drop the messages whose hold duration ran out by time
+ */
+void SimulatedTile::expire(uint64_t time) {
+  while (!_unsent.empty() && _unsent.front().expires != 0
+    && _unsent.front().expires <= time
+  ) {
+    _unsent.pop_front();
+    messagesExpired++;
+  }
+}
+
+void SimulatedTile::handleCommand(const std::string &command) {
+  char bfr[128];
+  uint64_t latency = responseLatency * 1000;
+  size_t star = command.rfind('*');
+  commandsReceived++;
+  if (star == std::string::npos || command.size() < star + 3) return;
+  std::string body = command.substr(0, star);
+  uint8_t cs = 0;
+  for (size_t i=1; i<body.size(); i++) cs ^= static_cast<uint8_t>(body[i]);
+  std::string name = body.substr(0, 3);
+  std::string args = body.size() > 4 ? body.substr(4) : "";
+  if (strtol(command.substr(star + 1, 2).c_str(), NULL, 16) != cs) {
+    snprintf(bfr, sizeof(bfr), "%s ERR,E_BADCHECKSUM", name.c_str());
+    emit(bfr, latency);
+    return;
+  }
+  // a sleeping or booting tile does not listen
+  uint64_t now = VirtualClock::now();
+  if (now < _bootedAt || now < _sleepUntil) return;
+  if (name == "$RS") {
+    emit("$RS OK", latency);
+    resets++;
+    boot();
+  } else if (name == "$DT") {
+    if (args == "@") {
+      timeQueries++;
+      emitDateTime(now + latency);
+    } else if (args == "?") {
+      snprintf(bfr, sizeof(bfr), "$DT %lu", dateTimeRate);
+      emit(bfr, latency);
+    } else {
+      dateTimeRate = strtoul(args.c_str(), NULL, 10);
+      schedule(_nextDateTime, dateTimeRate);
+      emit("$DT OK", latency);
+    }
+  } else if (name == "$RT" || name == "$GN" || name == "$GS") {
+    unsigned long rate = strtoul(args.c_str(), NULL, 10);
+    if (name == "$RT") {
+      rssiRate = rate;
+      schedule(_nextRssi, rate);
+    }
+    if (name == "$GN") {
+      geospatialRate = rate;
+      schedule(_nextGeospatial, rate);
+    }
+    if (name == "$GS") {
+      gpsStatusRate = rate;
+      schedule(_nextGpsStatus, rate);
+    }
+    snprintf(bfr, sizeof(bfr), "%s OK", name.c_str());
+    emit(bfr, latency);
+  } else if (name == "$MT") {
+    expire(now);
+    if (args == "D=U") {
+      snprintf(bfr, sizeof(bfr), "$MT %lu", static_cast<unsigned long>(_unsent.size()));
+      _unsent.clear();
+    } else {
+      snprintf(bfr, sizeof(bfr), "$MT %lu", static_cast<unsigned long>(_unsent.size()));
+    }
+    emit(bfr, latency);
+  } else if (name == "$TD") {
+    size_t comma = args.find(',');
+    std::string data = comma == std::string::npos ? args : args.substr(comma + 1);
+    // hex encoded data counts half
+    if (data.size() / 2 > 192) {
+      emit("$TD ERR,E_MSGTOOLONG,0", latency);
+    } else if (queueLimit > 0 && _unsent.size() >= queueLimit) {
+      messagesRejected++;
+      emit("$TD ERR,DBXTOHIVEFULL,0", latency);
+    } else {
+      QueuedMessage message;
+      message.id = ++_messageId;
+      message.expires = 0;
+      // HD=<seconds> before the data
+      if (comma != std::string::npos && args.compare(0, 3, "HD=") == 0) {
+        message.expires = now + strtoull(args.c_str() + 3, NULL, 10) * 1000000;
+      }
+      _unsent.push_back(message);
+      messagesQueued++;
+      snprintf(
+        bfr, sizeof(bfr), "$TD OK,%llu", static_cast<unsigned long long>(_messageId));
+      emit(bfr, latency);
+    }
+  } else if (name == "$SL") {
+    unsigned long seconds = 0;
+    if (args.compare(0, 2, "S=") == 0) seconds = strtoul(args.c_str() + 2, NULL, 10);
+    emit("$SL OK", latency);
+    _sleepUntil = now + latency + seconds * 1000000;
+    sleeps++;
+    sleepTime += seconds * 1000000;
+  } else {
+    snprintf(bfr, sizeof(bfr), "%s ERR,E_UNKNOWN", name.c_str());
+    emit(bfr, latency);
+  }
+}
+
+boolean SimulatedTile::available() {
+  update();
+  return !_fifo.empty();
+}
+
+/*
+ *  Mimics the Arduino behavior where reading an empty buffer returns 255
+ */
+char SimulatedTile::read() {
+  update();
+  if (_fifo.empty()) return 255;
+  char ret = _fifo.front();
+  _fifo.pop_front();
+  bytesFromTile++;
+  return ret;
+}
+
+void SimulatedTile::write(byte character) {
+  bytesToTile++;
+  if (character == '\n') {
+    handleCommand(_command);
+    _command.clear();
+  } else {
+    _command.push_back(character);
+  }
+}
+
+size_t SimulatedTile::write(char *bfr, size_t len) {
+  update();
+  for (size_t i=0; i<len; i++) write(static_cast<byte>(bfr[i]));
+  return len;
+}
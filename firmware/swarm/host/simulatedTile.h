@@ -0,0 +1,106 @@
+/*
+ *  Scripted SWARM tile simulator for host builds
+ *
+ *  - implements SerialWrapperBase so it can be passed to SwarmNode instead of
+ *    SerialWrapper
+ *  - runs on the virtual clock of the Arduino shim, bytes are delivered at the
+ *    UART rate and land in a receive FIFO of limited size like on the ESP32
+ *  - answers the commands used by the firmware, see
+ *    https://swarm.space/wp-content/uploads/2021/06/Swarm-Tile-Product-Manual.pdf
+ *  - emits unsolicited $DT, $RT, $GN, and $GS reports at the configured rates
+ */
+#ifndef _SIMULATED_TILE_H_
+#define _SIMULATED_TILE_H_
+
+#include <Arduino.h>
+#include <deque>
+#include <string>
+#ifndef _SERIAL_WRAPPER_H_
+#include "../src/serialWrapper.h"
+#endif
+
+
+class SimulatedTile: public SerialWrapperBase {
+  private:
+    typedef struct {
+      uint64_t time;
+      char character;
+    } TimedByte;
+    // bytes on their way from the tile to the MCU
+    std::deque<TimedByte> _wire;
+    // bytes received by the MCU UART but not read yet
+    std::deque<char> _fifo;
+    // command currently being received from the MCU
+    std::string _command;
+    // messages accepted with $TD and waiting for a satellite
+    typedef struct {
+      uint64_t id;
+      // end of the hold duration, 0 for none
+      uint64_t expires;
+    } QueuedMessage;
+    std::deque<QueuedMessage> _unsent;
+    unsigned long _startEpoch;
+    uint64_t _bootedAt;
+    uint64_t _sleepUntil;
+    uint64_t _nextDateTime;
+    uint64_t _nextRssi;
+    uint64_t _nextGeospatial;
+    uint64_t _nextGpsStatus;
+    uint64_t _nextPass;
+    unsigned long _messageId;
+    void boot();
+    void emit(const char *sentence, uint64_t latencyUs=0);
+    void emitAt(const char *sentence, uint64_t time);
+    void emitDateTime(uint64_t time);
+    void expire(uint64_t time);
+    void handleCommand(const std::string &command);
+    void schedule(uint64_t &next, unsigned long rate);
+    void update();
+  public:
+    // configuration, times in ms unless noted otherwise
+    uint32_t baudRate = 115200;
+    size_t fifoSize = 256;
+    unsigned long bootTime = 8000;
+    unsigned long responseLatency = 20;
+    unsigned long gpsFixTime = 30000;
+    // time between satellite passes that send one queued message each
+    unsigned long passInterval = 600000;
+    // messages the tile holds until they are sent, 0 for no limit
+    unsigned long queueLimit = 0;
+    // passes send nothing while false, e.g. no view of the sky
+    boolean satellitesVisible = true;
+    // report rates in seconds, 0 disables, retained over $RS like on the tile
+    unsigned long dateTimeRate = 20;
+    unsigned long rssiRate = 60;
+    unsigned long geospatialRate = 60;
+    unsigned long gpsStatusRate = 60;
+    // statistics
+    unsigned long bytesToTile = 0;
+    unsigned long bytesFromTile = 0;
+    unsigned long bytesDropped = 0;
+    unsigned long commandsReceived = 0;
+    unsigned long messagesQueued = 0;
+    unsigned long messagesSent = 0;
+    unsigned long messagesRejected = 0;
+    // dropped after their hold duration
+    unsigned long messagesExpired = 0;
+    unsigned long resets = 0;
+    // $DT @ queries
+    unsigned long timeQueries = 0;
+    // $SL, sleepTime in us
+    unsigned long sleeps = 0;
+    uint64_t sleepTime = 0;
+    SimulatedTile(unsigned long startEpoch=1663023600);
+    // tile time as unix epoch
+    unsigned long epoch();
+    // queue an arbitrary sentence, NMEA checksum and newline are added
+    void inject(const char *sentence);
+    // the MCU UART is off in deep sleep, everything sent so far is lost
+    void resetUart();
+    boolean available();
+    char read();
+    void write(byte character);
+    size_t write(char *bfr, size_t len);
+};
+
+#endif
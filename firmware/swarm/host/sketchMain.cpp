@@ -0,0 +1,18 @@
+/*
+ *  Runs an Arduino sketch on the host, the build passes the sketch path in
+ *  SKETCH
+ *
+ *  - the Arduino builder includes Arduino.h into every sketch, we do the same
+ *  - TZ is UTC like on the ESP32 without time zone configuration
+ */
+#include <Arduino.h>
+#include SKETCH
+
+
+int main() {
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  setup();
+  while (true) loop();
+  return 0;
+}
@@ -0,0 +1,312 @@
+/*
+ *  Statistics of readings taken more often than messages are sent, sent as
+ *  one binary frame, see FRAME_SC_SUMMARY in the message format spec in
+ *  swarm.ino
+ *
+ *  - per value min, max, and the running mean and variance (Welford's
+ *    algorithm); fields marked FIELD_ACCUMULATOR in sensorSchema.h like
+ *    precip_mm are summed up exactly instead
+ *  - fixed size and updated in place, a sample costs a few float operations
+ *    per value; trivially copyable so it can be kept in RTC memory
+ *  - all samples share the same channel layout like in MessageBatch, a
+ *    different layout requires a new aggregate
+ *  - values outside the range of their field in sensorSchema.h are left out,
+ *    one sensor error would spoil the statistics; how often is sent along
+ *    per value
+ *  - statistics too large for one message can be sent one channel per
+ *    frame, see encode()
+ *  - directions like windDir_deg (FIELD_DIRECTION) are averaged as unit
+ *    vectors, the circular mean and circular standard deviation are sent
+ *    instead of min, mean, and max that make no sense for angles; the means
+ *    of the wind components give the direction of the average wind
+ */
+#ifndef _AGGREGATE_H_
+#define _AGGREGATE_H_
+
+#ifndef _MESSAGES_H_
+#include "messages.h"
+#endif
+
+#define FRAME_SC_SUMMARY 0x03
+#define MAX_AGGREGATE_VALUES MAX_MESSAGE_VALUES
+
+
+typedef struct {
+  // fixed point like in the binary encoding
+  int32_t min;
+  int32_t max;
+  // running mean and sum of squared differences from it
+  float mean;
+  float m2;
+  int64_t sum;
+  // unit vectors of directions
+  float sinSum;
+  float cosSum;
+  // samples the value was left out of for being out of range
+  uint32_t rejected;
+} FieldAggregate;
+
+
+class MessageAggregate {
+  private:
+    static int32_t saturate(int64_t value) {
+      if (value > INT32_MAX) return INT32_MAX;
+      if (value < INT32_MIN) return INT32_MIN;
+      return static_cast<int32_t>(value);
+    };
+
+    static boolean putByte(char *bfr, size_t &idx, const uint8_t value) {
+      if (idx + 1 > MAX_MESSAGE_LENGTH) return false;
+      bfr[idx++] = static_cast<char>(value);
+      return true;
+    };
+
+    static boolean putVarint(char *bfr, size_t &idx, const uint64_t value) {
+      char varintBfr[10];
+      const size_t len = MessageHelpers::writeVarint(value, varintBfr);
+      if (idx + len > MAX_MESSAGE_LENGTH) return false;
+      memcpy(bfr + idx, varintBfr, len);
+      idx += len;
+      return true;
+    };
+
+    static uint64_t roundPositive(const float value) {
+      return value > 0 ? static_cast<uint64_t>(value + .5) : 0;
+    };
+
+    // samples that went into the statistics of value i
+    uint32_t valid(const uint8_t i) const {
+      return numberOfSamples - fields[i].rejected;
+    };
+
+    boolean anyRejected(const uint8_t first, const uint8_t count) const {
+      for (uint8_t i=first; i<first+count; i++) {
+        if (fields[i].rejected > 0) return true;
+      }
+      return false;
+    };
+
+    /*
+     *  Statistics of value i, see message format spec in swarm.ino
+     */
+    boolean encodeValue(char *bfr, size_t &idx, const uint8_t i) const {
+      const FieldAggregate &field = fields[i];
+      if (aggregations[i] == FIELD_ACCUMULATOR) {
+        if (!putVarint(bfr, idx, MessageHelpers::zigzag(field.sum))) return false;
+        return putVarint(bfr, idx, MessageHelpers::zigzag(field.max));
+      }
+      if (aggregations[i] == FIELD_DIRECTION) {
+        const float scale = pow(10, decimals[i]);
+        uint64_t mean = roundPositive(circularMean(i) * scale);
+        // rounded up to a full circle
+        if (mean >= roundPositive(360 * scale)) mean = 0;
+        if (!putVarint(bfr, idx, mean)) return false;
+        return putVarint(bfr, idx, roundPositive(circularStdDev(i) * scale));
+      }
+      // mean and max as offsets from min are positive and small
+      uint64_t mean = roundPositive(field.mean - field.min);
+      const uint64_t range = static_cast<uint64_t>(
+        static_cast<int64_t>(field.max) - field.min);
+      if (mean > range) mean = range;
+      if (!putVarint(bfr, idx, MessageHelpers::zigzag(field.min))) return false;
+      if (!putVarint(bfr, idx, mean)) return false;
+      if (!putVarint(bfr, idx, range)) return false;
+      return putVarint(bfr, idx, roundPositive(sqrt(variance(i))));
+    };
+
+  public:
+    // channel layout
+    uint8_t numberOfChannels = 0;
+    uint8_t channels[5];
+    // number of values, CHANNEL_SELF_DESCRIBING flag like in encodeChannel
+    uint8_t counts[5];
+    uint8_t numberOfValues = 0;
+    uint8_t decimals[MAX_AGGREGATE_VALUES];
+    // FIELD_GAUGE, FIELD_ACCUMULATOR, or FIELD_DIRECTION
+    uint8_t aggregations[MAX_AGGREGATE_VALUES];
+    // samples
+    uint32_t numberOfSamples = 0;
+    // samples with values left out for being out of range
+    uint32_t numberOfRejected = 0;
+    unsigned long firstTimeStamp = 0;
+    unsigned long lastTimeStamp = 0;
+    // lowest battery voltage in 0.01V
+    int32_t batteryVoltage = 0;
+    FieldAggregate fields[MAX_AGGREGATE_VALUES];
+
+    void reset() {
+      numberOfChannels = 0;
+      numberOfValues = 0;
+      numberOfSamples = 0;
+      numberOfRejected = 0;
+    };
+
+    /*
+     *  Sample variance of a value
+     */
+    float variance(const uint8_t i) const {
+      if (valid(i) < 2) return 0;
+      return fields[i].m2 / (valid(i) - 1);
+    };
+
+    /*
+     *  Circular mean of a direction in degrees, 0 to less than 360
+     */
+    float circularMean(const uint8_t i) const {
+      float ret = atan2(fields[i].sinSum, fields[i].cosSum) * 180 / M_PI;
+      return ret < 0 ? ret + 360 : ret;
+    };
+
+    /*
+     *  Circular standard deviation of a direction in degrees,
+     *  sqrt(-2 ln R) with R the length of the mean unit vector
+     */
+    float circularStdDev(const uint8_t i) const {
+      if (valid(i) == 0) return 0;
+      const float r = sqrt(fields[i].sinSum * fields[i].sinSum
+        + fields[i].cosSum * fields[i].cosSum) / valid(i);
+      if (r >= 1) return 0;
+      // opposite directions cancel out
+      if (r <= 0) return 360;
+      const float ret = sqrt(-2 * log(r)) * 180 / M_PI;
+      return ret > 360 ? 360 : ret;
+    };
+
+    /*
+     *  Add the readings of a message. Returns false if the channel layout
+     *  differs; send the aggregate and start a new one in this case.
+     */
+    boolean add(const Message &message) {
+      Readings readings;
+      MessageHelpers::getReadings(message, readings);
+      const int32_t battery = static_cast<uint16_t>(message.batteryVoltage * 100 + .5);
+      if (numberOfSamples == 0) {
+        numberOfChannels = readings.numberOfChannels;
+        memcpy(channels, readings.channels, readings.numberOfChannels);
+        memcpy(counts, readings.counts, readings.numberOfChannels);
+        numberOfValues = readings.numberOfValues;
+        memcpy(decimals, readings.decimals, readings.numberOfValues);
+        uint8_t idx = 0;
+        for (uint8_t i=0; i<numberOfChannels; i++) {
+          const SensorSchema *schema = counts[i] & CHANNEL_SELF_DESCRIBING
+            ? NULL : findSensorSchema(channels[i]);
+          const uint8_t count = counts[i] & ~CHANNEL_SELF_DESCRIBING;
+          for (uint8_t j=0; j<count; j++, idx++) {
+            aggregations[idx] = schema != NULL
+              ? schema->fields[j].aggregation : FIELD_GAUGE;
+          }
+        }
+        for (uint8_t i=0; i<numberOfValues; i++) {
+          fields[i].min = INT32_MAX;
+          fields[i].max = INT32_MIN;
+          fields[i].mean = 0;
+          fields[i].m2 = 0;
+          fields[i].sum = 0;
+          fields[i].sinSum = 0;
+          fields[i].cosSum = 0;
+          fields[i].rejected = 0;
+        }
+        firstTimeStamp = message.timeStamp;
+        batteryVoltage = battery;
+      } else {
+        if (readings.numberOfChannels != numberOfChannels) return false;
+        if (readings.numberOfValues != numberOfValues) return false;
+        for (uint8_t i=0; i<numberOfChannels; i++) {
+          if (readings.channels[i] != channels[i]) return false;
+          if (readings.counts[i] != counts[i]) return false;
+        }
+        if (message.timeStamp < lastTimeStamp) return false;
+      }
+      numberOfSamples++;
+      if (readings.outOfRange != 0) numberOfRejected++;
+      lastTimeStamp = message.timeStamp;
+      if (battery < batteryVoltage) batteryVoltage = battery;
+      for (uint8_t i=0; i<numberOfValues; i++) {
+        FieldAggregate &field = fields[i];
+        if (readings.outOfRange & (1ULL << i)) {
+          field.rejected++;
+          continue;
+        }
+        const int32_t value = saturate(Sdi12Parser::rescale(
+          readings.values[i], readings.decimals[i], decimals[i]));
+        if (value < field.min) field.min = value;
+        if (value > field.max) field.max = value;
+        field.sum += value;
+        const float delta = value - field.mean;
+        field.mean += delta / valid(i);
+        field.m2 += delta * (value - field.mean);
+        if (aggregations[i] == FIELD_DIRECTION) {
+          const float angle = value / pow(10, decimals[i]) * M_PI / 180;
+          field.sinSum += sin(angle);
+          field.cosSum += cos(angle);
+        }
+      }
+      return true;
+    };
+
+    /*
+     *  Write the aggregate as binary frame, see message format spec in
+     *  swarm.ino. Returns 0 if there is nothing to send or it does not fit
+     *  into MAX_MESSAGE_LENGTH; send the channels first to last - 1 in
+     *  frames of their own in this case.
+     */
+    size_t encode(char *bfr, const unsigned long index) {
+      return encode(bfr, index, 0, numberOfChannels);
+    };
+
+    size_t encode(
+      char *bfr, const unsigned long index, const uint8_t first,
+      const uint8_t last
+    ) {
+      size_t idx = 0;
+      if (numberOfSamples == 0) return 0;
+      bfr[idx++] = FRAME_SC_SUMMARY;
+      idx += MessageHelpers::writeVarint(index, bfr + idx);
+      for (size_t i=0; i<4; i++) {
+        bfr[idx++] = static_cast<char>((firstTimeStamp >> (8 * i)) & 0xFF);
+      }
+      idx += MessageHelpers::writeVarint(lastTimeStamp - firstTimeStamp, bfr + idx);
+      idx += MessageHelpers::writeVarint(numberOfSamples, bfr + idx);
+      idx += MessageHelpers::writeVarint(numberOfRejected, bfr + idx);
+      idx += MessageHelpers::writeVarint(batteryVoltage, bfr + idx);
+      bfr[idx++] = last - first;
+      uint8_t valueIdx = 0;
+      uint8_t firstValue = 0;
+      for (uint8_t i=0; i<last; i++) {
+        const uint8_t count = counts[i] & ~CHANNEL_SELF_DESCRIBING;
+        if (i < first) {
+          valueIdx += count;
+          firstValue = valueIdx;
+          continue;
+        }
+        if (!putByte(bfr, idx, channels[i])) return 0;
+        if (!putByte(bfr, idx, counts[i]
+          | (anyRejected(valueIdx, count) ? CHANNEL_OUT_OF_RANGE : 0))
+        ) {
+          return 0;
+        }
+        if (counts[i] & CHANNEL_SELF_DESCRIBING) {
+          for (uint8_t j=0; j<count; j++) {
+            if (!putByte(bfr, idx, decimals[valueIdx+j])) return 0;
+          }
+        }
+        valueIdx += count;
+      }
+      valueIdx = firstValue;
+      for (uint8_t c=first; c<last; c++) {
+        const uint8_t count = counts[c] & ~CHANNEL_SELF_DESCRIBING;
+        const boolean flagged = anyRejected(valueIdx, count);
+        for (uint8_t i=valueIdx; i<valueIdx+count; i++) {
+          if (flagged) {
+            if (!putVarint(bfr, idx, fields[i].rejected)) return 0;
+            if (valid(i) == 0) continue;
+          }
+          if (!encodeValue(bfr, idx, i)) return 0;
+        }
+        valueIdx += count;
+      }
+      return idx;
+    };
+};
+
+#endif
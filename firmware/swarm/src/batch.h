@@ -0,0 +1,228 @@
+/*
+ *  Collect several measurement cycles (epochs) in RAM and send them as one
+ *  binary message, see FRAME_SC_BATCH in the message format spec in swarm.ino
+ *
+ *  - all epochs of a batch share the same channel layout, i.e. channels,
+ *    number of values and their decimals; a different layout requires a new
+ *    batch
+ *  - epochs after the first are stored as deltas in the frame, readings
+ *    usually change little between epochs so that most deltas take one byte
+ *  - values out of range are left out like in encodeChannel, the value
+ *    before them (0 in the first epoch) is kept so that the next delta
+ *    refers to it
+ */
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#ifndef _MESSAGES_H_
+#include "messages.h"
+#endif
+
+#define FRAME_SC_BATCH 0x02
+#define MAX_BATCH_DEPTH 12
+// values of all channels in one epoch
+#define MAX_BATCH_VALUES MAX_MESSAGE_VALUES
+
+
+class MessageBatch {
+  private:
+    // encoded length of the frame with the epochs added so far
+    size_t _length = 0;
+
+    static size_t varintLength(uint64_t value) {
+      size_t len = 1;
+      while (value > 0x7F) {
+        value >>= 7;
+        len++;
+      }
+      return len;
+    };
+
+    static int32_t saturate(int64_t value) {
+      if (value > INT32_MAX) return INT32_MAX;
+      if (value < INT32_MIN) return INT32_MIN;
+      return static_cast<int32_t>(value);
+    };
+
+    // the bits of count values from first on
+    static uint64_t channelBits(
+      const uint64_t bits, const uint8_t first, const uint8_t count
+    ) {
+      return (bits >> first) & ((1ULL << count) - 1);
+    };
+
+    /*
+     *  Encoded length of the masks of values out of range including those
+     *  of readings, one varint per epoch for each channel with any
+     */
+    size_t masksLength(const Readings &readings) const {
+      uint64_t any = readings.outOfRange;
+      for (uint8_t e=0; e<numberOfEpochs; e++) any |= outOfRange[e];
+      size_t len = 0;
+      uint8_t first = 0;
+      for (uint8_t i=0; i<readings.numberOfChannels; i++) {
+        const uint8_t count = readings.counts[i] & ~CHANNEL_SELF_DESCRIBING;
+        if (channelBits(any, first, count) != 0) {
+          for (uint8_t e=0; e<numberOfEpochs; e++) {
+            len += varintLength(channelBits(outOfRange[e], first, count));
+          }
+          len += varintLength(channelBits(readings.outOfRange, first, count));
+        }
+        first += count;
+      }
+      return len;
+    };
+
+  public:
+    // channel layout
+    uint8_t numberOfChannels = 0;
+    uint8_t channels[5];
+    // number of values, CHANNEL_SELF_DESCRIBING flag like in encodeChannel
+    uint8_t counts[5];
+    uint8_t numberOfValues = 0;
+    uint8_t decimals[MAX_BATCH_VALUES];
+    // epochs
+    uint8_t numberOfEpochs = 0;
+    unsigned long timeStamps[MAX_BATCH_DEPTH];
+    // battery voltage in 0.01V
+    int32_t batteryVoltages[MAX_BATCH_DEPTH];
+    int32_t values[MAX_BATCH_DEPTH][MAX_BATCH_VALUES];
+    // bit i is set if value i was out of range, see Readings
+    uint64_t outOfRange[MAX_BATCH_DEPTH];
+
+    void reset() {
+      numberOfChannels = 0;
+      numberOfValues = 0;
+      numberOfEpochs = 0;
+      _length = 0;
+    };
+
+    /*
+     *  Add the readings of a message as a new epoch. Returns false if the
+     *  batch is full, the channel layout or the decimals of a self-describing
+     *  value differ, or the epoch would not fit
+     *  into MAX_MESSAGE_LENGTH; send the batch and start a new one in this
+     *  case.
+     */
+    boolean add(const Message &message) {
+      Readings readings;
+      if (numberOfEpochs == MAX_BATCH_DEPTH) return false;
+      MessageHelpers::getReadings(message, readings);
+      const int32_t battery = static_cast<uint16_t>(message.batteryVoltage * 100 + .5);
+      size_t len = 0;
+      if (numberOfEpochs == 0) {
+        // the first epoch defines the layout and the precision of
+        // self-describing values
+        len = 1 + 5 + 4 + varintLength(battery) + 2;
+        for (uint8_t i=0; i<readings.numberOfChannels; i++) {
+          len += 2;
+          if (readings.counts[i] & CHANNEL_SELF_DESCRIBING) {
+            len += readings.counts[i] & ~CHANNEL_SELF_DESCRIBING;
+          }
+        }
+        for (uint8_t i=0; i<readings.numberOfValues; i++) {
+          if (readings.outOfRange & (1ULL << i)) {
+            readings.values[i] = 0;
+            continue;
+          }
+          len += varintLength(MessageHelpers::zigzag(saturate(readings.values[i])));
+        }
+      } else {
+        if (readings.numberOfChannels != numberOfChannels) return false;
+        if (readings.numberOfValues != numberOfValues) return false;
+        for (uint8_t i=0; i<numberOfChannels; i++) {
+          if (readings.channels[i] != channels[i]) return false;
+          if (readings.counts[i] != counts[i]) return false;
+        }
+        // schema values are already scaled to the decimals of their field
+        if (memcmp(readings.decimals, decimals, numberOfValues) != 0) return false;
+        if (message.timeStamp < timeStamps[numberOfEpochs-1]) return false;
+        len = varintLength(message.timeStamp - timeStamps[numberOfEpochs-1]);
+        len += varintLength(MessageHelpers::zigzag(
+          static_cast<int64_t>(battery) - batteryVoltages[numberOfEpochs-1]));
+        for (uint8_t i=0; i<readings.numberOfValues; i++) {
+          if (readings.outOfRange & (1ULL << i)) {
+            readings.values[i] = values[numberOfEpochs-1][i];
+            continue;
+          }
+          len += varintLength(MessageHelpers::zigzag(
+            static_cast<int64_t>(saturate(readings.values[i])) -
+            values[numberOfEpochs-1][i]));
+        }
+      }
+      // the message index is not known yet, assume the worst case above
+      if (_length + len + masksLength(readings) > MAX_MESSAGE_LENGTH) return false;
+      if (numberOfEpochs == 0) {
+        numberOfChannels = readings.numberOfChannels;
+        memcpy(channels, readings.channels, readings.numberOfChannels);
+        memcpy(counts, readings.counts, readings.numberOfChannels);
+        numberOfValues = readings.numberOfValues;
+        memcpy(decimals, readings.decimals, readings.numberOfValues);
+      }
+      timeStamps[numberOfEpochs] = message.timeStamp;
+      batteryVoltages[numberOfEpochs] = battery;
+      outOfRange[numberOfEpochs] = readings.outOfRange;
+      for (uint8_t i=0; i<numberOfValues; i++) {
+        values[numberOfEpochs][i] = saturate(readings.values[i]);
+      }
+      numberOfEpochs++;
+      _length += len;
+      return true;
+    };
+
+    /*
+     *  Write the batch as binary frame, see message format spec in swarm.ino
+     */
+    size_t encode(char *bfr, const unsigned long index) {
+      size_t idx = 0;
+      if (numberOfEpochs == 0) return 0;
+      uint64_t any = 0;
+      for (uint8_t e=0; e<numberOfEpochs; e++) any |= outOfRange[e];
+      bfr[idx++] = FRAME_SC_BATCH;
+      idx += MessageHelpers::writeVarint(index, bfr + idx);
+      for (size_t i=0; i<4; i++) {
+        bfr[idx++] = static_cast<char>((timeStamps[0] >> (8 * i)) & 0xFF);
+      }
+      idx += MessageHelpers::writeVarint(batteryVoltages[0], bfr + idx);
+      bfr[idx++] = numberOfEpochs;
+      bfr[idx++] = numberOfChannels;
+      uint8_t valueIdx = 0;
+      for (uint8_t i=0; i<numberOfChannels; i++) {
+        const uint8_t count = counts[i] & ~CHANNEL_SELF_DESCRIBING;
+        bfr[idx++] = channels[i];
+        bfr[idx++] = counts[i]
+          | (channelBits(any, valueIdx, count) != 0 ? CHANNEL_OUT_OF_RANGE : 0);
+        if (counts[i] & CHANNEL_SELF_DESCRIBING) {
+          for (uint8_t j=0; j<count; j++) bfr[idx++] = decimals[valueIdx+j];
+        }
+        valueIdx += count;
+      }
+      for (uint8_t e=0; e<numberOfEpochs; e++) {
+        if (e > 0) {
+          idx += MessageHelpers::writeVarint(
+            timeStamps[e] - timeStamps[e-1], bfr + idx);
+          idx += MessageHelpers::writeVarint(MessageHelpers::zigzag(
+            static_cast<int64_t>(batteryVoltages[e]) - batteryVoltages[e-1]),
+            bfr + idx);
+        }
+        valueIdx = 0;
+        for (uint8_t i=0; i<numberOfChannels; i++) {
+          const uint8_t count = counts[i] & ~CHANNEL_SELF_DESCRIBING;
+          if (channelBits(any, valueIdx, count) != 0) {
+            idx += MessageHelpers::writeVarint(
+              channelBits(outOfRange[e], valueIdx, count), bfr + idx);
+          }
+          for (uint8_t j=valueIdx; j<valueIdx+count; j++) {
+            if (outOfRange[e] & (1ULL << j)) continue;
+            const int64_t previous = e > 0 ? values[e-1][j] : 0;
+            idx += MessageHelpers::writeVarint(MessageHelpers::zigzag(
+              static_cast<int64_t>(values[e][j]) - previous), bfr + idx);
+          }
+          valueIdx += count;
+        }
+      }
+      return idx;
+    };
+};
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ *  Spend a monthly message quota, e.g. the 720 messages included in the
+ *  SWARM plan, on the readings that matter
+ *
+ *  - readings are taken every sampling interval and due() decides if they
+ *    are worth a message
+ *  - the pace is the rest of the month divided by the messages left. Flat
+ *    readings are sent at BUDGET_FLAT_FACTOR times that interval, which
+ *    saves budget for later; a change beyond the usual sample-to-sample
+ *    noise shortens the interval down to minInterval. Whatever is saved or
+ *    overspent shows up in the pace for the rest of the month.
+ *  - nothing is sent once the quota is spent, months are calendar months of
+ *    tile time (UTC); other messages like acknowledgements of configuration
+ *    commands are charged to the same quota
+ *  - trivially copyable so it can be kept in RTC memory
+ */
+#ifndef _BUDGET_H_
+#define _BUDGET_H_
+
+#include <Arduino.h>
+#ifndef _MESSAGES_H_
+#include "messages.h"
+#endif
+
+#define BUDGET_MAX_VALUES 48
+// flat readings are sent at this multiple of the pace
+#define BUDGET_FLAT_FACTOR 2
+// a change of this many times the usual change between samples is
+// significant
+#define BUDGET_NOISE_MULTIPLE 4
+// the usual change is averaged over about this many samples
+#define BUDGET_NOISE_WINDOW 16
+
+
+class MessageBudget {
+  public:
+    // configuration, seconds
+    uint32_t quota = 720;
+    unsigned long minInterval = 900;
+    unsigned long maxInterval = 21600;
+    // months since January 1970 and messages sent in it
+    uint32_t month = 0;
+    uint32_t spent = 0;
+    unsigned long lastSent = 0;
+    // readings of the last message
+    uint8_t numberOfSentValues = 0;
+    float sentValues[BUDGET_MAX_VALUES];
+    // the previous sample, and the average absolute change between samples
+    uint8_t numberOfValues = 0;
+    float previous[BUDGET_MAX_VALUES];
+    float noise[BUDGET_MAX_VALUES];
+    // one unit of the last digit of every value
+    float resolution[BUDGET_MAX_VALUES];
+
+    /*
+     *  Calendar month of a unix epoch, see
+     *  http://howardhinnant.github.io/date_algorithms.html
+     */
+    static uint32_t monthOf(const unsigned long epoch) {
+      const unsigned long z = epoch / 86400 + 719468;
+      const unsigned long era = z / 146097;
+      const unsigned long doe = z - era * 146097;
+      const unsigned long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+      const unsigned long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+      const unsigned long mp = (5 * doy + 2) / 153;
+      const unsigned long m = mp < 10 ? mp + 3 : mp - 9;
+      const unsigned long y = yoe + era * 400 + (m <= 2 ? 1 : 0);
+      return (y - 1970) * 12 + m - 1;
+    };
+
+    static unsigned long monthStart(const uint32_t month) {
+      const unsigned long m = month % 12 + 1;
+      const unsigned long y = 1970 + month / 12 - (m <= 2 ? 1 : 0);
+      const unsigned long era = y / 400;
+      const unsigned long yoe = y - era * 400;
+      const unsigned long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5;
+      const unsigned long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+      return (era * 146097 + doe - 719468) * 86400;
+    };
+
+    /*
+     *  All values of a message in one array, returns how many
+     */
+    static uint8_t flatten(
+      const Message &message, float *values, float *resolution
+    ) {
+      static const float powers[] = {
+        1, 10, 100, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+      uint8_t ret = 0;
+      for (uint8_t i=0; i<5 && message.payloads[i].channel != 0; i++) {
+        Sdi12Values parsed;
+        const Sdi12Values *payload = &message.payloads[i].values;
+        if (payload->count == 0) {
+          Sdi12Parser::parse(
+            message.payloads[i].payload, strlen(message.payloads[i].payload),
+            parsed);
+          payload = &parsed;
+        }
+        for (uint8_t j=0; j<payload->count && ret<BUDGET_MAX_VALUES; j++) {
+          values[ret] = Sdi12Parser::toFloat(*payload, j);
+          resolution[ret] = 1 / powers[payload->decimals[j]];
+          ret++;
+        }
+      }
+      return ret;
+    };
+
+    /*
+     *  How much the readings moved away from the last message, root mean
+     *  square over all values so one noisy value does not decide alone; 1 is
+     *  BUDGET_NOISE_MULTIPLE times the usual change
+     */
+    float significance(const float *values, const uint8_t count) {
+      // nothing to compare with
+      if (count != numberOfSentValues || lastSent == 0) return 1e6;
+      float ret = 0;
+      for (uint8_t i=0; i<count; i++) {
+        float scale = noise[i] > resolution[i] ? noise[i] : resolution[i];
+        float change = (values[i] - sentValues[i]) / (BUDGET_NOISE_MULTIPLE * scale);
+        ret += change * change;
+      }
+      return count > 0 ? sqrt(ret / count) : 0;
+    };
+
+    /*
+     *  Start a new month if tileTime is in one, returns the messages left
+     */
+    uint32_t remaining(const unsigned long tileTime) {
+      const uint32_t current = monthOf(tileTime);
+      if (current != month) {
+        month = current;
+        spent = 0;
+      }
+      return spent < quota ? quota - spent : 0;
+    };
+
+    /*
+     *  Seconds between messages to use up the rest of the quota evenly
+     */
+    unsigned long pace(const unsigned long tileTime) {
+      const uint32_t left = remaining(tileTime);
+      if (left == 0) return 0xFFFFFFFFUL;
+      return (monthStart(month + 1) - tileTime) / left;
+    };
+
+    /*
+     *  Seconds to wait after the last message for readings that moved this
+     *  much
+     */
+    unsigned long interval(const unsigned long tileTime, const float significance) {
+      const unsigned long current = pace(tileTime);
+      const unsigned long upper = maxInterval > current ? maxInterval : current;
+      float ret = current * static_cast<float>(BUDGET_FLAT_FACTOR) /
+        (1 + BUDGET_FLAT_FACTOR * significance * significance);
+      if (ret > upper) return upper;
+      if (ret < minInterval) return minInterval;
+      return static_cast<unsigned long>(ret);
+    };
+
+    /*
+     *  Take the readings of a sample into account, true if they should be
+     *  sent; call spend() if they are
+     */
+    boolean due(const unsigned long tileTime, const Message &message) {
+      float values[BUDGET_MAX_VALUES];
+      float resolutions[BUDGET_MAX_VALUES];
+      const uint8_t count = flatten(message, values, resolutions);
+      const float moved = significance(values, count);
+      if (count == numberOfValues) {
+        for (uint8_t i=0; i<count; i++) {
+          noise[i] += (fabs(values[i] - previous[i]) - noise[i]) / BUDGET_NOISE_WINDOW;
+        }
+      } else {
+        for (uint8_t i=0; i<count; i++) noise[i] = 0;
+      }
+      for (uint8_t i=0; i<count; i++) {
+        previous[i] = values[i];
+        resolution[i] = resolutions[i];
+      }
+      numberOfValues = count;
+      if (remaining(tileTime) == 0) return false;
+      return tileTime - lastSent >= interval(tileTime, moved);
+    };
+
+    /*
+     *  Count a message that is not readings, false if the quota is spent
+     */
+    boolean charge(const unsigned long tileTime) {
+      if (remaining(tileTime) == 0) return false;
+      spent++;
+      return true;
+    };
+
+    void spend(const unsigned long tileTime, const Message &message) {
+      float resolutions[BUDGET_MAX_VALUES];
+      remaining(tileTime);
+      numberOfSentValues = flatten(message, sentValues, resolutions);
+      lastSent = tileTime;
+      spent++;
+    };
+};
+
+#endif
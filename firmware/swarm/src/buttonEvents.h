@@ -0,0 +1,186 @@
+/*
+ *  Button presses from GPIO interrupts
+ *
+ *  - the interrupt handler only puts the raw edge, level and time, into a
+ *    single producer single consumer ring; no locks, the handler owns the
+ *    head, the UI the tail; handler and UI run on the same core, fences
+ *    keep the compiler from moving the edge across the index update;
+ *    edge() is in IRAM and calls nothing else, an edge during a flash
+ *    write would crash the handler otherwise
+ *  - the UI debounces when it takes events: a level counts once it was
+ *    stable for BUTTON_DEBOUNCE_MS, replayed from the edge times so that a
+ *    short press is not lost when the UI looks late
+ *  - every button has its own debounce and repeat state
+ *  - a button held for BUTTON_REPEAT_AFTER repeats every
+ *    BUTTON_REPEAT_INTERVAL like a keyboard
+ *  - knows nothing about pins, interrupts or sleep, see DisplayWrapper
+ */
+#ifndef _BUTTON_EVENTS_H_
+#define _BUTTON_EVENTS_H_
+
+#include <Arduino.h>
+#include <atomic>
+
+#define BUTTONS 3
+// power of 2, a press with bounces takes a few edges
+#define BUTTON_QUEUE_SIZE 32
+#define BUTTON_DEBOUNCE_MS 30
+#define BUTTON_REPEAT_AFTER 1000
+#define BUTTON_REPEAT_INTERVAL 200
+// nothing pending in wakeIn()
+#define BUTTON_NO_WAKE 0xFFFFFFFFUL
+
+// event types
+#define BUTTON_PRESSED 0
+#define BUTTON_REPEATED 1
+#define BUTTON_RELEASED 2
+
+
+typedef struct {
+  // index of the button
+  uint8_t button;
+  uint8_t type;
+  // millis() when it happened, i.e. the level was stable
+  unsigned long time;
+} ButtonEvent;
+
+
+class ButtonEvents {
+  private:
+    typedef struct {
+      uint8_t button;
+      boolean down;
+      unsigned long time;
+    } Edge;
+
+    Edge _edges[BUTTON_QUEUE_SIZE];
+    // written by the interrupt handler only
+    volatile uint8_t _head = 0;
+    // written by the UI only
+    volatile uint8_t _tail = 0;
+    // debounce state of the UI
+    boolean _raw[BUTTONS] = {false};
+    unsigned long _rawTime[BUTTONS] = {0};
+    boolean _down[BUTTONS] = {false};
+    unsigned long _nextRepeat[BUTTONS] = {0};
+
+    /*
+     *  Take the level of button if it was stable until now
+     */
+    boolean settle(const uint8_t button, const unsigned long now, ButtonEvent &event) {
+      if (_raw[button] == _down[button]) return false;
+      if (now - _rawTime[button] < BUTTON_DEBOUNCE_MS) return false;
+      _down[button] = _raw[button];
+      event.button = button;
+      event.time = _rawTime[button] + BUTTON_DEBOUNCE_MS;
+      event.type = _down[button] ? BUTTON_PRESSED : BUTTON_RELEASED;
+      _nextRepeat[button] = event.time + BUTTON_REPEAT_AFTER;
+      return true;
+    };
+
+  public:
+    // edges lost because the UI did not take events
+    volatile unsigned long overflows = 0;
+
+    /*
+     *  From the interrupt handler, down is the level read in the handler
+     */
+    void IRAM_ATTR edge(
+      const uint8_t button, const boolean down, const unsigned long time
+    ) {
+      const uint8_t head = _head;
+      const uint8_t next = (head + 1) & (BUTTON_QUEUE_SIZE - 1);
+      if (next == _tail) {
+        overflows++;
+        return;
+      }
+      _edges[head].button = button;
+      _edges[head].down = down;
+      _edges[head].time = time;
+      std::atomic_signal_fence(std::memory_order_release);
+      _head = next;
+    };
+
+    /*
+     *  Level read by the UI for an edge the interrupt handler missed, e.g.
+     *  while the CPU was asleep; ignored while edges are queued, they are
+     *  older and the handler will queue the newer ones
+     */
+    void sample(const uint8_t button, const boolean down, const unsigned long now) {
+      if (button >= BUTTONS || _tail != _head || down == _raw[button]) return;
+      _raw[button] = down;
+      _rawTime[button] = now;
+    };
+
+    /*
+     *  Next debounced event at now, false if there is none
+     */
+    boolean next(ButtonEvent &event, const unsigned long now) {
+      while (_tail != _head) {
+        std::atomic_signal_fence(std::memory_order_acquire);
+        const Edge &edge = _edges[_tail];
+        if (edge.button >= BUTTONS) {
+          _tail = (_tail + 1) & (BUTTON_QUEUE_SIZE - 1);
+          continue;
+        }
+        // the level before this edge may have been long enough, the edge
+        // stays queued and is replayed with the next call
+        if (settle(edge.button, edge.time, event)) return true;
+        // after a lost edge or a sample() the level may not change
+        if (edge.down != _raw[edge.button]) {
+          _raw[edge.button] = edge.down;
+          _rawTime[edge.button] = edge.time;
+        }
+        std::atomic_signal_fence(std::memory_order_release);
+        _tail = (_tail + 1) & (BUTTON_QUEUE_SIZE - 1);
+      }
+      for (uint8_t i=0; i<BUTTONS; i++) {
+        if (settle(i, now, event)) return true;
+      }
+      for (uint8_t i=0; i<BUTTONS; i++) {
+        if (_down[i] && _raw[i] && static_cast<long>(now - _nextRepeat[i]) >= 0) {
+          event.button = i;
+          event.type = BUTTON_REPEATED;
+          event.time = _nextRepeat[i];
+          _nextRepeat[i] += BUTTON_REPEAT_INTERVAL;
+          return true;
+        }
+      }
+      return false;
+    };
+
+    /*
+     *  ms from now until next() has an event without another edge, a level
+     *  to settle or a repeat; BUTTON_NO_WAKE if nothing is pending. Only
+     *  valid after next() returned false.
+     */
+    unsigned long wakeIn(const unsigned long now) const {
+      unsigned long ret = BUTTON_NO_WAKE;
+      for (uint8_t i=0; i<BUTTONS; i++) {
+        unsigned long at;
+        if (_raw[i] != _down[i]) {
+          at = _rawTime[i] + BUTTON_DEBOUNCE_MS;
+        } else if (_down[i]) {
+          at = _nextRepeat[i];
+        } else {
+          continue;
+        }
+        const unsigned long in = static_cast<long>(at - now) > 0 ? at - now : 0;
+        if (in < ret) ret = in;
+      }
+      return ret;
+    };
+
+    /*
+     *  Debounced level
+     */
+    boolean down(const uint8_t button) const {
+      return button < BUTTONS && _down[button];
+    };
+
+    boolean empty() const {
+      return _tail == _head;
+    };
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ *  Build a tile command in its final buffer
+ *
+ *  - text and hex-encoded bytes are appended in place while the NMEA
+ *    checksum is updated, finish() adds *<checksum>\n; nothing is formatted
+ *    into temporary buffers and copied together
+ *  - hex digits come from a table, lower case like in the tile manual
+ *  - a command that does not fit is not truncated, finish() returns 0
+ */
+#ifndef _COMMAND_WRITER_H_
+#define _COMMAND_WRITER_H_
+
+#include <Arduino.h>
+
+// *<checksum>\n
+#define COMMAND_CHECKSUM_LENGTH 4
+
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+
+class CommandWriter {
+  private:
+    char *_bfr;
+    size_t _size;
+    size_t _len = 0;
+    uint8_t _checksum = 0;
+    boolean _overflow = false;
+
+  public:
+    CommandWriter(char *bfr, const size_t size): _bfr(bfr), _size(size) {};
+
+    size_t length() const {
+      return _len;
+    };
+
+    /*
+     *  The leading $ is not part of the checksum
+     */
+    void append(const char *text, const size_t len) {
+      if (_overflow || _len + len > _size) {
+        _overflow = true;
+        return;
+      }
+      size_t i = 0;
+      if (_len == 0 && len > 0 && text[0] == '$') _bfr[_len++] = text[i++];
+      for (; i<len; i++) {
+        _checksum ^= static_cast<uint8_t>(text[i]);
+        _bfr[_len++] = text[i];
+      }
+    };
+
+    /*
+     *  Two characters per byte, see TD in the tile manual
+     */
+    void appendHex(const char *bytes, const size_t len) {
+      if (_overflow || _len + 2 * len > _size) {
+        _overflow = true;
+        return;
+      }
+      char *out = _bfr + _len;
+      uint8_t checksum = _checksum;
+      for (size_t i=0; i<len; i++) {
+        const uint8_t byte = bytes[i];
+        const char high = HEX_DIGITS[byte >> 4];
+        const char low = HEX_DIGITS[byte & 0x0F];
+        checksum ^= high ^ low;
+        *out++ = high;
+        *out++ = low;
+      }
+      _checksum = checksum;
+      _len += 2 * len;
+    };
+
+    /*
+     *  Add checksum and new line, returns the length of the command or 0 if
+     *  it did not fit
+     */
+    size_t finish() {
+      if (_overflow || _len + COMMAND_CHECKSUM_LENGTH > _size) return 0;
+      _bfr[_len++] = '*';
+      _bfr[_len++] = HEX_DIGITS[_checksum >> 4];
+      _bfr[_len++] = HEX_DIGITS[_checksum & 0x0F];
+      _bfr[_len++] = '\n';
+      return _len;
+    };
+};
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ *  CRC-32 (IEEE 802.3, as used by zlib) for data kept in flash
+ *
+ *  - bitwise without a table, the records checked are small
+ *  - update() allows for checking data that is not contiguous
+ */
+#ifndef _CRC32_H_
+#define _CRC32_H_
+
+#include <Arduino.h>
+
+#define CRC32_INITIAL 0xFFFFFFFFUL
+
+
+class Crc32 {
+  public:
+    static uint32_t update(uint32_t crc, const void *data, const size_t len) {
+      const uint8_t *bytes = static_cast<const uint8_t*>(data);
+      for (size_t i=0; i<len; i++) {
+        crc ^= bytes[i];
+        for (uint8_t j=0; j<8; j++) {
+          crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+      }
+      return crc;
+    };
+
+    static uint32_t finish(const uint32_t crc) { return ~crc; };
+
+    static uint32_t compute(const void *data, const size_t len) {
+      return finish(update(CRC32_INITIAL, data, len));
+    };
+};
+
+#endif
@@ -0,0 +1,4 @@
+#include "displayWrapper.h"
+
+
+ButtonEvents DisplayWrapper::events;
@@ -4,6 +4,14 @@
  *  - abstracts display and could be potentially swapped for other
  *    output options such as Serial
  *  - adds functionality
+ *  - text goes into a TextConsole, only the lines that changed are redrawn
+ *    and sent over I2C, at most once per DISPLAY_FRAME_INTERVAL; call
+ *    update() regularly to get deferred text out
+ *  - the display is switched off after DISPLAY_BLANK_AFTER without a button
+ *    press and on again by the next one; text keeps going into the console
+ *    meanwhile but is not sent
+ *  - buttons are read by GPIO interrupts into ButtonEvents, nextEvent()
+ *    waits for them in light sleep instead of polling
  */
  // libraries driving the OLED display
 #ifndef _DISPLAY_WRAPPER_H_
@@ -13,11 +21,29 @@
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SH110X.h>
+#ifndef _PROFILER_H_
+#include "profiler.h"
+#endif
+#ifndef _TEXT_CONSOLE_H_
+#include "textConsole.h"
+#endif
+#ifndef _BUTTON_EVENTS_H_
+#include "buttonEvents.h"
+#endif
+#include <esp_sleep.h>
 
 // this varies on different Feather boards see example code
 #define BUTTON_A 15
 #define BUTTON_B 32
 #define BUTTON_C 14
+// wait for a button without timeout
+#define BUTTON_WAIT_FOREVER 0xFFFFFFFFUL
+
+// ms between frames sent to the display
+#define DISPLAY_FRAME_INTERVAL 250
+// ms without a button press until the display is switched off
+#define DISPLAY_BLANK_AFTER 120000
+#define DISPLAY_WIDTH 128
 
 // add base class for mocking and testing
 class DisplayWrapperBase {
@@ -25,7 +51,7 @@ class DisplayWrapperBase {
     virtual ~DisplayWrapperBase() {};
     virtual void begin() {};
     virtual boolean button(int button) { return false; };
-    virtual boolean buttonDebounced(int button) { return false; };
+    virtual boolean nextEvent(ButtonEvent &event, unsigned long ms) { return false; };
     virtual void clearDisplay() {};
     virtual void display() {};
     virtual int getCursorY() { return 0; };
@@ -37,20 +63,85 @@ class DisplayWrapperBase {
     virtual void println(String line) {};
     virtual void resetDisplay() {};
     virtual void setCursor(int x, int y) {};
+    virtual void update() {};
     virtual void write(char c) {};
 };
 
 class DisplayWrapper: public DisplayWrapperBase {
   private:
     Adafruit_SH1107 thisDisplay = Adafruit_SH1107(64, 128, &Wire);
-    // buffer and lineNumber for later implementation of scrolling
-    // display, UNUSED for now
-    char displayBuffer[20][7];
-    unsigned long buttonDownTime;
-    int lineNumber;
-    // keep track whether button has been released;
-    boolean buttonState[32] = { true };
+    TextConsole console;
+    unsigned long lastFrame = 0;
+    // first update() that found text not sent yet
+    unsigned long dirtySince = 0;
+    boolean pending = false;
+    unsigned long lastActivity = 0;
+    boolean blank = false;
+
+    /*
+     *  Filled by the interrupt handlers, static since they have no object;
+     *  defined in displayWrapper.cpp so that it is built before begin()
+     *  attaches them, a function-local static would be built on first use
+     *  in the handler behind a guard that may lock
+     */
+    static ButtonEvents events;
+
+    static uint8_t pin(const uint8_t button) {
+      static const uint8_t pins[BUTTONS] = { BUTTON_A, BUTTON_B, BUTTON_C };
+      return pins[button];
+    };
+
+    static void IRAM_ATTR buttonAChanged() {
+      events.edge(0, !digitalRead(BUTTON_A), millis());
+    };
+
+    static void IRAM_ATTR buttonBChanged() {
+      events.edge(1, !digitalRead(BUTTON_B), millis());
+    };
+
+    static void IRAM_ATTR buttonCChanged() {
+      events.edge(2, !digitalRead(BUTTON_C), millis());
+    };
+
+    /*
+     *  Light sleep until ms passed or a button changes; a held button wakes
+     *  on release, otherwise its level would wake at once
+     */
+    void sleepUntilButton(const unsigned long ms) {
+      for (uint8_t i=0; i<BUTTONS; i++) {
+        gpio_wakeup_enable(static_cast<gpio_num_t>(pin(i)),
+          digitalRead(pin(i)) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+      }
+      esp_sleep_enable_gpio_wakeup();
+      esp_sleep_enable_timer_wakeup(ms * 1000ULL);
+      esp_light_sleep_start();
+      // the loop sleeps on the timer only
+      esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+      for (uint8_t i=0; i<BUTTONS; i++) {
+        gpio_wakeup_disable(static_cast<gpio_num_t>(pin(i)));
+      }
+      sleeps++;
+      // the handler may not see an edge that woke the CPU
+      for (uint8_t i=0; i<BUTTONS; i++) {
+        events.sample(i, !digitalRead(pin(i)), millis());
+      }
+    };
+
+    void activity() {
+      lastActivity = millis();
+      if (blank) {
+        thisDisplay.oled_command(SH110X_DISPLAYON);
+        blank = false;
+      }
+    };
+
   public:
+    // statistics, frames sent and the lines they contained
+    unsigned long frames = 0;
+    unsigned long linesSent = 0;
+    // light sleeps while waiting for a button
+    unsigned long sleeps = 0;
+
     DisplayWrapper() {
       pinMode(BUTTON_A, INPUT_PULLUP);
       pinMode(BUTTON_B, INPUT_PULLUP);
@@ -63,76 +154,140 @@ class DisplayWrapper: public DisplayWrapperBase {
       thisDisplay.setTextSize(1);
       setTextColor(SH110X_WHITE);
       thisDisplay.setRotation(1);
-      clearDisplay();
-      setCursor(0, 0);
-      lineNumber=0;
+      thisDisplay.clearDisplay();
+      resetDisplay();
+      attachInterrupt(digitalPinToInterrupt(BUTTON_A), buttonAChanged, CHANGE);
+      attachInterrupt(digitalPinToInterrupt(BUTTON_B), buttonBChanged, CHANGE);
+      attachInterrupt(digitalPinToInterrupt(BUTTON_C), buttonCChanged, CHANGE);
+      activity();
     };
 
     // read button A
     boolean button(int bttn) {
-      return !digitalRead(bttn);
+      boolean ret = !digitalRead(bttn);
+      if (ret) activity();
+      return ret;
     };
 
-    // check for release (or 1s time passed) and read button
-    boolean buttonDebounced(int bttn) {
-      boolean ret = !digitalRead(bttn);
-      if (!buttonState[bttn]) {
-        buttonState[bttn] = ret;
-        if (ret) buttonDownTime = millis();
-      } else {
-        buttonState[bttn] = ret;
-        if (buttonDownTime + 1000 > millis()) {
-          ret = false;
+    /*
+     *  Wait up to ms for a press, repeat or release, event.button is
+     *  BUTTON_A, B or C; sleeps light in between and keeps sending frames
+     */
+    boolean nextEvent(ButtonEvent &event, unsigned long ms) {
+      ButtonEvents &buttons = events;
+      const unsigned long start = millis();
+      while (!buttons.next(event, millis())) {
+        const unsigned long now = millis();
+        if (now - start >= ms) return false;
+        update();
+        unsigned long wait = ms - (now - start);
+        const unsigned long wake = buttons.wakeIn(now);
+        if (wake < wait) wait = wake;
+        if (pending && wait > DISPLAY_FRAME_INTERVAL) wait = DISPLAY_FRAME_INTERVAL;
+        if (!blank) {
+          const unsigned long blankIn = lastActivity + DISPLAY_BLANK_AFTER - now;
+          if (blankIn < wait) wait = blankIn;
         }
+        if (wait > 0) sleepUntilButton(wait);
       }
-      return ret;
+      event.button = pin(event.button);
+      activity();
+      return true;
     };
 
-    void clearDisplay() { thisDisplay.clearDisplay(); };
+    void clearDisplay() { console.clear(); };
 
-    void display() { thisDisplay.display(); };
+    /*
+     *  Draw the lines that changed and send them; the driver sends the
+     *  display RAM between the first and the last line drawn, lines that are
+     *  not next to each other go out separately
+     */
+    void display() {
+      if (blank) return;
+      const uint8_t dirty = console.takeDirty();
+      pending = false;
+      if (dirty == 0) return;
+      ProfileScope scope(PHASE_DISPLAY);
+      uint8_t row = 0;
+      while (row < CONSOLE_LINES) {
+        if ((dirty & (1 << row)) == 0) {
+          row++;
+          continue;
+        }
+        const uint8_t first = row;
+        for (; row < CONSOLE_LINES && (dirty & (1 << row)); row++) {
+          size_t len;
+          const char *text = console.line(row, len);
+          thisDisplay.fillRect(0, row * 8, DISPLAY_WIDTH, 8, SH110X_BLACK);
+          thisDisplay.setCursor(0, row * 8);
+          for (size_t i=0; i<len; i++) thisDisplay.write(text[i]);
+        }
+        thisDisplay.display();
+        linesSent += row - first;
+        Profiler::global().countBytes(BUS_I2C, (row - first) * DISPLAY_WIDTH);
+      }
+      frames++;
+      lastFrame = millis();
+    };
 
-    int getCursorY() { return thisDisplay.getCursorY(); };
+    /*
+     *  Send what changed once it waited for DISPLAY_FRAME_INTERVAL, more
+     *  text in the meantime goes out with it; switch the display off after a
+     *  while without a button press
+     */
+    void update() {
+      const unsigned long now = millis();
+      if (console.dirty() != 0 && !pending) {
+        pending = true;
+        dirtySince = now;
+      }
+      if (pending && now - dirtySince >= DISPLAY_FRAME_INTERVAL &&
+        now - lastFrame >= DISPLAY_FRAME_INTERVAL
+      ) {
+        display();
+      }
+      if (!blank && now - lastActivity >= DISPLAY_BLANK_AFTER) {
+        thisDisplay.oled_command(SH110X_DISPLAYOFF);
+        blank = true;
+      }
+    };
 
-    void print(char character) { thisDisplay.print(character); };
+    boolean isBlank() { return blank; };
+
+    int getCursorY() { return console.row() * 8; };
+
+    void print(char character) { write(character); };
 
     void print(int number, int format=DEC) {
-      thisDisplay.print(number, format);
+      char bfr[16];
+      int len = snprintf(bfr, sizeof(bfr), format == HEX ? "%x" : "%d", number);
+      for (int i=0; i<len; i++) write(bfr[i]);
     };
 
-    void println(String line) { thisDisplay.println(line); };
+    void println(String line) {
+      for (size_t i=0; i<line.length(); i++) write(line.c_str()[i]);
+      write('\n');
+    };
 
     void printBuffer(char *bfr, size_t len) {
-      if (getCursorY() > 60) {
-          clearDisplay();
-          setCursor(0, 0);
-      }
-      for (size_t i=0; i<len; i++) {
-        print(bfr[i]);
-      }
-      display();
+      console.write(bfr, len);
+      update();
     };
 
     void shortPrintBuffer(char *bfr, size_t len) {
       if (static_cast<int>(len) > 20) {
-        printBuffer(bfr, 21);
-        if (!bfr[20] != '\n') print('\n');
+        console.write(bfr, 21);
+        if (bfr[20] != '\n') console.write('\n');
+        update();
       } else {
         printBuffer(bfr, len);
       }
     };
 
     void printBuffer(String string) {
-      char bfr[512];
       size_t len = string.length();
-      if (len > 512) {
-        string = string.substring(0, 512);
-        len = 512;
-      }
-      // not sure why we need len+1 here but last letter
-      // get truncated otherwise
-      string.toCharArray(bfr, len+1);
-      printBuffer(bfr, len);
+      if (len > 512) len = 512;
+      printBuffer(const_cast<char *>(string.c_str()), len);
     };
 
     /*
@@ -143,11 +298,11 @@ class DisplayWrapper: public DisplayWrapperBase {
       setCursor(0, 0);
     };
 
-    void setCursor(int x, int y) { thisDisplay.setCursor(x, y); };
+    void setCursor(int x, int y) { console.setCursor(y / 8, x / 6); };
 
     void setTextColor(uint16_t textcolor) {
       thisDisplay.setTextColor(textcolor);
     };
 
-    void write(char c) { thisDisplay.write(c); };
+    void write(char c) { console.write(c); };
 };
@@ -0,0 +1,272 @@
+/*
+ *  Remote configuration with authenticated commands sent to the tile
+ *
+ *  - a command is ASCII text: a sequence number, settings as KEY=value, and
+ *    the SipHash-2-4 tag of everything before the '#' as 16 hex digits, e.g.
+ *    42,MF=1800,BD=4#4a1f0c9b7e2d3a58
+ *  - keys, values as in NodeConfig:
+ *     - MF measurementFrequencyS, SF sampleFrequencyS, AF aggregateFrequencyS
+ *     - BD batchDepth, MQ monthlyQuota
+ *     - EN encoding, T for text (CSV) or B for binary
+ *     - CH channels measured, e.g. CH=014, the others are disabled
+ *     - CI how often a channel is powered and measured, address and every
+ *       n-th message, e.g. CI=37
+ *     - AD SDI-12 address change, old and new address, e.g. AD=12
+ *    CH, CI and AD can be repeated and refer to the addresses before AD
+ *  - the sequence has to be higher than the last one, a recorded command
+ *    cannot be sent again
+ *  - a command is applied as a whole or not at all, nothing out of range is
+ *    stored; the node acknowledges with the sequence and the status in its
+ *    next uplink, unless the tag was wrong or the command a replay
+ *  - knows nothing about the tile or the sensors, see processIncoming() in
+ *    swarm.ino
+ */
+#ifndef _DOWNLINK_H_
+#define _DOWNLINK_H_
+
+#include <Arduino.h>
+#ifndef _SIP_HASH_H_
+#include "sipHash.h"
+#endif
+#ifndef _NMEA_DECODER_H_
+#include "nmeaDecoder.h"
+#endif
+#ifndef _NODE_PERSISTENT_MEMORY_
+#include "memory.h"
+#endif
+#ifndef _COMMAND_WRITER_H_
+#include "commandWriter.h"
+#endif
+
+// first byte of an acknowledgement in the uplink
+#define FRAME_CONFIG_ACK 0x04
+// hex digits of the tag
+#define DOWNLINK_TAG_LENGTH 16
+// fits a $MM line of the tile as hex
+#define DOWNLINK_MAX_LENGTH 112
+
+// status of a command
+#define DOWNLINK_APPLIED 0
+#define DOWNLINK_BAD_TAG 1
+#define DOWNLINK_REPLAYED 2
+#define DOWNLINK_BAD_FORMAT 3
+#define DOWNLINK_BAD_VALUE 4
+// the settings were applied but a sensor did not take its new address
+#define DOWNLINK_ADDRESS_FAILED 5
+
+
+typedef struct {
+  uint32_t sequence;
+  uint8_t status;
+  // SDI-12 address changes, done on the bus by the caller
+  uint8_t numberOfAddressChanges;
+  char oldAddress[CONFIG_MAX_CHANNELS];
+  char newAddress[CONFIG_MAX_CHANNELS];
+} DownlinkCommand;
+
+
+class Downlink {
+  private:
+    static int8_t channelIndex(const NodeConfig &config, const char addr) {
+      for (uint8_t i=0; i<config.numberOfChannels; i++) {
+        if (config.channels[i] == addr) return i;
+      }
+      return -1;
+    };
+
+    static boolean toNumber(const NmeaField &field, const uint32_t max, uint32_t &value) {
+      uint64_t ret;
+      if (!NmeaDecoder::toUnsigned(field, &ret) || ret > max) return false;
+      value = ret;
+      return true;
+    };
+
+    static int8_t hexValue(const char c) {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      return -1;
+    };
+
+    /*
+     *  A KEY=value field into config, returns the status
+     */
+    static uint8_t applyField(
+      const NmeaField &field, NodeConfig &config, DownlinkCommand &command
+    ) {
+      uint32_t value;
+      if (field.len < 3 || field.text[2] != '=') return DOWNLINK_BAD_FORMAT;
+      const char *key = field.text;
+      const NmeaField valueField = {field.text + 3, field.len - 3};
+      const char *v = valueField.text;
+      if (memcmp(key, "MF", 2) == 0 || memcmp(key, "SF", 2) == 0 ||
+        memcmp(key, "AF", 2) == 0
+      ) {
+        if (!toNumber(valueField, 0xFFFFFFFFUL, value)) return DOWNLINK_BAD_FORMAT;
+        if (key[0] == 'M') config.measurementFrequencyS = value;
+        else if (key[0] == 'S') config.sampleFrequencyS = value;
+        else config.aggregateFrequencyS = value;
+      } else if (memcmp(key, "BD", 2) == 0) {
+        if (!toNumber(valueField, 0xFF, value)) return DOWNLINK_BAD_VALUE;
+        config.batchDepth = value;
+      } else if (memcmp(key, "MQ", 2) == 0) {
+        if (!toNumber(valueField, 0xFFFF, value)) return DOWNLINK_BAD_VALUE;
+        config.monthlyQuota = value;
+      } else if (memcmp(key, "EN", 2) == 0) {
+        if (valueField.len != 1) return DOWNLINK_BAD_FORMAT;
+        if (v[0] == 'T') config.encoding = ENCODING_CSV;
+        else if (v[0] == 'B') config.encoding = ENCODING_BINARY;
+        else return DOWNLINK_BAD_VALUE;
+      } else if (memcmp(key, "CH", 2) == 0) {
+        for (size_t i=0; i<valueField.len; i++) {
+          if (channelIndex(config, v[i]) < 0) return DOWNLINK_BAD_VALUE;
+        }
+        for (uint8_t i=0; i<config.numberOfChannels; i++) {
+          const boolean enabled = memchr(v, config.channels[i], valueField.len) != NULL;
+          if (!enabled) config.channelInterval[i] = CHANNEL_DISABLED;
+          else if (config.channelInterval[i] == CHANNEL_DISABLED) config.channelInterval[i] = 1;
+        }
+      } else if (memcmp(key, "CI", 2) == 0) {
+        if (valueField.len < 2) return DOWNLINK_BAD_FORMAT;
+        const int8_t i = channelIndex(config, v[0]);
+        const NmeaField interval = {v + 1, valueField.len - 1};
+        if (!toNumber(interval, 0xFF, value)) return DOWNLINK_BAD_FORMAT;
+        if (i < 0 || value == CHANNEL_DISABLED) return DOWNLINK_BAD_VALUE;
+        config.channelInterval[i] = value;
+      } else if (memcmp(key, "AD", 2) == 0) {
+        if (valueField.len != 2) return DOWNLINK_BAD_FORMAT;
+        if (channelIndex(config, v[0]) < 0 || channelIndex(config, v[1]) >= 0 ||
+          !PersistentMemory::validChannel(v[1])
+        ) {
+          return DOWNLINK_BAD_VALUE;
+        }
+        for (uint8_t i=0; i<command.numberOfAddressChanges; i++) {
+          if (command.oldAddress[i] == v[0] || command.newAddress[i] == v[1]) {
+            return DOWNLINK_BAD_VALUE;
+          }
+        }
+        command.oldAddress[command.numberOfAddressChanges] = v[0];
+        command.newAddress[command.numberOfAddressChanges] = v[1];
+        command.numberOfAddressChanges++;
+      } else {
+        // an unknown setting may mean an older firmware, better do nothing
+        return DOWNLINK_BAD_FORMAT;
+      }
+      return DOWNLINK_APPLIED;
+    };
+
+  public:
+    /*
+     *  A key of zeros, e.g. if none was set at build time, disables remote
+     *  configuration
+     */
+    static boolean enabled(const uint8_t *key) {
+      for (uint8_t i=0; i<SIP_HASH_KEY_LENGTH; i++) {
+        if (key[i] != 0) return true;
+      }
+      return false;
+    };
+
+    /*
+     *  Length of the command without the tag, 0 if the tag is missing or
+     *  does not match
+     */
+    static size_t verify(const uint8_t *key, const char *text, const size_t len) {
+      if (len <= DOWNLINK_TAG_LENGTH + 1) return 0;
+      const size_t bodyLen = len - DOWNLINK_TAG_LENGTH - 1;
+      if (text[bodyLen] != '#') return 0;
+      uint64_t tag = 0;
+      for (size_t i=bodyLen+1; i<len; i++) {
+        const int8_t digit = hexValue(text[i]);
+        if (digit < 0) return 0;
+        tag = (tag << 4) | digit;
+      }
+      return SipHash::compute(key, text, bodyLen) == tag ? bodyLen : 0;
+    };
+
+    /*
+     *  Append the tag to a command, e.g. for the host tool that signs
+     *  commands; bfr needs len + DOWNLINK_TAG_LENGTH + 1
+     */
+    static size_t sign(const uint8_t *key, const char *text, const size_t len, char *bfr) {
+      const uint64_t tag = SipHash::compute(key, text, len);
+      memmove(bfr, text, len);
+      bfr[len] = '#';
+      for (uint8_t i=0; i<DOWNLINK_TAG_LENGTH; i++) {
+        bfr[len + 1 + i] = HEX_DIGITS[(tag >> (4 * (DOWNLINK_TAG_LENGTH - 1 - i))) & 0x0F];
+      }
+      return len + 1 + DOWNLINK_TAG_LENGTH;
+    };
+
+    /*
+     *  Verify a command and apply it to config, returns command.status.
+     *  The sequence is used up once the tag is verified, even if the
+     *  settings are rejected; the caller commits config either way.
+     */
+    static uint8_t process(
+      const uint8_t *key, const char *text, const size_t len, NodeConfig &config,
+      DownlinkCommand &command
+    ) {
+      uint32_t sequence;
+      memset(&command, 0, sizeof(command));
+      const size_t bodyLen = verify(key, text, len);
+      if (bodyLen == 0) return command.status = DOWNLINK_BAD_TAG;
+      const char *end = text + bodyLen;
+      const char *comma = static_cast<const char*>(memchr(text, ',', bodyLen));
+      if (comma == NULL) comma = end;
+      const NmeaField sequenceField = {text, static_cast<size_t>(comma - text)};
+      if (!toNumber(sequenceField, 0xFFFFFFFFUL, sequence)) {
+        return command.status = DOWNLINK_BAD_FORMAT;
+      }
+      command.sequence = sequence;
+      if (sequence <= config.downlinkSequence) return command.status = DOWNLINK_REPLAYED;
+      config.downlinkSequence = sequence;
+      NodeConfig updated = config;
+      while (comma < end) {
+        const char *start = comma + 1;
+        comma = static_cast<const char*>(memchr(start, ',', end - start));
+        if (comma == NULL) comma = end;
+        const NmeaField field = {start, static_cast<size_t>(comma - start)};
+        command.status = applyField(field, updated, command);
+        if (command.status != DOWNLINK_APPLIED) {
+          command.numberOfAddressChanges = 0;
+          return command.status;
+        }
+      }
+      // nothing out of range is stored, rather than replaced by defaults
+      if (!PersistentMemory::sanitize(updated)) {
+        command.numberOfAddressChanges = 0;
+        return command.status = DOWNLINK_BAD_VALUE;
+      }
+      config = updated;
+      return command.status = DOWNLINK_APPLIED;
+    };
+
+    /*
+     *  After a sensor took its new address on the bus, id is its new
+     *  SDI12Measurement::identity; false if oldAddr is not a channel
+     */
+    static boolean renameChannel(
+      NodeConfig &config, const char oldAddr, const char newAddr, const uint32_t id
+    ) {
+      const int8_t i = channelIndex(config, oldAddr);
+      if (i < 0) return false;
+      config.channels[i] = newAddr;
+      config.channelIds[i] = id;
+      return true;
+    };
+
+    /*
+     *  Acknowledgement frame for the uplink, at most 7 bytes:
+     *  FRAME_CONFIG_ACK, sequence (varint), status (byte)
+     */
+    static size_t encodeAck(const DownlinkCommand &command, char *bfr) {
+      size_t idx = 0;
+      bfr[idx++] = FRAME_CONFIG_ACK;
+      idx += MessageHelpers::writeVarint(command.sequence, bfr + idx);
+      bfr[idx++] = command.status;
+      return idx;
+    };
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ *  Wrapper around a raw flash partition to allow for simulating flash and
+ *  power loss on the host
+ *
+ *  - NOR flash semantics: erasing sets a whole sector to 0xFF, writing can
+ *    only clear bits
+ *  - the device uses the data partition of the default partition table
+ *    meant for SPIFFS, the firmware does not use a file system
+ */
+#ifndef _FLASH_WRAPPER_H_
+#define _FLASH_WRAPPER_H_
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+#define FLASH_SECTOR_SIZE 4096
+
+
+ // Base class, no flash
+ class FlashWrapperBase {
+   public:
+     virtual ~FlashWrapperBase() {};
+     // bytes available, 0 if there is no flash
+     virtual uint32_t size() { return 0; };
+     virtual uint32_t sectorSize() { return FLASH_SECTOR_SIZE; };
+     virtual boolean read(uint32_t address, void *bfr, size_t len) { return false; };
+     virtual boolean write(uint32_t address, const void *data, size_t len) {
+       return false;
+     };
+     virtual boolean erase(uint32_t sector) { return false; };
+ };
+
+ // Inherited class
+ class FlashWrapper: public FlashWrapperBase {
+  private:
+    const esp_partition_t *_partition = NULL;
+  public:
+    boolean begin() {
+      _partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+      return _partition != NULL;
+    };
+    uint32_t size() { return _partition == NULL ? 0 : _partition->size; };
+    boolean read(uint32_t address, void *bfr, size_t len) {
+      if (_partition == NULL) return false;
+      return esp_partition_read(_partition, address, bfr, len) == ESP_OK;
+    };
+    boolean write(uint32_t address, const void *data, size_t len) {
+      if (_partition == NULL) return false;
+      return esp_partition_write(_partition, address, data, len) == ESP_OK;
+    };
+    boolean erase(uint32_t sector) {
+      if (_partition == NULL) return false;
+      return esp_partition_erase_range(
+        _partition, sector * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE) == ESP_OK;
+    };
+ };
+
+#endif
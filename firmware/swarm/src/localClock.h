@@ -0,0 +1,155 @@
+/*
+ *  Local clock disciplined by the time of the tile
+ *
+ *  - runs on millis() between fixes from $DT reports or $DT @, so the loop
+ *    does not have to wait for the tile to know the time
+ *  - a fix is an interval: the tile reports whole seconds, and a report
+ *    may have waited in the UART while the MCU slept. Each fix is
+ *    intersected with the prediction, the result is the new anchor
+ *  - the drift of millis() is estimated against the first anchor once
+ *    CLOCK_MIN_BASELINE passed; until then it is only known to be within
+ *    CLOCK_MAX_DRIFT_PPM, millis() counts on the RTC slow clock in light
+ *    sleep which is far less stable than the crystal
+ *  - now() never goes backwards, after a fix that contradicts the
+ *    prediction it holds until the time caught up
+ *  - trivially copyable, kept in RetainedState over deep sleep; see
+ *    suspend()
+ */
+#ifndef _LOCAL_CLOCK_H_
+#define _LOCAL_CLOCK_H_
+
+#include <Arduino.h>
+
+// ppm
+#define CLOCK_MAX_DRIFT_PPM 1000
+// temperature changes the drift after it was estimated, ppm
+#define CLOCK_MIN_DRIFT_ERROR_PPM 10
+// ms
+#define CLOCK_MIN_BASELINE 600000UL
+#define CLOCK_TRUSTED 1000
+// from the deep sleep timer to setup()
+#define CLOCK_BOOT_TIME 500
+
+
+class LocalClock {
+  private:
+    boolean _valid = false;
+    // the time was within _halfMs of _centerMs at millis() _local
+    uint32_t _local = 0;
+    uint64_t _centerMs = 0;
+    uint32_t _halfMs = 0;
+    // anchor the drift is estimated from
+    boolean _hasBase = false;
+    uint32_t _baseLocal = 0;
+    uint64_t _baseCenterMs = 0;
+    uint32_t _baseHalfMs = 0;
+    uint64_t _lastMs = 0;
+
+    int64_t predict(const uint32_t elapsed) const {
+      return static_cast<int64_t>(_centerMs) + elapsed
+        + static_cast<int64_t>(elapsed * (driftPpm / 1e6f));
+    };
+
+    uint32_t spread(const uint32_t elapsed) const {
+      return _halfMs + static_cast<uint32_t>(elapsed * (driftErrorPpm / 1e6f));
+    };
+
+  public:
+    // the tile time passes driftPpm faster than millis(), known to within
+    // driftErrorPpm
+    float driftPpm = 0;
+    float driftErrorPpm = CLOCK_MAX_DRIFT_PPM;
+    // statistics
+    unsigned long fixes = 0;
+    // fixes outside of the prediction
+    unsigned long steps = 0;
+
+    boolean valid() const { return _valid; };
+
+    /*
+     *  The tile time was between epoch and widthMs later at millis() local
+     */
+    void fix(const unsigned long epoch, const uint32_t widthMs, const uint32_t local) {
+      int64_t lo = static_cast<int64_t>(epoch) * 1000;
+      int64_t hi = lo + widthMs;
+      fixes++;
+      if (_valid) {
+        const uint32_t elapsed = local - _local;
+        const int64_t center = predict(elapsed);
+        const uint32_t half = spread(elapsed);
+        if (center + half < lo || center - half > hi) {
+          steps++;
+          // the drift cannot be trusted across a step
+          _hasBase = false;
+        } else {
+          if (center - half > lo) lo = center - half;
+          if (center + half < hi) hi = center + half;
+        }
+      }
+      _valid = true;
+      _local = local;
+      _centerMs = (lo + hi) / 2;
+      _halfMs = (hi - lo + 1) / 2;
+      if (!_hasBase) {
+        _hasBase = true;
+        _baseLocal = _local;
+        _baseCenterMs = _centerMs;
+        _baseHalfMs = _halfMs;
+        return;
+      }
+      // the longer the baseline the better the estimate, the tile time has
+      // a resolution of a second
+      const uint32_t baseline = _local - _baseLocal;
+      if (baseline < CLOCK_MIN_BASELINE) return;
+      float error = 1e6f * (_halfMs + _baseHalfMs) / baseline;
+      if (error >= CLOCK_MAX_DRIFT_PPM) return;
+      if (error < CLOCK_MIN_DRIFT_ERROR_PPM) error = CLOCK_MIN_DRIFT_ERROR_PPM;
+      const int64_t passed = static_cast<int64_t>(_centerMs - _baseCenterMs);
+      driftPpm = 1e6f * (passed - static_cast<int64_t>(baseline)) / baseline;
+      driftErrorPpm = error;
+    };
+
+    /*
+     *  Epoch in ms at millis() local, 0 before the first fix
+     */
+    uint64_t nowMs(const uint32_t local) {
+      if (!_valid) return 0;
+      const uint64_t ret = predict(local - _local);
+      if (ret > _lastMs) _lastMs = ret;
+      return _lastMs;
+    };
+
+    unsigned long now(const uint32_t local) {
+      return nowMs(local) / 1000;
+    };
+
+    /*
+     *  The time is within this many ms of now()
+     */
+    uint32_t uncertainty(const uint32_t local) const {
+      if (!_valid) return UINT32_MAX;
+      return spread(local - _local);
+    };
+
+    // good enough to run the loop without waiting for the tile
+    boolean trusted(const uint32_t local) const {
+      return uncertainty(local) <= CLOCK_TRUSTED;
+    };
+
+    /*
+     *  Going into deep sleep for seconds at millis() local, millis() starts
+     *  over at 0 on wake-up; the sleep timer is not what the drift was
+     *  estimated from
+     */
+    void suspend(const uint32_t local, const unsigned long seconds) {
+      if (!_valid) return;
+      const uint32_t elapsed = local - _local;
+      _centerMs = predict(elapsed) + static_cast<uint64_t>(seconds) * 1000;
+      _halfMs = spread(elapsed) + CLOCK_BOOT_TIME
+        + static_cast<uint32_t>(seconds * (CLOCK_MAX_DRIFT_PPM / 1e3f));
+      _local = 0;
+      _hasBase = false;
+    };
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ *  The state of the main loop that has to survive deep sleep
+ *
+ *  - refers to the globals of swarm.ino, which are lost in deep sleep, and
+ *    copies them into and out of RetainedState
+ *  - the only place that knows the fields of RetainedState, a new field
+ *    goes here and in RetainedState, see SleepWrapperBase::save()
+ */
+#ifndef _LOOP_STATE_H_
+#define _LOOP_STATE_H_
+
+#include <Arduino.h>
+#ifndef _SLEEP_WRAPPER_H_
+#include "sleepWrapper.h"
+#endif
+#ifndef _TILE_SLEEP_H_
+#include "tileSleep.h"
+#endif
+
+
+class LoopState {
+  public:
+    int &messageCounter;
+    unsigned long &nextScheduled;
+    unsigned long &nextSample;
+    unsigned long &measurementFrequencyS;
+    char (&availableChannels)[10];
+    int &numberOfChannels;
+    MessageBatch &batch;
+    MessageBudget &budget;
+    MessageAggregate &aggregate;
+    TileSleep &tileSleep;
+    LocalClock &localClock;
+
+    LoopState(
+      int &messageCounter, unsigned long &nextScheduled,
+      unsigned long &nextSample, unsigned long &measurementFrequencyS,
+      char (&availableChannels)[10], int &numberOfChannels,
+      MessageBatch &batch, MessageBudget &budget, MessageAggregate &aggregate,
+      TileSleep &tileSleep, LocalClock &localClock
+    ): messageCounter(messageCounter), nextScheduled(nextScheduled),
+      nextSample(nextSample), measurementFrequencyS(measurementFrequencyS),
+      availableChannels(availableChannels), numberOfChannels(numberOfChannels),
+      batch(batch), budget(budget), aggregate(aggregate),
+      tileSleep(tileSleep), localClock(localClock) {};
+
+    /*
+     *  Keep the state in RTC memory before deep sleep
+     */
+    void save(SleepWrapperBase &sleeper) const {
+      RetainedState *rtc = sleeper.retained();
+      if (rtc == NULL) return;
+      RetainedState state;
+      memset(&state, 0, sizeof(state));
+      // restore() counts wake-ups in RTC memory
+      state.wakeups = rtc->wakeups;
+      state.messageCounter = messageCounter;
+      state.nextScheduled = nextScheduled;
+      state.nextSample = nextSample;
+      state.measurementFrequencyS = measurementFrequencyS;
+      memcpy(state.availableChannels, availableChannels, sizeof(availableChannels));
+      state.numberOfChannels = numberOfChannels;
+      memcpy(state.batch, &batch, sizeof(batch));
+      memcpy(state.budget, &budget, sizeof(budget));
+      memcpy(state.aggregate, &aggregate, sizeof(aggregate));
+      state.tileAsleep = tileSleep.asleep;
+      memcpy(state.clock, &localClock, sizeof(localClock));
+      sleeper.save(state);
+    };
+
+    /*
+     *  Continue where we left before deep sleep, false after a cold start
+     */
+    boolean restore(SleepWrapperBase &sleeper) {
+      RetainedState state;
+      if (!sleeper.restore(state)) return false;
+      messageCounter = state.messageCounter;
+      nextScheduled = state.nextScheduled;
+      nextSample = state.nextSample;
+      measurementFrequencyS = state.measurementFrequencyS;
+      memcpy(availableChannels, state.availableChannels, sizeof(availableChannels));
+      numberOfChannels = state.numberOfChannels;
+      memcpy(&batch, state.batch, sizeof(batch));
+      memcpy(&budget, state.budget, sizeof(budget));
+      memcpy(&aggregate, state.aggregate, sizeof(aggregate));
+      tileSleep.asleep = state.tileAsleep;
+      memcpy(&localClock, state.clock, sizeof(localClock));
+      return true;
+    };
+};
+
+#endif
@@ -1,48 +1,251 @@
+/*
+ * Configuration storage
+ *
+ * - the whole configuration is one struct behind a header with a magic
+ *   number, a schema version, its length and a CRC
+ * - begin() reads it once at boot, after that the firmware works on the
+ *   copy in RAM and commit() writes it only if something changed
+ * - new settings are added at the end of NodeConfig, an older layout is
+ *   read up to its length and the new fields keep their defaults; a newer
+ *   layout is read up to what this firmware knows. The version only has to
+ *   change if the meaning of existing fields changes, begin() then has to
+ *   convert the older layout.
+ * - out of range values are replaced by defaults
+ */
 #ifndef _NODE_PERSISTENT_MEMORY_
 #define _NODE_PERSISTENT_MEMORY_
-#endif
 
+#include <stddef.h>
 #include <EEPROM.h>
+#ifndef _CRC32_H_
+#include "crc32.h"
+#endif
+#ifndef _BATCH_H_
+#include "batch.h"
+#endif
 
-#define EEPROM_SIZE 16
+#define EEPROM_SIZE 256
+#define CONFIG_ADDRESS 0
+// before the configuration struct, a single uint32_t
 #define FREQUENCY_ADDRESS 0
+#define CONFIG_MAGIC 0x53574346
+#define CONFIG_VERSION 1
+#define CONFIG_MAX_CHANNELS 10
+
+#define MIN_MEASUREMENT_FREQUENCY 60
+#define MAX_MEASUREMENT_FREQUENCY 86400
+#define DEFAULT_MEASUREMENT_FREQUENCY 3600
+#define DEFAULT_SAMPLE_FREQUENCY 900
+// one loop cycle, tileTimeFrequency in swarm.ino
+#define MIN_AGGREGATE_FREQUENCY 20
+// channelInterval of a channel that is not measured at all
+#define CHANNEL_DISABLED 0xFF
 
 
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  // of the NodeConfig that follows
+  uint16_t length;
+  uint32_t crc;
+} ConfigHeader;
+
 /*
- * Configuration storage
- * - this is rather static and project-specific but good enough for now
+ *  Only add fields at the end
  */
+typedef struct {
+  // seconds between messages
+  uint32_t measurementFrequencyS;
+  // seconds between samples when batching
+  uint32_t sampleFrequencyS;
+  // ENCODING_CSV or ENCODING_BINARY
+  uint8_t encoding;
+  // epochs per message, 1 disables batching
+  uint8_t batchDepth;
+  // SDI-12 addresses found the last time, 0 terminated if shorter
+  uint8_t numberOfChannels;
+  char channels[CONFIG_MAX_CHANNELS];
+  // measure a channel only with every n-th message, 0 and 1 for every one,
+  // CHANNEL_DISABLED for none
+  uint8_t channelInterval[CONFIG_MAX_CHANNELS];
+  // cold starts
+  uint32_t boots;
+  // messages per month for MessageBudget, 0 for a fixed schedule
+  uint16_t monthlyQuota;
+  // messages spent in budgetMonth, see MessageBudget
+  uint32_t budgetMonth;
+  uint32_t budgetSpent;
+  // seconds between samples aggregated into one message, 0 disables
+  uint32_t aggregateFrequencyS;
+  // SDI12Measurement::identity of the sensors at channels, 0 if unknown
+  uint32_t channelIds[CONFIG_MAX_CHANNELS];
+  // ms from reset to the first readings of the last cold start
+  uint32_t bootToSampleMs;
+  // of the last remote configuration command, see src/downlink.h
+  uint32_t downlinkSequence;
+} NodeConfig;
+
+static_assert(sizeof(ConfigHeader) + sizeof(NodeConfig) <= EEPROM_SIZE - CONFIG_ADDRESS,
+  "the configuration does not fit into EEPROM_SIZE");
+
+
 class PersistentMemory {
+  private:
+    // what is in EEPROM
+    NodeConfig _stored;
+    boolean _valid = false;
+
+    static boolean validFrequency(const uint32_t value) {
+      return value >= MIN_MEASUREMENT_FREQUENCY && value <= MAX_MEASUREMENT_FREQUENCY;
+    };
+
   public:
-    static void writeFrequency(uint32_t value) {
-      // for some reason it does not work if we do that
-      // in the constructor
-      EEPROM.begin(EEPROM_SIZE);
-      for (size_t i=0; i<sizeof(value); i++) {
-        byte bte = (value >> 8 * i) & 0xFF;
-        EEPROM.write(FREQUENCY_ADDRESS+i, bte);
-      }
-      EEPROM.commit();
+    NodeConfig config;
+
+    static boolean validChannel(const char channel) {
+      return (channel >= '0' && channel <= '9') ||
+        (channel >= 'a' && channel <= 'z') || (channel >= 'A' && channel <= 'Z');
+    };
+
+    PersistentMemory() {
+      defaults(config);
+      _stored = config;
+    };
+
+    static void defaults(NodeConfig &config) {
+      // no garbage in padding, commit() compares bytes
+      memset(&config, 0, sizeof(config));
+      config.measurementFrequencyS = DEFAULT_MEASUREMENT_FREQUENCY;
+      config.sampleFrequencyS = DEFAULT_SAMPLE_FREQUENCY;
+      config.encoding = ENCODING_BINARY;
+      config.batchDepth = 1;
     };
 
     /*
-     *  Get measurement Frequency or use default
-     *  - not necessarily the best place but we are re-using it
-     *  - however it gives us the chance to generalize
+     *  Replace values out of range by defaults, returns false if there were
+     *  any
      */
-    static uint32_t getMeasurementFrequency(unsigned long dflt) {
-      uint32_t ret = readFrequency();
-      if (ret < 60 && ret > 86400) ret = dflt;
+    static boolean sanitize(NodeConfig &config) {
+      NodeConfig dflt;
+      boolean ret = true;
+      defaults(dflt);
+      if (!validFrequency(config.measurementFrequencyS)) {
+        config.measurementFrequencyS = dflt.measurementFrequencyS;
+        ret = false;
+      }
+      if (!validFrequency(config.sampleFrequencyS)) {
+        config.sampleFrequencyS = dflt.sampleFrequencyS;
+        ret = false;
+      }
+      if (config.encoding != ENCODING_CSV && config.encoding != ENCODING_BINARY) {
+        config.encoding = dflt.encoding;
+        ret = false;
+      }
+      if (config.batchDepth < 1 || config.batchDepth > MAX_BATCH_DEPTH) {
+        config.batchDepth = dflt.batchDepth;
+        ret = false;
+      }
+      if (config.aggregateFrequencyS != 0 && (
+        config.aggregateFrequencyS < MIN_AGGREGATE_FREQUENCY ||
+        config.aggregateFrequencyS > MAX_MEASUREMENT_FREQUENCY)
+      ) {
+        config.aggregateFrequencyS = dflt.aggregateFrequencyS;
+        ret = false;
+      }
+      uint8_t n = 0;
+      while (n < CONFIG_MAX_CHANNELS && n < config.numberOfChannels &&
+        validChannel(config.channels[n])
+      ) {
+        n++;
+      }
+      if (n != config.numberOfChannels) ret = false;
+      config.numberOfChannels = n;
+      for (; n<CONFIG_MAX_CHANNELS; n++) {
+        config.channels[n] = 0;
+        config.channelIds[n] = 0;
+      }
       return ret;
     };
 
-    static uint32_t readFrequency() {
-      uint32_t ret = 0;
+    /*
+     *  Read the configuration, defaults if there is none or it is corrupt,
+     *  returns false in that case
+     */
+    boolean begin() {
+      ConfigHeader header;
+      uint8_t bfr[EEPROM_SIZE];
       EEPROM.begin(EEPROM_SIZE);
-      for (size_t i=0; i < sizeof(ret); i++) {
-        byte bte = EEPROM.read(FREQUENCY_ADDRESS+i);
-        ret = ret + bte * pow(256, i);
+      defaults(config);
+      _valid = false;
+      EEPROM.get(CONFIG_ADDRESS, header);
+      if (header.magic == CONFIG_MAGIC &&
+        header.length <= EEPROM_SIZE - CONFIG_ADDRESS - sizeof(header)
+      ) {
+        for (size_t i=0; i<header.length; i++) {
+          bfr[i] = EEPROM.read(CONFIG_ADDRESS + sizeof(header) + i);
+        }
+        if (Crc32::compute(bfr, header.length) == header.crc) {
+          memcpy(
+            &config, bfr,
+            header.length < sizeof(config) ? header.length : sizeof(config));
+          _valid = true;
+        }
+      } else {
+        // the frequency of the first firmware versions
+        uint32_t frequency;
+        EEPROM.get(FREQUENCY_ADDRESS, frequency);
+        if (validFrequency(frequency)) config.measurementFrequencyS = frequency;
       }
-      return ret;
-    }
+      if (!sanitize(config)) _valid = false;
+      _stored = config;
+      return _valid;
+    };
+
+    boolean changed() {
+      return !_valid || memcmp(&config, &_stored, sizeof(config)) != 0;
+    };
+
+    /*
+     *  Write the configuration if it changed, false if that failed
+     */
+    boolean commit() {
+      ConfigHeader header;
+      sanitize(config);
+      if (!changed()) return true;
+      header.magic = CONFIG_MAGIC;
+      header.version = CONFIG_VERSION;
+      header.length = sizeof(config);
+      header.crc = Crc32::compute(&config, sizeof(config));
+      EEPROM.put(CONFIG_ADDRESS, header);
+      EEPROM.put(CONFIG_ADDRESS + sizeof(header), config);
+      if (!EEPROM.commit()) return false;
+      _stored = config;
+      _valid = true;
+      return true;
+    };
+
+    /*
+     *  Measurement frequency of the configuration, dflt if out of range
+     */
+    uint32_t getMeasurementFrequency(unsigned long dflt) {
+      return validFrequency(config.measurementFrequencyS)
+        ? config.measurementFrequencyS : dflt;
+    };
+
+    /*
+     *  Store the measurement frequency, false without storing anything if it
+     *  is out of range or the write failed
+     */
+    boolean writeFrequency(uint32_t value) {
+      if (!validFrequency(value)) return false;
+      config.measurementFrequencyS = value;
+      return commit();
+    };
+
+    // what is stored, not the copy in RAM
+    uint32_t readFrequency() {
+      return _stored.measurementFrequencyS;
+    };
 };
+
+#endif
@@ -0,0 +1,407 @@
+/*
+ *  Store-and-forward log of messages in flash
+ *
+ *  - messages are appended to the log before they are handed to the tile,
+ *    marked as queued with the tile time and their id in the tile once the
+ *    tile took them with $TD OK, and acknowledged once the tile sent them. Everything not
+ *    queued is handed over again later, e.g. after the tile rejected a
+ *    message, did not respond, or after a reset; a queued message the tile
+ *    did not send within its hold time is appended again, see requeue().
+ *    Power loss between $TD OK and marking it queued sends a message
+ *    twice, index and time stamp tell the copies apart.
+ *  - the flash is used as a ring of segments (sectors) that are erased in
+ *    turn, this spreads wear evenly. Each segment starts with a header
+ *    holding a sequence number and its erase count. When the ring is full
+ *    the oldest segment is reclaimed and messages not sent by then are
+ *    dropped.
+ *  - a record is written with its header and data first and committed by
+ *    clearing a bit of its state byte, queuing writes the time and clears
+ *    a second bit, acknowledging a third one.
+ *    A record that is not committed or fails its CRC ends the segment, i.e.
+ *    power loss at any point loses at most the record being written.
+ */
+#ifndef _MESSAGE_LOG_H_
+#define _MESSAGE_LOG_H_
+
+#include <Arduino.h>
+#include <stddef.h>
+#ifndef _FLASH_WRAPPER_H_
+#include "flashWrapper.h"
+#endif
+#ifndef _CRC32_H_
+#include "crc32.h"
+#endif
+
+// 64 kB with 4 kB sectors, a week of hourly messages
+#define LOG_MAX_SEGMENTS 16
+// MAX_MESSAGE_LENGTH, the tile does not take more
+#define LOG_MAX_RECORD_LENGTH 192
+#define LOG_SEGMENT_MAGIC 0x53574c32
+
+// bits of the state byte, cleared when set
+#define LOG_STATE_COMMITTED 0x01
+#define LOG_STATE_ACKNOWLEDGED 0x02
+#define LOG_STATE_QUEUED 0x04
+
+// result of reading a record
+#define LOG_RECORD_VALID 0
+#define LOG_RECORD_FREE 1
+#define LOG_RECORD_CORRUPT 2
+
+
+typedef struct {
+  uint32_t magic;
+  uint32_t sequence;
+  uint32_t eraseCount;
+  uint32_t crc;
+} LogSegmentHeader;
+
+typedef struct {
+  uint16_t len;
+  uint8_t state;
+  uint8_t reserved;
+  // increases with every record, survives restarts
+  uint32_t sequence;
+  // over len, sequence and the data
+  uint32_t crc;
+  // tile time the tile took the message at and its id there, erased until
+  // then
+  uint32_t queuedAt;
+  uint32_t reserved2;
+  uint64_t tileId;
+} LogRecordHeader;
+
+// handle of a record, see readPending()
+typedef struct {
+  uint32_t address;
+  uint32_t sequence;
+  size_t len;
+  // tile time the tile took the message at, 0 if it did not yet
+  uint32_t queuedAt;
+  uint64_t tileId;
+} LogRecord;
+
+
+class MessageLog {
+  private:
+    FlashWrapperBase *_flashRef;
+    uint32_t _sectorSize = 0;
+    uint8_t _numberOfSegments = 0;
+    // 0 if the segment has no valid header
+    uint32_t _sequence[LOG_MAX_SEGMENTS];
+    uint32_t _eraseCount[LOG_MAX_SEGMENTS];
+    // records not acknowledged per segment
+    uint16_t _pending[LOG_MAX_SEGMENTS];
+    uint8_t _active = 0;
+    // next free byte in the active segment, _sectorSize if it is closed
+    uint32_t _writeOffset = 0;
+    uint32_t _newestSegment = 0;
+    uint32_t _nextRecord = 1;
+    boolean _mounted = false;
+
+    static uint32_t align(const uint32_t len) { return (len + 3) & ~3UL; };
+
+    static boolean erased(const void *data, const size_t len) {
+      const uint8_t *bytes = static_cast<const uint8_t*>(data);
+      for (size_t i=0; i<len; i++) if (bytes[i] != 0xFF) return false;
+      return true;
+    };
+
+    static uint32_t segmentCrc(const LogSegmentHeader &header) {
+      return Crc32::compute(&header, offsetof(LogSegmentHeader, crc));
+    };
+
+    static uint32_t recordCrc(const LogRecordHeader &header, const char *data) {
+      uint32_t crc = Crc32::update(CRC32_INITIAL, &header.len, sizeof(header.len));
+      crc = Crc32::update(crc, &header.sequence, sizeof(header.sequence));
+      return Crc32::finish(Crc32::update(crc, data, header.len));
+    };
+
+    uint32_t address(const uint8_t segment, const uint32_t offset) {
+      return segment * _sectorSize + offset;
+    };
+
+    uint8_t readRecord(
+      const uint8_t segment, const uint32_t offset, LogRecordHeader &header,
+      char *bfr
+    ) {
+      char scratch[LOG_MAX_RECORD_LENGTH];
+      if (bfr == NULL) bfr = scratch;
+      if (offset + sizeof(header) > _sectorSize) return LOG_RECORD_FREE;
+      if (!_flashRef->read(address(segment, offset), &header, sizeof(header))) {
+        return LOG_RECORD_CORRUPT;
+      }
+      if (erased(&header, sizeof(header))) return LOG_RECORD_FREE;
+      if ((header.state & LOG_STATE_COMMITTED) != 0 || header.len == 0 ||
+        header.len > LOG_MAX_RECORD_LENGTH ||
+        offset + align(sizeof(header) + header.len) > _sectorSize
+      ) {
+        return LOG_RECORD_CORRUPT;
+      }
+      if (!_flashRef->read(
+        address(segment, offset + sizeof(header)), bfr, header.len)
+      ) {
+        return LOG_RECORD_CORRUPT;
+      }
+      return recordCrc(header, bfr) == header.crc
+        ? LOG_RECORD_VALID : LOG_RECORD_CORRUPT;
+    };
+
+    /*
+     *  Count the records of a segment, returns where the free space starts
+     *  or _sectorSize if it ends with a corrupt record
+     */
+    uint32_t scan(const uint8_t segment) {
+      uint32_t offset = sizeof(LogSegmentHeader);
+      LogRecordHeader header;
+      uint8_t status;
+      _pending[segment] = 0;
+      while ((status = readRecord(segment, offset, header, NULL)) == LOG_RECORD_VALID) {
+        if (!acknowledged(header.state)) _pending[segment]++;
+        if (header.sequence >= _nextRecord) _nextRecord = header.sequence + 1;
+        offset += align(sizeof(header) + header.len);
+      }
+      return status == LOG_RECORD_FREE ? offset : _sectorSize;
+    };
+
+    /*
+     *  Free space has to be erased, it is not after an interrupted erase
+     */
+    boolean erasedFrom(const uint8_t segment, uint32_t offset) {
+      uint8_t bfr[64];
+      while (offset < _sectorSize) {
+        size_t len = _sectorSize - offset < sizeof(bfr) ? _sectorSize - offset : sizeof(bfr);
+        if (!_flashRef->read(address(segment, offset), bfr, len)) return false;
+        if (!erased(bfr, len)) return false;
+        offset += len;
+      }
+      return true;
+    };
+
+    /*
+     *  Erase the next segment and make it the active one
+     */
+    boolean openSegment() {
+      uint8_t next = (_active + 1) % _numberOfSegments;
+      // the oldest segment, messages not sent by now are lost
+      if (_sequence[next] != 0) {
+        numberOfDropped += _pending[next];
+        numberOfPending -= _pending[next];
+      }
+      _sequence[next] = 0;
+      _pending[next] = 0;
+      _active = next;
+      _writeOffset = _sectorSize;
+      LogSegmentHeader header;
+      header.magic = LOG_SEGMENT_MAGIC;
+      header.sequence = ++_newestSegment;
+      header.eraseCount = ++_eraseCount[next];
+      header.crc = segmentCrc(header);
+      if (!_flashRef->erase(next)) return false;
+      if (!_flashRef->write(address(next, 0), &header, sizeof(header))) return false;
+      _sequence[next] = header.sequence;
+      _writeOffset = sizeof(header);
+      return true;
+    };
+
+    /*
+     *  Header of a record read with readPending(), false if it is gone
+     */
+    boolean find(const LogRecord &record, LogRecordHeader &header) {
+      if (!_mounted) return false;
+      const uint8_t segment = record.address / _sectorSize;
+      if (segment >= _numberOfSegments || _sequence[segment] == 0) return false;
+      // the segment might have been reclaimed in the meantime
+      return readRecord(segment, record.address % _sectorSize, header, NULL)
+        == LOG_RECORD_VALID && header.sequence == record.sequence;
+    };
+
+  public:
+    uint32_t numberOfPending = 0;
+    // since begin()
+    uint32_t numberOfDropped = 0;
+
+    MessageLog(FlashWrapperBase *flashRef) {
+      _flashRef = flashRef;
+    };
+
+    static boolean acknowledged(const uint8_t state) {
+      return (state & LOG_STATE_ACKNOWLEDGED) == 0;
+    };
+
+    static boolean queued(const uint8_t state) {
+      return (state & LOG_STATE_QUEUED) == 0;
+    };
+
+    /*
+     *  Find the segments and count the records not acknowledged yet, false
+     *  if there is no flash
+     */
+    boolean begin() {
+      _mounted = false;
+      numberOfPending = 0;
+      numberOfDropped = 0;
+      _newestSegment = 0;
+      _nextRecord = 1;
+      _sectorSize = _flashRef->sectorSize();
+      uint32_t segments = _sectorSize > 0 ? _flashRef->size() / _sectorSize : 0;
+      _numberOfSegments = segments < LOG_MAX_SEGMENTS ? segments : LOG_MAX_SEGMENTS;
+      if (_numberOfSegments < 2) return false;
+      for (uint8_t i=0; i<_numberOfSegments; i++) {
+        LogSegmentHeader header;
+        _sequence[i] = 0;
+        _eraseCount[i] = 0;
+        _pending[i] = 0;
+        if (!_flashRef->read(address(i, 0), &header, sizeof(header))) continue;
+        if (header.magic != LOG_SEGMENT_MAGIC || header.crc != segmentCrc(header)) {
+          continue;
+        }
+        _sequence[i] = header.sequence;
+        _eraseCount[i] = header.eraseCount;
+        if (header.sequence > _newestSegment) {
+          _newestSegment = header.sequence;
+          _active = i;
+        }
+      }
+      _mounted = true;
+      if (_newestSegment == 0) {
+        // empty, the first append opens segment 0
+        _active = _numberOfSegments - 1;
+        _writeOffset = _sectorSize;
+        return true;
+      }
+      // oldest first
+      for (uint8_t i=1; i<=_numberOfSegments; i++) {
+        uint8_t segment = (_active + i) % _numberOfSegments;
+        if (_sequence[segment] == 0) continue;
+        _writeOffset = scan(segment);
+        numberOfPending += _pending[segment];
+      }
+      if (!erasedFrom(_active, _writeOffset)) _writeOffset = _sectorSize;
+      return true;
+    };
+
+    boolean mounted() { return _mounted; };
+
+    uint32_t eraseCount(const uint8_t segment) {
+      return segment < _numberOfSegments ? _eraseCount[segment] : 0;
+    };
+
+    /*
+     *  Store a message, false if it could not be written
+     */
+    boolean append(const char *message, const size_t len) {
+      if (!_mounted || len == 0 || len > LOG_MAX_RECORD_LENGTH) return false;
+      const uint32_t size = align(sizeof(LogRecordHeader) + len);
+      if (_writeOffset + size > _sectorSize && !openSegment()) return false;
+      uint8_t bfr[sizeof(LogRecordHeader) + LOG_MAX_RECORD_LENGTH];
+      LogRecordHeader header;
+      header.len = len;
+      header.state = 0xFF;
+      header.reserved = 0xFF;
+      header.sequence = _nextRecord;
+      header.crc = recordCrc(header, message);
+      header.queuedAt = 0xFFFFFFFF;
+      header.reserved2 = 0xFFFFFFFF;
+      header.tileId = 0xFFFFFFFFFFFFFFFFULL;
+      memcpy(bfr, &header, sizeof(header));
+      memcpy(bfr + sizeof(header), message, len);
+      const uint32_t recordAddress = address(_active, _writeOffset);
+      // a failed write leaves an unknown state, don't write there again
+      _writeOffset = _sectorSize;
+      if (!_flashRef->write(recordAddress, bfr, sizeof(header) + len)) return false;
+      const uint8_t state = 0xFF & ~LOG_STATE_COMMITTED;
+      if (!_flashRef->write(
+        recordAddress + offsetof(LogRecordHeader, state), &state, 1)
+      ) {
+        return false;
+      }
+      _writeOffset = recordAddress % _sectorSize + size;
+      _pending[_active]++;
+      numberOfPending++;
+      _nextRecord++;
+      return true;
+    };
+
+    /*
+     *  Get the oldest message not acknowledged yet with a sequence number
+     *  larger than after, bfr has to hold LOG_MAX_RECORD_LENGTH characters
+     */
+    boolean readPending(LogRecord &record, char *bfr, const uint32_t after=0) {
+      if (!_mounted || numberOfPending == 0) return false;
+      for (uint8_t i=1; i<=_numberOfSegments; i++) {
+        uint8_t segment = (_active + i) % _numberOfSegments;
+        if (_sequence[segment] == 0 || _pending[segment] == 0) continue;
+        uint32_t offset = sizeof(LogSegmentHeader);
+        LogRecordHeader header;
+        while (readRecord(segment, offset, header, bfr) == LOG_RECORD_VALID) {
+          if (!acknowledged(header.state) && header.sequence > after) {
+            record.address = address(segment, offset);
+            record.sequence = header.sequence;
+            record.len = header.len;
+            record.queuedAt = queued(header.state) ? header.queuedAt : 0;
+            record.tileId = queued(header.state) ? header.tileId : 0;
+            return true;
+          }
+          offset += align(sizeof(header) + header.len);
+        }
+      }
+      return false;
+    };
+
+    /*
+     *  Note that the tile took a message at tileTime as tileId, it stays
+     *  pending until acknowledged; false if it is gone or can't be written
+     */
+    boolean markQueued(
+      const LogRecord &record, const uint32_t tileTime, const uint64_t tileId
+    ) {
+      LogRecordHeader header;
+      if (!find(record, header)) return false;
+      if (queued(header.state) || acknowledged(header.state)) return true;
+      if (!_flashRef->write(
+        record.address + offsetof(LogRecordHeader, queuedAt), &tileTime,
+        sizeof(tileTime)) ||
+        !_flashRef->write(
+        record.address + offsetof(LogRecordHeader, tileId), &tileId,
+        sizeof(tileId))
+      ) {
+        return false;
+      }
+      const uint8_t state = header.state & ~LOG_STATE_QUEUED;
+      return _flashRef->write(
+        record.address + offsetof(LogRecordHeader, state), &state, 1);
+    };
+
+    /*
+     *  Hand a queued message to the tile again, e.g. after its hold time ran
+     *  out there: data, as read with readPending(), is appended as a new
+     *  record and this one acknowledged. False if it could not be written.
+     */
+    boolean requeue(const LogRecord &record, const char *data) {
+      if (!append(data, record.len)) return false;
+      // gone if the append reclaimed its segment
+      acknowledge(record);
+      return true;
+    };
+
+    /*
+     *  Mark a message as delivered, false if it is gone or can't be written
+     */
+    boolean acknowledge(const LogRecord &record) {
+      LogRecordHeader header;
+      if (!find(record, header)) return false;
+      if (acknowledged(header.state)) return true;
+      const uint8_t state = header.state & ~LOG_STATE_ACKNOWLEDGED;
+      if (!_flashRef->write(
+        record.address + offsetof(LogRecordHeader, state), &state, 1)
+      ) {
+        return false;
+      }
+      _pending[record.address / _sectorSize]--;
+      numberOfPending--;
+      return true;
+    };
+};
+
+#endif
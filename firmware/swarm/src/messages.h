@@ -2,6 +2,31 @@
  *  This file contains functionality used in swarm.ino but should be tested
  *  separately
  */
+#ifndef _MESSAGES_H_
+#define _MESSAGES_H_
+
+#ifndef _SENSOR_SCHEMA_H_
+#include "sensorSchema.h"
+#endif
+#ifndef _SDI12_PARSER_H_
+#include "sdi12Parser.h"
+#endif
+
+// message encodings, see message format spec in swarm.ino
+#define ENCODING_CSV 0
+#define ENCODING_BINARY 1
+// first byte of a binary SC frame, can't be confused with the first digit of
+// the message index in a CSV message
+#define FRAME_SC_BINARY 0x01
+// maximum user data the SWARM tile accepts in one message
+#define MAX_MESSAGE_LENGTH 192
+// channel flag for values that carry their own precision, see encodeChannel
+#define CHANNEL_SELF_DESCRIBING 0x80
+// channel flag for values left out for being outside the range of their
+// field, see encodeChannel
+#define CHANNEL_OUT_OF_RANGE 0x40
+// values of all channels of a message, see getReadings
+#define MAX_MESSAGE_VALUES 48
 
 /*
  * A message can hold up to five of those BUT the message length is
@@ -13,6 +38,9 @@ typedef struct {
   uint8_t channel = 0;
   // a payload to be used within the message type
   char payload[150] = {0};
+  // the payload as numbers, filled by SDI12Measurement::getPayload; if empty
+  // the encoders parse the payload text instead
+  Sdi12Values values;
 } Payload;
 
  // struct holding all information for messages
@@ -29,6 +57,22 @@ typedef struct {
   Payload payloads[5];
 } Message;
 
+/*
+ *  The values of all channels of a message as fixed point numbers, see
+ *  MessageHelpers::getReadings
+ */
+typedef struct {
+  uint8_t numberOfChannels;
+  uint8_t channels[5];
+  // number of values, CHANNEL_SELF_DESCRIBING flag like in encodeChannel
+  uint8_t counts[5];
+  uint8_t numberOfValues;
+  uint8_t decimals[MAX_MESSAGE_VALUES];
+  int64_t values[MAX_MESSAGE_VALUES];
+  // bit i is set if values[i] is outside the valid range of its field
+  uint64_t outOfRange;
+} Readings;
+
 
 class MessageHelpers {
 
@@ -37,7 +81,7 @@ class MessageHelpers {
      * Convert message struct into a string. char buffers need to be \0
      * terminated or they will added at the lenght of their definition
      */
-    static size_t formatMessage(Message message, char *bfr) {
+    static size_t formatMessage(const Message &message, char *bfr) {
       // sprintf returns int, the string copied to the buffer is \0 terminated
       int len;
       size_t idx = 0;
@@ -67,6 +111,171 @@ class MessageHelpers {
       return idx;
     };
 
+    /*
+     *  Write an unsigned LEB128 varint, returns bytes written
+     */
+    static size_t writeVarint(uint64_t value, char *bfr) {
+      size_t idx = 0;
+      while (value > 0x7F) {
+        bfr[idx++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+      }
+      bfr[idx++] = static_cast<char>(value);
+      return idx;
+    };
+
+    /*
+     *  Map signed to unsigned so that small negative numbers stay small
+     */
+    static uint64_t zigzag(int64_t value) {
+      return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    };
+
+    /*
+     *  Values of a payload, the text is parsed only if the measurement did
+     *  not provide them
+     */
+    static const Sdi12Values &getValues(
+      const Payload &payload, Sdi12Values &parsed
+    ) {
+      if (payload.values.count > 0) return payload.values;
+      parsed.count = 0;
+      Sdi12Parser::parse(
+        payload.payload, strnlen(payload.payload, sizeof(payload.payload)),
+        parsed);
+      return parsed;
+    };
+
+    /*
+     *  Values of all channels, scaled to the precision of the field and
+     *  range checked for known sensors (see sensorSchema.h) or as reported
+     *  for self-describing channels
+     */
+    static void getReadings(const Message &message, Readings &readings) {
+      readings.numberOfChannels = 0;
+      readings.numberOfValues = 0;
+      readings.outOfRange = 0;
+      for (size_t i=0; i<5; i++) {
+        const Payload &payload = message.payloads[i];
+        if (payload.channel == 0) continue;
+        Sdi12Values parsed;
+        const Sdi12Values &values = getValues(payload, parsed);
+        const SensorSchema *schema = findSensorSchema(payload.channel);
+        const uint8_t first = readings.numberOfValues;
+        for (uint8_t j=0;
+          j<values.count && readings.numberOfValues < MAX_MESSAGE_VALUES; j++
+        ) {
+          readings.values[readings.numberOfValues] = values.mantissas[j];
+          readings.decimals[readings.numberOfValues] = values.decimals[j];
+          readings.numberOfValues++;
+        }
+        uint8_t count = readings.numberOfValues - first;
+        if (schema != NULL && schema->numberOfFields == count) {
+          for (uint8_t j=0; j<count; j++) {
+            readings.values[first+j] = Sdi12Parser::rescale(
+              readings.values[first+j], readings.decimals[first+j],
+              schema->fields[j].decimals);
+            readings.decimals[first+j] = schema->fields[j].decimals;
+            if (!inRange(schema->fields[j], readings.values[first+j])) {
+              readings.outOfRange |= 1ULL << (first + j);
+            }
+          }
+        } else {
+          count |= CHANNEL_SELF_DESCRIBING;
+        }
+        readings.channels[readings.numberOfChannels] = payload.channel;
+        readings.counts[readings.numberOfChannels] = count;
+        readings.numberOfChannels++;
+      }
+    };
+
+    /*
+     *  Encode the values of one SDI-12 payload
+     *
+     *  - channel byte, count byte, count varints
+     *  - known sensors (see sensorSchema.h): zigzag varints of the values
+     *    scaled to the precision of the field
+     *  - unknown sensors or unexpected number of values: count byte is flagged
+     *    with CHANNEL_SELF_DESCRIBING and each varint holds
+     *    zigzag(mantissa) << 3 | decimals
+     *  - values of known sensors outside the range of their field are left
+     *    out, the count byte is flagged with CHANNEL_OUT_OF_RANGE and a
+     *    varint with bit i set for each of them comes first
+     *  - returns 0 if the channel does not fit into maxLen
+     */
+    static size_t encodeChannel(
+      const Payload &payload, char *bfr, const size_t maxLen
+    ) {
+      Sdi12Values parsed;
+      const Sdi12Values &values = getValues(payload, parsed);
+      const SensorSchema *schema = findSensorSchema(payload.channel);
+      // a single varint takes 10 bytes at most
+      char varintBfr[10];
+      size_t varintLen;
+      const uint8_t count = values.count;
+      if (schema != NULL && schema->numberOfFields != count) schema = NULL;
+      uint64_t outOfRange = 0;
+      for (uint8_t i=0; schema != NULL && i<count; i++) {
+        if (!inRange(
+          schema->fields[i],
+          Sdi12Parser::scaled(values, i, schema->fields[i].decimals))
+        ) {
+          outOfRange |= 1ULL << i;
+        }
+      }
+      if (maxLen < 2) return 0;
+      size_t idx = 0;
+      bfr[idx++] = payload.channel;
+      bfr[idx++] = count | (schema == NULL ? CHANNEL_SELF_DESCRIBING : 0)
+        | (outOfRange != 0 ? CHANNEL_OUT_OF_RANGE : 0);
+      if (outOfRange != 0) {
+        varintLen = writeVarint(outOfRange, varintBfr);
+        if (idx + varintLen > maxLen) return 0;
+        memcpy(bfr + idx, varintBfr, varintLen);
+        idx += varintLen;
+      }
+      for (uint8_t i=0; i<count; i++) {
+        if (outOfRange & (1ULL << i)) continue;
+        if (schema != NULL) {
+          varintLen = writeVarint(
+            zigzag(Sdi12Parser::scaled(values, i, schema->fields[i].decimals)),
+            varintBfr);
+        } else {
+          // three bits for decimals, SDI-12 values have seven digits at most
+          const uint8_t decimals = values.decimals[i] > 7 ? 7 : values.decimals[i];
+          varintLen = writeVarint(
+            zigzag(Sdi12Parser::scaled(values, i, decimals)) << 3 | decimals,
+            varintBfr);
+        }
+        if (idx + varintLen > maxLen) return 0;
+        memcpy(bfr + idx, varintBfr, varintLen);
+        idx += varintLen;
+      }
+      return idx;
+    };
+
+    /*
+     *  Convert message struct into a binary frame, see message format spec in
+     *  swarm.ino. Channels that don't fit into MAX_MESSAGE_LENGTH are dropped
+     *  as a whole rather than truncated.
+     */
+    static size_t encodeMessage(const Message &message, char *bfr) {
+      size_t idx = 0;
+      bfr[idx++] = FRAME_SC_BINARY;
+      idx += writeVarint(message.index, bfr + idx);
+      for (size_t i=0; i<4; i++) {
+        bfr[idx++] = static_cast<char>((message.timeStamp >> (8 * i)) & 0xFF);
+      }
+      idx += writeVarint(
+        static_cast<uint64_t>(message.batteryVoltage * 100 + .5), bfr + idx);
+      for (size_t i=0; i<5; i++) {
+        if (message.payloads[i].channel == 0) continue;
+        idx += encodeChannel(
+          message.payloads[i], bfr + idx, MAX_MESSAGE_LENGTH - idx);
+      }
+      return idx;
+    };
+
     static unsigned long getNextScheduled(
       unsigned long timeStamp, unsigned long interval
     ) {
@@ -75,3 +284,5 @@ class MessageHelpers {
       return static_cast<double>((timeStamp + interval)/interval) * interval;
     };
 };
+
+#endif
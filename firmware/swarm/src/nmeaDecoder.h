@@ -0,0 +1,418 @@
+/*
+ *  Decode sentences received from the SWARM tile into typed structs
+ *
+ *  - one pass over the line splits the fields and verifies the checksum,
+ *    fields point into the line, nothing is copied
+ *  - dates are converted to epoch arithmetically, independent of the time
+ *    zone, see http://howardhinnant.github.io/date_algorithms.html
+ *  - formats from
+ *    https://swarm.space/wp-content/uploads/2021/06/Swarm-Tile-Product-Manual.pdf
+ */
+#ifndef _NMEA_DECODER_H_
+#define _NMEA_DECODER_H_
+
+#include <Arduino.h>
+
+// sentence types
+#define NMEA_UNKNOWN 0
+#define NMEA_DT 1
+#define NMEA_GN 2
+#define NMEA_GS 3
+#define NMEA_RT 4
+#define NMEA_MT 5
+#define NMEA_TD 6
+// modem status, $TILE on older firmware
+#define NMEA_M138 7
+// received messages, e.g. $MM AI=0,68656c6c6f,5354468575916,1638633600
+#define NMEA_MM 8
+
+// command results, a report is a sentence that carries data
+#define NMEA_REPORT 0
+#define NMEA_OK 1
+#define NMEA_ERR 2
+
+#define NMEA_MAX_FIELDS 8
+
+
+typedef struct {
+  const char *text;
+  size_t len;
+} NmeaField;
+
+typedef struct {
+  uint8_t type;
+  uint8_t result;
+  // comma separated fields after the sentence type
+  uint8_t numberOfFields;
+  NmeaField fields[NMEA_MAX_FIELDS];
+  // decoded fields depending on type and result
+  union {
+    // $DT 20190408195123,V
+    struct {
+      unsigned long epoch;
+      boolean valid;
+    } dateTime;
+    // $GN 37.8000,-122.2700,12,0,0
+    struct {
+      float latitude;
+      float longitude;
+      int32_t altitude;
+      uint16_t course;
+      uint16_t speed;
+    } position;
+    // $GS 109,214,10,0,G3
+    struct {
+      uint16_t hdop;
+      uint16_t vdop;
+      uint8_t satellites;
+      char fix[2];
+    } gpsStatus;
+    // $RT RSSI=-104 and $TD SENT,RSSI=-110,SNR=6,FDEV=0,5354468575916
+    struct {
+      int16_t rssi;
+      int16_t snr;
+      int32_t fdev;
+      // message id, $TD OK and $TD SENT only
+      uint64_t id;
+    } signal;
+    // $MM AI=0,68656c6c6f,5354468575916,1638633600, the data is
+    // fields[1] as hex
+    struct {
+      uint16_t application;
+      uint64_t id;
+      unsigned long epoch;
+      boolean valid;
+    } received;
+    // $MT 5
+    unsigned long count;
+    // response to a rate query, e.g. $DT 60
+    unsigned long rate;
+  };
+} NmeaSentence;
+
+
+class NmeaDecoder {
+  private:
+    static int8_t hexValue(const char c) {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      return -1;
+    };
+
+    static uint8_t twoDigits(const char *bfr) {
+      return (bfr[0] - '0') * 10 + (bfr[1] - '0');
+    };
+
+    static boolean isLeapYear(const uint16_t year) {
+      return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    };
+
+    static uint8_t typeOf(const char *type, const size_t len) {
+      if (len == 3) {
+        if (memcmp(type, "$DT", 3) == 0) return NMEA_DT;
+        if (memcmp(type, "$GN", 3) == 0) return NMEA_GN;
+        if (memcmp(type, "$GS", 3) == 0) return NMEA_GS;
+        if (memcmp(type, "$RT", 3) == 0) return NMEA_RT;
+        if (memcmp(type, "$MT", 3) == 0) return NMEA_MT;
+        if (memcmp(type, "$TD", 3) == 0) return NMEA_TD;
+        if (memcmp(type, "$MM", 3) == 0) return NMEA_MM;
+      }
+      if (len == 5) {
+        if (memcmp(type, "$M138", 5) == 0) return NMEA_M138;
+        if (memcmp(type, "$TILE", 5) == 0) return NMEA_M138;
+      }
+      return NMEA_UNKNOWN;
+    };
+
+    /*
+     *  key=value field with a signed integer value, e.g. RSSI=-104
+     */
+    static boolean keyValue(
+      const NmeaField &field, const char *key, int32_t *value
+    ) {
+      const size_t keyLen = strlen(key);
+      int64_t ret;
+      if (field.len <= keyLen || memcmp(field.text, key, keyLen) != 0) return false;
+      NmeaField valueField = {field.text + keyLen, field.len - keyLen};
+      if (!toSigned(valueField, &ret)) return false;
+      *value = static_cast<int32_t>(ret);
+      return true;
+    };
+
+    static void decodeDateTime(NmeaSentence *sentence) {
+      const NmeaField &date = sentence->fields[0];
+      uint64_t rate;
+      sentence->dateTime.epoch = 0;
+      sentence->dateTime.valid = false;
+      if (sentence->numberOfFields == 1 && toUnsigned(date, &rate)) {
+        sentence->rate = rate;
+        return;
+      }
+      if (sentence->numberOfFields != 2 || date.len != 14) return;
+      for (size_t i=0; i<14; i++) {
+        if (date.text[i] < '0' || date.text[i] > '9') return;
+      }
+      const uint16_t year = twoDigits(date.text) * 100 + twoDigits(date.text + 2);
+      const uint8_t month = twoDigits(date.text + 4);
+      const uint8_t day = twoDigits(date.text + 6);
+      const uint8_t hour = twoDigits(date.text + 8);
+      const uint8_t minute = twoDigits(date.text + 10);
+      const uint8_t second = twoDigits(date.text + 12);
+      static const uint8_t daysInMonth[] = {
+        31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+      // going back to 2019 to make SWARM examples work, see validateTimeStruct
+      if (year < 2019 || year > 2037) return;
+      if (month < 1 || month > 12) return;
+      if (day < 1) return;
+      if (day > daysInMonth[month-1] + (month == 2 && isLeapYear(year))) return;
+      // GPS does not do leap seconds
+      if (hour > 23 || minute > 59 || second > 59) return;
+      sentence->dateTime.epoch =
+        daysFromCivil(year, month, day) * 86400UL + hour * 3600UL +
+        minute * 60UL + second;
+      sentence->dateTime.valid = sentence->fields[1].len == 1
+        && sentence->fields[1].text[0] == 'V';
+    };
+
+    static void decodePosition(NmeaSentence *sentence) {
+      int64_t value;
+      uint8_t decimals;
+      if (sentence->numberOfFields == 1) {
+        uint64_t rate = 0;
+        toUnsigned(sentence->fields[0], &rate);
+        sentence->rate = rate;
+        return;
+      }
+      memset(&sentence->position, 0, sizeof(sentence->position));
+      if (sentence->numberOfFields < 5) return;
+      if (toFixed(sentence->fields[0], &value, &decimals)) {
+        sentence->position.latitude = value / pow(10, decimals);
+      }
+      if (toFixed(sentence->fields[1], &value, &decimals)) {
+        sentence->position.longitude = value / pow(10, decimals);
+      }
+      if (toSigned(sentence->fields[2], &value)) sentence->position.altitude = value;
+      if (toSigned(sentence->fields[3], &value)) sentence->position.course = value;
+      if (toSigned(sentence->fields[4], &value)) sentence->position.speed = value;
+    };
+
+    static void decodeGpsStatus(NmeaSentence *sentence) {
+      uint64_t value;
+      if (sentence->numberOfFields == 1) {
+        uint64_t rate = 0;
+        toUnsigned(sentence->fields[0], &rate);
+        sentence->rate = rate;
+        return;
+      }
+      memset(&sentence->gpsStatus, 0, sizeof(sentence->gpsStatus));
+      if (sentence->numberOfFields < 5) return;
+      if (toUnsigned(sentence->fields[0], &value)) sentence->gpsStatus.hdop = value;
+      if (toUnsigned(sentence->fields[1], &value)) sentence->gpsStatus.vdop = value;
+      if (toUnsigned(sentence->fields[2], &value)) sentence->gpsStatus.satellites = value;
+      if (sentence->fields[4].len == 2) memcpy(sentence->gpsStatus.fix, sentence->fields[4].text, 2);
+    };
+
+    static void decodeSignal(NmeaSentence *sentence, const uint8_t first) {
+      int32_t value;
+      uint64_t id;
+      memset(&sentence->signal, 0, sizeof(sentence->signal));
+      for (uint8_t i=first; i<sentence->numberOfFields; i++) {
+        const NmeaField &field = sentence->fields[i];
+        if (keyValue(field, "RSSI=", &value)) sentence->signal.rssi = value;
+        else if (keyValue(field, "SNR=", &value)) sentence->signal.snr = value;
+        else if (keyValue(field, "FDEV=", &value)) sentence->signal.fdev = value;
+        else if (toUnsigned(field, &id)) sentence->signal.id = id;
+      }
+    };
+
+    static void decodeReceived(NmeaSentence *sentence) {
+      int32_t application;
+      uint64_t value;
+      memset(&sentence->received, 0, sizeof(sentence->received));
+      if (sentence->numberOfFields < 3) return;
+      if (!keyValue(sentence->fields[0], "AI=", &application)) return;
+      if (!toUnsigned(sentence->fields[2], &value)) return;
+      sentence->received.application = application;
+      // even if the data is broken, the message can still be deleted by id
+      sentence->received.id = value;
+      if (sentence->fields[1].len % 2 != 0) return;
+      if (sentence->numberOfFields > 3 && toUnsigned(sentence->fields[3], &value)) {
+        sentence->received.epoch = value;
+      }
+      sentence->received.valid = true;
+    };
+
+  public:
+    /*
+     *  Unsigned decimal field
+     */
+    static boolean toUnsigned(const NmeaField &field, uint64_t *value) {
+      uint64_t ret = 0;
+      if (field.len == 0 || field.len > 19) return false;
+      for (size_t i=0; i<field.len; i++) {
+        const char c = field.text[i];
+        if (c < '0' || c > '9') return false;
+        ret = ret * 10 + (c - '0');
+      }
+      *value = ret;
+      return true;
+    };
+
+    /*
+     *  Signed decimal field, with an optional sign
+     */
+    static boolean toSigned(const NmeaField &field, int64_t *value) {
+      uint64_t ret;
+      if (field.len == 0) return false;
+      const boolean negative = field.text[0] == '-';
+      const size_t skip = (negative || field.text[0] == '+') ? 1 : 0;
+      NmeaField digits = {field.text + skip, field.len - skip};
+      if (!toUnsigned(digits, &ret)) return false;
+      *value = negative ? -static_cast<int64_t>(ret) : static_cast<int64_t>(ret);
+      return true;
+    };
+
+    /*
+     *  Decimal field like -122.2700 as mantissa and number of decimals
+     */
+    static boolean toFixed(
+      const NmeaField &field, int64_t *mantissa, uint8_t *decimals
+    ) {
+      size_t dot = field.len;
+      for (size_t i=0; i<field.len; i++) {
+        if (field.text[i] == '.') {
+          dot = i;
+          break;
+        }
+      }
+      int64_t integer = 0;
+      uint64_t fraction = 0;
+      NmeaField integerField = {field.text, dot};
+      if (!toSigned(integerField, &integer)) return false;
+      *decimals = 0;
+      if (dot < field.len) {
+        NmeaField fractionField = {field.text + dot + 1, field.len - dot - 1};
+        if (fractionField.len > 9 || !toUnsigned(fractionField, &fraction)) return false;
+        *decimals = fractionField.len;
+      }
+      int64_t scale = 1;
+      for (uint8_t i=0; i<*decimals; i++) scale *= 10;
+      const boolean negative = field.text[0] == '-';
+      *mantissa = integer * scale + (negative ? -1 : 1) * static_cast<int64_t>(fraction);
+      return true;
+    };
+
+    /*
+     *  Days since 1970-01-01 of a date in the proleptic Gregorian calendar
+     */
+    static unsigned long daysFromCivil(
+      const uint16_t year, const uint8_t month, const uint8_t day
+    ) {
+      // years start in March, so that the leap day is the last day
+      const uint16_t y = year - (month <= 2);
+      const uint16_t era = y / 400;
+      const uint16_t yearOfEra = y - era * 400;
+      const uint16_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+      const unsigned long dayOfEra =
+        yearOfEra * 365UL + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+      return era * 146097UL + dayOfEra - 719468UL;
+    };
+
+    static boolean fieldEquals(const NmeaField &field, const char *text) {
+      return strlen(text) == field.len && memcmp(field.text, text, field.len) == 0;
+    };
+
+    /*
+     *  Decode a line like $DT 20190408195123,V*41, trailing characters after
+     *  the checksum are ignored. Returns false if the line is not a
+     *  sentence or the checksum does not match, sentence->type is
+     *  NMEA_UNKNOWN for sentences that are not decoded.
+     */
+    static boolean decode(
+      const char *line, const size_t len, NmeaSentence *sentence
+    ) {
+      uint8_t checksum = 0;
+      size_t typeLen = 0;
+      size_t fieldStart = 0;
+      size_t idx = 1;
+      sentence->type = NMEA_UNKNOWN;
+      sentence->result = NMEA_REPORT;
+      sentence->numberOfFields = 0;
+      if (len < 4 || line[0] != '$') return false;
+      for (; idx<len && line[idx] != '*'; idx++) {
+        const char c = line[idx];
+        checksum ^= static_cast<uint8_t>(c);
+        if (typeLen == 0) {
+          if (c == ' ') {
+            typeLen = idx;
+            fieldStart = idx + 1;
+          }
+        } else if (c == ',') {
+          if (sentence->numberOfFields < NMEA_MAX_FIELDS) {
+            NmeaField &field = sentence->fields[sentence->numberOfFields++];
+            field.text = line + fieldStart;
+            field.len = idx - fieldStart;
+          }
+          fieldStart = idx + 1;
+        }
+      }
+      if (idx + 2 >= len) return false;
+      const int8_t high = hexValue(line[idx+1]);
+      const int8_t low = hexValue(line[idx+2]);
+      if (high < 0 || low < 0 || ((high << 4) | low) != checksum) return false;
+      if (typeLen == 0) {
+        typeLen = idx;
+      } else if (sentence->numberOfFields < NMEA_MAX_FIELDS) {
+        NmeaField &field = sentence->fields[sentence->numberOfFields++];
+        field.text = line + fieldStart;
+        field.len = idx - fieldStart;
+      }
+      sentence->type = typeOf(line, typeLen);
+      if (sentence->numberOfFields > 0) {
+        if (fieldEquals(sentence->fields[0], "OK")) sentence->result = NMEA_OK;
+        if (fieldEquals(sentence->fields[0], "ERR")) sentence->result = NMEA_ERR;
+      }
+      switch (sentence->type) {
+        case NMEA_DT:
+          if (sentence->result == NMEA_REPORT) decodeDateTime(sentence);
+          break;
+        case NMEA_GN:
+          if (sentence->result == NMEA_REPORT) decodePosition(sentence);
+          break;
+        case NMEA_GS:
+          if (sentence->result == NMEA_REPORT) decodeGpsStatus(sentence);
+          break;
+        case NMEA_RT:
+          if (sentence->numberOfFields == 1 && sentence->result == NMEA_REPORT
+            && sentence->fields[0].text[0] != 'R'
+          ) {
+            uint64_t rate = 0;
+            toUnsigned(sentence->fields[0], &rate);
+            sentence->rate = rate;
+          } else if (sentence->result == NMEA_REPORT) {
+            decodeSignal(sentence, 0);
+          }
+          break;
+        case NMEA_MT:
+          if (sentence->result == NMEA_REPORT) {
+            uint64_t count = 0;
+            if (sentence->numberOfFields > 0) toUnsigned(sentence->fields[0], &count);
+            sentence->count = count;
+          }
+          break;
+        case NMEA_TD:
+          // $TD OK,<id> and $TD SENT,RSSI=..,SNR=..,FDEV=..,<id>
+          if (sentence->result != NMEA_ERR) decodeSignal(sentence, 1);
+          break;
+        case NMEA_MM:
+          if (sentence->result == NMEA_REPORT) decodeReceived(sentence);
+          break;
+        default:
+          break;
+      }
+      return true;
+    };
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ *  Assemble lines received from the SWARM tile without blocking
+ *
+ *  - bytes are moved from the UART into a ring of line slots by poll(), the
+ *    caller can sleep in between since nothing is lost as long as the UART
+ *    buffer does not overflow
+ *  - the NMEA checksum of $...*hh lines is calculated while the bytes
+ *    arrive, complete lines are handed out in place with peek() and
+ *    returned with release()
+ *  - poll() stops reading from the UART if all slots are taken, so a burst
+ *    of unsolicited messages waits in the UART buffer instead of being
+ *    dropped or split
+ */
+#ifndef _NMEA_READER_H_
+#define _NMEA_READER_H_
+
+#include <Arduino.h>
+#ifndef _SERIAL_WRAPPER_H_
+#include "serialWrapper.h"
+#endif
+
+// long enough for a $MM message with 192 bytes of hex encoded data
+#define NMEA_MAX_LINE_LENGTH 448
+#define NMEA_LINE_SLOTS 8
+
+
+typedef struct {
+  // the line including the line feed, \0 terminated
+  char text[NMEA_MAX_LINE_LENGTH];
+  size_t len;
+  // NMEA sentence with a matching checksum
+  boolean valid;
+} NmeaLine;
+
+
+class NmeaReader {
+  private:
+    // state of the checksum calculation for the line being assembled
+    enum {
+      LINE_START, LINE_BODY, LINE_HEX1, LINE_HEX2, LINE_END, LINE_RAW
+    } _state = LINE_START;
+    SerialWrapperBase *_serialRef;
+    NmeaLine _lines[NMEA_LINE_SLOTS];
+    // oldest complete line and number of complete lines
+    uint8_t _head = 0;
+    uint8_t _count = 0;
+    uint8_t _checksum = 0;
+    uint8_t _expected = 0;
+    boolean _truncated = false;
+
+    static int8_t hexValue(const char c) {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      return -1;
+    };
+
+    NmeaLine &assembling() {
+      return _lines[(_head + _count) % NMEA_LINE_SLOTS];
+    };
+
+    void complete() {
+      NmeaLine &line = assembling();
+      line.text[line.len] = 0;
+      line.valid = _state == LINE_END && _checksum == _expected && !_truncated;
+      if (_state == LINE_END && !line.valid) checksumErrors++;
+      if (_truncated) truncatedLines++;
+      linesReceived++;
+      _count++;
+      _state = LINE_START;
+      _checksum = 0;
+      _expected = 0;
+      _truncated = false;
+      if (_count < NMEA_LINE_SLOTS) assembling().len = 0;
+    };
+
+    void feed(const char c) {
+      NmeaLine &line = assembling();
+      int8_t hex;
+      if (line.len < NMEA_MAX_LINE_LENGTH - 1) {
+        line.text[line.len++] = c;
+      } else {
+        _truncated = true;
+      }
+      switch (_state) {
+        case LINE_START:
+          _state = c == '$' ? LINE_BODY : LINE_RAW;
+          break;
+        case LINE_BODY:
+          if (c == '*') _state = LINE_HEX1;
+          else if (c != '\n') _checksum ^= static_cast<uint8_t>(c);
+          break;
+        case LINE_HEX1:
+        case LINE_HEX2:
+          hex = hexValue(c);
+          if (hex < 0) {
+            _state = LINE_RAW;
+          } else {
+            _expected = (_expected << 4) | hex;
+            _state = _state == LINE_HEX1 ? LINE_HEX2 : LINE_END;
+          }
+          break;
+        case LINE_END:
+          if (c != '\r' && c != '\n') _state = LINE_RAW;
+          break;
+        default:
+          break;
+      }
+      if (c == '\n') complete();
+    };
+
+  public:
+    unsigned long linesReceived = 0;
+    unsigned long checksumErrors = 0;
+    unsigned long truncatedLines = 0;
+
+    NmeaReader(SerialWrapperBase *serialRef) {
+      _serialRef = serialRef;
+      _lines[0].len = 0;
+    };
+
+    /*
+     *  Move available bytes from the UART into the line slots, returns the
+     *  number of complete lines waiting. Never blocks.
+     */
+    uint8_t poll() {
+      while (_count < NMEA_LINE_SLOTS && _serialRef->available()) {
+        feed(_serialRef->read());
+      }
+      return _count;
+    };
+
+    /*
+     *  Number of bytes of a line that has started but is not complete yet
+     */
+    size_t pending() {
+      if (_count == NMEA_LINE_SLOTS) return 0;
+      return assembling().len;
+    };
+
+    /*
+     *  Complete a pending line as is, e.g. if the tile stopped sending
+     */
+    void flush() {
+      if (pending() == 0) return;
+      _state = LINE_RAW;
+      complete();
+    };
+
+    /*
+     *  Oldest complete line or NULL, valid until release()
+     */
+    const NmeaLine *peek() {
+      if (_count == 0) return NULL;
+      return &_lines[_head];
+    };
+
+    void release() {
+      if (_count == 0) return;
+      const boolean full = _count == NMEA_LINE_SLOTS;
+      _head = (_head + 1) % NMEA_LINE_SLOTS;
+      _count--;
+      // the freed slot becomes the one being assembled
+      if (full) assembling().len = 0;
+    };
+};
+
+#endif
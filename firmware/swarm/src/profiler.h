@@ -0,0 +1,249 @@
+/*
+ *  Lightweight profiling of where the awake time of a cycle goes
+ *
+ *  - ProfileScope times a phase like waiting for the tile or reading the
+ *    sensors from construction to destruction, the durations are summed up
+ *    per phase as min/mean/max and kept in a ring buffer of recent samples
+ *  - scopes nest, a phase inside another one is not counted twice for the
+ *    energy estimate
+ *  - bytes are counted per bus
+ *  - together with the current draw per phase this gives an estimate of
+ *    the charge used per cycle, awake time outside of any phase is counted
+ *    with the idle current
+ *  - a single instance, Profiler::global(), so that instrumenting a
+ *    function does not change its signature
+ *  - durations come from esp_timer_get_time() in 64 bit, micros() wraps
+ *    after 71 minutes, which a long light sleep or a cycle can exceed
+ */
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// phases
+#define PHASE_TIME_STAMP 0
+#define PHASE_SDI12_DISCOVERY 1
+#define PHASE_SDI12_MEASUREMENT 2
+#define PHASE_TILE_COMMAND 3
+#define PHASE_DISPLAY 4
+#define PHASE_BUTTON 5
+#define PHASE_SLEEP 6
+#define PROFILER_PHASES 7
+
+// buses
+#define BUS_TILE_RX 0
+#define BUS_TILE_TX 1
+#define BUS_SDI12 2
+#define BUS_I2C 3
+#define PROFILER_BUSES 4
+
+#define PROFILER_RING_SIZE 64
+#define PROFILER_MAX_DEPTH 4
+
+
+typedef struct {
+  uint8_t phase;
+  // millis() at the start
+  uint32_t start;
+  // us
+  uint64_t duration;
+} ProfileSample;
+
+typedef struct {
+  uint32_t count;
+  // us
+  uint64_t min;
+  uint64_t max;
+  uint64_t total;
+  // without nested phases
+  uint64_t exclusive;
+} PhaseStats;
+
+
+class Profiler {
+  private:
+    PhaseStats _phases[PROFILER_PHASES];
+    uint32_t _bytes[PROFILER_BUSES];
+    ProfileSample _ring[PROFILER_RING_SIZE];
+    uint8_t _head = 0;
+    uint8_t _samples = 0;
+    // time spent in nested phases, per open scope
+    uint64_t _nested[PROFILER_MAX_DEPTH];
+    uint8_t _depth = 0;
+    uint64_t _cycleStart = 0;
+    // exclusive time per phase at the start of the cycle
+    uint64_t _cycleExclusive[PROFILER_PHASES];
+
+  public:
+    boolean enabled = true;
+    // current draw in mA per phase and outside of phases
+    float currents[PROFILER_PHASES] = {
+      // tile and MCU awake, waiting for the UART
+      45, 45, 45, 60, 50, 45,
+      // light sleep, the tile keeps running
+      25};
+    float idleCurrent = 45;
+    // charge of the last cycle and all cycles in mAh
+    float cycleCharge = 0;
+    float totalCharge = 0;
+    uint32_t cycles = 0;
+
+    static const char *phaseName(const uint8_t phase) {
+      static const char *names[] = {
+        "TIME", "DISC", "MEAS", "TILE", "DSPL", "BTTN", "SLP"};
+      return phase < PROFILER_PHASES ? names[phase] : "?";
+    };
+
+    static Profiler &global() {
+      static Profiler instance;
+      return instance;
+    };
+
+    Profiler() { reset(); };
+
+    void reset() {
+      for (uint8_t i=0; i<PROFILER_PHASES; i++) {
+        _phases[i] = {0, 0, 0, 0, 0};
+        _cycleExclusive[i] = 0;
+      }
+      for (uint8_t i=0; i<PROFILER_BUSES; i++) _bytes[i] = 0;
+      _head = 0;
+      _samples = 0;
+      _depth = 0;
+      cycleCharge = 0;
+      totalCharge = 0;
+      cycles = 0;
+    };
+
+    /*
+     *  Called by ProfileScope, returns the nesting depth
+     */
+    uint8_t enter() {
+      if (_depth < PROFILER_MAX_DEPTH) _nested[_depth] = 0;
+      return _depth++;
+    };
+
+    void leave(const uint8_t phase, const uint32_t start, const uint64_t duration) {
+      if (_depth == 0) return;
+      _depth--;
+      if (!enabled || phase >= PROFILER_PHASES) return;
+      const uint64_t nested = _depth < PROFILER_MAX_DEPTH ? _nested[_depth] : 0;
+      if (_depth > 0 && _depth <= PROFILER_MAX_DEPTH) _nested[_depth - 1] += duration;
+      PhaseStats &stats = _phases[phase];
+      if (stats.count == 0 || duration < stats.min) stats.min = duration;
+      if (duration > stats.max) stats.max = duration;
+      stats.count++;
+      stats.total += duration;
+      stats.exclusive += duration > nested ? duration - nested : 0;
+      ProfileSample &sample = _ring[(_head + _samples) % PROFILER_RING_SIZE];
+      sample.phase = phase;
+      sample.start = start;
+      sample.duration = duration;
+      if (_samples < PROFILER_RING_SIZE) {
+        _samples++;
+      } else {
+        _head = (_head + 1) % PROFILER_RING_SIZE;
+      }
+    };
+
+    void countBytes(const uint8_t bus, const size_t len) {
+      if (enabled && bus < PROFILER_BUSES) _bytes[bus] += len;
+    };
+
+    uint32_t bytes(const uint8_t bus) { return _bytes[bus]; };
+
+    const PhaseStats &phase(const uint8_t phase) { return _phases[phase]; };
+
+    uint8_t numberOfSamples() { return _samples; };
+
+    /*
+     *  Recent samples, 0 is the oldest one
+     */
+    const ProfileSample &sample(const uint8_t i) {
+      return _ring[(_head + i) % PROFILER_RING_SIZE];
+    };
+
+    /*
+     *  Start and end a cycle, e.g. an iteration of loop(), to estimate the
+     *  charge it used
+     */
+    void beginCycle() {
+      _cycleStart = esp_timer_get_time();
+      for (uint8_t i=0; i<PROFILER_PHASES; i++) {
+        _cycleExclusive[i] = _phases[i].exclusive;
+      }
+    };
+
+    float endCycle() {
+      const uint64_t elapsed = esp_timer_get_time() - _cycleStart;
+      // mA * us
+      double charge = 0;
+      uint64_t inPhases = 0;
+      for (uint8_t i=0; i<PROFILER_PHASES; i++) {
+        const uint64_t time = _phases[i].exclusive - _cycleExclusive[i];
+        inPhases += time;
+        charge += time * static_cast<double>(currents[i]);
+      }
+      if (elapsed > inPhases) charge += (elapsed - inPhases) * static_cast<double>(idleCurrent);
+      cycleCharge = charge / 3.6e9;
+      totalCharge += cycleCharge;
+      cycles++;
+      return cycleCharge;
+    };
+
+    /*
+     *  Summary in short lines to fit the display, times in ms as
+     *  count min/mean/max
+     */
+    size_t report(char *bfr, const size_t len) {
+      size_t idx = 0;
+      for (uint8_t i=0; i<PROFILER_PHASES && idx < len; i++) {
+        const PhaseStats &stats = _phases[i];
+        if (stats.count == 0) continue;
+        idx += snprintf(
+          bfr + idx, len - idx, "%s %lu %lu/%lu/%lu\n", phaseName(i),
+          static_cast<unsigned long>(stats.count),
+          static_cast<unsigned long>(stats.min / 1000),
+          static_cast<unsigned long>(stats.total / stats.count / 1000),
+          static_cast<unsigned long>(stats.max / 1000));
+      }
+      if (idx < len) {
+        idx += snprintf(
+          bfr + idx, len - idx, "UART %lu/%lu\nSDI %lu I2C %lu\n",
+          static_cast<unsigned long>(_bytes[BUS_TILE_RX]),
+          static_cast<unsigned long>(_bytes[BUS_TILE_TX]),
+          static_cast<unsigned long>(_bytes[BUS_SDI12]),
+          static_cast<unsigned long>(_bytes[BUS_I2C]));
+      }
+      if (idx < len && cycles > 0) {
+        idx += snprintf(
+          bfr + idx, len - idx, "mAh %.4f/%.4f\n", cycleCharge,
+          totalCharge / cycles);
+      }
+      return idx < len ? idx : len - 1;
+    };
+};
+
+
+/*
+ *  Times a phase from construction to destruction
+ */
+class ProfileScope {
+  private:
+    uint8_t _phase;
+    uint64_t _start;
+    uint32_t _startMs;
+  public:
+    ProfileScope(const uint8_t phase) {
+      _phase = phase;
+      Profiler::global().enter();
+      _startMs = millis();
+      _start = esp_timer_get_time();
+    };
+    ~ProfileScope() {
+      Profiler::global().leave(_phase, _startMs, esp_timer_get_time() - _start);
+    };
+};
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ *  A Wrapper around the SDI12 Arduino library to allow for testing and
+ *  timing SDI12Measurement without sensors, in the same way as
+ *  SerialWrapperBase does for the tile
+ */
+#ifndef _SDI12_BUS_H_
+#define _SDI12_BUS_H_
+
+#include <Arduino.h>
+#include <SDI12.h>
+
+#define DATA_PIN 21
+#define POWER_PIN -1
+
+
+ // Base class, a bus without sensors
+ class Sdi12BusBase {
+   public:
+     virtual ~Sdi12BusBase() {};
+     virtual void begin() {};
+     virtual int available() { return 0; };
+     virtual int read() { return -1; };
+     // drop everything received so far
+     virtual void clearBuffer() {};
+     // wake the sensors and send a command, blocks until it is on the wire
+     virtual void sendCommand(const char *cmd) {};
+ };
+
+ // Inherited class
+ class Sdi12Bus: public Sdi12BusBase {
+  private:
+    SDI12 _sdi12;
+  public:
+    Sdi12Bus(int8_t dataPin): _sdi12(dataPin) {};
+    void begin() { _sdi12.begin(); };
+    int available() { return _sdi12.available(); };
+    int read() { return _sdi12.read(); };
+    void clearBuffer() { _sdi12.clearBuffer(); };
+    void sendCommand(const char *cmd) { _sdi12.sendCommand(cmd); };
+ };
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ *  Parse SDI-12 responses into numbers without copying or allocating
+ *
+ *  - data responses (aD0! ... aD9!) have the form <addr><values><CR><LF>
+ *    where each value is a sign followed by up to 7 digits and an optional
+ *    decimal point, e.g. 3+26+0.000-0.38
+ *  - values are kept as mantissa and number of decimals, i.e. exactly as
+ *    reported by the sensor, and can be converted to fixed point or float
+ */
+#ifndef _SDI12_PARSER_H_
+#define _SDI12_PARSER_H_
+
+#include <Arduino.h>
+
+// values per sensor, ATMOS 41 reports 18
+#define SDI12_MAX_VALUES 24
+
+
+typedef struct {
+  uint8_t count = 0;
+  int32_t mantissas[SDI12_MAX_VALUES];
+  uint8_t decimals[SDI12_MAX_VALUES];
+} Sdi12Values;
+
+
+class Sdi12Parser {
+  public:
+    /*
+     *  Read one value like +12.34 or -0.5 starting at *pos, return false if
+     *  there is no value. The value is mantissa * 10^-decimals.
+     */
+    static boolean parseValue(
+      const char *bfr, const size_t len, size_t *pos, int32_t *mantissa,
+      uint8_t *decimals
+    ) {
+      size_t idx = *pos;
+      boolean negative;
+      boolean fraction = false;
+      uint8_t digits = 0;
+      int32_t value = 0;
+      *decimals = 0;
+      if (idx >= len || (bfr[idx] != '+' && bfr[idx] != '-')) return false;
+      negative = bfr[idx] == '-';
+      idx++;
+      while (idx < len) {
+        char c = bfr[idx];
+        if (c >= '0' && c <= '9') {
+          // the spec allows 7 digits, more would overflow eventually
+          if (++digits > 9) return false;
+          value = value * 10 + (c - '0');
+          if (fraction) (*decimals)++;
+        } else if (c == '.' && !fraction) {
+          fraction = true;
+        } else {
+          break;
+        }
+        idx++;
+      }
+      if (digits == 0) return false;
+      *mantissa = negative ? -value : value;
+      *pos = idx;
+      return true;
+    };
+
+    /*
+     *  Append the values of a data response to values
+     *
+     *  - a leading address is skipped, parsing stops at CR or LF
+     *  - returns false if the response contains anything else than values
+     *    or if values is full, values parsed so far are kept
+     */
+    static boolean parse(const char *bfr, const size_t len, Sdi12Values &values) {
+      size_t pos = 0;
+      if (len > 0 && bfr[0] != '+' && bfr[0] != '-') pos++;
+      while (pos < len && bfr[pos] != '\r' && bfr[pos] != '\n' && bfr[pos] != 0) {
+        if (values.count == SDI12_MAX_VALUES) return false;
+        if (!parseValue(
+          bfr, len, &pos, &values.mantissas[values.count],
+          &values.decimals[values.count])
+        ) {
+          return false;
+        }
+        values.count++;
+      }
+      return true;
+    };
+
+    /*
+     *  Number of values in a data response
+     */
+    static uint16_t count(const char *bfr, const size_t len) {
+      uint16_t ret = 0;
+      int32_t mantissa;
+      uint8_t decimals;
+      size_t pos = 0;
+      if (len > 0 && bfr[0] != '+' && bfr[0] != '-') pos++;
+      while (parseValue(bfr, len, &pos, &mantissa, &decimals)) ret++;
+      return ret;
+    };
+
+    /*
+     *  Bring a value to a fixed number of decimals, rounding half away from
+     *  zero
+     */
+    static int64_t rescale(int64_t mantissa, uint8_t from, const uint8_t to) {
+      while (from < to) {
+        mantissa *= 10;
+        from++;
+      }
+      while (from > to) {
+        mantissa = (mantissa + (mantissa < 0 ? -5 : 5)) / 10;
+        from--;
+      }
+      return mantissa;
+    };
+
+    /*
+     *  Fixed point representation of value i with the given number of
+     *  decimals
+     */
+    static int64_t scaled(
+      const Sdi12Values &values, const uint8_t i, const uint8_t decimals
+    ) {
+      return rescale(values.mantissas[i], values.decimals[i], decimals);
+    };
+
+    static float toFloat(const Sdi12Values &values, const uint8_t i) {
+      static const float powers[] = {
+        1, 10, 100, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+      return values.mantissas[i] / powers[values.decimals[i]];
+    };
+
+    /*
+     *  Parse the response to a measurement command: address (1 byte),
+     *  seconds until data is ready (3 bytes), number of values (2 bytes for
+     *  aC!, 1 byte for aM!)
+     */
+    static boolean parseMeasurementResponse(
+      const char *bfr, const size_t len, char *addr, uint16_t *seconds,
+      uint8_t *numberOfValues
+    ) {
+      if (len != 5 && len != 6) return false;
+      for (size_t i=1; i<len; i++) {
+        if (bfr[i] < '0' || bfr[i] > '9') return false;
+      }
+      *addr = bfr[0];
+      *seconds = (bfr[1] - '0') * 100 + (bfr[2] - '0') * 10 + (bfr[3] - '0');
+      *numberOfValues = bfr[4] - '0';
+      if (len == 6) *numberOfValues = *numberOfValues * 10 + (bfr[5] - '0');
+      return true;
+    };
+};
+
+#endif
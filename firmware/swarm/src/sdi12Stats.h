@@ -0,0 +1,157 @@
+/*
+ *  Timing of SDI-12 transactions
+ *
+ *  - a sensor has to start its response within 15 ms after the command and
+ *  terminate it with <CR><LF>, a recorder retries a command that is not
+ *  answered
+ *  - per address we keep the latency from the end of the command to the
+ *  first character of the response, once a sensor is known its first
+ *  attempt uses a tighter deadline than the spec
+ *  - per command type we count transactions and the time they took,
+ *  including retries
+ */
+#ifndef _SDI12_STATS_H_
+#define _SDI12_STATS_H_
+
+#include <Arduino.h>
+
+// wait for the first character of a response in ms, the spec allows 15 ms
+#define SDI12_RESPONSE_TIMEOUT 30
+// wait for each following character in ms, a character takes 8.3 ms at
+// 1200 baud
+#define SDI12_CHAR_TIMEOUT 20
+// attempts per command
+#define SDI12_RETRIES 3
+// responses needed before the deadline of an address is tightened
+#define SDI12_LATENCY_SAMPLES 3
+// added to the largest latency seen to get the deadline in ms
+#define SDI12_LATENCY_MARGIN 5
+
+// 0-9, a-z, A-Z
+#define SDI12_ADDRESSES 62
+
+// command types
+#define SDI12_COMMAND_ACKNOWLEDGE 0
+#define SDI12_COMMAND_INFO 1
+#define SDI12_COMMAND_MEASURE 2
+#define SDI12_COMMAND_CONCURRENT 3
+#define SDI12_COMMAND_DATA 4
+#define SDI12_COMMAND_OTHER 5
+#define SDI12_COMMAND_TYPES 6
+
+
+typedef struct {
+  uint16_t responses = 0;
+  uint16_t timeouts = 0;
+  // ms
+  uint16_t maxLatency = 0;
+  uint32_t totalLatency = 0;
+} Sdi12AddressStats;
+
+typedef struct {
+  uint32_t transactions = 0;
+  // including the first one
+  uint32_t attempts = 0;
+  // not answered after all retries
+  uint32_t failures = 0;
+  // ms
+  uint32_t totalTime = 0;
+} Sdi12CommandStats;
+
+
+class Sdi12Stats {
+  public:
+    Sdi12AddressStats addresses[SDI12_ADDRESSES];
+    Sdi12CommandStats commands[SDI12_COMMAND_TYPES];
+
+    /*
+     *  Index into addresses, -1 for ? and invalid addresses
+     */
+    static int8_t addressIndex(const char addr) {
+      if (addr >= '0' && addr <= '9') return addr - '0';
+      if (addr >= 'a' && addr <= 'z') return addr - 'a' + 10;
+      if (addr >= 'A' && addr <= 'Z') return addr - 'A' + 36;
+      return -1;
+    };
+
+    /*
+     *  Type of a command like 3D0!
+     */
+    static uint8_t commandType(const char *cmd) {
+      switch (cmd[0] == 0 ? 0 : cmd[1]) {
+        case '!':
+          return SDI12_COMMAND_ACKNOWLEDGE;
+        case 'I':
+          return SDI12_COMMAND_INFO;
+        case 'M':
+          return SDI12_COMMAND_MEASURE;
+        case 'C':
+          return SDI12_COMMAND_CONCURRENT;
+        case 'D':
+          return SDI12_COMMAND_DATA;
+        default:
+          return SDI12_COMMAND_OTHER;
+      }
+    };
+
+    void recordResponse(const char addr, const unsigned long latency) {
+      const int8_t idx = addressIndex(addr);
+      if (idx < 0) return;
+      Sdi12AddressStats &stats = addresses[idx];
+      const uint16_t clamped = latency < 0xffff ? latency : 0xffff;
+      stats.responses++;
+      stats.totalLatency += clamped;
+      if (clamped > stats.maxLatency) stats.maxLatency = clamped;
+    };
+
+    void recordTimeout(const char addr) {
+      const int8_t idx = addressIndex(addr);
+      if (idx >= 0) addresses[idx].timeouts++;
+    };
+
+    void recordTransaction(
+      const char *cmd, const unsigned long elapsed, const uint8_t attempts,
+      const boolean answered
+    ) {
+      Sdi12CommandStats &stats = commands[commandType(cmd)];
+      stats.transactions++;
+      stats.attempts += attempts;
+      if (!answered) stats.failures++;
+      stats.totalTime += elapsed;
+    };
+
+    /*
+     *  Deadline for the first character of a response from addr in ms, the
+     *  spec timeout until enough responses have been seen
+     */
+    uint16_t responseTimeout(const char addr) {
+      const int8_t idx = addressIndex(addr);
+      if (idx < 0 || addresses[idx].responses < SDI12_LATENCY_SAMPLES) {
+        return SDI12_RESPONSE_TIMEOUT;
+      }
+      const uint16_t ret = addresses[idx].maxLatency + SDI12_LATENCY_MARGIN;
+      return ret < SDI12_RESPONSE_TIMEOUT ? ret : SDI12_RESPONSE_TIMEOUT;
+    };
+
+    uint16_t averageLatency(const char addr) {
+      const int8_t idx = addressIndex(addr);
+      if (idx < 0 || addresses[idx].responses == 0) return 0;
+      return addresses[idx].totalLatency / addresses[idx].responses;
+    };
+
+    uint32_t averageTime(const uint8_t type) {
+      if (commands[type].transactions == 0) return 0;
+      return commands[type].totalTime / commands[type].transactions;
+    };
+
+    void reset() {
+      for (uint8_t i=0; i<SDI12_ADDRESSES; i++) {
+        addresses[i] = Sdi12AddressStats();
+      }
+      for (uint8_t i=0; i<SDI12_COMMAND_TYPES; i++) {
+        commands[i] = Sdi12CommandStats();
+      }
+    };
+};
+
+#endif
@@ -1,59 +1,84 @@
-# include <SDI12.h>
-# include "SDI12Wrapper.h"
+# include "sdi12Wrapper.h"
 # include <Arduino.h>
 
-# define DATA_PIN 21
-# define POWER_PIN -1
 
-
-SDI12 mySDI12(DATA_PIN);
-
-
-SDI12Measurement::SDI12Measurement() {
-  mySDI12.begin();
+SDI12Measurement::SDI12Measurement(Sdi12BusBase *busRef) {
+  _busRef = busRef;
+  _busRef->begin();
 };
 
 /*
  *  Count Values in a partial aD! response
  */
 uint16_t SDI12Measurement::countValues(char *bfr, size_t len) {
-  uint16_t ret = 0;
-  for(size_t i=0; i<len; i++) {
-    if (bfr[i] == '+' or bfr[i] == '-') ret++;
-  }
-  return ret;
+  return Sdi12Parser::count(bfr, len);
 }
 
 /*
- *  Read the SDI-12 buffer (after command)
+ *  Read a response up to its terminating <CR><LF>
+ *
+ *  - wait up to timeout ms for the first character and SDI12_CHAR_TIMEOUT
+ *  for each of the following ones
+ *  - returns the length without <CR><LF>, 0 if there was no complete
+ *  response
  */
-size_t SDI12Measurement::readSDI12Buffer(char *bfr) {
-  size_t i=0;
+size_t SDI12Measurement::readResponse(
+  char *bfr, const unsigned long timeout, unsigned long *latency
+) {
+  size_t i = 0;
+  boolean received = false;
+  const unsigned long start = millis();
+  unsigned long last = start;
   // terminate return for the case that there is no return
   // this is important for \0 terminated strings
   bfr[0] = 0;
-  while (mySDI12.available()) {
-    uint8_t c = mySDI12.read();
-    if ((c != '\n') && (c != '\r') && (i < SDI12_BUFFER_SIZE)) {
-      bfr[i] = c;
-    } else {
+  while (millis() - last < (received ? SDI12_CHAR_TIMEOUT : timeout)) {
+    if (!_busRef->available()) continue;
+    char c = _busRef->read();
+    last = millis();
+    if (!received) *latency = last - start;
+    received = true;
+    if (c == '\n') {
       bfr[i] = 0;
-      break;
+      return i;
     }
-    i++;
+    if (c != '\r' && i < SDI12_BUFFER_SIZE - 1) bfr[i++] = c;
   }
-  return i;
+  // cut short or garbled, retry
+  bfr[0] = 0;
+  return 0;
 };
 
 /*
- *  Send an SDI-12 command and wait for return
+ *  Send an SDI-12 command and wait for the response, retry if there is none
+ *
+ *  - the first attempt uses the deadline learned from earlier responses of
+ *  the address, retries the one of the spec
  */
 size_t SDI12Measurement::sendSDI12(char *cmd, char *bfr) {
-  mySDI12.clearBuffer();
-  delay(300);
-  mySDI12.sendCommand((char*) cmd);
-  delay(300);
-  return readSDI12Buffer(bfr);
+  const unsigned long start = millis();
+  unsigned long latency = 0;
+  size_t len = 0;
+  uint8_t attempts = 0;
+  while (len == 0 && attempts < SDI12_RETRIES) {
+    const unsigned long timeout = attempts == 0
+      ? stats.responseTimeout(cmd[0]) : SDI12_RESPONSE_TIMEOUT;
+    _busRef->clearBuffer();
+    // blocks until the break and the command are on the wire
+    _busRef->sendCommand(cmd);
+    len = readResponse(bfr, timeout, &latency);
+    if (len > 0) {
+      stats.recordResponse(cmd[0], latency);
+    } else {
+      stats.recordTimeout(cmd[0]);
+    }
+    attempts++;
+  }
+  stats.recordTransaction(cmd, millis() - start, attempts, len > 0);
+  // the response with <CR><LF>
+  Profiler::global().countBytes(
+    BUS_SDI12, strlen(cmd) * attempts + (len > 0 ? len + 2 : 0));
+  return len;
 };
 
 /*
@@ -61,6 +86,7 @@ size_t SDI12Measurement::sendSDI12(char *cmd, char *bfr) {
  *  are 8 byte characters
  */
 size_t SDI12Measurement::getChannels(char *bfr, const char maxChannel) {
+  ProfileScope scope(PHASE_SDI12_DISCOVERY);
   int idx = 0;
   char localBfr[128];
   for (char i='0'; i<=maxChannel; i++) {
@@ -73,6 +99,29 @@ size_t SDI12Measurement::getChannels(char *bfr, const char maxChannel) {
   return idx;
 };
 
+/*
+ *  CRC of vendor, model, version and serial number, the same sensor always
+ *  gives the same response
+ */
+uint32_t SDI12Measurement::identity(const char *response, const size_t len) {
+  return len > 0 ? Crc32::compute(response, len) : 0;
+}
+
+uint32_t SDI12Measurement::identify(const char addr) {
+  char bfr[SDI12_BUFFER_SIZE];
+  return identity(bfr, getInfo(bfr, addr));
+}
+
+boolean SDI12Measurement::verifyChannels(
+  const char *addrs, const uint32_t *ids, const uint8_t n
+) {
+  ProfileScope scope(PHASE_SDI12_DISCOVERY);
+  for (uint8_t i=0; i<n; i++) {
+    if (ids[i] == 0 || identify(addrs[i]) != ids[i]) return false;
+  }
+  return n > 0;
+}
+
 /*
  *  A simple method to check configuration
  */
@@ -96,66 +145,158 @@ size_t SDI12Measurement::getInfo(char *bfr, char addr) {
 /*
  *  Parse the sensor response after sending a command
  *
- *  - Response format address (1 byte), wait time in ms (3 byte),
+ *  - Response format address (1 byte), wait time in s (3 byte),
  *  number of values (2 byte), represented as text
- *  - add error handling
+ *  - a malformed response announces no values and no wait time
+ *  - a trailing <CR><LF> is ignored, loop_once keeps it
  */
-void SDI12Measurement::parseResponse(char *response, size_t len) {
-  char bfr[4];
-  // read in order of length, so that we always get /0 terminated
-  memcpy(bfr, response+4, 2);
-  numberOfValues = atoi((char*) bfr);
-  memcpy(bfr, response+1, 3);
-  retrievalTime = millis() + strtoul((char*) bfr, NULL, 10) * 1000;
+boolean SDI12Measurement::parseResponse(char *response, size_t len) {
+  char addr;
+  uint16_t seconds = 0;
+  uint8_t values = 0;
+  while (len > 0 && (response[len-1] == '\r' || response[len-1] == '\n')) len--;
+  boolean ret = Sdi12Parser::parseMeasurementResponse(
+    response, len, &addr, &seconds, &values);
+  numberOfValues = values;
+  retrievalTime = millis() + seconds * 1000UL;
+  return ret;
 }
 
-// return payLoad
-size_t SDI12Measurement::getPayload(char *bfr, char addr) {
+/*
+ *  Take a measurement and return the concatenated aD! responses, without
+ *  addresses, in bfr; the values are parsed as they arrive into values
+ */
+size_t SDI12Measurement::getPayload(
+  char *bfr, char addr, Sdi12Values *values
+) {
+  ProfileScope scope(PHASE_SDI12_MEASUREMENT);
   char cmd[] = {addr, 'C', '!', 0, 0};
   char rspns[SDI12_BUFFER_SIZE] = { 0 };
   size_t len = sendSDI12(cmd, rspns);
-  memcpy(bfr, rspns, SDI12_BUFFER_SIZE);
   parseResponse(rspns, len);
   // blocking
   while (retrievalTime > millis()) {};
-  // start response string with the address byte
-  // bfr[0] = addr;
+  return retrieveData(addr, numberOfValues, bfr, values);
+}
+
+/*
+ *  Request the data of a finished measurement with aD0! to aD7! until the
+ *  expected number of values has been received
+ */
+size_t SDI12Measurement::retrieveData(
+  const char addr, const uint16_t expected, char *bfr, Sdi12Values *values
+) {
+  char rspns[SDI12_BUFFER_SIZE] = { 0 };
+  size_t len;
   size_t resIndex = 0;
+  if (bfr != NULL) bfr[0] = 0;
+  if (values != NULL) values->count = 0;
+  valuesReceived = 0;
+  if (expected == 0) return 0;
   // request results
   // - iterate through ASCII code, representing 0..9 and
   // - issue commands x0D0! to x0D9!
-  valuesReceived = 0;
   for (char i=48; i<56; i++) {
     char cmd[] = {addr, 'D', i, '!', 0};
     len = sendSDI12(cmd, rspns);
-    memcpy(bfr+resIndex, rspns+1, len);
-    // the response is \0 terminated but we want to concatenate those returns
-    // for this reason we override the last character of the prior copy
-    resIndex += len;
-    if (resIndex > 0) { resIndex--; }
+    if (len == 0) break;
+    if (bfr != NULL) {
+      // skip the address, the copy includes the terminating \0
+      memcpy(bfr+resIndex, rspns+1, len);
+      resIndex += len - 1;
+    }
+    if (values != NULL) Sdi12Parser::parse(rspns, len, *values);
     // check whether we got all the values
     valuesReceived += countValues(rspns, len);
-    if (valuesReceived >= numberOfValues) break;
+    if (valuesReceived >= expected) break;
   }
-  // however we would like to maintain one \0 at the end
-  resIndex + 1;
   return resIndex;
 }
 
+/*
+ *  Start concurrent measurements, sensors keep measuring while we talk to
+ *  other sensors on the bus
+ *
+ *  - aC! responses are atttnn, i.e. seconds until the data is ready and
+ *  the number of values
+ *  - sensors that don't answer or don't announce values are not pending
+ */
+uint8_t SDI12Measurement::startMeasurements(const char *addrs, const uint8_t n) {
+  ProfileScope scope(PHASE_SDI12_MEASUREMENT);
+  char rspns[SDI12_BUFFER_SIZE] = { 0 };
+  char addr;
+  uint16_t seconds;
+  uint8_t ret = 0;
+  numberOfConcurrent = n < SDI12_MAX_SENSORS ? n : SDI12_MAX_SENSORS;
+  for (uint8_t i=0; i<numberOfConcurrent; i++) {
+    ConcurrentMeasurement &measurement = concurrent[i];
+    char cmd[] = {addrs[i], 'C', '!', 0};
+    size_t len = sendSDI12(cmd, rspns);
+    measurement.addr = addrs[i];
+    measurement.numberOfValues = 0;
+    seconds = 0;
+    measurement.pending = Sdi12Parser::parseMeasurementResponse(
+      rspns, len, &addr, &seconds, &measurement.numberOfValues)
+      && addr == addrs[i] && measurement.numberOfValues > 0;
+    measurement.readyTime = millis() + seconds * 1000UL;
+    if (measurement.pending) ret++;
+  }
+  return ret;
+}
+
+/*
+ *  Wait until the pending measurement that finishes first is ready
+ *
+ *  BLOCKING
+ */
+int8_t SDI12Measurement::waitForNextReady() {
+  ProfileScope scope(PHASE_SDI12_MEASUREMENT);
+  int8_t next = -1;
+  for (uint8_t i=0; i<numberOfConcurrent; i++) {
+    if (!concurrent[i].pending) continue;
+    // overflow safe comparison
+    if (next < 0 || static_cast<long>(
+      concurrent[i].readyTime - concurrent[next].readyTime) < 0
+    ) {
+      next = i;
+    }
+  }
+  if (next < 0) return -1;
+  while (static_cast<long>(millis() - concurrent[next].readyTime) < 0) {
+    delay(10);
+  }
+  concurrent[next].pending = false;
+  return next;
+}
+
+size_t SDI12Measurement::collectData(
+  const uint8_t idx, char *bfr, Sdi12Values *values
+) {
+  ProfileScope scope(PHASE_SDI12_MEASUREMENT);
+  numberOfValues = concurrent[idx].numberOfValues;
+  return retrieveData(concurrent[idx].addr, numberOfValues, bfr, values);
+}
+
+boolean SDI12Measurement::getValues(Sdi12Values &values, const char addr) {
+  getPayload(NULL, addr, &values);
+  return numberOfValues > 0 && values.count == numberOfValues;
+}
+
 /*
  * change sensor channel, success (true), false if channel already taken or
  * not confirmed
+ *
+ * - the sensor confirms with its new address; sendSDI12 retries a lost
+ *   response, the retry goes to the old address, so without a confirmation
+ *   the new address is asked whether the sensor moved anyway
  */
 boolean SDI12Measurement::setChannel(char oldAddr, char newAddr) {
-  boolean ret = 0;
-  char cmd[] = {oldAddr, 'A', newAddr, '!'};
-  char bfr[128];
-  size_t len = getInfo(bfr, newAddr);
-  if (len == 0) {
-    sendSDI12(cmd, bfr);
-    if (bfr[0] = newAddr) ret = 1;
-  }
-  return ret;
+  char cmd[] = {oldAddr, 'A', newAddr, '!', 0};
+  char bfr[SDI12_BUFFER_SIZE];
+  if (oldAddr == newAddr || getInfo(bfr, newAddr) > 0) return false;
+  const size_t len = sendSDI12(cmd, bfr);
+  if (len > 0 && bfr[0] == newAddr) return true;
+  return getInfo(bfr, newAddr) > 0;
 }
 
 /*
@@ -175,6 +316,7 @@ void SDI12Measurement::takeMeasurement(char channel) {
   measureSensor = channel;
   measurementStep = 1;
   measurementReady = false;
+  valuesReceived = 0;
   memset(measurementBfr, 0, 256);
 }
 
@@ -205,10 +347,11 @@ void SDI12Measurement::loop_once() {
   }
 
   if (measurementStep > 2 && waitForRetrieval && responseReady) {
-    if (strlen(responseBfr) > 2) {
+    // address and <CR><LF> are not part of the values
+    if (strlen(responseBfr) > 3) {
       memcpy(
         measurementBfr+strlen(measurementBfr), responseBfr+1,
-        strlen(responseBfr)-2);
+        strlen(responseBfr)-3);
       valuesReceived += countValues(responseBfr, strlen(responseBfr));
       if (valuesReceived >= numberOfValues) {
         measurementReady = true;
@@ -223,19 +366,19 @@ void SDI12Measurement::loop_once() {
   }
 
   if (command[0] != 0) {
-    mySDI12.clearBuffer();
+    _busRef->clearBuffer();
     sendCommandTime = time + 300;
   }
 
   if (command[0] != 0 && sendCommandTime > time) {
-    mySDI12.sendCommand((char*) command);
+    _busRef->sendCommand(command);
     waitForResponse = true;
     memset(command, 0, 8);
   }
 
   if (waitForResponse) {
-    if (mySDI12.available()) {
-      char c = mySDI12.read();
+    if (_busRef->available()) {
+      char c = _busRef->read();
       if (c!=0) responseBfr[strlen(responseBfr)] = c;
       if (c=='\n') {
         responseReady = true;
@@ -16,11 +16,43 @@
   */
 
  #include <Arduino.h>
+ #ifndef _SDI12_PARSER_H_
+ #include "sdi12Parser.h"
+ #endif
+ #ifndef _SDI12_STATS_H_
+ #include "sdi12Stats.h"
+ #endif
+ #ifndef _SDI12_BUS_H_
+ #include "sdi12Bus.h"
+ #endif
+ #ifndef _PROFILER_H_
+ #include "profiler.h"
+ #endif
+ #ifndef _CRC32_H_
+ #include "crc32.h"
+ #endif
+
+ // addresses 0 to 9
+ #define SDI12_MAX_SENSORS 10
+
+ // a measurement started with aC!, see startMeasurements
+ typedef struct {
+   char addr;
+   // announced in the aC! response
+   uint8_t numberOfValues;
+   unsigned long readyTime;
+   boolean pending;
+ } ConcurrentMeasurement;
 
  class SDI12Measurement {
    private:
-     size_t readSDI12Buffer(char *bfr);
+     Sdi12BusBase *_busRef;
+     size_t readResponse(
+       char *bfr, const unsigned long timeout, unsigned long *latency);
      size_t sendSDI12(char *cmd, char *bfr);
+     size_t retrieveData(
+       const char addr, const uint16_t expected, char *bfr,
+       Sdi12Values *values);
    public:
      // state variables
      boolean measurementReady = false;
@@ -37,7 +69,12 @@
      char measurementBfr[256] = { 0 };
      boolean responseReady = false;
      char command[8] = { 0 };
-     SDI12Measurement();
+     // concurrent measurements, in the order of the addresses
+     ConcurrentMeasurement concurrent[SDI12_MAX_SENSORS];
+     uint8_t numberOfConcurrent = 0;
+     // transaction timing per address and command type
+     Sdi12Stats stats;
+     SDI12Measurement(Sdi12BusBase *busRef);
      void debug();
      // count values in a response string obtained with the aD! command
      uint16_t countValues(char *bfr, const size_t len);
@@ -48,10 +85,28 @@
      size_t getInfo(char *bfr, const char addr='?');
      // return available channels/address
      size_t getChannels(char *bfr, const char maxChannel='9');
-     // read measurements from a channel/address
-     size_t getPayload(char *bfr, const char addr=0);
-     // parse response for time
-     void parseResponse(char *response, size_t len);
+     // identity of a sensor from its aI! response, 0 if there was none
+     static uint32_t identity(const char *response, const size_t len);
+     uint32_t identify(const char addr);
+     // true if the sensors at addrs still have the identities ids, one aI!
+     // per address instead of probing all of them
+     boolean verifyChannels(const char *addrs, const uint32_t *ids, const uint8_t n);
+     // read measurements from a channel/address, also as numbers if values
+     // is given; bfr may be NULL if only the numbers are needed
+     size_t getPayload(char *bfr, const char addr=0, Sdi12Values *values=NULL);
+     // read measurements as numbers, false if the sensor returned fewer or
+     // more values than announced in the aC! response
+     boolean getValues(Sdi12Values &values, const char addr);
+     // start measurements on all addresses at once with aC!, returns the
+     // number of sensors measuring
+     uint8_t startMeasurements(const char *addrs, const uint8_t n);
+     // wait for the next sensor to be ready, returns its index in addrs or
+     // -1 if all measurements have been collected
+     int8_t waitForNextReady();
+     // read the data of a concurrent measurement, like getPayload
+     size_t collectData(const uint8_t idx, char *bfr, Sdi12Values *values=NULL);
+     // parse response for time and number of values, false if malformed
+     boolean parseResponse(char *response, size_t len);
      // update channel, return success 1 or failure 0
      boolean setChannel(char oldAddr, char newAddr);
      // start non-blocking implementation
@@ -0,0 +1,152 @@
+/*
+ *  Field definitions of the sensors we are deploying, keyed by SDI-12 address
+ *
+ *  - the one place that defines what a channel contains: names, units,
+ *    precision, valid range, and how a field is aggregated. The tables in
+ *    payload_decoder/decoder.js are generated from it, see
+ *    ../host/generateSchema.cpp, a ctest fails if they differ.
+ *  - decimals determines the fixed-point precision used by the binary message
+ *    encoding, taken from what the sensors actually report
+ *  - FIELD_ACCUMULATOR marks counts and amounts since the last measurement,
+ *    their sum is what matters when readings are aggregated
+ *  - FIELD_DIRECTION marks angles in degrees, 359 and 1 are 2 apart and
+ *    average to 0 rather than 180
+ *  - readings outside of min and max are sensor errors
+ *  - everything is constexpr, the table is checked at compile time and a
+ *    channel is found by its offset from SENSOR_FIRST_CHANNEL
+ */
+#ifndef _SENSOR_SCHEMA_H_
+#define _SENSOR_SCHEMA_H_
+
+#include <Arduino.h>
+
+// how a field is aggregated, see aggregate.h
+#define FIELD_GAUGE 0
+#define FIELD_ACCUMULATOR 1
+#define FIELD_DIRECTION 2
+// SDI-12 address of the first sensor, channels have to be consecutive
+#define SENSOR_FIRST_CHANNEL 50
+
+
+typedef struct {
+  const char *name;
+  const char *unit;
+  uint8_t decimals;
+  uint8_t aggregation;
+  // valid range in the unit of the field
+  float min;
+  float max;
+} FieldSchema;
+
+typedef struct {
+  // SDI-12 address as ASCII code, e.g. 51 for '3'
+  uint8_t channel;
+  uint8_t numberOfFields;
+  const FieldSchema *fields;
+} SensorSchema;
+
+
+template <size_t N>
+constexpr SensorSchema sensorSchema(
+  const uint8_t channel, const FieldSchema (&fields)[N]
+) {
+  return {channel, N, fields};
+}
+
+// In-Situ Level Troll
+static constexpr FieldSchema levelTrollFields[] = {
+  {"pressure", "psi", 4, FIELD_GAUGE, -20, 1000},
+  {"waterTmp", "C", 4, FIELD_GAUGE, -5, 50}};
+
+// Meter ATMOS 41 / Campbell Scientific ClimaVue 50
+static constexpr FieldSchema atmos41Fields[] = {
+  {"solarFluxDensity_W_per_m2", "W/m2", 0, FIELD_GAUGE, 0, 1750},
+  {"precip_mm", "mm", 3, FIELD_ACCUMULATOR, 0, 400},
+  {"lightng_ct", "count", 0, FIELD_ACCUMULATOR, 0, 65535},
+  {"lightngDist_km", "km", 0, FIELD_GAUGE, 0, 40},
+  {"windSpeed_m_per_s", "m/s", 2, FIELD_GAUGE, 0, 30},
+  {"windDir_deg", "deg", 1, FIELD_DIRECTION, 0, 360},
+  {"maxWindSp_m_per_s", "m/s", 2, FIELD_GAUGE, 0, 60},
+  {"airTmp_c", "C", 1, FIELD_GAUGE, -50, 60},
+  {"vaporPr_kPa", "kPa", 2, FIELD_GAUGE, 0, 47},
+  {"barometricPr_kPa", "kPa", 2, FIELD_GAUGE, 50, 110},
+  {"relHumidity_0_1", "1", 3, FIELD_GAUGE, 0, 1},
+  {"humSensorTemp_C", "C", 1, FIELD_GAUGE, -50, 60},
+  {"tiltNS_deg", "deg", 1, FIELD_GAUGE, -90, 90},
+  {"tiltWE_deg", "deg", 1, FIELD_GAUGE, -90, 90},
+  {"compass_unused", "deg", 0, FIELD_DIRECTION, 0, 360},
+  {"windSpeedN_m_per_s", "m/s", 2, FIELD_GAUGE, -60, 60},
+  {"windSpeedE_m_per_s", "m/s", 2, FIELD_GAUGE, -60, 60},
+  {"windSpeedMax_per_s", "m/s", 2, FIELD_GAUGE, 0, 60}};
+
+// TekBox leaf wetness
+static constexpr FieldSchema leafWetnessFields[] = {
+  {"leafWetness_percent", "%", 2, FIELD_GAUGE, 0, 100}};
+
+// Meter TEROS 12
+static constexpr FieldSchema teros12Fields[] = {
+  {"calibratedCountsVWC", "count", 2, FIELD_GAUGE, 0, 5000},
+  {"soilTemp_C", "C", 1, FIELD_GAUGE, -40, 60},
+  {"conductivity", "uS/cm", 0, FIELD_GAUGE, 0, 20000}};
+
+static constexpr SensorSchema sensorSchemas[] = {
+  sensorSchema(50, levelTrollFields),
+  sensorSchema(51, atmos41Fields),
+  sensorSchema(52, leafWetnessFields),
+  sensorSchema(53, teros12Fields),
+  sensorSchema(54, teros12Fields),
+  sensorSchema(55, teros12Fields)};
+
+#define NUMBER_OF_SENSOR_SCHEMAS (sizeof(sensorSchemas) / sizeof(SensorSchema))
+
+
+/*
+ *  Compile time checks of the table, C++11 constexpr functions are a single
+ *  return statement
+ */
+constexpr boolean validFields(const FieldSchema *fields, const uint8_t n) {
+  return n == 0 || (
+    fields[0].decimals <= 9 && fields[0].min < fields[0].max &&
+    (fields[0].aggregation == FIELD_GAUGE ||
+      fields[0].aggregation == FIELD_ACCUMULATOR ||
+      fields[0].aggregation == FIELD_DIRECTION) &&
+    validFields(fields + 1, n - 1));
+}
+
+constexpr boolean validSchemas(const size_t i) {
+  return i == NUMBER_OF_SENSOR_SCHEMAS || (
+    sensorSchemas[i].channel == SENSOR_FIRST_CHANNEL + i &&
+    sensorSchemas[i].numberOfFields > 0 &&
+    validFields(sensorSchemas[i].fields, sensorSchemas[i].numberOfFields) &&
+    validSchemas(i + 1));
+}
+
+static_assert(validSchemas(0),
+  "sensorSchemas must have consecutive channels and valid fields");
+
+
+/*
+ *  Return the schema for a channel or NULL if we don't know the sensor
+ */
+inline const SensorSchema *findSensorSchema(uint8_t channel) {
+  if (channel < SENSOR_FIRST_CHANNEL) return NULL;
+  if (channel >= SENSOR_FIRST_CHANNEL + NUMBER_OF_SENSOR_SCHEMAS) return NULL;
+  return &sensorSchemas[channel - SENSOR_FIRST_CHANNEL];
+}
+
+/*
+ *  Whether a fixed point value with the precision of the field is within
+ *  its valid range
+ *
+ *  - the bounds are scaled in double and rounded to the precision of the
+ *    field, compared in float a value beyond 2^24 lost its last digits
+ */
+inline boolean inRange(const FieldSchema &field, const int64_t value) {
+  static const double powers[] = {
+    1, 10, 100, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+  const double scale = powers[field.decimals];
+  return value >= llround(field.min * scale) &&
+    value <= llround(field.max * scale);
+}
+
+#endif
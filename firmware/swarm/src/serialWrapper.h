@@ -8,6 +8,10 @@
 #define _SERIAL_WRAPPER_H_
 #endif
 
+ #ifndef _PROFILER_H_
+ #include "profiler.h"
+ #endif
+
  // Base class
  class SerialWrapperBase {
    public:
@@ -30,7 +34,16 @@
       _serialRef->begin(speed);
     };
     boolean available() { return _serialRef->available(); };
-    char read() { return _serialRef->read(); };
-    void write(byte character) { _serialRef->write(character); };
-    size_t write(char *bfr, size_t len) { return _serialRef->write(bfr, len); }
+    char read() {
+      Profiler::global().countBytes(BUS_TILE_RX, 1);
+      return _serialRef->read();
+    };
+    void write(byte character) {
+      Profiler::global().countBytes(BUS_TILE_TX, 1);
+      _serialRef->write(character);
+    };
+    size_t write(char *bfr, size_t len) {
+      Profiler::global().countBytes(BUS_TILE_TX, len);
+      return _serialRef->write(bfr, len);
+    }
  };
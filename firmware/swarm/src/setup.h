@@ -8,7 +8,7 @@
 #ifndef _SDI12_WRAPPER_H_
 #include "src/sdi12Wrapper.h"
 #endif
-#ifndef _SDI12_WRAPPER_H_
+#ifndef _NODE_PERSISTENT_MEMORY_
 #include "src/memory.h"
 #endif
 
@@ -62,32 +62,27 @@ class SetupHelpers {
         newChannel = availableChannels[idx];
         while (true) {
           // maybe we can consilidate in a screen function using a struct
-          dspl.setCursor(90, 10);
-          dspl.setTextColor(SH110X_BLACK);
-          // the display uses an odd character page
-          // see here https://learn.adafruit.com/assets/103682
-          dspl.write(218);
-          dspl.setTextColor(SH110X_WHITE);
+          // a character replaces the one in its cell of the console
           dspl.setCursor(90, 10);
           dspl.printBuffer(availableChannels+idx, 1);
           dspl.setCursor(90, 28);
-          dspl.setTextColor(SH110X_BLACK);
-          dspl.write(218);
-          dspl.setTextColor(SH110X_WHITE);
-          dspl.setCursor(90, 28);
           dspl.print(newChannel);
-          if (dspl.buttonDebounced(BUTTON_A)) {
+          // sleeps until a button is pressed
+          ButtonEvent event;
+          if (!dspl.nextEvent(event, BUTTON_WAIT_FOREVER)) continue;
+          if (event.type == BUTTON_RELEASED) continue;
+          if (event.button == BUTTON_A) {
             idx++;
             if (idx == numberOfChannels) { idx = 0; }
             newChannel = availableChannels[idx];
           }
-          if (dspl.buttonDebounced(BUTTON_B)) {
+          if (event.button == BUTTON_B) {
             newChannel++;
             if (newChannel > 57) {
               newChannel = 48;
             }
           }
-          if (dspl.buttonDebounced(BUTTON_C)) {
+          if (event.button == BUTTON_C && event.type == BUTTON_PRESSED) {
             if (availableChannels[idx] == newChannel ||
               sdi12.setChannel(availableChannels[idx], newChannel)
             ) {
@@ -105,11 +100,10 @@ class SetupHelpers {
     /*
      *  User menu/screen to change measurement frequency
      */
-    static void setupFrequency(DisplayWrapper &dspl) {
-      PersistentMemory mem;
+    static void setupFrequency(DisplayWrapper &dspl, PersistentMemory &mem) {
       char bfr[16];
       while (true) {
-        uint32_t current = mem.getMeasurementFrequency(3600);
+        uint32_t current = mem.readFrequency();
         uint32_t updated = current;
         uint32_t updated_old = 0;
         dspl.resetDisplay();
@@ -128,21 +122,21 @@ class SetupHelpers {
         while (true) {
           if (updated != updated_old) {
             dspl.setCursor(80, 28);
-            dspl.setTextColor(SH110X_BLACK);
-            char del[6] = { 218, 218, 218, 218, 218, 218 };
-            dspl.printBuffer(del);
-            dspl.setTextColor(SH110X_WHITE);
-            dspl.setCursor(80, 28);
-            // change display only if changed to avoid flicker
-            sprintf(bfr, "%d", updated);
-            dspl.printBuffer(bfr);
+            // change display only if changed to avoid flicker, the spaces
+            // overwrite the digits of a longer value
+            int len = sprintf(bfr, "%-6d", updated);
+            dspl.printBuffer(bfr, len);
           }
           updated_old = updated;
-          if (dspl.buttonDebounced(BUTTON_A)) updated += 60;
-          if (dspl.buttonDebounced(BUTTON_B)) updated -= 60;
+          // sleeps until a button is pressed, holding A or B repeats
+          ButtonEvent event;
+          if (!dspl.nextEvent(event, BUTTON_WAIT_FOREVER)) continue;
+          if (event.type == BUTTON_RELEASED) continue;
+          if (event.button == BUTTON_A) updated += 60;
+          if (event.button == BUTTON_B) updated -= 60;
           if (updated > 86400) updated = 86400;
           if (updated < 60) updated = 60;
-          if (dspl.buttonDebounced(BUTTON_C)) {
+          if (event.button == BUTTON_C && event.type == BUTTON_PRESSED) {
             mem.writeFrequency(updated);
             if (updated != mem.readFrequency()) {
               dspl.setCursor(80, 46);
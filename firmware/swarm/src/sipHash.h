@@ -0,0 +1,65 @@
+/*
+ *  SipHash-2-4, a keyed hash for authenticating short messages
+ *
+ *  - 128 bit key, 64 bit tag; made for short inputs, cheaper than an HMAC
+ *    and needs no crypto library
+ *  - see https://www.aumasson.jp/siphash/siphash.pdf, the test vector of
+ *    appendix A is in tests/testDownlink
+ */
+#ifndef _SIP_HASH_H_
+#define _SIP_HASH_H_
+
+#include <Arduino.h>
+
+#define SIP_HASH_KEY_LENGTH 16
+
+
+class SipHash {
+  private:
+    static uint64_t rotate(const uint64_t x, const uint8_t bits) {
+      return (x << bits) | (x >> (64 - bits));
+    };
+
+    static uint64_t readLittleEndian(const uint8_t *bytes) {
+      uint64_t ret = 0;
+      for (uint8_t i=0; i<8; i++) ret |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+      return ret;
+    };
+
+    static void round(uint64_t *v) {
+      v[0] += v[1]; v[1] = rotate(v[1], 13); v[1] ^= v[0]; v[0] = rotate(v[0], 32);
+      v[2] += v[3]; v[3] = rotate(v[3], 16); v[3] ^= v[2];
+      v[0] += v[3]; v[3] = rotate(v[3], 21); v[3] ^= v[0];
+      v[2] += v[1]; v[1] = rotate(v[1], 17); v[1] ^= v[2]; v[2] = rotate(v[2], 32);
+    };
+
+    static void compress(uint64_t *v, const uint64_t m) {
+      v[3] ^= m;
+      round(v);
+      round(v);
+      v[0] ^= m;
+    };
+
+  public:
+    static uint64_t compute(const uint8_t *key, const void *data, const size_t len) {
+      const uint8_t *bytes = static_cast<const uint8_t*>(data);
+      const uint64_t k0 = readLittleEndian(key);
+      const uint64_t k1 = readLittleEndian(key + 8);
+      uint64_t v[4] = {
+        k0 ^ 0x736f6d6570736575ULL, k1 ^ 0x646f72616e646f6dULL,
+        k0 ^ 0x6c7967656e657261ULL, k1 ^ 0x7465646279746573ULL};
+      const size_t blocks = len / 8;
+      for (size_t i=0; i<blocks; i++) compress(v, readLittleEndian(bytes + 8 * i));
+      // the remaining bytes and the length in the last block
+      uint64_t last = static_cast<uint64_t>(len & 0xFF) << 56;
+      for (size_t i=0; i<len % 8; i++) {
+        last |= static_cast<uint64_t>(bytes[8 * blocks + i]) << (8 * i);
+      }
+      compress(v, last);
+      v[2] ^= 0xFF;
+      for (uint8_t i=0; i<4; i++) round(v);
+      return v[0] ^ v[1] ^ v[2] ^ v[3];
+    };
+};
+
+#endif
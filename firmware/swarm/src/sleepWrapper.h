@@ -0,0 +1,146 @@
+/*
+ *  Wrapper around the ESP32 sleep modes to allow for simulating deep sleep
+ *  on the host
+ *
+ *  - light sleep keeps RAM and returns, deep sleep only keeps RTC memory and
+ *    the firmware starts over with setup() on wake-up
+ *  - RetainedState holds what loop() needs to continue after deep sleep. It
+ *    is sealed with a checksum so that a cold start or a firmware with a
+ *    different layout is never mistaken for a wake-up.
+ */
+#ifndef _SLEEP_WRAPPER_H_
+#define _SLEEP_WRAPPER_H_
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <esp_sleep.h>
+#ifndef _BATCH_H_
+#include "batch.h"
+#endif
+#ifndef _BUDGET_H_
+#include "budget.h"
+#endif
+#ifndef _AGGREGATE_H_
+#include "aggregate.h"
+#endif
+#ifndef _LOCAL_CLOCK_H_
+#include "localClock.h"
+#endif
+
+#define RETAINED_STATE_MAGIC 0x53574d31
+
+
+/*
+ *  Kept in RTC memory, no default member initializers since those would
+ *  run on every wake-up
+ */
+typedef struct {
+  uint32_t magic;
+  // deep sleep wake-ups since the last cold start
+  uint32_t wakeups;
+  int messageCounter;
+  unsigned long nextScheduled;
+  unsigned long nextSample;
+  unsigned long measurementFrequencyS;
+  char availableChannels[10];
+  int numberOfChannels;
+  // MessageBatch is trivially copyable
+  uint8_t batch[sizeof(MessageBatch)];
+  // MessageBudget as well
+  uint8_t budget[sizeof(MessageBudget)];
+  // and MessageAggregate
+  uint8_t aggregate[sizeof(MessageAggregate)];
+  // the tile sleeps as well, see TileSleep
+  boolean tileAsleep;
+  // LocalClock, suspended
+  uint8_t clock[sizeof(LocalClock)];
+  uint32_t checksum;
+} RetainedState;
+
+
+ // Base class
+ class SleepWrapperBase {
+   public:
+     virtual ~SleepWrapperBase() {};
+     // true if the firmware started from deep sleep rather than power on
+     // or reset
+     virtual boolean wokeFromDeepSleep() { return false; };
+     virtual void lightSleep(unsigned long seconds) {};
+     // does not return on the device
+     virtual void deepSleep(unsigned long seconds) {};
+     // RTC memory, NULL if there is none
+     virtual RetainedState *retained() { return NULL; };
+
+     /*
+      *  FNV-1a over everything but the checksum
+      */
+     static uint32_t checksum(const RetainedState &state) {
+       const uint8_t *bytes = reinterpret_cast<const uint8_t*>(&state);
+       uint32_t ret = 2166136261UL;
+       for (size_t i=0; i<offsetof(RetainedState, checksum); i++) {
+         ret = (ret ^ bytes[i]) * 16777619UL;
+       }
+       return ret;
+     };
+
+     void save(const RetainedState &state) {
+       RetainedState *rtc = retained();
+       if (rtc == NULL) return;
+       *rtc = state;
+       rtc->magic = RETAINED_STATE_MAGIC;
+       rtc->checksum = checksum(*rtc);
+     };
+
+     /*
+      *  Get the state saved before deep sleep, false after a cold start
+      */
+     boolean restore(RetainedState &state) {
+       RetainedState *rtc = retained();
+       if (rtc == NULL || !wokeFromDeepSleep()) return false;
+       if (rtc->magic != RETAINED_STATE_MAGIC || rtc->checksum != checksum(*rtc)) {
+         return false;
+       }
+       rtc->wakeups++;
+       rtc->checksum = checksum(*rtc);
+       state = *rtc;
+       return true;
+     };
+
+     /*
+      *  Seconds to sleep at tileTime so that we are awake lead seconds
+      *  before the first time report after nextEvent, reports are aligned
+      *  to multiples of interval like the tile sends them
+      */
+     static unsigned long sleepDuration(
+       const unsigned long tileTime, const unsigned long nextEvent,
+       const unsigned long interval, const unsigned long lead
+     ) {
+       const unsigned long wakeTime = (nextEvent / interval + 1) * interval - lead;
+       return wakeTime > tileTime ? wakeTime - tileTime : 0;
+     };
+ };
+
+ // Inherited class
+ class SleepWrapper: public SleepWrapperBase {
+  private:
+    RetainedState *_rtcRef;
+  public:
+    // rtcRef has to be declared RTC_DATA_ATTR
+    SleepWrapper(RetainedState *rtcRef) {
+      _rtcRef = rtcRef;
+    };
+    boolean wokeFromDeepSleep() {
+      return esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED;
+    };
+    void lightSleep(unsigned long seconds) {
+      esp_sleep_enable_timer_wakeup(seconds * 1000000ULL);
+      esp_light_sleep_start();
+    };
+    void deepSleep(unsigned long seconds) {
+      esp_sleep_enable_timer_wakeup(seconds * 1000000ULL);
+      esp_deep_sleep_start();
+    };
+    RetainedState *retained() { return _rtcRef; };
+ };
+
+#endif
@@ -10,6 +10,15 @@
 const unsigned long READ_TIMEOUT = 100; // ms
 // time after which we don't wait any longer for a command response
 const unsigned long COMMAND_TIMEOUT = 5000; // ms
+// idle time between checks of the UART, the UART buffer takes the bytes
+// arriving in the meantime
+const unsigned long POLL_INTERVAL = 1; // ms
+// getLine copies up to this many characters
+const size_t MAX_LINE_LENGTH = 255;
+// $DT @ sent to a tile that does not answer after waking up
+const uint8_t WAKE_UP_TRIES = 3;
+// a time report has a resolution of a second and needs a few ms on the wire
+const uint32_t REPORT_WIDTH = 1010; // ms
 
 
 /*
@@ -30,6 +39,52 @@ boolean validateTimeStruct(struct tm tme) {
 }
 
 
+typedef struct {
+  SwarmNode *node;
+  unsigned long time;
+  // the UART was empty before the report, i.e. it did not wait in there
+  boolean idle;
+  boolean fresh;
+  unsigned long received;
+} TimeReport;
+
+void receiveBoot(void *context, const uint8_t status, const NmeaLine *line) {
+  BootState *state = static_cast<BootState*>(context);
+  NmeaSentence sentence;
+  // the display does not modify the buffer
+  state->display->printBuffer(const_cast<char*>(line->text), line->len);
+  if (!NmeaDecoder::decode(line->text, line->len, &sentence)) return;
+  if (sentence.type == NMEA_M138 && sentence.numberOfFields == 2
+    && NmeaDecoder::fieldEquals(sentence.fields[0], "BOOT")
+    && NmeaDecoder::fieldEquals(sentence.fields[1], "RUNNING")
+  ) {
+    state->running = true;
+  }
+}
+
+void receiveSent(void *context, const uint8_t status, const NmeaLine *line) {
+  SentMessages *sent = static_cast<SentMessages*>(context);
+  NmeaSentence sentence;
+  if (!NmeaDecoder::decode(line->text, line->len, &sentence)) return;
+  if (sentence.type != NMEA_TD || sentence.result != NMEA_REPORT) return;
+  // the oldest one is left to the hold time
+  if (sent->count == TILE_MAX_SENT) {
+    memmove(sent->ids, sent->ids + 1, (TILE_MAX_SENT - 1) * sizeof(sent->ids[0]));
+    sent->count--;
+  }
+  sent->ids[sent->count++] = sentence.signal.id;
+}
+
+void receiveTime(void *context, const uint8_t status, const NmeaLine *line) {
+  TimeReport *report = static_cast<TimeReport*>(context);
+  unsigned long time = report->node->parseTime(line->text, line->len);
+  if (time == 0) return;
+  report->time = time;
+  report->fresh = report->idle;
+  report->received = millis();
+}
+
+
 /*
  *  Constructor
  *
@@ -39,10 +94,16 @@ boolean validateTimeStruct(struct tm tme) {
 SwarmNode::SwarmNode(
   DisplayWrapperBase *wrappedDisplayObject,
   SerialWrapperBase *wrappedSerialObject, const boolean devMode)
+  : reader(wrappedSerialObject), commands(wrappedSerialObject)
 {
   _wrappedDisplayRef = wrappedDisplayObject;
   _wrappedSerialRef = wrappedSerialObject;
   dev = devMode;
+  _boot.display = wrappedDisplayObject;
+  _boot.running = false;
+  _sent.count = 0;
+  // reports of messages the tile sent come at any time
+  commands.addListener("$TD SENT", receiveSent, &_sent);
 };
 
 /*
@@ -51,6 +112,7 @@ SwarmNode::SwarmNode(
  *  - Issue a reset to the SWARM tile immediately. Tile will not be ready to
  *  process this command if starting up but it will restart if already
  *  running. This is just a simply way to get to a known state.
+ *  - unless reset() was called before, then this waits for that reset
  *
  *  NOT INCLUDED IN TESTS
  */
@@ -60,52 +122,63 @@ void SwarmNode::begin(const unsigned long timeReportingFrequency) {
   char bfr[256];
   char timeFrequencyBfr[16];
   size_t len=0;
-  // issue tile reset
-  len = tileCommand("$RS", 3, bfr);
+  TileResponse response;
+  if (!_resetting) reset();
   // BLOCKING: wait for indication that tile is running
-  while (true) {
-    len = getLine(bfr);
-    if (len) _wrappedDisplayRef->printBuffer(bfr, len);
-    delay(500);
-    if (parseLine(bfr, len, "BOOT,RUNNING", 12) > -1) break;
+  while (!_boot.running) {
+    if (poll() == 0) delay(POLL_INTERVAL);
   }
+  commands.removeListener(receiveBoot, &_boot);
+  _resetting = false;
   // TODO: use compile flags instead of program flow for this
   // IF dev=true delete all unsent messages to not use up 720 monthly included
   // messages while developing and testing
   if (dev) {
     _wrappedDisplayRef->printBuffer("DEV MODE:\nDELETING OLD MESSAGES");
-    len = tileCommand("$MT D=U", 7, bfr);
+    queueCommand("$MT D=U", 7);
   }
-  // configure the frequency at which a time report is issued
+  // configure the frequency at which a time report is issued, all
+  // configuration commands are in flight at the same time
   _wrappedDisplayRef->printBuffer("CONFIGURE");
   len = sprintf(
-    timeFrequencyBfr, "$DT %i", timeReportingFrequency);
+    timeFrequencyBfr, "$DT %lu", timeReportingFrequency);
+  queueCommand(timeFrequencyBfr, len, NULL, NULL, NULL, "$DT OK");
   // drastically reduce the number of unsolicited messages
-  len = tileCommand("$RT 3600", 8, bfr);
-  len = tileCommand("$GN 3600", 8, bfr);
-  len = tileCommand("$GS 3600", 8, bfr);
-  _wrappedDisplayRef->printBuffer(bfr, len);
+  queueCommand("$RT 3600", 8, NULL, NULL, NULL, "$RT OK");
+  queueCommand("$GN 3600", 8, NULL, NULL, NULL, "$GN OK");
+  response.bfr = bfr;
+  response.size = sizeof(bfr);
+  queueCommand("$GS 3600", 8, &response, NULL, NULL, "$GS OK");
+  waitForCommands();
+  _wrappedDisplayRef->printBuffer(bfr, response.len);
   // TODO: this is blocking which is nasty
   // wait until we obtain a valid time message
   // BLOCKING
   while (waitForTimeStamp() == 0);
 };
 
+/*
+ *  Issue a tile reset and return, see begin()
+ */
+void SwarmNode::reset() {
+  _boot.display = _wrappedDisplayRef;
+  _boot.running = false;
+  // newer tile firmware reports $M138 instead of $TILE
+  commands.addListener("$TILE", receiveBoot, &_boot);
+  commands.addListener("$M138", receiveBoot, &_boot);
+  queueCommand("$RS", 3);
+  _resetting = true;
+}
+
 /*
  *  Add NMEA checksum and new line to command
  */
 size_t SwarmNode::cleanCommand(
   const char *command, const size_t len, char *bfr
 ) {
-  // sprintf returns trailing \0 terminator
-  char hexbfr[3];
-  memcpy(bfr, command, len);
-  bfr[len] = '*';
-  sprintf(hexbfr, "%02x", nmeaChecksum(command, len));
-  // don't use \0 terminators
-  memcpy(bfr+len+1, hexbfr, 2);
-  memcpy(bfr+len+3, "\n", 1);
-  return len + 4;
+  CommandWriter writer(bfr, len + COMMAND_CHECKSUM_LENGTH);
+  writer.append(command, len);
+  return writer.finish();
 }
 
 /*
@@ -115,35 +188,44 @@ size_t SwarmNode::cleanCommand(
  *  prone to weird conditions
  */
 void SwarmNode::emptySerialBuffer() {
-  char bfr[256];
-  while (getLine(bfr) > 0);
+  while (nextLine() != NULL) reader.release();
 }
 
 /*
- *  get a line from _serialRef
+ *  get a line from _serialRef, lines longer than MAX_LINE_LENGTH are cut
  */
 size_t SwarmNode::getLine(char *bfr) {
-  size_t idx = 0;
-  char character;
+  const NmeaLine *line = nextLine();
+  if (line == NULL) return 0;
+  size_t len = line->len < MAX_LINE_LENGTH ? line->len : MAX_LINE_LENGTH;
+  memcpy(bfr, line->text, len);
+  reader.release();
+  return len;
+}
+
+/*
+ *  Oldest line received, call reader.release() when done with it
+ *
+ *  - returns NULL if nothing has been received
+ *  - waits for the rest of a line that has started, a line is considered
+ *  complete if nothing arrives for READ_TIMEOUT
+ */
+const NmeaLine *SwarmNode::nextLine() {
   unsigned long startMillis = millis();
-  if (_wrappedSerialRef->available()) {
-    do {
-      character = _wrappedSerialRef->read();
-      // if no character is in the Serial cache it will return 255
-      // this is currently blocking until a newline character appears on
-      // the Serial
-      if (character != 255) {
-        bfr[idx] = character;
-        idx ++;
-        startMillis = millis();
-      }
-    // return if
-    // - EOL
-    // - timed out
-    // - terminate also after 255 characters
-    } while (character != 10 && startMillis + READ_TIMEOUT > millis() && idx < 255);
+  size_t pending;
+  if (reader.poll() > 0) return reader.peek();
+  pending = reader.pending();
+  if (pending == 0) return NULL;
+  while (startMillis + READ_TIMEOUT > millis()) {
+    delay(POLL_INTERVAL);
+    if (reader.poll() > 0) return reader.peek();
+    if (reader.pending() != pending) {
+      pending = reader.pending();
+      startMillis = millis();
+    }
   }
-  return idx;
+  reader.flush();
+  return reader.peek();
 }
 
 /*
@@ -172,15 +254,20 @@ unsigned long int SwarmNode::getTimeStamp() {
  * BLOCKING
  */
 unsigned long int SwarmNode::waitForTimeStamp() {
-  size_t bfrLen = 0;
-  char messageBfr[256];
-  // we need to keep that for a check
-  unsigned long ret = 0;
-  while (true) {
-    bfrLen = getLine(messageBfr);
-    ret = parseTime(messageBfr, bfrLen);
-    if (ret > 0) return ret;
+  ProfileScope scope(PHASE_TIME_STAMP);
+  TimeReport report = {this, 0, false, false, 0};
+  commands.addListener("$DT", receiveTime, &report);
+  // sleep until a time report has arrived, other lines go to their listeners
+  while (report.time == 0) {
+    if (poll() > 0) continue;
+    report.idle = true;
+    delay(POLL_INTERVAL);
   }
+  commands.removeListener(receiveTime, &report);
+  if (_clock != NULL && report.fresh) {
+    _clock->fix(report.time, REPORT_WIDTH + POLL_INTERVAL, report.received);
+  }
+  return report.time;
 }
 
 /*
@@ -201,8 +288,10 @@ uint8_t SwarmNode::nmeaChecksum(const char *sz, const size_t len) {
  * Check weather a buffer contains a valid NMEA check sum
  */
 boolean SwarmNode::checkNmeaChecksum(const char *bffr, const size_t len) {
-  const uint16_t pos = parseLine(bffr, len, "*", 1);
+  const int16_t pos = parseLine(bffr, len, "*", 1);
   char sum[3] = {0};
+  // no checksum at all, don't read beyond the buffer
+  if (pos < 0 || static_cast<size_t>(pos) + 3 > len) return false;
   memcpy(sum, bffr+pos+1, 2);
   // see https://stackoverflow.com/questions/1070497/c-convert-hex-string-to-signed-integer
   return (nmeaChecksum(bffr, pos) == strtol(sum, NULL, 16));
@@ -240,42 +329,17 @@ int16_t SwarmNode::parseLine(
  *
  * Returm type could be t_time but that does not play well with the Arduino
  * test framework
+ *
+ * - returns 0 if the line is not a valid $DT report, see NmeaDecoder
  */
 unsigned long int SwarmNode::parseTime(
   const char *timeResponse, const size_t len
 ) {
-  char part[5];
-  // see https://newbedev.com/shell-arduino-esp32-getlocaltime-time-h-struct-tm-code-example
-  struct tm time = {0};
-  // check NMEA checksum whether response is complete
-  if (!checkNmeaChecksum(timeResponse, len)) { return 0; }
-  // check valid flag on time reading
-  if (parseLine(timeResponse, len, ",V*", 3) < 0 ) { return 0; }
-  // this is a little bit lazy way to determine whether we have the
-  // right message type but it will work for the next 979 years
-  if (parseLine(timeResponse, len, "$DT 2", 5) > -1) {
-    memcpy(part, timeResponse + 4, 4);
-    part[4] = '\0';
-    // time format stores years since 1900
-    time.tm_year = strtol(part, NULL, 10) - 1900;
-    // check whether valid year: 2010 to 2037
-    memcpy(part, timeResponse + 8, 2);
-    // we have to do that only once since we copy
-    // 2 bytes in every of the following steps
-    part[2] = '\0';
-    // struct works with 0-indexed month
-    time.tm_mon = strtol(part, NULL, 10) - 1;
-    memcpy(part, timeResponse + 10, 2);
-    time.tm_mday = strtol(part, NULL, 10);
-    memcpy(part, timeResponse + 12, 2);
-    time.tm_hour = strtol(part, NULL, 10);
-    memcpy(part, timeResponse + 14, 2);
-    time.tm_min = strtol(part, NULL, 10);
-    memcpy(part, timeResponse + 16, 2);
-    time.tm_sec = strtol(part, NULL, 10);
-    if (validateTimeStruct(time)) { return mktime(&time); };
-  }
-  return 0;
+  NmeaSentence sentence;
+  if (!NmeaDecoder::decode(timeResponse, len, &sentence)) return 0;
+  if (sentence.type != NMEA_DT || sentence.result != NMEA_REPORT) return 0;
+  if (!sentence.dateTime.valid) return 0;
+  return sentence.dateTime.epoch;
 }
 
 /*
@@ -284,56 +348,329 @@ unsigned long int SwarmNode::parseTime(
 size_t SwarmNode::formatMessage(
   const char *message, const size_t len, char *bfr
 ) {
-  // limit by Tile spec
-  char convertedMessage[512];
-  char prefix[] = "$TD HD=86400,";
-  size_t commandIdx = sizeof(prefix) - 1;
-  memcpy(bfr, prefix, commandIdx);
-  size_t convertedLen = toHexString(message, len, convertedMessage);
-  memcpy(bfr + commandIdx, convertedMessage, convertedLen);
-  return commandIdx + convertedLen;
+  CommandWriter writer(bfr, TD_PREFIX_LENGTH + 2 * len);
+  writer.append(TD_PREFIX, TD_PREFIX_LENGTH);
+  writer.appendHex(message, len);
+  return writer.length();
+}
+
+/*
+ * Format a message as complete $TD command, the message is hex-encoded
+ * straight into bfr while the checksum is computed
+ */
+size_t SwarmNode::messageCommand(
+  const char *message, const size_t len, char *bfr
+) {
+  CommandWriter writer(
+    bfr, TD_PREFIX_LENGTH + 2 * len + COMMAND_CHECKSUM_LENGTH);
+  writer.append(TD_PREFIX, TD_PREFIX_LENGTH);
+  writer.appendHex(message, len);
+  return writer.finish();
 }
 
 /*
  * Format a text message, add metadata, and send to tile
+ *
+ * BLOCKING
  */
 void SwarmNode::sendMessage(const char *message, const size_t len) {
-  char commandBfr[512];
-  char responseBfr[512];
-  size_t responseLen=len;
-  responseLen = formatMessage(message, responseLen, commandBfr);
-  responseLen = tileCommand(commandBfr, responseLen, responseBfr);
+  TileResponse response;
+  while (!queueMessage(message, len, &response)) {
+    if (poll() == 0) delay(POLL_INTERVAL);
+  }
+  waitForResponse(&response);
+}
+
+/*
+ * Format a text message and queue it, the tile confirms with $TD OK,<id>
+ */
+boolean SwarmNode::queueMessage(
+  const char *message, const size_t len, TileResponse *response,
+  TileCallback callback, void *context
+) {
+  char commandBfr[TD_PREFIX_LENGTH + 2 * len + COMMAND_CHECKSUM_LENGTH];
+  size_t commandLen = messageCommand(message, len, commandBfr);
+  return queueCleanCommand(
+    commandBfr, commandLen, response, callback, context, "$TD OK");
+}
+
+/*
+ *  Send messages from the log to the tile, oldest first, and acknowledge
+ *  them in the log once the tile sent them
+ *
+ *  - stops at the first message the tile does not accept, e.g. because its
+ *    queue is full, the rest is tried again on the next call
+ *  - a message the tile took is marked queued with tileTime and its id; it
+ *    is acknowledged with its $TD SENT, or if the tile reports an empty
+ *    queue within TD_HOLD_DURATION, e.g. when the report came while the MCU
+ *    slept
+ *  - a queued message still pending after TD_REQUEUE_AFTER was dropped by
+ *    the tile and is appended to the log again
+ *
+ * BLOCKING
+ */
+uint8_t SwarmNode::forwardMessages(
+  MessageLog &log, const uint8_t maxMessages, const unsigned long tileTime
+) {
+  char bfr[LOG_MAX_RECORD_LENGTH];
+  char line[64];
+  LogRecord record;
+  NmeaSentence sentence;
+  uint32_t after = 0;
+  uint8_t ret = 0;
+  // asked at most once, only if messages wait in the tile
+  boolean asked = false;
+  int32_t unsent = -1;
+  // reports arriving meanwhile are matched next time
+  const uint8_t reported = _sent.count;
+  // queued messages come first, they were handed over in this order
+  while (ret < maxMessages && log.readPending(record, bfr, after)) {
+    after = record.sequence;
+    if (record.queuedAt != 0) {
+      boolean sent = false;
+      for (uint8_t i=0; i<reported; i++) {
+        if (_sent.ids[i] == record.tileId) sent = true;
+      }
+      const unsigned long age = tileTime - record.queuedAt;
+      if (!sent && age >= TD_REQUEUE_AFTER) {
+        // the copy comes up again later in this loop
+        log.requeue(record, bfr);
+        continue;
+      }
+      // an empty queue only means sent while the tile may not have dropped it
+      if (!sent && age < TD_HOLD_DURATION) {
+        if (!asked) unsent = unsentMessages();
+        asked = true;
+        sent = unsent == 0;
+      }
+      if (sent) log.acknowledge(record);
+      continue;
+    }
+    TileResponse response;
+    response.bfr = line;
+    response.size = sizeof(line);
+    while (!queueMessage(bfr, record.len, &response)) {
+      if (poll() == 0) delay(POLL_INTERVAL);
+    }
+    waitForResponse(&response);
+    if (response.status != TILE_OK) break;
+    if (!NmeaDecoder::decode(line, response.len, &sentence)) {
+      sentence.signal.id = 0;
+    }
+    // if this fails the message is handed over again next time
+    log.markQueued(record, tileTime, sentence.signal.id);
+    ret++;
+  }
+  // the others were for messages not in the log anymore
+  const uint8_t seen = reported < _sent.count ? reported : _sent.count;
+  memmove(_sent.ids, _sent.ids + seen, (_sent.count - seen) * sizeof(_sent.ids[0]));
+  _sent.count -= seen;
+  return ret;
+}
+
+/*
+ *  Read the oldest message the tile received, e.g. a remote configuration
+ *  command; messages stay on the tile until they are deleted
+ *
+ *  - one $MM R=O per call, the tile answers $MM ERR if there is none
+ *  - unsolicited $RD reports of the same messages are not needed, the tile
+ *    keeps every message it received until it is deleted
+ *
+ * BLOCKING
+ */
+size_t SwarmNode::readDownlink(char *bfr, const size_t size, uint64_t &id) {
+  // a message of the maximum length does not fit MAX_LINE_LENGTH
+  char line[NMEA_MAX_LINE_LENGTH];
+  NmeaSentence sentence;
+  TileResponse response;
+  response.bfr = line;
+  response.size = sizeof(line);
+  while (!queueCommand("$MM R=O", 7, &response, NULL, NULL, "$MM AI=")) {
+    if (poll() == 0) delay(POLL_INTERVAL);
+  }
+  waitForResponse(&response);
+  if (response.status != TILE_OK) return 0;
+  if (!NmeaDecoder::decode(line, response.len, &sentence)) return 0;
+  if (sentence.type != NMEA_MM) return 0;
+  id = sentence.received.id;
+  if (!sentence.received.valid) return 0;
+  return fromHexString(
+    sentence.fields[1].text, sentence.fields[1].len, bfr, size);
+}
+
+/*
+ *  Delete a message read with readDownlink without waiting for the tile
+ */
+boolean SwarmNode::deleteDownlink(const uint64_t id) {
+  char command[32];
+  // no %llu on all platforms
+  char digits[21];
+  size_t n = 0;
+  uint64_t value = id;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  size_t len = sprintf(command, "$MM D=");
+  while (n > 0) command[len++] = digits[--n];
+  return queueCommand(command, len);
+}
+
+/*
+ *  Ask the tile how many messages wait for a satellite, see TileSleep
+ *
+ * BLOCKING
+ */
+int32_t SwarmNode::unsentMessages() {
+  char line[32];
+  NmeaSentence sentence;
+  TileResponse response;
+  response.bfr = line;
+  response.size = sizeof(line);
+  while (!queueCommand("$MT C=U", 7, &response)) {
+    if (poll() == 0) delay(POLL_INTERVAL);
+  }
+  waitForResponse(&response);
+  if (response.status != TILE_OK) return -1;
+  if (!NmeaDecoder::decode(line, response.len, &sentence)) return -1;
+  if (sentence.type != NMEA_MT || sentence.result != NMEA_REPORT) return -1;
+  return sentence.count;
+}
+
+/*
+ *  Put the tile to sleep with $SL, it does not listen until it woke up by
+ *  its timer; unsolicited reports stop as well
+ *
+ * BLOCKING
+ */
+boolean SwarmNode::sleep(const unsigned long seconds) {
+  char command[24];
+  TileResponse response;
+  const size_t len = sprintf(command, "$SL S=%lu", seconds);
+  while (!queueCommand(command, len, &response, NULL, NULL, "$SL OK")) {
+    if (poll() == 0) delay(POLL_INTERVAL);
+  }
+  waitForResponse(&response);
+  return response.status == TILE_OK;
+}
+
+/*
+ *  Current time with $DT @ rather than waiting for the next time report,
+ *  which may have waited in the UART while the MCU slept; again if the tile
+ *  is still waking up from sleep()
+ *
+ * BLOCKING
+ */
+unsigned long SwarmNode::queryTime() {
+  char line[48];
+  for (uint8_t i=0; i<WAKE_UP_TRIES; i++) {
+    TileResponse response;
+    response.bfr = line;
+    response.size = sizeof(line);
+    while (!queueCommand("$DT @", 5, &response)) {
+      if (poll() == 0) delay(POLL_INTERVAL);
+    }
+    // the tile took the time somewhere in the round trip
+    const unsigned long sent = millis();
+    waitForResponse(&response);
+    if (response.status != TILE_OK) continue;
+    unsigned long ret = parseTime(line, response.len);
+    if (ret == 0) continue;
+    const unsigned long received = millis();
+    if (_clock != NULL) _clock->fix(ret, REPORT_WIDTH + (received - sent), received);
+    return ret;
+  }
+  return 0;
+}
+
+void SwarmNode::attachClock(LocalClock *clock) {
+  _clock = clock;
 }
 
 /*
  *  Send a command to SWARM tile
  *
- *  - returns the response to a command assuming that the first three characters
- *    of the command match the response pattern
+ *  - returns the response to a command, i.e. the first line of the same
+ *    sentence type or starting with prefix, 0 on timeout
  *
+ * BLOCKING
+ */
+size_t SwarmNode::tileCommand(
+  const char *command, const size_t len, char *bfr, const char *prefix
+) {
+  ProfileScope scope(PHASE_TILE_COMMAND);
+  TileResponse response;
+  response.bfr = bfr;
+  response.size = MAX_LINE_LENGTH;
+  while (!queueCommand(command, len, &response, NULL, NULL, prefix)) {
+    if (poll() == 0) delay(POLL_INTERVAL);
+  }
+  waitForResponse(&response);
+  _wrappedDisplayRef->shortPrintBuffer(bfr, response.len);
+  return response.len;
+}
+
+/*
+ *  Send a command to SWARM tile without waiting for the response
+ */
+boolean SwarmNode::queueCommand(
+  const char *command, const size_t len, TileResponse *response,
+  TileCallback callback, void *context, const char *prefix,
+  const unsigned long timeout
+) {
+  char commandBfr[len + COMMAND_CHECKSUM_LENGTH];
+  size_t commandLen = cleanCommand(command, len, commandBfr);
+  return queueCleanCommand(
+    commandBfr, commandLen, response, callback, context, prefix, timeout);
+}
+
+/*
+ *  Send a command with checksum to SWARM tile without waiting for the
+ *  response
+ */
+boolean SwarmNode::queueCleanCommand(
+  char *command, const size_t len, TileResponse *response,
+  TileCallback callback, void *context, const char *prefix,
+  const unsigned long timeout
+) {
+  if (!commands.add(
+    command, len, timeout > 0 ? timeout : COMMAND_TIMEOUT, response,
+    callback, context, prefix)
+  ) {
+    return false;
+  }
+  _wrappedDisplayRef->shortPrintBuffer(command, len);
+  return true;
+}
+
+/*
+ *  Process received lines, complete commands, and call listeners
+ */
+uint8_t SwarmNode::poll() {
+  return commands.poll(reader);
+}
+
+/*
+ * BLOCKING
+ */
+void SwarmNode::waitForResponse(TileResponse *response) {
+  ProfileScope scope(PHASE_TILE_COMMAND);
+  while (response->status == TILE_PENDING) {
+    if (poll() == 0) delay(POLL_INTERVAL);
+  }
+}
+
+/*
+ *  Wait until all commands are completed or timed out, e.g. before sleeping
  *
  * BLOCKING
  */
- size_t SwarmNode::tileCommand(
-   const char *command, const size_t len, char *bfr
- ) {
-   char commandBfr[len+4];
-   size_t retLen = 0;
-   unsigned long startMillis = millis();
-   cleanCommand(command, len, commandBfr);
-   _wrappedDisplayRef->shortPrintBuffer(commandBfr, len+4);
-   _wrappedSerialRef->write(commandBfr, len+4);
-   // discard unsolicated messages if they arrive between a command and the
-   // command response
-   do {
-     retLen = getLine(bfr);
-   } while (
-     parseLine(bfr, 3, commandBfr, 3) < 0
-     && startMillis + COMMAND_TIMEOUT > millis()
-   );
-   _wrappedDisplayRef->shortPrintBuffer(bfr, retLen);
-   return retLen;
- }
+void SwarmNode::waitForCommands() {
+  ProfileScope scope(PHASE_TILE_COMMAND);
+  while (commands.pending() > 0) {
+    if (poll() == 0) delay(POLL_INTERVAL);
+  }
+}
 
  /*
   * Convert to ASCII representation of HEX values; because of special
@@ -343,13 +680,30 @@ void SwarmNode::sendMessage(const char *message, const size_t len) {
   size_t SwarmNode::toHexString(
     const char *inputBfr, const size_t len, char *bfr
   ) {
-    // sprintf outputs a terminating \0 character for this reason length 3
-    // see https://stackoverflow.com/questions/3706086/using-sprintf-will-change-the-specified-variable
-    char smallBfr[3];
     for (size_t i=0; i<len; i++) {
-      sprintf(smallBfr, "%02x", inputBfr[i]);
-      // use without the terminating \0 character
-      memcpy(bfr+i*2, smallBfr, 2);
+      const uint8_t byte = inputBfr[i];
+      bfr[i*2] = HEX_DIGITS[byte >> 4];
+      bfr[i*2+1] = HEX_DIGITS[byte & 0x0F];
     }
     return len * 2;
   }
+
+/*
+ *  Convert hex as received from the tile back to bytes
+ */
+size_t SwarmNode::fromHexString(
+  const char *hex, const size_t len, char *bfr, const size_t size
+) {
+  if (len % 2 != 0 || len / 2 > size) return 0;
+  for (size_t i=0; i<len; i++) {
+    const char c = hex[i];
+    uint8_t digit;
+    if (c >= '0' && c <= '9') digit = c - '0';
+    else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+    else return 0;
+    if (i % 2 == 0) bfr[i/2] = digit << 4;
+    else bfr[i/2] |= digit;
+  }
+  return len / 2;
+}
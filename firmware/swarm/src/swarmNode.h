@@ -19,27 +19,97 @@
 #ifndef _SERIAL_WRAPPER_H_
 #include "serialWrapper.h"
 #endif
+#ifndef _NMEA_READER_H_
+#include "nmeaReader.h"
+#endif
+#ifndef _NMEA_DECODER_H_
+#include "nmeaDecoder.h"
+#endif
+#ifndef _TILE_COMMAND_QUEUE_H_
+#include "tileCommandQueue.h"
+#endif
+#ifndef _PROFILER_H_
+#include "profiler.h"
+#endif
+#ifndef _MESSAGE_LOG_H_
+#include "messageLog.h"
+#endif
+#ifndef _COMMAND_WRITER_H_
+#include "commandWriter.h"
+#endif
+#ifndef _LOCAL_CLOCK_H_
+#include "localClock.h"
+#endif
+
+// $TD with hold duration of a day, the message follows as hex
+#define TD_PREFIX "$TD HD=86400,"
+#define TD_PREFIX_LENGTH (sizeof(TD_PREFIX) - 1)
+// seconds, the HD of TD_PREFIX; the tile drops a message it could not send
+// by then
+#define TD_HOLD_DURATION 86400
+// a message is handed over again this long after the tile took it, an hour
+// more since the tile time of the $TD may come from an older time report
+#define TD_REQUEUE_AFTER (TD_HOLD_DURATION + 3600)
+// $TD SENT reports kept between calls of forwardMessages()
+#define TILE_MAX_SENT 8
 
 
 boolean validateTimeStruct(struct tm tme);
 
 
+/*
+ *  State shared with the listeners used while waiting for the tile
+ */
+typedef struct {
+  DisplayWrapperBase *display;
+  boolean running;
+} BootState;
+
+/*
+ *  Ids of the messages the tile reported sent with $TD SENT, see
+ *  forwardMessages()
+ */
+typedef struct {
+  uint64_t ids[TILE_MAX_SENT];
+  uint8_t count;
+} SentMessages;
+
+
 class SwarmNode {
 
   private:
     DisplayWrapperBase *_wrappedDisplayRef;
     SerialWrapperBase *_wrappedSerialRef;
     boolean dev;
+    // reset() was sent and the tile has not reported running yet
+    boolean _resetting = false;
+    BootState _boot;
+    SentMessages _sent;
+    // fixed by the time the tile sends, see attachClock()
+    LocalClock *_clock = NULL;
 
   public:
+    // lines received from the tile, use poll(), peek(), and release() to
+    // process them without copying
+    NmeaReader reader;
+    // commands in flight and listeners for unsolicited sentences, driven by
+    // poll()
+    TileCommandQueue commands;
     SwarmNode(
       DisplayWrapperBase *wrappedDisplayObject,
       SerialWrapperBase *wrappedSerialObject, const boolean dev=true);
     void begin(const unsigned long timeReportingFrequency=60);
+    // reset the tile without waiting for it, e.g. to take readings while
+    // it boots; begin() waits for it then
+    void reset();
     size_t cleanCommand(const char *command, const size_t len, char *bfr);
     void emptySerialBuffer();
     size_t formatMessage(const char *message, const size_t len, char *bfr);
+    // complete $TD command with checksum in one pass, bfr needs
+    // TD_PREFIX_LENGTH + 2 * len + COMMAND_CHECKSUM_LENGTH
+    size_t messageCommand(const char *message, const size_t len, char *bfr);
     size_t getLine(char *bfr);
+    const NmeaLine *nextLine();
     int getTime(char *bfr);
     unsigned long waitForTimeStamp();
     unsigned long getTimeStamp();
@@ -54,7 +124,50 @@ class SwarmNode {
       const size_t searchLen);
     unsigned long parseTime(const char *timeResponse, const size_t len);
     void sendMessage(const char *message, const size_t len);
+    // non-blocking variants, false if too many commands are pending; a
+    // timeout of 0 means COMMAND_TIMEOUT
+    boolean queueCommand(
+      const char *command, const size_t len, TileResponse *response=NULL,
+      TileCallback callback=NULL, void *context=NULL, const char *prefix=NULL,
+      const unsigned long timeout=0);
+    // same for a command that already has its checksum
+    boolean queueCleanCommand(
+      char *command, const size_t len, TileResponse *response=NULL,
+      TileCallback callback=NULL, void *context=NULL, const char *prefix=NULL,
+      const unsigned long timeout=0);
+    boolean queueMessage(
+      const char *message, const size_t len, TileResponse *response=NULL,
+      TileCallback callback=NULL, void *context=NULL);
+    // send messages stored in the log and acknowledge those the tile sent,
+    // returns the number the tile accepted
+    uint8_t forwardMessages(
+      MessageLog &log, const uint8_t maxMessages, const unsigned long tileTime);
+    // oldest message received by the tile into bfr, 0 if there is none or
+    // it is broken or does not fit size; delete it with deleteDownlink(id)
+    // when done, id stays 0 only if there is nothing to delete
+    size_t readDownlink(char *bfr, const size_t size, uint64_t &id);
+    boolean deleteDownlink(const uint64_t id);
+    // messages the tile accepted but did not send yet, -1 if it does not
+    // answer
+    int32_t unsentMessages();
+    // put the tile to sleep, it wakes by itself after seconds; false if it
+    // did not take the command
+    boolean sleep(const unsigned long seconds);
+    // current time with $DT @, also after the tile woke from sleep(); 0 if
+    // it does not answer
+    unsigned long queryTime();
+    // fix clock with $DT @ and with the time reports waitForTimeStamp()
+    // waited for; older reports are not fresh enough for it
+    void attachClock(LocalClock *clock);
+    uint8_t poll();
+    void waitForResponse(TileResponse *response);
+    void waitForCommands();
     size_t toHexString(
       const char *inputBuffer, const size_t len, char *bfr);
-    size_t tileCommand(const char *command, const size_t len, char *bfr);
+    // inverse of toHexString, returns 0 if hex is not hex or too long
+    static size_t fromHexString(
+      const char *hex, const size_t len, char *bfr, const size_t size);
+    size_t tileCommand(
+      const char *command, const size_t len, char *bfr,
+      const char *prefix=NULL);
 };
@@ -0,0 +1,104 @@
+/*
+ *  Text of a small display as a rolling console
+ *
+ *  - the rows of the display are a ring buffer of lines, after the last row
+ *    the next line overwrites the oldest one at the top. Lines never move:
+ *    scrolling would redraw the whole display for every new line, clearing
+ *    it when full like before costs a whole frame too.
+ *  - every row has a dirty bit, the display only redraws and sends the rows
+ *    that changed; with the 8 pixel font a row is one band of the display,
+ *    128 bytes of display RAM
+ *  - knows nothing about the display, see DisplayWrapper for the drawing
+ */
+#ifndef _TEXT_CONSOLE_H_
+#define _TEXT_CONSOLE_H_
+
+#include <Arduino.h>
+
+// 128x64 pixels with the 6x8 pixel font of the GFX library
+#define CONSOLE_LINES 8
+#define CONSOLE_COLUMNS 21
+#define CONSOLE_ALL_DIRTY 0xFF
+
+
+class TextConsole {
+  private:
+    char _lines[CONSOLE_LINES][CONSOLE_COLUMNS];
+    uint8_t _lengths[CONSOLE_LINES] = {0};
+    // cursor
+    uint8_t _row = 0;
+    uint8_t _column = 0;
+    // bit per row
+    uint8_t _dirty = CONSOLE_ALL_DIRTY;
+
+    void newLine() {
+      _column = 0;
+      _row = (_row + 1) % CONSOLE_LINES;
+      if (_lengths[_row] > 0) _dirty |= 1 << _row;
+      _lengths[_row] = 0;
+    };
+
+  public:
+    void clear() {
+      for (uint8_t i=0; i<CONSOLE_LINES; i++) _lengths[i] = 0;
+      _row = 0;
+      _column = 0;
+      _dirty = CONSOLE_ALL_DIRTY;
+    };
+
+    /*
+     *  Like the GFX library: \n starts a new line, \r is ignored, long lines
+     *  wrap
+     */
+    void write(const char c) {
+      if (c == '\n') {
+        newLine();
+        return;
+      }
+      if (c == '\r') return;
+      if (_column == CONSOLE_COLUMNS) newLine();
+      const uint8_t i = _row;
+      // overwrite after setCursor
+      while (_lengths[i] < _column) _lines[i][_lengths[i]++] = ' ';
+      _lines[i][_column++] = c;
+      if (_column > _lengths[i]) _lengths[i] = _column;
+      _dirty |= 1 << _row;
+    };
+
+    void write(const char *bfr, const size_t len) {
+      for (size_t i=0; i<len; i++) write(bfr[i]);
+    };
+
+    void setCursor(const uint8_t row, const uint8_t column) {
+      _row = row < CONSOLE_LINES ? row : CONSOLE_LINES - 1;
+      _column = column < CONSOLE_COLUMNS ? column : CONSOLE_COLUMNS;
+    };
+
+    uint8_t row() const {
+      return _row;
+    };
+
+    /*
+     *  Text of a row, not \0 terminated
+     */
+    const char *line(const uint8_t row, size_t &len) const {
+      len = _lengths[row];
+      return _lines[row];
+    };
+
+    uint8_t dirty() const {
+      return _dirty;
+    };
+
+    /*
+     *  Returns the dirty rows and marks all of them clean, call it when the
+     *  rows were drawn
+     */
+    uint8_t takeDirty() {
+      const uint8_t ret = _dirty;
+      _dirty = 0;
+      return ret;
+    };
+};
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ *  Pipeline commands to the SWARM tile without waiting for the responses
+ *
+ *  - a command is written to the tile right away and kept as pending until
+ *    its response arrives or it times out, completion is reported through a
+ *    TileResponse the caller can check later and/or a callback
+ *  - responses are correlated by sentence type, i.e. the first three
+ *    characters like $RT, with the oldest pending command of that type. The
+ *    tile also reports unsolicited sentences of the same types, e.g.
+ *    $RT RSSI=-104, a command can restrict its response to a prefix like
+ *    $RT OK for that reason; $XX ERR always matches
+ *  - all other lines are handed to listeners registered for their type
+ *  - nothing blocks, poll() drives everything
+ */
+#ifndef _TILE_COMMAND_QUEUE_H_
+#define _TILE_COMMAND_QUEUE_H_
+
+#include <Arduino.h>
+#ifndef _NMEA_READER_H_
+#include "nmeaReader.h"
+#endif
+
+#define TILE_MAX_PENDING 8
+#define TILE_MAX_LISTENERS 6
+// e.g. "$TD OK" or "$TILE"
+#define TILE_MAX_PREFIX_LENGTH 12
+
+// status of a command
+#define TILE_PENDING 0
+#define TILE_OK 1
+#define TILE_ERROR 2
+#define TILE_TIMEOUT 3
+
+
+/*
+ *  Called on completion of a command with the response, line is NULL on
+ *  timeout. Listeners are called with status TILE_OK.
+ */
+typedef void (*TileCallback)(
+  void *context, const uint8_t status, const NmeaLine *line);
+
+/*
+ *  Future-style handle of a command, owned by the caller and valid until
+ *  status is not TILE_PENDING anymore
+ */
+typedef struct {
+  uint8_t status = TILE_PENDING;
+  // optional, the response is copied here up to size characters
+  char *bfr = NULL;
+  size_t size = 0;
+  size_t len = 0;
+} TileResponse;
+
+
+class TileCommandQueue {
+  private:
+    typedef struct {
+      char prefix[TILE_MAX_PREFIX_LENGTH];
+      size_t prefixLen;
+      unsigned long deadline;
+      TileResponse *response;
+      TileCallback callback;
+      void *context;
+    } PendingCommand;
+
+    typedef struct {
+      char prefix[TILE_MAX_PREFIX_LENGTH];
+      size_t prefixLen;
+      TileCallback callback;
+      void *context;
+    } Listener;
+
+    SerialWrapperBase *_serialRef;
+    // oldest first
+    PendingCommand _pending[TILE_MAX_PENDING];
+    uint8_t _numberOfPending = 0;
+    Listener _listeners[TILE_MAX_LISTENERS];
+    uint8_t _numberOfListeners = 0;
+
+    static size_t copyPrefix(const char *prefix, const size_t len, char *bfr) {
+      size_t ret = len < TILE_MAX_PREFIX_LENGTH ? len : TILE_MAX_PREFIX_LENGTH;
+      memcpy(bfr, prefix, ret);
+      return ret;
+    };
+
+    static boolean startsWith(
+      const char *line, const size_t len, const char *prefix,
+      const size_t prefixLen
+    ) {
+      return len >= prefixLen && memcmp(line, prefix, prefixLen) == 0;
+    };
+
+    void complete(const uint8_t idx, const uint8_t status, const NmeaLine *line) {
+      // copy before calling back, the callback might queue the next command
+      PendingCommand command = _pending[idx];
+      _numberOfPending--;
+      for (uint8_t i=idx; i<_numberOfPending; i++) _pending[i] = _pending[i+1];
+      if (command.response != NULL) {
+        command.response->len = 0;
+        if (line != NULL && command.response->bfr != NULL) {
+          command.response->len = line->len < command.response->size
+            ? line->len : command.response->size;
+          memcpy(command.response->bfr, line->text, command.response->len);
+        }
+        command.response->status = status;
+      }
+      if (command.callback != NULL) command.callback(command.context, status, line);
+    };
+
+    /*
+     *  Hand a line to the pending command it answers, returns false if it
+     *  does not answer any
+     */
+    boolean correlate(const NmeaLine *line) {
+      for (uint8_t i=0; i<_numberOfPending; i++) {
+        const PendingCommand &command = _pending[i];
+        // same sentence type
+        if (!startsWith(line->text, line->len, command.prefix, 3)) continue;
+        if (line->len > 7 && memcmp(line->text + 3, " ERR", 4) == 0) {
+          complete(i, TILE_ERROR, line);
+          return true;
+        }
+        if (startsWith(line->text, line->len, command.prefix, command.prefixLen)) {
+          complete(i, TILE_OK, line);
+          return true;
+        }
+      }
+      return false;
+    };
+
+  public:
+    unsigned long commandsSent = 0;
+    unsigned long responses = 0;
+    unsigned long timeouts = 0;
+    unsigned long unsolicited = 0;
+
+    TileCommandQueue(SerialWrapperBase *serialRef) {
+      _serialRef = serialRef;
+    };
+
+    uint8_t pending() { return _numberOfPending; };
+
+    /*
+     *  Write a command that already carries its checksum and line feed to
+     *  the tile. Returns false if too many commands are pending.
+     *
+     *  - prefix restricts the response, defaults to the sentence type
+     *  - timeout in ms
+     */
+    boolean add(
+      char *command, const size_t len, const unsigned long timeout,
+      TileResponse *response=NULL, TileCallback callback=NULL,
+      void *context=NULL, const char *prefix=NULL
+    ) {
+      if (_numberOfPending == TILE_MAX_PENDING || len < 3) return false;
+      PendingCommand &pending = _pending[_numberOfPending];
+      if (prefix != NULL) {
+        pending.prefixLen = copyPrefix(prefix, strlen(prefix), pending.prefix);
+      } else {
+        pending.prefixLen = copyPrefix(command, 3, pending.prefix);
+      }
+      pending.deadline = millis() + timeout;
+      pending.response = response;
+      pending.callback = callback;
+      pending.context = context;
+      if (response != NULL) {
+        response->status = TILE_PENDING;
+        response->len = 0;
+      }
+      _numberOfPending++;
+      commandsSent++;
+      _serialRef->write(command, len);
+      return true;
+    };
+
+    /*
+     *  Register a callback for lines starting with prefix that are not a
+     *  response to a command, an empty prefix gets all of them
+     */
+    boolean addListener(const char *prefix, TileCallback callback, void *context=NULL) {
+      if (_numberOfListeners == TILE_MAX_LISTENERS) return false;
+      Listener &listener = _listeners[_numberOfListeners];
+      listener.prefixLen = copyPrefix(prefix, strlen(prefix), listener.prefix);
+      listener.callback = callback;
+      listener.context = context;
+      _numberOfListeners++;
+      return true;
+    };
+
+    void removeListener(TileCallback callback, void *context=NULL) {
+      uint8_t idx = 0;
+      for (uint8_t i=0; i<_numberOfListeners; i++) {
+        if (_listeners[i].callback == callback && _listeners[i].context == context) {
+          continue;
+        }
+        _listeners[idx++] = _listeners[i];
+      }
+      _numberOfListeners = idx;
+    };
+
+    /*
+     *  Process the lines received so far and expire commands, returns the
+     *  number of lines processed. Never blocks.
+     */
+    uint8_t poll(NmeaReader &reader) {
+      uint8_t ret = 0;
+      const NmeaLine *line;
+      reader.poll();
+      while ((line = reader.peek()) != NULL) {
+        ret++;
+        // lines cut short or garbled on the wire are of no use
+        if (line->valid) {
+          if (correlate(line)) {
+            responses++;
+          } else {
+            unsolicited++;
+            for (uint8_t i=0; i<_numberOfListeners; i++) {
+              const Listener &listener = _listeners[i];
+              if (startsWith(line->text, line->len, listener.prefix, listener.prefixLen)) {
+                listener.callback(listener.context, TILE_OK, line);
+              }
+            }
+          }
+        }
+        reader.release();
+        // make room for lines waiting in the UART buffer
+        reader.poll();
+      }
+      const unsigned long now = millis();
+      uint8_t i = 0;
+      while (i < _numberOfPending) {
+        // overflow safe comparison
+        if (static_cast<long>(now - _pending[i].deadline) >= 0) {
+          timeouts++;
+          complete(i, TILE_TIMEOUT, NULL);
+        } else {
+          i++;
+        }
+      }
+      return ret;
+    };
+};
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ *  Sleep of the tile between acquisition windows
+ *
+ *  - awake, the tile sends a time report every tileTimeFrequency only to
+ *    pace the loop; asleep with $SL S=<seconds> it is quiet and wakes by
+ *    its own timer
+ *  - it only sleeps with nothing to send: messages it accepted go out with
+ *    the next satellite pass and need the radio, messages still in the log
+ *    need the tile to take them
+ *  - it wakes lead seconds before the first time report after the next
+ *    event, like the MCU from deep sleep; the MCU sleeps TILE_WAKE_MARGIN
+ *    longer and syncs the time with a single $DT @
+ *  - a sleep shorter than TILE_MIN_SLEEP is not worth the wake-up
+ *  - knows nothing about the tile, see SwarmNode::sleep() and queryTime()
+ */
+#ifndef _TILE_SLEEP_H_
+#define _TILE_SLEEP_H_
+
+#include <Arduino.h>
+#ifndef _SLEEP_WRAPPER_H_
+#include "sleepWrapper.h"
+#endif
+
+// seconds
+#define TILE_MIN_SLEEP 120
+#define TILE_WAKE_MARGIN 2
+
+
+class TileSleep {
+  public:
+    // the tile was put to sleep and the time was not synced since
+    boolean asleep = false;
+    // statistics
+    unsigned long sleeps = 0;
+    unsigned long sleptS = 0;
+
+    /*
+     *  Seconds the tile can sleep at tileTime before nextEvent, 0 if it
+     *  should stay awake; see SleepWrapperBase::sleepDuration
+     */
+    static unsigned long duration(
+      const unsigned long tileTime, const unsigned long nextEvent,
+      const unsigned long interval, const unsigned long lead
+    ) {
+      const unsigned long ret = SleepWrapperBase::sleepDuration(
+        tileTime, nextEvent, interval, lead);
+      return ret >= TILE_MIN_SLEEP ? ret : 0;
+    };
+
+    /*
+     *  The tile took $SL, returns how long the MCU can sleep
+     */
+    unsigned long slept(const unsigned long seconds) {
+      asleep = true;
+      sleeps++;
+      sleptS += seconds;
+      return seconds + TILE_WAKE_MARGIN;
+    };
+
+    void woke() {
+      asleep = false;
+    };
+};
+
+#endif
@@ -22,6 +22,81 @@
  *
  * Entire message must fit into 192 characters
  *
+ * Encodings (messageEncoding):
+ * - ENCODING_CSV: the fields above as comma separated text, e.g.
+ *   000549,1638633620,3.59,SC,51,+26+0.000+0,52,+0.00
+ * - ENCODING_BINARY: SC messages as binary frame, all integers are unsigned
+ *   LEB128 varints, signed ones zigzag encoded
+ *    - 0x01 (frame type, never an ASCII digit)
+ *    - index (varint)
+ *    - timeStamp (uint32, little endian)
+ *    - batteryVoltage in 0.01V (varint)
+ *    - for each channel until the end of the frame:
+ *       - channel (byte)
+ *       - number of values n (byte, bit 7 set for self-describing values,
+ *         bit 6 set if values were out of range)
+ *       - if bit 6 is set, a varint with bit i set for each value i outside
+ *         the range of its field in src/sensorSchema.h
+ *       - n signed varints less those out of range; fixed point value with
+ *         the precision defined in src/sensorSchema.h or, if
+ *         self-describing, zigzag(mantissa) << 3 | decimals
+ *   Channels that don't fit are dropped rather than truncated
+ *
+ * Batching (batchDepth > 1): readings are taken every sampleFrequencyS and
+ * up to batchDepth epochs are sent as one binary frame when the batch is
+ * full, does not fit into another epoch, or measurementFrequencyS is due
+ *    - 0x02 (frame type)
+ *    - index (varint)
+ *    - timeStamp of the first epoch (uint32, little endian)
+ *    - batteryVoltage of the first epoch in 0.01V (varint)
+ *    - number of epochs (byte)
+ *    - number of channels (byte)
+ *    - for each channel: channel (byte), number of values n (byte, bit 7
+ *      set for self-describing values, bit 6 if values were out of range in
+ *      any epoch), if self-describing n decimals bytes
+ *    - values of the first epoch as signed varints
+ *    - for each further epoch: seconds since the previous epoch (varint),
+ *      battery delta (signed varint), and the delta of each value to the
+ *      previous epoch (signed varints)
+ *    - in every epoch the values of a channel with bit 6 are preceded by
+ *      the varint of the values out of range like above; those are left
+ *      out and the next delta refers to the value before them, 0 in the
+ *      first epoch
+ *
+ * Aggregation (aggregateFrequencyS > 0 in the configuration): readings are
+ * taken every aggregateFrequencyS and sent as statistics every
+ * measurementFrequencyS, see src/aggregate.h
+ *    - 0x03 (frame type)
+ *    - index (varint)
+ *    - timeStamp of the first sample (uint32, little endian)
+ *    - seconds from the first to the last sample (varint)
+ *    - number of samples (varint)
+ *    - number of samples with values out of range (varint)
+ *    - lowest batteryVoltage in 0.01V (varint)
+ *    - number of channels (byte)
+ *    - for each channel: channel (byte), number of values n (byte, bit 7
+ *      set for self-describing values, bit 6 if values were out of range),
+ *      if self-describing n decimals bytes
+ *    - for each value, fixed point like above: min (signed varint), mean -
+ *      min, max - min, and the standard deviation (varints); sum and max
+ *      (signed varints) for accumulating fields like precip_mm; circular
+ *      mean from 0 to less than 360 and circular standard deviation
+ *      (varints) for directions like windDir_deg
+ *    - values of a channel with bit 6 are preceded by the number of samples
+ *      they were left out of (varint), none follow if that is all samples
+ *   If the statistics don't fit each channel is sent in a frame of its own
+ *
+ * Configuration acknowledgement: the result of a remote configuration
+ * command, see src/downlink.h
+ *    - 0x04 (frame type)
+ *    - sequence of the command (varint)
+ *    - status (byte), DOWNLINK_APPLIED or why it was rejected
+ *
+ * Monthly quota (monthlyQuota in the configuration > 0): readings are taken
+ * every sampleFrequencyS and sent when src/budget.h finds them worth it,
+ * sooner when they change and less often when they are flat, never more
+ * than the quota per calendar month; measurementFrequencyS is not used
+ *
  * Pins used (TODO: Complete!)
  *
  *  13   battery Voltage measurement (used)
@@ -49,12 +124,30 @@
 #include "src/swarmNode.h"
 #include "src/sdi12Wrapper.h"
 #include "src/messages.h"
+#include "src/batch.h"
+#include "src/budget.h"
+#include "src/aggregate.h"
 #include "src/memory.h"
 #include "src/setup.h"
+#include "src/sleepWrapper.h"
+#include "src/profiler.h"
+#include "src/flashWrapper.h"
+#include "src/messageLog.h"
+#include "src/downlink.h"
+#include "src/tileSleep.h"
+#include "src/localClock.h"
+#include "src/loopState.h"
 
 #define BATTERY_PIN A13
 #define uS_TO_S_FACTOR 1000000  // Conversion factor for micro seconds to seconds
-#define DEFAULT_SEND_FREQUENCY 3600 // use an hour as default
+// seconds to be awake before the time report that makes a message due
+#define DEEP_SLEEP_LEAD 5
+// messages from the log handed to the tile per cycle
+#define LOG_FORWARD_PER_CYCLE 4
+// seconds between checks for remote configuration commands
+#define DOWNLINK_FREQUENCY 3600
+// commands read from the tile per check
+#define DOWNLINK_PER_CHECK 2
 
 // Wrapper around the OLED display
 DisplayWrapper dspl = DisplayWrapper();
@@ -63,16 +156,42 @@ SerialWrapper srl = SerialWrapper(&Serial2, 115200);
 // third arguments indicates dev mode deleting unsent messages on restart
 SwarmNode tile = SwarmNode(&dspl, &srl, false);
 // SDI12 communication
-SDI12Measurement measurement = SDI12Measurement();
-// Configuration storage
+Sdi12Bus sdi12Bus = Sdi12Bus(DATA_PIN);
+SDI12Measurement measurement = SDI12Measurement(&sdi12Bus);
+// Configuration storage, read once in setup()
 PersistentMemory mem = PersistentMemory();
 // message types and helpers
 MessageHelpers helpers;
+// readings waiting to be sent when batching
+MessageBatch batch;
+// decides which samples are sent if there is a monthly quota
+MessageBudget budget;
+// statistics of the readings since the last message when aggregating
+MessageAggregate aggregate;
 SetupHelpers stp;
+// loop state kept over deep sleep
+RTC_DATA_ATTR RetainedState retainedState;
+SleepWrapper sleeper = SleepWrapper(&retainedState);
+// puts the tile to sleep between acquisition windows
+TileSleep tileSleep;
+// the time between fixes from the tile
+LocalClock localClock;
+// messages are kept in flash until the tile sent them
+FlashWrapper flash = FlashWrapper();
+MessageLog messageLog = MessageLog(&flash);
 
+// the following four come from the configuration, see applyConfig()
+// binary encoding fits all ATMOS 41 fields plus more channels, see spec above
+uint8_t messageEncoding = ENCODING_BINARY;
 // Sending every hour (3600s) meets the monthly included rate of 720 message
 // arithmetic with millis() needs unsigned long
-unsigned long measurementFrequencyS = DEFAULT_SEND_FREQUENCY;
+unsigned long measurementFrequencyS = DEFAULT_MEASUREMENT_FREQUENCY;
+// number of sampling epochs per message, 1 disables batching, e.g. 4 with
+// sampleFrequencyS = 900 gives 15 min resolution at hourly message cost
+uint8_t batchDepth = 1;
+unsigned long sampleFrequencyS = DEFAULT_SAMPLE_FREQUENCY;
+// seconds between readings aggregated into one message, 0 disables
+unsigned long aggregateFrequencyS = 0;
 // time polling frequency, set on SWARM tile for unsolicitated time messages
 // determines precision of send schedule but also power consumption
 const unsigned long tileTimeFrequency = 20;
@@ -87,6 +206,48 @@ int messageCounter = 0;
 // by setting nextScheduled = 0 sending will start after restart, schedule
 // will start for the next message, good for testing
 unsigned long nextScheduled = 0;
+unsigned long nextSample = 0;
+// readings taken while the tile boots and the millis() they were taken at,
+// see fastBoot()
+Message firstMessage;
+boolean firstMessageReady = false;
+unsigned long firstMessageTaken = 0;
+// cold start, the time to the first readings is still to be logged
+boolean bootTimePending = false;
+// sleep deep between scheduled events rather than waking every
+// tileTimeFrequency, wake-ups skip the setup screens and the tile
+// initialization
+const boolean useDeepSleep = false;
+// put the tile to sleep with $SL when it has nothing to send rather than
+// keeping it awake for the time reports. Off by default; set to true where
+// power matters more than receiving remote configuration commands right
+// away, a sleeping tile receives nothing, see src/tileSleep.h
+const boolean useTileSleep = false;
+// run the loop on the local clock while it is good enough rather than
+// waiting for a time report of the tile. Off by default; set to true with
+// useDeepSleep or useTileSleep, where waiting for a report costs awake time,
+// see src/localClock.h
+const boolean useLocalClock = false;
+// boot with the sensors of the last boot if they still answer with the same
+// identity, skips the setup screens unless a button is held at reset. Off by
+// default; set to true for unattended nodes once a boot through the setup
+// screens stored the sensors
+const boolean useFastBoot = false;
+// key of the remote configuration commands, shared with the tool signing
+// them (host/signCommand); all zeros disables remote configuration
+const uint8_t downlinkKey[SIP_HASH_KEY_LENGTH] = {0};
+unsigned long nextDownlink = 0;
+// acknowledgement held back until the monthly quota allows for it
+char pendingAck[8];
+size_t pendingAckLength = 0;
+// print where the awake time goes after every cycle on the debug Serial,
+// holding BUTTON B shows the same on the display
+const boolean profileToSerial = false;
+// the globals above that are kept in RTC memory over deep sleep
+LoopState loopState = LoopState(
+  messageCounter, nextScheduled, nextSample, measurementFrequencyS,
+  availableChannels, numberOfChannels, batch, budget, aggregate, tileSleep,
+  localClock);
 
 /*
  *  Measure battery/system voltage Adafruit Feather HUZZAH
@@ -99,25 +260,50 @@ float getBatteryVoltage() {
  * Wait for button for maximal ms.
  */
 boolean waitForButtonA(DisplayWrapper &dspl, unsigned long ms) {
-  unsigned long start = millis();
-  boolean res = false;
-  while(start + ms > millis()) {
-    if (dspl.buttonDebounced(BUTTON_A)) {
-      res = true;
-      break;
-    }
+  ProfileScope scope(PHASE_BUTTON);
+  const unsigned long start = millis();
+  ButtonEvent event;
+  unsigned long elapsed = 0;
+  // other buttons mean nothing here
+  while (dspl.nextEvent(event, ms - elapsed)) {
+    if (event.button == BUTTON_A && event.type == BUTTON_PRESSED) return true;
+    elapsed = millis() - start;
+    if (elapsed >= ms) break;
   }
-  return res;
+  return false;
 }
 
 /*
- *  Collect data and construct message
+ *  Keep the time from reset to the first readings, e.g. to compare the boot
+ *  paths. The only configuration write of a cold boot, it also stores the
+ *  boot counter and the channels found.
  */
-size_t getMessage(
-  char *bfr, const char *channels, const int idx, const unsigned long tme
-) {
-  Message message = {0};
-  size_t len = 0;
+void logBootTime() {
+  char bfr[32];
+  bootTimePending = false;
+  mem.config.bootToSampleMs = millis();
+  mem.commit();
+  sprintf(
+    bfr, "FIRST SAMPLE %lu ms\n",
+    static_cast<unsigned long>(mem.config.bootToSampleMs));
+  dspl.printBuffer(bfr);
+  if (profileToSerial) Serial.print(bfr);
+}
+
+/*
+ *  Collect data
+ */
+void collectMessage(Message &message, const int idx, const unsigned long tme) {
+  // taken while the tile was booting, stamped with the time they were
+  // taken at rather than the first time report
+  if (firstMessageReady) {
+    const unsigned long age = (millis() - firstMessageTaken) / 1000;
+    firstMessageReady = false;
+    message = firstMessage;
+    message.index = idx;
+    message.timeStamp = tme > age ? tme - age : tme;
+    return;
+  }
   // message index
   message.index = idx;
   // time
@@ -126,26 +312,294 @@ size_t getMessage(
   message.batteryVoltage = getBatteryVoltage();
   // message type
   memcpy(message.type, "SC\0", 3);
-  // payloads, read only the first five channels
-  for (size_t i=0; i<5; i++) {
-    char channel = availableChannels[i];
-    if (channel == 0) break;
-    message.payloads[i].channel = channel;
-    // get measurement from SDI-12 device on address channel
-    len = measurement.getPayload(message.payloads[i].payload, channel);
-    // Serial.print(len);
-    // Serial.print(", ");
-    // Serial.write(message.payloads[i].payload, len);
-    // Serial.println();
+  // payloads, read only the first five channels that are due
+  char channels[5];
+  uint8_t n = 0;
+  for (uint8_t i=0; i<CONFIG_MAX_CHANNELS && n<5; i++) {
+    if (availableChannels[i] == 0) break;
+    uint8_t interval = mem.config.channelInterval[i];
+    if (interval == CHANNEL_DISABLED) continue;
+    if (interval > 1 && idx % interval != 0) continue;
+    channels[n] = availableChannels[i];
+    message.payloads[n].channel = availableChannels[i];
+    n++;
   }
+  // start all sensors at once and collect their data in the order they are
+  // ready, this takes as long as the slowest sensor instead of the sum of all
+  measurement.startMeasurements(channels, n);
+  int8_t i;
+  while ((i = measurement.waitForNextReady()) > -1) {
+    // the values are parsed while they arrive so the encoders don't need to
+    // parse the text
+    measurement.collectData(
+      i, message.payloads[i].payload, &message.payloads[i].values);
+  }
+  if (bootTimePending) logBootTime();
+}
+
+/*
+ *  Collect data and construct message
+ */
+size_t getMessage(
+  char *bfr, const char *channels, const int idx, const unsigned long tme
+) {
+  Message message = {0};
+  collectMessage(message, idx, tme);
   // format message for sending
+  if (messageEncoding == ENCODING_BINARY) {
+    return helpers.encodeMessage(message, bfr);
+  }
   return helpers.formatMessage(message, bfr);
 }
 
 /*
- *  Deal with incoming messages
+ *  Keep a message in the log until the tile sent it, hand it to the
+ *  tile right away if there is no log
  */
-void processIncoming() {};
+void storeMessage(const char *message, const size_t len) {
+  if (!messageLog.append(message, len)) tile.queueMessage(message, len);
+}
+
+/*
+ *  Send batched readings to the tile and start a new batch
+ */
+void sendBatch(const unsigned long tme) {
+  char bfr[32];
+  char messageBfr[MAX_MESSAGE_LENGTH];
+  size_t len = batch.encode(messageBfr, messageCounter);
+  sprintf(
+    bfr, "SENDING %lu AT %lu",
+    static_cast<unsigned long>(batch.numberOfEpochs), tme);
+  dspl.printBuffer(bfr);
+  storeMessage(messageBfr, len);
+  batch.reset();
+  messageCounter++;
+}
+
+/*
+ *  Take readings and add them to the batch, send the batch first if the
+ *  readings don't fit anymore
+ */
+void sampleIntoBatch(const unsigned long tme) {
+  char messageBfr[MAX_MESSAGE_LENGTH];
+  Message message = {0};
+  collectMessage(message, messageCounter, tme);
+  if (batch.add(message)) return;
+  if (batch.numberOfEpochs > 0) sendBatch(tme);
+  if (batch.add(message)) return;
+  // a single epoch too large for a batch, send what fits
+  storeMessage(messageBfr, helpers.encodeMessage(message, messageBfr));
+  messageCounter++;
+}
+
+/*
+ *  Send the statistics of the readings so far and start over, one frame per
+ *  channel if they don't fit into a message, the current readings if there
+ *  are none
+ */
+void sendAggregate(const unsigned long tme) {
+  char bfr[48];
+  char messageBfr[MAX_MESSAGE_LENGTH];
+  size_t len;
+  if (aggregate.numberOfSamples == 0 && aggregate.numberOfRejected == 0) {
+    len = getMessage(messageBfr, availableChannels, messageCounter, tme);
+    storeMessage(messageBfr, len);
+    messageCounter++;
+    return;
+  }
+  sprintf(
+    bfr, "SENDING %lu SAMPLES AT %lu",
+    static_cast<unsigned long>(aggregate.numberOfSamples), tme);
+  dspl.printBuffer(bfr);
+  len = aggregate.encode(messageBfr, messageCounter);
+  if (len > 0) {
+    storeMessage(messageBfr, len);
+    messageCounter++;
+  } else {
+    dspl.printBuffer("SUMMARY TOO LARGE, ONE PER CHANNEL");
+    for (uint8_t i=0; i<aggregate.numberOfChannels; i++) {
+      len = aggregate.encode(messageBfr, messageCounter, i, i + 1);
+      if (len == 0) {
+        sprintf(bfr, "SUMMARY OF CHANNEL %d DROPPED", aggregate.channels[i]);
+        dspl.printBuffer(bfr);
+        continue;
+      }
+      storeMessage(messageBfr, len);
+      messageCounter++;
+    }
+  }
+  aggregate.reset();
+}
+
+/*
+ *  Take readings and add them to the statistics, send those first if the
+ *  channel layout changed
+ */
+void sampleIntoAggregate(const unsigned long tme) {
+  Message message = {0};
+  collectMessage(message, messageCounter, tme);
+  if (aggregate.add(message)) return;
+  sendAggregate(tme);
+  aggregate.add(message);
+}
+
+/*
+ *  Take over the settings of the configuration
+ */
+void applyConfig() {
+  measurementFrequencyS = mem.config.measurementFrequencyS;
+  sampleFrequencyS = mem.config.sampleFrequencyS;
+  messageEncoding = mem.config.encoding;
+  batchDepth = mem.config.batchDepth;
+  budget.quota = mem.config.monthlyQuota;
+  budget.minInterval = sampleFrequencyS;
+  budget.month = mem.config.budgetMonth;
+  budget.spent = mem.config.budgetSpent;
+  aggregateFrequencyS = mem.config.aggregateFrequencyS;
+}
+
+/*
+ *  Write the spending of the budget with every message so that a reset
+ *  does not forget any; one EEPROM write is cheap next to a message
+ */
+void persistBudget() {
+  mem.config.budgetMonth = budget.month;
+  mem.config.budgetSpent = budget.spent;
+  mem.commit();
+}
+
+/*
+ *  Send the acknowledgement of the last configuration command; a monthly
+ *  quota pays for it like for readings, if spent it waits for the next
+ *  month. A command raising the quota is acknowledged right away.
+ */
+void sendPendingAck(const unsigned long tme) {
+  if (pendingAckLength == 0) return;
+  if (budget.quota > 0) {
+    if (!budget.charge(tme)) {
+      dspl.printBuffer("QUOTA SPENT, ACK DEFERRED\n");
+      return;
+    }
+    persistBudget();
+  }
+  storeMessage(pendingAck, pendingAckLength);
+  pendingAckLength = 0;
+}
+
+/*
+ *  Take readings and send them if they are worth it and the monthly quota
+ *  allows for it, the spending survives resets, see persistBudget()
+ */
+void sampleWithBudget(const unsigned long tme) {
+  char messageBfr[MAX_MESSAGE_LENGTH];
+  Message message = {0};
+  sendPendingAck(tme);
+  collectMessage(message, messageCounter, tme);
+  if (!budget.due(tme, message)) return;
+  size_t len = messageEncoding == ENCODING_BINARY
+    ? helpers.encodeMessage(message, messageBfr)
+    : helpers.formatMessage(message, messageBfr);
+  storeMessage(messageBfr, len);
+  budget.spend(tme, message);
+  messageCounter++;
+  persistBudget();
+}
+
+/*
+ *  Send what was collected under the old settings before they change
+ */
+void flushReadings(const unsigned long tme) {
+  if (batch.numberOfEpochs > 0) sendBatch(tme);
+  if (aggregate.numberOfSamples > 0) sendAggregate(tme);
+}
+
+/*
+ *  Apply a remote configuration command and acknowledge it with the next
+ *  messages, see src/downlink.h
+ */
+void configure(const char *text, const size_t len, const unsigned long tme) {
+  char bfr[48];
+  DownlinkCommand command;
+  NodeConfig updated = mem.config;
+  const uint8_t status = Downlink::process(downlinkKey, text, len, updated, command);
+  sprintf(
+    bfr, "CONFIG %lu STATUS %d\n",
+    static_cast<unsigned long>(command.sequence), status);
+  dspl.printBuffer(bfr);
+  // nobody to tell
+  if (status == DOWNLINK_BAD_TAG || status == DOWNLINK_REPLAYED) return;
+  if (status == DOWNLINK_APPLIED) flushReadings(tme);
+  for (uint8_t i=0; i<command.numberOfAddressChanges; i++) {
+    const char oldAddr = command.oldAddress[i];
+    const char newAddr = command.newAddress[i];
+    if (measurement.setChannel(oldAddr, newAddr)) {
+      Downlink::renameChannel(updated, oldAddr, newAddr, measurement.identify(newAddr));
+    } else {
+      command.status = DOWNLINK_ADDRESS_FAILED;
+    }
+  }
+  // the sequence is used up either way
+  mem.config = updated;
+  mem.commit();
+  if (status == DOWNLINK_APPLIED) {
+    applyConfig();
+    memcpy(availableChannels, mem.config.channels, CONFIG_MAX_CHANNELS);
+    numberOfChannels = mem.config.numberOfChannels;
+    nextSample = 0;
+    nextScheduled = helpers.getNextScheduled(tme, measurementFrequencyS);
+  }
+  // the latest acknowledgement replaces one still waiting for the quota
+  pendingAckLength = Downlink::encodeAck(command, pendingAck);
+  sendPendingAck(tme);
+}
+
+/*
+ *  Deal with incoming messages, remote configuration commands are the only
+ *  ones so far; everything read is deleted from the tile
+ */
+void processIncoming(const unsigned long tileTime) {
+  char bfr[DOWNLINK_MAX_LENGTH];
+  uint64_t id;
+  if (!Downlink::enabled(downlinkKey) || tileTime <= nextDownlink) return;
+  nextDownlink = helpers.getNextScheduled(tileTime, DOWNLINK_FREQUENCY);
+  for (uint8_t i=0; i<DOWNLINK_PER_CHECK; i++) {
+    id = 0;
+    size_t len = tile.readDownlink(bfr, sizeof(bfr), id);
+    // nothing left or no answer
+    if (id == 0) break;
+    // broken, too long, or not signed with the key: deleted all the same,
+    // the next $MM R=O would return it again otherwise
+    if (len > 0) configure(bfr, len, tileTime);
+    tile.deleteDownlink(id);
+  }
+}
+
+/*
+ *  Boot with the channels of the last boot, one aI! per channel instead of
+ *  probing all addresses; false if a sensor changed or there were none.
+ *  The first readings are taken while the tile boots.
+ */
+boolean fastBoot() {
+  const uint8_t n = mem.config.numberOfChannels;
+  if (n == 0) return false;
+  dspl.printBuffer("FAST BOOT\n");
+  if (!measurement.verifyChannels(mem.config.channels, mem.config.channelIds, n)) {
+    dspl.printBuffer("SENSORS CHANGED\n");
+    return false;
+  }
+  memcpy(availableChannels, mem.config.channels, CONFIG_MAX_CHANNELS);
+  numberOfChannels = n;
+  // written with the boot time, see logBootTime()
+  mem.config.boots++;
+  // the tile takes seconds to boot and the GPS longer for a fix
+  tile.reset();
+  firstMessageTaken = millis();
+  collectMessage(firstMessage, 0, 0);
+  firstMessageReady = true;
+  tile.begin(tileTimeFrequency);
+  dspl.printBuffer("TILE INIT SUCCESSFUL\n");
+  return true;
+}
 
 /*
  *  Setup
@@ -158,14 +612,30 @@ void setup() {
   esp_wifi_set_mode(WIFI_MODE_NULL);
   btStop();
   // Serial.begin(115200);
+  if (profileToSerial) Serial.begin(115200);
   // Initialize display and add some boiler plate
   dspl.begin();
+  // unsent messages from before a reset or deep sleep are still there
+  flash.begin();
+  messageLog.begin();
+  // the only time the configuration is read
+  mem.begin();
+  applyConfig();
+  tile.attachClock(&localClock);
+  // the tile keeps running while we sleep, go straight to the loop
+  if (useDeepSleep && loopState.restore(sleeper)) return;
+  bootTimePending = true;
+  // a button held at reset gets to the setup screens
+  if (useFastBoot && !dspl.button(BUTTON_A) && !dspl.button(BUTTON_B) &&
+    !dspl.button(BUTTON_C) && fastBoot()
+  ) {
+    return;
+  }
   dspl.printBuffer(
     "SWARM node v0.0.5\nfalk.schuetzenmeister@tnc.org\nJune 2022");
   // we can use buttons to advance
   waitForButtonA(dspl, 3000);
   dspl.resetDisplay();
-  measurementFrequencyS = mem.getMeasurementFrequency(DEFAULT_SEND_FREQUENCY);
   sprintf(
     bfr, "Reporting frequency:\n\n%d seconds", measurementFrequencyS);
   dspl.printBuffer(bfr);
@@ -173,7 +643,7 @@ void setup() {
   // wait for input to get into setup routine
   if (waitForButtonA(dspl, 3000)) {
     // this will not exit and requires a reset
-    stp.setupFrequency(dspl);
+    stp.setupFrequency(dspl, mem);
   }
   // print sensor information
   dspl.resetDisplay();
@@ -185,14 +655,21 @@ void setup() {
   dspl.printBuffer(bfr);
   waitForButtonA(dspl, 2000);
   dspl.resetDisplay();
+  memset(mem.config.channelIds, 0, sizeof(mem.config.channelIds));
   for (size_t i=0; i<numberOfChannels; i++) {
     len = measurement.getInfo(bfr, availableChannels[i]);
+    // verified by the next fast boot
+    mem.config.channelIds[i] = SDI12Measurement::identity(bfr, len);
     dspl.print(availableChannels[i]);
     dspl.print(':');
     dspl.printBuffer(bfr, len);
     dspl.print('\n');
     waitForButtonA(dspl, 2000);
   };
+  // written with the boot time, see logBootTime()
+  memcpy(mem.config.channels, availableChannels, CONFIG_MAX_CHANNELS);
+  mem.config.numberOfChannels = numberOfChannels;
+  mem.config.boots++;
   dspl.printBuffer("\nPUSH BUTTON (A) TO CHANGE ADDRESSES\n");
   // wait for input to get into setup routine
   if (waitForButtonA(dspl, 3000)) {
@@ -213,38 +690,159 @@ void setup() {
   waitForButtonA(dspl, 3000);
 }
 
+/*
+ *  Tile time of the next reading or message
+ */
+unsigned long nextEventTime() {
+  unsigned long ret = nextScheduled;
+  if (budget.quota > 0) ret = nextSample;
+  if ((batchDepth > 1 || aggregateFrequencyS > 0) && nextSample < ret) {
+    ret = nextSample;
+  }
+  return ret;
+}
+
+/*
+ *  Tile time from the local clock if it is good enough, from $DT @ otherwise
+ *  which fixes the clock; 0 if the tile does not answer
+ */
+unsigned long currentTime() {
+  if (useLocalClock && localClock.trusted(millis())) return localClock.now(millis());
+  return tile.queryTime();
+}
+
+/*
+ *  Put the tile to sleep until the next event if it has nothing to send,
+ *  returns how long the MCU can sleep, 0 if the tile stays awake
+ */
+unsigned long sleepTile(const unsigned long tileTime) {
+  if (messageLog.numberOfPending > 0) return 0;
+  if (TileSleep::duration(
+    tileTime, nextEventTime(), tileTimeFrequency, DEEP_SLEEP_LEAD) == 0) return 0;
+  // messages in the tile need the radio until the next satellite pass
+  if (tile.unsentMessages() != 0) return 0;
+  // tileTime may be a time report that waited in the UART for up to
+  // tileTimeFrequency, the wake-up needs the time now
+  const unsigned long duration = TileSleep::duration(
+    currentTime(), nextEventTime(), tileTimeFrequency, DEEP_SLEEP_LEAD);
+  if (duration == 0 || !tile.sleep(duration)) return 0;
+  return tileSleep.slept(duration);
+}
+
+/*
+ *  Show the profile of the cycles so far
+ */
+void printProfile() {
+  char bfr[256];
+  size_t len = Profiler::global().report(bfr, sizeof(bfr));
+  if (profileToSerial) Serial.write(bfr, len);
+  if (dspl.button(BUTTON_B)) {
+    dspl.resetDisplay();
+    dspl.printBuffer(bfr, len);
+  }
+}
+
 void loop() {
   size_t len;
   char bfr[32];
-  char commandBfr[16];
   char messageBfr[192];
-  // control when loop advances, SWARM tile controls timing
-  unsigned long tileTime = tile.waitForTimeStamp();
+  Profiler::global().beginCycle();
+  // control when loop advances, SWARM tile controls timing unless the
+  // local clock does; after sleep the tile does not report the time by
+  // itself right away
+  unsigned long tileTime = 0;
+  if (tileSleep.asleep) {
+    tileTime = tile.queryTime();
+    tileSleep.woke();
+  } else if (useLocalClock) {
+    // time reports nobody waits for, other lines go to their listeners
+    tile.poll();
+    tileTime = currentTime();
+  }
+  if (tileTime == 0) tileTime = tile.waitForTimeStamp();
   /*
    *  1. check and process incoming messages
    */
-  processIncoming();
+  processIncoming(tileTime);
   /*
    *  2. send messages according schedule
    */
-  if (tileTime > nextScheduled) {
+  if (budget.quota > 0) {
+    if (tileTime > nextSample) {
+      sampleWithBudget(tileTime);
+      nextSample = helpers.getNextScheduled(tileTime, sampleFrequencyS);
+    }
+  } else if (batchDepth > 1) {
+    if (tileTime > nextSample) {
+      sampleIntoBatch(tileTime);
+      nextSample = helpers.getNextScheduled(tileTime, sampleFrequencyS);
+    }
+    if (batch.numberOfEpochs >= batchDepth ||
+      (tileTime > nextScheduled && batch.numberOfEpochs > 0)
+    ) {
+      sendBatch(tileTime);
+      nextScheduled = helpers.getNextScheduled(tileTime, measurementFrequencyS);
+    }
+  } else if (aggregateFrequencyS > 0) {
+    if (tileTime > nextSample) {
+      sampleIntoAggregate(tileTime);
+      nextSample = helpers.getNextScheduled(tileTime, aggregateFrequencyS);
+    }
+    // even if every sample was out of range
+    if (tileTime > nextScheduled) {
+      sendAggregate(tileTime);
+      nextScheduled = helpers.getNextScheduled(tileTime, measurementFrequencyS);
+    }
+  } else if (tileTime > nextScheduled) {
     len = getMessage(messageBfr, availableChannels, messageCounter, tileTime);
     // Serial.write(messageBfr, len);
     // Serial.println();
+    // forwarded to the SWARM tile from the log below
+    storeMessage(messageBfr, len);
     sprintf(bfr, "SENDING AT %d", tileTime);
     dspl.printBuffer(bfr);
-    // send to SWARM tile
-    tile.sendMessage(messageBfr, len);
     // schedule next message
     nextScheduled = helpers.getNextScheduled(tileTime, measurementFrequencyS);
     // increase counter
     messageCounter++;
   }
   /*
-   *  3. power management
+   *  3. hand stored messages to the tile, anything it does not accept is
+   *     tried again next cycle; they stay in the log until the tile sent
+   *     them
+   */
+  tile.forwardMessages(messageLog, LOG_FORWARD_PER_CYCLE, tileTime);
+  /*
+   *  4. power management
    */
-   // len = sprintf(commandBfr, "$SL S=%d", tileTimeFrequency);
-   // tile.tileCommand(commandBfr, len, bfr);
-   esp_sleep_enable_timer_wakeup(tileTimeFrequency * uS_TO_S_FACTOR);
-   esp_light_sleep_start();
+   // don't sleep through the responses of the tile
+   tile.waitForCommands();
+   // text held back by the frame interval, blanks the display if idle
+   dspl.display();
+   dspl.update();
+   // the tile wakes by itself, the MCU sleeps as long
+   unsigned long tileSleepS = useTileSleep ? sleepTile(tileTime) : 0;
+   if (useDeepSleep) {
+     unsigned long duration = tileSleepS;
+     if (duration == 0) {
+       duration = SleepWrapperBase::sleepDuration(
+         tileTime, nextEventTime(), tileTimeFrequency, DEEP_SLEEP_LEAD);
+     }
+     // not worth a restart otherwise
+     if (duration > tileTimeFrequency) {
+       // the profile does not survive deep sleep
+       Profiler::global().endCycle();
+       printProfile();
+       // millis() starts over
+       localClock.suspend(millis(), duration);
+       loopState.save(sleeper);
+       sleeper.deepSleep(duration);
+     }
+   }
+   {
+     ProfileScope scope(PHASE_SLEEP);
+     sleeper.lightSleep(tileSleepS > 0 ? tileSleepS : tileTimeFrequency);
+   }
+   Profiler::global().endCycle();
+   printProfile();
 }
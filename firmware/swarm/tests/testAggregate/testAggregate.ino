@@ -0,0 +1,265 @@
+// this fixes a bug in Aunit.h dependencies
+#line 2 "testAggregate.ino"
+
+#include <AUnitVerbose.h>
+using namespace aunit;
+
+// There is a problem in Arduino; the import from relative paths that
+// are not children of the sketch path is not supported.
+// I am HACKING this with a symlink to the src directory for now.
+
+#include "src/aggregate.h"
+
+
+void fillMessage(
+  Message &message, unsigned long timeStamp, float batteryVoltage,
+  const char *leafWetness, const char *teros12, const char *unknown
+) {
+  message = {0};
+  message.timeStamp = timeStamp;
+  message.batteryVoltage = batteryVoltage;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = 52;
+  strcpy(message.payloads[0].payload, leafWetness);
+  message.payloads[1].channel = 53;
+  strcpy(message.payloads[1].payload, teros12);
+  message.payloads[2].channel = 56;
+  strcpy(message.payloads[2].payload, unknown);
+}
+
+/*
+ *  ATMOS 41 with precipitation and lightning strikes since the last reading
+ */
+void fillAtmos41(
+  Message &message, unsigned long timeStamp, const char *precipitation,
+  const int strikes, const float airTemperature,
+  const char *windDirection = "109.1"
+) {
+  message = {0};
+  message.timeStamp = timeStamp;
+  message.batteryVoltage = 3.7;
+  message.payloads[0].channel = 51;
+  snprintf(
+    message.payloads[0].payload, sizeof(message.payloads[0].payload),
+    "+552+%s+%d+0+0.67+%s+1.79%+.1f+1.68+101.28+0.446+36.3+1.2+0.4+0"
+    "-0.22+0.64+1.79", precipitation, strikes, windDirection, airTemperature);
+}
+
+
+test(welford) {
+  MessageAggregate aggregate;
+  Message message;
+  const float temperatures[] = {16.1, 16.0, 15.8, 16.4, 17.0, 16.9};
+  for (uint8_t i=0; i<6; i++) {
+    char teros12[32];
+    snprintf(teros12, sizeof(teros12), "+2038.84%+.1f+39", temperatures[i]);
+    fillMessage(message, 1000 + 60 * i, 3.6 - 0.01 * i, "+0.00", teros12, "+1.5-2");
+    assertTrue(aggregate.add(message));
+  }
+  // two-pass in tenths of a degree
+  float mean = 0;
+  for (uint8_t i=0; i<6; i++) mean += temperatures[i] * 10 / 6;
+  float m2 = 0;
+  for (uint8_t i=0; i<6; i++) {
+    m2 += (temperatures[i] * 10 - mean) * (temperatures[i] * 10 - mean);
+  }
+  assertEqual(static_cast<int>(aggregate.numberOfSamples), 6);
+  assertEqual(static_cast<long>(aggregate.lastTimeStamp - aggregate.firstTimeStamp), 300L);
+  assertEqual(static_cast<long>(aggregate.batteryVoltage), 355L);
+  assertEqual(static_cast<long>(aggregate.fields[2].min), 158L);
+  assertEqual(static_cast<long>(aggregate.fields[2].max), 170L);
+  assertEqual(static_cast<long>(aggregate.fields[2].sum), 982L);
+  assertNear(aggregate.fields[2].mean, mean, 0.001);
+  assertNear(aggregate.variance(2), m2 / 5, 0.001);
+  // constant values
+  assertNear(aggregate.fields[1].mean, 203884., 0.5);
+  assertNear(aggregate.variance(1), 0., 0.001);
+}
+
+/*
+ *  Precipitation and lightning are summed up exactly
+ */
+test(accumulators) {
+  MessageAggregate aggregate;
+  Message message;
+  const char *precipitation[] = {"0.000", "0.127", "0.254", "0.000", "1.016"};
+  for (uint8_t i=0; i<5; i++) {
+    fillAtmos41(message, 1000 + 60 * i, precipitation[i], i % 2, 28.3 + i);
+    assertTrue(aggregate.add(message));
+  }
+  assertEqual(static_cast<int>(aggregate.numberOfValues), 18);
+  assertEqual(static_cast<int>(aggregate.aggregations[0]), FIELD_GAUGE);
+  assertEqual(static_cast<int>(aggregate.aggregations[1]), FIELD_ACCUMULATOR);
+  assertEqual(static_cast<int>(aggregate.aggregations[2]), FIELD_ACCUMULATOR);
+  assertEqual(static_cast<long>(aggregate.fields[1].sum), 1397L);
+  assertEqual(static_cast<long>(aggregate.fields[1].max), 1016L);
+  assertEqual(static_cast<long>(aggregate.fields[2].sum), 2L);
+  assertNear(aggregate.fields[7].mean, 303., 0.01);
+  // all 18 fields fit into one message
+  char bfr[MAX_MESSAGE_LENGTH];
+  size_t len = aggregate.encode(bfr, 7);
+  assertMore(static_cast<int>(len), 0);
+  assertLess(static_cast<int>(len), MAX_MESSAGE_LENGTH);
+}
+
+/*
+ *  Same frame is decoded in payload_decoder/test.js
+ */
+test(encodeSummary) {
+  MessageAggregate aggregate;
+  Message message;
+  char bfr[MAX_MESSAGE_LENGTH];
+  const uint8_t expected[] = {
+    0x03, 0x0c, 0x80, 0x90, 0xab, 0x61, 0x78, 0x03, 0x00, 0xe6, 0x02, 0x03,
+    0x34, 0x01, 0x35, 0x03, 0x38, 0x82, 0x01, 0x00, 0x00, 0x05, 0x0a, 0x05,
+    0xd8, 0xf1, 0x18, 0x72, 0xd8, 0x01, 0x6c, 0xbc, 0x02, 0x02, 0x03, 0x02,
+    0x4e, 0x01, 0x02, 0x01, 0x1e, 0x02, 0x03, 0x02, 0x03, 0x00, 0x01, 0x01};
+  fillMessage(message, 1638633600, 3.59, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+  assertTrue(aggregate.add(message));
+  fillMessage(message, 1638633660, 3.58, "+0.05", "+2040.10+16.0+41", "+1.7-2");
+  assertTrue(aggregate.add(message));
+  fillMessage(message, 1638633720, 3.58, "+0.10", "+2041.00+15.8+40", "+1.8-1");
+  assertTrue(aggregate.add(message));
+  size_t len = aggregate.encode(bfr, 12);
+  assertEqual(static_cast<int>(len), static_cast<int>(sizeof(expected)));
+  for (size_t i=0; i<len; i++) {
+    assertEqual(static_cast<uint8_t>(bfr[i]), expected[i]);
+  }
+}
+
+/*
+ *  Wind from 359 and 1 degree is wind from the north, not from the south
+ */
+test(windDirection) {
+  MessageAggregate aggregate;
+  Message message;
+  const char *directions[] = {"359.0", "1.0", "359.0", "1.0"};
+  for (uint8_t i=0; i<4; i++) {
+    fillAtmos41(message, 1000 + 60 * i, "0.000", 0, 20.0, directions[i]);
+    assertTrue(aggregate.add(message));
+  }
+  assertEqual(static_cast<int>(aggregate.aggregations[5]), FIELD_DIRECTION);
+  const float mean = aggregate.circularMean(5);
+  assertTrue(mean < 0.01 || mean > 359.99);
+  assertNear(aggregate.circularStdDev(5), 1., 0.01);
+  char bfr[MAX_MESSAGE_LENGTH];
+  assertMore(static_cast<int>(aggregate.encode(bfr, 0)), 0);
+  // opposite directions cancel out
+  aggregate.reset();
+  fillAtmos41(message, 1000, "0.000", 0, 20.0, "90.0");
+  assertTrue(aggregate.add(message));
+  fillAtmos41(message, 1060, "0.000", 0, 20.0, "270.0");
+  assertTrue(aggregate.add(message));
+  assertMore(aggregate.circularStdDev(5), 180.0f);
+}
+
+/*
+ *  A missing value changes the layout and requires a new aggregate
+ */
+test(aggregateLayoutChange) {
+  MessageAggregate aggregate;
+  Message message;
+  fillMessage(message, 1000, 3.5, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+  assertTrue(aggregate.add(message));
+  fillMessage(message, 1060, 3.5, "+0.00", "+2038.84+16.1", "+1.5-2");
+  assertFalse(aggregate.add(message));
+  message.payloads[1].channel = 0;
+  assertFalse(aggregate.add(message));
+  // time going backwards
+  fillMessage(message, 900, 3.5, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+  assertFalse(aggregate.add(message));
+  assertEqual(static_cast<int>(aggregate.numberOfSamples), 1);
+  aggregate.reset();
+  assertEqual(static_cast<int>(aggregate.encode(NULL, 0)), 0);
+  // a new layout after reset
+  fillMessage(message, 1060, 3.5, "+0.00", "+2038.84+16.1", "+1.5-2");
+  assertTrue(aggregate.add(message));
+  assertEqual(static_cast<int>(aggregate.numberOfValues), 5);
+}
+
+/*
+ *  A sensor error would spoil the statistics, only the value out of range
+ *  is left out; same frame is decoded in payload_decoder/test.js
+ */
+test(outOfRange) {
+  MessageAggregate aggregate;
+  Message message;
+  char bfr[MAX_MESSAGE_LENGTH];
+  const uint8_t expected[] = {
+    0x03, 0x0c, 0x80, 0x90, 0xab, 0x61, 0x88, 0x0e, 0x03, 0x02, 0xe6, 0x02,
+    0x03, 0x34, 0x41, 0x35, 0x43, 0x38, 0x82, 0x01, 0x00, 0x01, 0x00, 0x05,
+    0x0a, 0x07, 0x00, 0xd8, 0xf1, 0x18, 0x72, 0xd8, 0x01, 0x6c, 0x01, 0xbc,
+    0x02, 0x01, 0x02, 0x01, 0x00, 0x4e, 0x01, 0x02, 0x01, 0x1e, 0x02, 0x03,
+    0x02, 0x03, 0x00, 0x01, 0x01};
+  fillMessage(message, 1638633600, 3.59, "+0.00", "+2038.84-9999.0+39", "+1.5-2");
+  assertTrue(aggregate.add(message));
+  fillMessage(message, 1638634500, 3.58, "+101.00", "+2040.10+16.0+41", "+1.7-2");
+  assertTrue(aggregate.add(message));
+  fillMessage(message, 1638635400, 3.58, "+0.10", "+2041.00+15.8+40", "+1.8-1");
+  assertTrue(aggregate.add(message));
+  assertEqual(static_cast<int>(aggregate.numberOfSamples), 3);
+  assertEqual(static_cast<int>(aggregate.numberOfRejected), 2);
+  assertEqual(static_cast<int>(aggregate.fields[2].rejected), 1);
+  assertEqual(static_cast<long>(aggregate.fields[2].min), 158L);
+  assertNear(aggregate.fields[2].mean, 159., 0.001);
+  // the other values of the channel use all samples
+  assertEqual(static_cast<int>(aggregate.fields[1].rejected), 0);
+  assertEqual(static_cast<long>(aggregate.fields[1].min), 203884L);
+  size_t len = aggregate.encode(bfr, 12);
+  assertEqual(static_cast<int>(len), static_cast<int>(sizeof(expected)));
+  for (size_t i=0; i<len; i++) {
+    assertEqual(static_cast<uint8_t>(bfr[i]), expected[i]);
+  }
+  // nothing but errors, no statistics for soilTemp_C
+  aggregate.reset();
+  fillMessage(message, 1060, 3.5, "+0.00", "+2038.84-9999.0+39", "+1.5-2");
+  assertTrue(aggregate.add(message));
+  const size_t all = aggregate.encode(bfr, 0);
+  aggregate.reset();
+  fillMessage(message, 1060, 3.5, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+  assertTrue(aggregate.add(message));
+  // three counts instead of the five bytes of the statistics of soilTemp_C
+  assertEqual(static_cast<int>(all), static_cast<int>(aggregate.encode(bfr, 0)) - 2);
+}
+
+/*
+ *  Statistics that don't fit into a message are not sent truncated but one
+ *  channel per frame
+ */
+test(summaryTooLarge) {
+  MessageAggregate aggregate;
+  Message message = {0};
+  for (uint8_t i=0; i<5; i++) {
+    message.payloads[i].channel = 60 + i;
+    strcpy(
+      message.payloads[i].payload,
+      "+1.234567+2.234567+3.234567+4.234567+5.234567+6.234567+7.234567"
+      "+8.234567+9.234567");
+  }
+  assertTrue(aggregate.add(message));
+  message.timeStamp = 60;
+  message.payloads[0].payload[1] = '9';
+  assertTrue(aggregate.add(message));
+  char bfr[MAX_MESSAGE_LENGTH];
+  assertEqual(static_cast<int>(aggregate.encode(bfr, 0)), 0);
+  for (uint8_t i=0; i<5; i++) {
+    const size_t len = aggregate.encode(bfr, i, i, i + 1);
+    assertMore(static_cast<int>(len), 0);
+    // one channel with the values of that channel
+    assertEqual(static_cast<uint8_t>(bfr[10]), static_cast<uint8_t>(1));
+    assertEqual(static_cast<uint8_t>(bfr[11]), static_cast<uint8_t>(60 + i));
+  }
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  while(!Serial);
+  // TestRunner::exclude("*");
+  // TestRunner::include("welford");
+}
+
+void loop() {
+  aunit::TestRunner::run();
+}
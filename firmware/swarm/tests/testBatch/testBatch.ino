@@ -0,0 +1,145 @@
+// this fixes a bug in Aunit.h dependencies
+#line 2 "testBatch.ino"
+
+#include <AUnitVerbose.h>
+using namespace aunit;
+
+// There is a problem in Arduino; the import from relative paths that
+// are not children of the sketch path is not supported.
+// I am HACKING this with a symlink to the src directory for now.
+
+#include "src/batch.h"
+
+
+void fillMessage(
+  Message &message, unsigned long timeStamp, float batteryVoltage,
+  const char *leafWetness, const char *teros12, const char *unknown
+) {
+  message = {0};
+  message.timeStamp = timeStamp;
+  message.batteryVoltage = batteryVoltage;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = 52;
+  strcpy(message.payloads[0].payload, leafWetness);
+  message.payloads[1].channel = 53;
+  strcpy(message.payloads[1].payload, teros12);
+  message.payloads[2].channel = 56;
+  strcpy(message.payloads[2].payload, unknown);
+}
+
+/*
+ *  Same frame is decoded in payload_decoder/test.js
+ */
+test(encodeBatch) {
+  MessageBatch batch;
+  Message message;
+  char bfr[MAX_MESSAGE_LENGTH];
+  const uint8_t expected[] = {
+    0x02, 0x0c, 0x80, 0x90, 0xab, 0x61, 0xe7, 0x02, 0x03, 0x03, 0x34, 0x01,
+    0x35, 0x03, 0x38, 0x82, 0x01, 0x00, 0x00, 0xd8, 0xf1, 0x18, 0xc2, 0x02,
+    0x4e, 0x1e, 0x03, 0x84, 0x07, 0x01, 0x0a, 0xfc, 0x01, 0x01, 0x04, 0x04,
+    0x00, 0x84, 0x07, 0x00, 0x09, 0xb4, 0x01, 0x03, 0x01, 0x02, 0x02};
+  fillMessage(message, 1638633600, 3.59, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+  assertTrue(batch.add(message));
+  fillMessage(message, 1638634500, 3.58, "+0.05", "+2040.10+16.0+41", "+1.7-2");
+  assertTrue(batch.add(message));
+  fillMessage(message, 1638635400, 3.58, "+0.00", "+2041.00+15.8+40", "+1.8-1");
+  assertTrue(batch.add(message));
+  // more decimals than the first epoch of the self-describing channel
+  fillMessage(message, 1638636300, 3.58, "+0.00", "+2041.00+15.8+40", "+1.75-1");
+  assertFalse(batch.add(message));
+  assertEqual(static_cast<int>(batch.numberOfEpochs), 3);
+  size_t len = batch.encode(bfr, 12);
+  assertEqual(static_cast<int>(len), static_cast<int>(sizeof(expected)));
+  for (size_t i=0; i<len; i++) {
+    assertEqual(static_cast<uint8_t>(bfr[i]), expected[i]);
+  }
+}
+
+/*
+ *  Values out of range are left out of their epoch only, same frame is
+ *  decoded in payload_decoder/test.js
+ */
+test(batchOutOfRange) {
+  MessageBatch batch;
+  Message message;
+  char bfr[MAX_MESSAGE_LENGTH];
+  const uint8_t expected[] = {
+    0x02, 0x0c, 0x80, 0x90, 0xab, 0x61, 0xe7, 0x02, 0x03, 0x03, 0x34, 0x41,
+    0x35, 0x43, 0x38, 0x82, 0x01, 0x00, 0x00, 0x00, 0x02, 0xd8, 0xf1, 0x18,
+    0x4e, 0x1e, 0x03, 0x84, 0x07, 0x01, 0x01, 0x00, 0xfc, 0x01, 0xc0, 0x02,
+    0x04, 0x04, 0x00, 0x84, 0x07, 0x00, 0x00, 0x14, 0x00, 0xb4, 0x01, 0x03,
+    0x01, 0x02, 0x02};
+  fillMessage(message, 1638633600, 3.59, "+0.00", "+2038.84-9999.0+39", "+1.5-2");
+  assertTrue(batch.add(message));
+  fillMessage(message, 1638634500, 3.58, "+101.00", "+2040.10+16.0+41", "+1.7-2");
+  assertTrue(batch.add(message));
+  fillMessage(message, 1638635400, 3.58, "+0.10", "+2041.00+15.8+40", "+1.8-1");
+  assertTrue(batch.add(message));
+  size_t len = batch.encode(bfr, 12);
+  assertEqual(static_cast<int>(len), static_cast<int>(sizeof(expected)));
+  for (size_t i=0; i<len; i++) {
+    assertEqual(static_cast<uint8_t>(bfr[i]), expected[i]);
+  }
+}
+
+/*
+ *  A missing value changes the layout and requires a new batch
+ */
+test(batchLayoutChange) {
+  MessageBatch batch;
+  Message message;
+  fillMessage(message, 1000, 3.5, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+  assertTrue(batch.add(message));
+  fillMessage(message, 1900, 3.5, "+0.00", "+2038.84+16.1", "+1.5-2");
+  assertFalse(batch.add(message));
+  message.payloads[1].channel = 0;
+  assertFalse(batch.add(message));
+  // time going backwards
+  fillMessage(message, 900, 3.5, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+  assertFalse(batch.add(message));
+  assertEqual(static_cast<int>(batch.numberOfEpochs), 1);
+  batch.reset();
+  assertEqual(static_cast<int>(batch.encode(NULL, 0)), 0);
+}
+
+/*
+ *  Batch is limited by MAX_BATCH_DEPTH and by MAX_MESSAGE_LENGTH
+ */
+test(batchFull) {
+  MessageBatch batch;
+  Message message;
+  char bfr[MAX_MESSAGE_LENGTH];
+  for (size_t i=0; i<MAX_BATCH_DEPTH; i++) {
+    fillMessage(message, 1000 + 900 * i, 3.5, "+0.00", "+2038.84+16.1+39", "+1.5-2");
+    assertTrue(batch.add(message));
+  }
+  assertFalse(batch.add(message));
+  batch.reset();
+  // large jumps need more bytes per epoch
+  size_t i = 0;
+  while (true) {
+    fillMessage(
+      message, 1000 + 900 * i, 3.5, "+0.00",
+      i % 2 ? "+2038.84+16.1+39" : "+9038.84-16.1+9039",
+      i % 2 ? "+9999999-9999999" : "-9999999+9999999");
+    if (!batch.add(message)) break;
+    i++;
+  }
+  assertLess(static_cast<int>(batch.numberOfEpochs), MAX_BATCH_DEPTH);
+  size_t len = batch.encode(bfr, 4294967295UL);
+  assertLessOrEqual(static_cast<int>(len), MAX_MESSAGE_LENGTH);
+  assertMore(static_cast<int>(len), MAX_MESSAGE_LENGTH - 20);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  while(!Serial);
+  // TestRunner::exclude("*");
+  // TestRunner::include("encodeBatch");
+}
+
+void loop() {
+  aunit::TestRunner::run();
+}
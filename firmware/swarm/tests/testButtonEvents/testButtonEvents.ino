@@ -0,0 +1,160 @@
+// this fixes a bug in Aunit.h dependencies
+#line 2 "testButtonEvents.ino"
+
+#include <AUnitVerbose.h>
+using namespace aunit;
+
+// There is a problem in Arduino; the import from relative paths that
+// are not children of the sketch path is not supported.
+// I am HACKING this with a symlink to the src directory for now.
+
+#include "src/displayWrapper.h"
+
+
+boolean eventIs(
+  ButtonEvent &event, const uint8_t button, const uint8_t type, const unsigned long time
+) {
+  return event.button == button && event.type == type && event.time == time;
+}
+
+
+// edges like the interrupt handler sees them, times in ms
+test(pressBounces) {
+  ButtonEvents buttons;
+  ButtonEvent event;
+  buttons.edge(0, true, 100);
+  buttons.edge(0, false, 102);
+  buttons.edge(0, true, 104);
+  buttons.edge(0, false, 105);
+  buttons.edge(0, true, 107);
+  assertFalse(buttons.next(event, 120));
+  assertTrue(buttons.next(event, 137));
+  assertTrue(eventIs(event, 0, BUTTON_PRESSED, 137));
+  assertFalse(buttons.next(event, 200));
+  buttons.edge(0, false, 300);
+  buttons.edge(0, true, 301);
+  buttons.edge(0, false, 303);
+  assertTrue(buttons.next(event, 340));
+  assertTrue(eventIs(event, 0, BUTTON_RELEASED, 333));
+  assertFalse(buttons.down(0));
+}
+
+
+// shorter than the debounce time
+test(glitchIgnored) {
+  ButtonEvents buttons;
+  ButtonEvent event;
+  buttons.edge(1, true, 100);
+  buttons.edge(1, false, 110);
+  assertFalse(buttons.next(event, 1000));
+  assertTrue(buttons.empty());
+}
+
+
+// the UI looks long after a short press
+test(latePressKept) {
+  ButtonEvents buttons;
+  ButtonEvent event;
+  buttons.edge(2, true, 100);
+  buttons.edge(2, false, 180);
+  assertTrue(buttons.next(event, 5000));
+  assertTrue(eventIs(event, 2, BUTTON_PRESSED, 130));
+  assertTrue(buttons.next(event, 5000));
+  assertTrue(eventIs(event, 2, BUTTON_RELEASED, 210));
+  assertFalse(buttons.next(event, 5000));
+}
+
+
+// presses of two buttons overlap, each keeps its own debounce
+test(buttonsIndependent) {
+  ButtonEvents buttons;
+  ButtonEvent event;
+  buttons.edge(0, true, 100);
+  buttons.edge(1, true, 120);
+  buttons.edge(1, false, 122);
+  buttons.edge(1, true, 125);
+  buttons.edge(0, false, 400);
+  buttons.edge(1, false, 500);
+  assertTrue(buttons.next(event, 1000));
+  assertTrue(eventIs(event, 0, BUTTON_PRESSED, 130));
+  assertTrue(buttons.next(event, 1000));
+  assertTrue(eventIs(event, 1, BUTTON_PRESSED, 155));
+  assertTrue(buttons.next(event, 1000));
+  assertTrue(eventIs(event, 0, BUTTON_RELEASED, 430));
+  assertTrue(buttons.next(event, 1000));
+  assertTrue(eventIs(event, 1, BUTTON_RELEASED, 530));
+  assertFalse(buttons.next(event, 1000));
+}
+
+
+test(holdRepeats) {
+  ButtonEvents buttons;
+  ButtonEvent event;
+  buttons.edge(1, true, 100);
+  assertFalse(buttons.next(event, 110));
+  assertEqual(buttons.wakeIn(110), 20UL);
+  assertTrue(buttons.next(event, 130));
+  assertTrue(eventIs(event, 1, BUTTON_PRESSED, 130));
+  assertFalse(buttons.next(event, 1000));
+  assertEqual(buttons.wakeIn(1000), 130UL);
+  assertTrue(buttons.next(event, 1130));
+  assertTrue(eventIs(event, 1, BUTTON_REPEATED, 1130));
+  assertTrue(buttons.next(event, 1335));
+  assertTrue(eventIs(event, 1, BUTTON_REPEATED, 1330));
+  assertFalse(buttons.next(event, 1335));
+  buttons.edge(1, false, 1400);
+  assertTrue(buttons.next(event, 1430));
+  assertTrue(eventIs(event, 1, BUTTON_RELEASED, 1430));
+  assertEqual(buttons.wakeIn(1430), BUTTON_NO_WAKE);
+}
+
+
+// a level read after sleep, the handler's edge comes late
+test(sampleMissedEdge) {
+  ButtonEvents buttons;
+  ButtonEvent event;
+  buttons.sample(0, true, 100);
+  buttons.edge(0, true, 101);
+  assertTrue(buttons.next(event, 130));
+  assertTrue(eventIs(event, 0, BUTTON_PRESSED, 130));
+  assertFalse(buttons.next(event, 131));
+}
+
+
+test(queueOverflow) {
+  ButtonEvents buttons;
+  ButtonEvent event;
+  for (uint8_t i=0; i<BUTTON_QUEUE_SIZE + 8; i++) {
+    buttons.edge(0, i % 2 == 0, 100 + i);
+  }
+  assertEqual(buttons.overflows, 9UL);
+  // the last queued edge was a press
+  assertTrue(buttons.next(event, 1000));
+  assertTrue(eventIs(event, 0, BUTTON_PRESSED, 160));
+}
+
+
+// nothing pressed, the wait sleeps instead of polling
+test(waitTimesOut) {
+  DisplayWrapper display;
+  display.begin();
+  ButtonEvent event;
+  const unsigned long start = millis();
+  assertFalse(display.nextEvent(event, 1000));
+  assertMoreOrEqual(millis() - start, 1000UL);
+  assertMoreOrEqual(display.sleeps, 1UL);
+  assertLessOrEqual(display.sleeps, 5UL);
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  while(!Serial);
+  // TestRunner::exclude("*");
+  // TestRunner::include("pressBounces");
+}
+
+void loop() {
+  aunit::TestRunner::run();
+}
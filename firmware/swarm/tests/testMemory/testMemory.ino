@@ -5,7 +5,7 @@
  */
 
 // this fixes a bug in Aunit.h dependencies
-#line 2 "testMessage.ino"
+#line 2 "testMemory.ino"
 
 #include <AUnitVerbose.h>
 using namespace aunit;
@@ -18,9 +18,123 @@ using namespace aunit;
 
 PersistentMemory mem = PersistentMemory();
 
+/*
+ *  Overwrite the configuration with a pattern
+ */
+void clobber(uint8_t value) {
+  EEPROM.begin(EEPROM_SIZE);
+  for (size_t i=0; i<EEPROM_SIZE; i++) EEPROM.write(i, value);
+  EEPROM.commit();
+}
+
 test(testMemory) {
-  mem.writeFrequency(111111);
-  assertEqual(static_cast<int>(mem.readFrequency()), 111111);
+  mem.begin();
+  mem.writeFrequency(7200);
+  assertEqual(static_cast<int>(mem.readFrequency()), 7200);
+  // out of range
+  assertFalse(mem.writeFrequency(111111));
+  assertEqual(static_cast<int>(mem.readFrequency()), 7200);
+}
+
+test(roundTrip) {
+  PersistentMemory written;
+  PersistentMemory read;
+  clobber(0xFF);
+  assertFalse(written.begin());
+  written.config.measurementFrequencyS = 1800;
+  written.config.batchDepth = 4;
+  memcpy(written.config.channels, "356", 3);
+  written.config.numberOfChannels = 3;
+  written.config.channelInterval[1] = 6;
+  written.config.channelIds[2] = 0xdeadbeef;
+  assertTrue(written.commit());
+  assertTrue(read.begin());
+  assertEqual(memcmp(&read.config, &written.config, sizeof(NodeConfig)), 0);
+  assertFalse(read.changed());
+}
+
+test(cachedCopy) {
+  PersistentMemory memory;
+  clobber(0xFF);
+  memory.begin();
+  memory.config.measurementFrequencyS = 600;
+  memory.commit();
+  // not read again
+  EEPROM.write(CONFIG_ADDRESS + sizeof(ConfigHeader), 0);
+  assertEqual(static_cast<long>(memory.config.measurementFrequencyS), 600L);
+  // nothing to write
+  assertFalse(memory.changed());
+  memory.config.measurementFrequencyS = 600;
+  assertFalse(memory.changed());
+  memory.config.measurementFrequencyS = 660;
+  assertTrue(memory.changed());
+}
+
+test(corrupted) {
+  PersistentMemory memory;
+  clobber(0xFF);
+  memory.begin();
+  memory.config.measurementFrequencyS = 600;
+  memory.commit();
+  EEPROM.write(CONFIG_ADDRESS + sizeof(ConfigHeader), 0x59);
+  EEPROM.commit();
+  assertFalse(memory.begin());
+  assertEqual(static_cast<long>(memory.config.measurementFrequencyS), 3600L);
+}
+
+test(outOfRange) {
+  NodeConfig config;
+  PersistentMemory::defaults(config);
+  assertTrue(PersistentMemory::sanitize(config));
+  config.aggregateFrequencyS = 60;
+  assertTrue(PersistentMemory::sanitize(config));
+  config.aggregateFrequencyS = 5;
+  config.batchDepth = 0;
+  assertFalse(PersistentMemory::sanitize(config));
+  assertEqual(static_cast<long>(config.aggregateFrequencyS), 0L);
+  assertEqual(static_cast<int>(config.batchDepth), 1);
+  // no identity without a channel
+  memcpy(config.channels, "35", 2);
+  config.numberOfChannels = 1;
+  config.channelIds[1] = 0xdeadbeef;
+  assertTrue(PersistentMemory::sanitize(config));
+  assertEqual(static_cast<long>(config.channelIds[1]), 0L);
+}
+
+test(legacyFrequency) {
+  PersistentMemory memory;
+  uint32_t frequency = 1200;
+  clobber(0xFF);
+  EEPROM.put(FREQUENCY_ADDRESS, frequency);
+  EEPROM.commit();
+  assertFalse(memory.begin());
+  assertEqual(static_cast<long>(memory.config.measurementFrequencyS), 1200L);
+  // garbage is not taken over
+  clobber(0xA5);
+  memory.begin();
+  assertEqual(static_cast<long>(memory.config.measurementFrequencyS), 3600L);
+  assertEqual(static_cast<int>(memory.config.batchDepth), 1);
+}
+
+test(olderLayout) {
+  PersistentMemory memory;
+  NodeConfig config;
+  PersistentMemory::defaults(config);
+  config.measurementFrequencyS = 900;
+  config.boots = 12;
+  // written by a firmware without the boot counter
+  ConfigHeader header;
+  header.magic = CONFIG_MAGIC;
+  header.version = CONFIG_VERSION;
+  header.length = offsetof(NodeConfig, boots);
+  header.crc = Crc32::compute(&config, header.length);
+  clobber(0xFF);
+  EEPROM.put(CONFIG_ADDRESS, header);
+  EEPROM.put(CONFIG_ADDRESS + sizeof(header), config);
+  EEPROM.commit();
+  assertTrue(memory.begin());
+  assertEqual(static_cast<long>(memory.config.measurementFrequencyS), 900L);
+  assertEqual(static_cast<long>(memory.config.boots), 0L);
 }
 
 void setup() {
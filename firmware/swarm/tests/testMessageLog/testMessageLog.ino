@@ -0,0 +1,186 @@
+// this fixes a bug in Aunit.h dependencies
+#line 2 "testMessageLog.ino"
+
+#include <AUnitVerbose.h>
+using namespace aunit;
+
+// There is a problem in Arduino; the import from relative paths that
+// are not children of the sketch path is not supported.
+// I am HACKING this with a symlink to the src directory for now.
+
+#include "src/messageLog.h"
+
+#define MOCK_SECTOR_SIZE 256
+#define MOCK_SECTORS 3
+
+
+/*
+ *  NOR flash in RAM
+ */
+class MockFlash: public FlashWrapperBase {
+  public:
+    uint8_t data[MOCK_SECTOR_SIZE * MOCK_SECTORS];
+    MockFlash() { memset(data, 0xFF, sizeof(data)); };
+    uint32_t size() { return sizeof(data); };
+    uint32_t sectorSize() { return MOCK_SECTOR_SIZE; };
+    boolean read(uint32_t address, void *bfr, size_t len) {
+      memcpy(bfr, data + address, len);
+      return true;
+    };
+    boolean write(uint32_t address, const void *bfr, size_t len) {
+      for (size_t i=0; i<len; i++) {
+        data[address + i] &= static_cast<const uint8_t*>(bfr)[i];
+      }
+      return true;
+    };
+    boolean erase(uint32_t sector) {
+      memset(data + sector * MOCK_SECTOR_SIZE, 0xFF, MOCK_SECTOR_SIZE);
+      return true;
+    };
+};
+
+
+test(appendAndAcknowledge) {
+  MockFlash flash;
+  MessageLog log(&flash);
+  char bfr[LOG_MAX_RECORD_LENGTH];
+  LogRecord record;
+  assertTrue(log.begin());
+  assertFalse(log.readPending(record, bfr));
+  assertTrue(log.append("first", 5));
+  assertTrue(log.append("second", 6));
+  assertEqual(static_cast<long>(log.numberOfPending), 2L);
+  assertTrue(log.readPending(record, bfr));
+  assertEqual(static_cast<long>(record.sequence), 1L);
+  assertEqual(record.len, static_cast<size_t>(5));
+  assertEqual(memcmp(bfr, "first", 5), 0);
+  assertTrue(log.acknowledge(record));
+  assertEqual(static_cast<long>(log.numberOfPending), 1L);
+  assertTrue(log.readPending(record, bfr));
+  assertEqual(memcmp(bfr, "second", 6), 0);
+  // the one after
+  assertFalse(log.readPending(record, bfr, record.sequence));
+  assertFalse(log.append(bfr, 0));
+  assertFalse(log.append(bfr, LOG_MAX_RECORD_LENGTH + 1));
+}
+
+/*
+ *  Queued messages stay pending until acknowledged, also after a restart,
+ *  and requeue() hands one over again as a new record
+ */
+test(queued) {
+  MockFlash flash;
+  MessageLog log(&flash);
+  char bfr[LOG_MAX_RECORD_LENGTH];
+  LogRecord record;
+  log.begin();
+  log.append("first", 5);
+  log.readPending(record, bfr);
+  assertEqual(static_cast<long>(record.queuedAt), 0L);
+  assertTrue(log.markQueued(record, 1638633600, 5354468575916ULL));
+  MessageLog restarted(&flash);
+  restarted.begin();
+  assertEqual(static_cast<long>(restarted.numberOfPending), 1L);
+  assertTrue(restarted.readPending(record, bfr));
+  assertEqual(static_cast<long>(record.queuedAt), 1638633600L);
+  assertTrue(record.tileId == 5354468575916ULL);
+  assertTrue(restarted.requeue(record, bfr));
+  assertEqual(static_cast<long>(restarted.numberOfPending), 1L);
+  assertTrue(restarted.readPending(record, bfr));
+  assertEqual(static_cast<long>(record.sequence), 2L);
+  assertEqual(static_cast<long>(record.queuedAt), 0L);
+  assertEqual(memcmp(bfr, "first", 5), 0);
+}
+
+test(remount) {
+  MockFlash flash;
+  MessageLog log(&flash);
+  char bfr[LOG_MAX_RECORD_LENGTH];
+  LogRecord record;
+  log.begin();
+  log.append("first", 5);
+  log.append("second", 6);
+  log.readPending(record, bfr);
+  log.acknowledge(record);
+  MessageLog restarted(&flash);
+  assertTrue(restarted.begin());
+  assertEqual(static_cast<long>(restarted.numberOfPending), 1L);
+  assertTrue(restarted.readPending(record, bfr));
+  assertEqual(static_cast<long>(record.sequence), 2L);
+  // sequence numbers go on
+  restarted.append("third", 5);
+  restarted.readPending(record, bfr, 2);
+  assertEqual(static_cast<long>(record.sequence), 3L);
+}
+
+test(wrap) {
+  MockFlash flash;
+  MessageLog log(&flash);
+  char bfr[LOG_MAX_RECORD_LENGTH];
+  char message[112 - sizeof(LogRecordHeader)];
+  LogRecord record;
+  memset(message, 'x', sizeof(message));
+  log.begin();
+  // two records of 112 bytes per segment, the fourth segment reclaims the
+  // first one
+  for (uint8_t i=0; i<7; i++) {
+    message[0] = '0' + i;
+    assertTrue(log.append(message, sizeof(message)));
+  }
+  assertEqual(static_cast<long>(log.numberOfDropped), 2L);
+  assertEqual(static_cast<long>(log.numberOfPending), 5L);
+  assertTrue(log.readPending(record, bfr));
+  assertEqual(bfr[0], '2');
+  assertEqual(static_cast<long>(log.eraseCount(0)), 2L);
+}
+
+test(tornRecord) {
+  MockFlash flash;
+  MessageLog log(&flash);
+  char bfr[LOG_MAX_RECORD_LENGTH];
+  LogRecord record;
+  log.begin();
+  log.append("first", 5);
+  log.append("second", 6);
+  // not committed
+  const size_t second = (sizeof(LogRecordHeader) + 5 + 3) & ~3;
+  flash.data[sizeof(LogSegmentHeader) + second + offsetof(LogRecordHeader, state)] = 0xFF;
+  MessageLog restarted(&flash);
+  restarted.begin();
+  assertEqual(static_cast<long>(restarted.numberOfPending), 1L);
+  // the segment is closed, new records go to the next one
+  assertTrue(restarted.append("third", 5));
+  assertTrue(restarted.readPending(record, bfr, 1));
+  assertEqual(record.address, static_cast<uint32_t>(MOCK_SECTOR_SIZE + sizeof(LogSegmentHeader)));
+}
+
+test(corruptRecord) {
+  MockFlash flash;
+  MessageLog log(&flash);
+  log.begin();
+  log.append("first", 5);
+  flash.data[sizeof(LogSegmentHeader) + sizeof(LogRecordHeader) + 2] ^= 0x04;
+  MessageLog restarted(&flash);
+  restarted.begin();
+  assertEqual(static_cast<long>(restarted.numberOfPending), 0L);
+}
+
+test(noFlash) {
+  FlashWrapperBase flash;
+  MessageLog log(&flash);
+  assertFalse(log.begin());
+  assertFalse(log.append("first", 5));
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  while(!Serial);
+  // TestRunner::exclude("*");
+  // TestRunner::include("wrap");
+}
+
+void loop() {
+  aunit::TestRunner::run();
+}
@@ -123,6 +123,177 @@ test(testNextScheduled) {
   assertEqual(res, expected);
 };
 
+test(writeVarint) {
+  MessageHelpers helpers;
+  char bfr[10];
+  assertEqual(static_cast<int>(helpers.writeVarint(0, bfr)), 1);
+  assertEqual(static_cast<uint8_t>(bfr[0]), 0);
+  assertEqual(static_cast<int>(helpers.writeVarint(300, bfr)), 2);
+  assertEqual(static_cast<uint8_t>(bfr[0]), 0xac);
+  assertEqual(static_cast<uint8_t>(bfr[1]), 0x02);
+  assertEqual(static_cast<int>(helpers.zigzag(0)), 0);
+  assertEqual(static_cast<int>(helpers.zigzag(-1)), 1);
+  assertEqual(static_cast<int>(helpers.zigzag(1)), 2);
+  assertEqual(static_cast<int>(helpers.zigzag(-38)), 75);
+}
+
+/*
+ *  Same frame is decoded in payload_decoder/test.js
+ */
+test(encodeMessage) {
+  Message message;
+  MessageHelpers helpers;
+  char bfr[MAX_MESSAGE_LENGTH];
+  const uint8_t expected[] = {
+    0x01, 0xa5, 0x04, 0x94, 0x90, 0xab, 0x61, 0xe7, 0x02, 0x33, 0x12, 0x34,
+    0x00, 0x00, 0x00, 0xba, 0x01, 0xbe, 0x26, 0x92, 0x04, 0xdc, 0x01, 0xec,
+    0x01, 0xc6, 0x9d, 0x01, 0x88, 0x0e, 0xd8, 0x01, 0x04, 0x22, 0x00, 0x4b,
+    0xab, 0x01, 0x92, 0x04, 0x34, 0x01, 0x00, 0x35, 0x03, 0xd8, 0xf1, 0x18,
+    0xc2, 0x02, 0x4e, 0x38, 0x82, 0xf1, 0x01, 0x18};
+  message.index = 549;
+  message.timeStamp = 1638633620;
+  message.batteryVoltage = 3.59;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = 51;
+  strcpy(message.payloads[0].payload,
+    "+26+0.000+0+0+0.93+246.3+2.65+11.0+1.18+100.83+0.900+10.8+0.2+1.7+0-0.38"
+    "-0.86+2.65");
+  message.payloads[1].channel = 52;
+  strcpy(message.payloads[1].payload, "+0.00");
+  message.payloads[2].channel = 53;
+  strcpy(message.payloads[2].payload, "+2038.84+16.1+39");
+  // unknown sensor, self-describing
+  message.payloads[3].channel = 56;
+  strcpy(message.payloads[3].payload, "+1.5-2");
+  size_t len = helpers.encodeMessage(message, bfr);
+  assertEqual(static_cast<int>(len), static_cast<int>(sizeof(expected)));
+  for (size_t i=0; i<len; i++) {
+    assertEqual(static_cast<uint8_t>(bfr[i]), expected[i]);
+  }
+}
+
+/*
+ *  Only the values out of range are left out, same frame is decoded in
+ *  payload_decoder/test.js
+ */
+test(encodeOutOfRange) {
+  Message message = {0};
+  MessageHelpers helpers;
+  char bfr[MAX_MESSAGE_LENGTH];
+  const uint8_t expected[] = {
+    0x01, 0x00, 0x88, 0x97, 0xab, 0x61, 0xe6, 0x02, 0x34, 0x41, 0x01, 0x35,
+    0x43, 0x02, 0xd0, 0xf1, 0x18, 0x4e, 0x38, 0x82, 0xa1, 0x02, 0x08};
+  message.timeStamp = 1638635400;
+  message.batteryVoltage = 3.58;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = 52;
+  strcpy(message.payloads[0].payload, "+101.00");
+  message.payloads[1].channel = 53;
+  strcpy(message.payloads[1].payload, "+2038.8-9999.0+39");
+  // unknown sensors are not checked
+  message.payloads[2].channel = 56;
+  strcpy(message.payloads[2].payload, "+1.8-1");
+  size_t len = helpers.encodeMessage(message, bfr);
+  assertEqual(static_cast<int>(len), static_cast<int>(sizeof(expected)));
+  for (size_t i=0; i<len; i++) {
+    assertEqual(static_cast<uint8_t>(bfr[i]), expected[i]);
+  }
+}
+
+/*
+ *  Values parsed during the measurement are used instead of the text
+ */
+test(encodeMessageValues) {
+  Message message = {0};
+  MessageHelpers helpers;
+  char bfr[MAX_MESSAGE_LENGTH];
+  char expected[MAX_MESSAGE_LENGTH];
+  message.index = 3;
+  message.timeStamp = 20;
+  message.batteryVoltage = 3.5;
+  memcpy(message.type, "SC", 2);
+  message.payloads[0].channel = 53;
+  strcpy(message.payloads[0].payload, "+2038.84+16.1+39");
+  size_t expectedLen = helpers.encodeMessage(message, expected);
+  message.payloads[0].payload[0] = 0;
+  Sdi12Parser::parse("3+2038.84+16.1+39\r\n", 19, message.payloads[0].values);
+  assertEqual(static_cast<int>(message.payloads[0].values.count), 3);
+  size_t len = helpers.encodeMessage(message, bfr);
+  assertEqual(static_cast<int>(len), static_cast<int>(expectedLen));
+  for (size_t i=0; i<len; i++) assertEqual(bfr[i], expected[i]);
+}
+
+/*
+ *  Only four channels with 20 values fit, the last one is dropped entirely
+ */
+test(encodeMessageToLong) {
+  Message message = {0};
+  MessageHelpers helpers;
+  char bfr[MAX_MESSAGE_LENGTH];
+  message.index = 7;
+  message.timeStamp = 20;
+  message.batteryVoltage = 3.5;
+  memcpy(message.type, "SC", 2);
+  for (size_t i=0; i<5; i++) {
+    message.payloads[i].channel = 56 + i;
+    for (size_t j=0; j<20; j++) strcat(message.payloads[i].payload, "+1.000");
+  }
+  size_t len = helpers.encodeMessage(message, bfr);
+  assertLessOrEqual(static_cast<int>(len), MAX_MESSAGE_LENGTH);
+  // header is 8 bytes, each channel 2 + 20 * 2
+  assertEqual(static_cast<int>(len), 8 + 4 * 42);
+}
+test(sensorSchema) {
+  assertTrue(findSensorSchema(49) == NULL);
+  assertTrue(findSensorSchema(56) == NULL);
+  const SensorSchema *schema = findSensorSchema(51);
+  assertEqual(static_cast<int>(schema->channel), 51);
+  assertEqual(static_cast<int>(schema->numberOfFields), 18);
+  assertEqual(schema->fields[1].name, "precip_mm");
+  assertEqual(static_cast<int>(schema->fields[1].aggregation), FIELD_ACCUMULATOR);
+  assertEqual(static_cast<int>(findSensorSchema(55)->numberOfFields), 3);
+  // relHumidity_0_1 with 3 decimals
+  assertTrue(inRange(schema->fields[10], 0));
+  assertTrue(inRange(schema->fields[10], 1000));
+  assertFalse(inRange(schema->fields[10], 1001));
+  assertFalse(inRange(schema->fields[10], -1));
+  // conductivity with 6 decimals is beyond the precision of a float
+  const FieldSchema fine = {"conductivity", "uS/cm", 6, FIELD_GAUGE, 0, 20000};
+  assertTrue(inRange(fine, 20000000000LL));
+  assertFalse(inRange(fine, 20000000001LL));
+  // 0.3 is not exact in binary
+  const FieldSchema fraction = {"fraction", "1", 4, FIELD_GAUGE, 0.1f, 0.3f};
+  assertTrue(inRange(fraction, 1000));
+  assertTrue(inRange(fraction, 3000));
+  assertFalse(inRange(fraction, 999));
+  assertFalse(inRange(fraction, 3001));
+}
+
+/*
+ *  Values of known sensors are scaled to their field and range checked
+ */
+test(getReadings) {
+  Message message = {0};
+  Readings readings;
+  message.payloads[0].channel = 53;
+  strcpy(message.payloads[0].payload, "+2038.8+16.12+39");
+  message.payloads[1].channel = 52;
+  strcpy(message.payloads[1].payload, "+101.00");
+  message.payloads[2].channel = 56;
+  strcpy(message.payloads[2].payload, "+1.5-99999");
+  MessageHelpers::getReadings(message, readings);
+  assertEqual(static_cast<int>(readings.numberOfChannels), 3);
+  assertEqual(static_cast<int>(readings.numberOfValues), 6);
+  assertEqual(static_cast<int>(readings.counts[0]), 3);
+  assertEqual(static_cast<int>(readings.counts[2]), 2 | CHANNEL_SELF_DESCRIBING);
+  assertEqual(static_cast<long>(readings.values[0]), 203880L);
+  assertEqual(static_cast<long>(readings.values[1]), 161L);
+  assertEqual(static_cast<int>(readings.decimals[1]), 1);
+  // leaf wetness above 100 %, unknown sensors are not checked
+  assertEqual(
+    static_cast<unsigned long>(readings.outOfRange), static_cast<unsigned long>(1 << 3));
+}
+
 void setup() {
   Serial.begin(115200);
   delay(500);
@@ -0,0 +1,123 @@
+// this fixes a bug in Aunit.h dependencies
+#line 2 "testNmeaDecoder.ino"
+
+#include <AUnitVerbose.h>
+using namespace aunit;
+
+// There is a problem in Arduino; the import from relative paths that
+// are not children of the sketch path is not supported.
+// I am HACKING this with a symlink to the src directory for now.
+
+#include "src/nmeaDecoder.h"
+
+
+test(decodeDateTime) {
+  NmeaSentence sentence;
+  // example from SWARM Tile Manual
+  char line[] = "$DT 20190408195123,V*41\n";
+  assertTrue(NmeaDecoder::decode(line, sizeof(line), &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_DT);
+  assertEqual(static_cast<int>(sentence.result), NMEA_REPORT);
+  assertEqual(static_cast<int>(sentence.numberOfFields), 2);
+  assertTrue(sentence.dateTime.valid);
+  assertEqual(sentence.dateTime.epoch, 1554753083UL);
+  // leap days
+  assertTrue(NmeaDecoder::decode("$DT 20200229120000,V*40", 23, &sentence));
+  assertEqual(sentence.dateTime.epoch, 1582977600UL);
+  assertTrue(NmeaDecoder::decode("$DT 20190229120000,V*4a", 23, &sentence));
+  assertFalse(sentence.dateTime.valid);
+  // rate
+  assertTrue(NmeaDecoder::decode("$DT 20,V*48", 11, &sentence));
+  assertFalse(sentence.dateTime.valid);
+  assertTrue(NmeaDecoder::decode("$DT OK*34", 9, &sentence));
+  assertEqual(static_cast<int>(sentence.result), NMEA_OK);
+}
+
+test(decodeChecksum) {
+  NmeaSentence sentence;
+  assertFalse(NmeaDecoder::decode("$DT 20190408195122,N*41\n", 24, &sentence));
+  assertFalse(NmeaDecoder::decode("$DT 20190408195123,V*4", 22, &sentence));
+  assertFalse(NmeaDecoder::decode("Fuchsteufelswild\n", 17, &sentence));
+}
+
+test(decodePosition) {
+  NmeaSentence sentence;
+  assertTrue(NmeaDecoder::decode("$GN 37.8000,-122.2700,12,0,0*3f", 31, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_GN);
+  assertNear(sentence.position.latitude, 37.8f, 0.0001f);
+  assertNear(sentence.position.longitude, -122.27f, 0.0001f);
+  assertEqual(static_cast<int>(sentence.position.altitude), 12);
+  assertTrue(NmeaDecoder::decode("$GN 60*2f", 9, &sentence));
+  assertEqual(sentence.rate, 60UL);
+}
+
+test(decodeGpsStatus) {
+  NmeaSentence sentence;
+  assertTrue(NmeaDecoder::decode("$GS 109,214,10,0,G3*7e", 22, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_GS);
+  assertEqual(static_cast<int>(sentence.gpsStatus.hdop), 109);
+  assertEqual(static_cast<int>(sentence.gpsStatus.vdop), 214);
+  assertEqual(static_cast<int>(sentence.gpsStatus.satellites), 10);
+  assertEqual(sentence.gpsStatus.fix[1], '3');
+}
+
+test(decodeSignal) {
+  NmeaSentence sentence;
+  assertTrue(NmeaDecoder::decode("$RT RSSI=-104*18", 16, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_RT);
+  assertEqual(static_cast<int>(sentence.signal.rssi), -104);
+  assertTrue(NmeaDecoder::decode(
+    "$TD SENT,RSSI=-110,SNR=6,FDEV=0,5354468575901*6d", 48, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_TD);
+  assertEqual(static_cast<int>(sentence.signal.rssi), -110);
+  assertEqual(static_cast<int>(sentence.signal.snr), 6);
+  assertTrue(sentence.signal.id == 5354468575901ULL);
+  assertTrue(NmeaDecoder::decode("$TD OK,5354468575916*2c", 23, &sentence));
+  assertEqual(static_cast<int>(sentence.result), NMEA_OK);
+  assertTrue(sentence.signal.id == 5354468575916ULL);
+}
+
+test(decodeOther) {
+  NmeaSentence sentence;
+  assertTrue(NmeaDecoder::decode("$MT 5*0c", 8, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_MT);
+  assertEqual(sentence.count, 5UL);
+  assertTrue(NmeaDecoder::decode("$M138 BOOT,RUNNING*2a", 21, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_M138);
+  assertTrue(NmeaDecoder::fieldEquals(sentence.fields[1], "RUNNING"));
+  assertTrue(NmeaDecoder::decode("$TILE BOOT,RUNNING*49", 21, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_M138);
+}
+
+test(decodeReceived) {
+  NmeaSentence sentence;
+  assertTrue(NmeaDecoder::decode(
+    "$MM AI=0,68656c6c6f,5354468575916,1638633600*6c", 47, &sentence));
+  assertEqual(static_cast<int>(sentence.type), NMEA_MM);
+  assertTrue(sentence.received.valid);
+  assertEqual(static_cast<int>(sentence.received.application), 0);
+  assertTrue(sentence.received.id == 5354468575916ULL);
+  assertEqual(sentence.received.epoch, 1638633600UL);
+  assertTrue(NmeaDecoder::fieldEquals(sentence.fields[1], "68656c6c6f"));
+  // no message waiting
+  assertTrue(NmeaDecoder::decode("$MM ERR,DBXNOMORE*03", 20, &sentence));
+  assertEqual(static_cast<int>(sentence.result), NMEA_ERR);
+}
+
+test(daysFromCivil) {
+  assertEqual(NmeaDecoder::daysFromCivil(1970, 1, 1), 0UL);
+  assertEqual(NmeaDecoder::daysFromCivil(2000, 3, 1), 11017UL);
+  assertEqual(NmeaDecoder::daysFromCivil(2037, 12, 31), 24836UL);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  while(!Serial);
+  // TestRunner::exclude("*");
+  // TestRunner::include("decodeDateTime");
+}
+
+void loop() {
+  aunit::TestRunner::run();
+}
@@ -0,0 +1,83 @@
+// this fixes a bug in Aunit.h dependencies
+#line 2 "testSdi12Stats.ino"
+
+#include <AUnitVerbose.h>
+using namespace aunit;
+
+// There is a problem in Arduino; the import from relative paths that
+// are not children of the sketch path is not supported.
+// I am HACKING this with a symlink to the src directory for now.
+
+#include "src/sdi12Stats.h"
+
+
+test(addressIndex) {
+  assertEqual(static_cast<int>(Sdi12Stats::addressIndex('0')), 0);
+  assertEqual(static_cast<int>(Sdi12Stats::addressIndex('9')), 9);
+  assertEqual(static_cast<int>(Sdi12Stats::addressIndex('a')), 10);
+  assertEqual(static_cast<int>(Sdi12Stats::addressIndex('Z')), 61);
+  assertEqual(static_cast<int>(Sdi12Stats::addressIndex('?')), -1);
+}
+
+test(commandType) {
+  assertEqual(
+    static_cast<int>(Sdi12Stats::commandType("3!")), SDI12_COMMAND_ACKNOWLEDGE);
+  assertEqual(static_cast<int>(Sdi12Stats::commandType("?I!")), SDI12_COMMAND_INFO);
+  assertEqual(static_cast<int>(Sdi12Stats::commandType("3M!")), SDI12_COMMAND_MEASURE);
+  assertEqual(
+    static_cast<int>(Sdi12Stats::commandType("3C!")), SDI12_COMMAND_CONCURRENT);
+  assertEqual(static_cast<int>(Sdi12Stats::commandType("3D0!")), SDI12_COMMAND_DATA);
+  assertEqual(static_cast<int>(Sdi12Stats::commandType("3A4!")), SDI12_COMMAND_OTHER);
+  assertEqual(static_cast<int>(Sdi12Stats::commandType("")), SDI12_COMMAND_OTHER);
+}
+
+test(responseTimeout) {
+  Sdi12Stats stats;
+  // unknown sensors get the spec deadline
+  assertEqual(static_cast<int>(stats.responseTimeout('3')), SDI12_RESPONSE_TIMEOUT);
+  stats.recordResponse('3', 9);
+  stats.recordResponse('3', 11);
+  assertEqual(static_cast<int>(stats.responseTimeout('3')), SDI12_RESPONSE_TIMEOUT);
+  stats.recordResponse('3', 10);
+  assertEqual(
+    static_cast<int>(stats.responseTimeout('3')), 11 + SDI12_LATENCY_MARGIN);
+  assertEqual(static_cast<int>(stats.averageLatency('3')), 10);
+  // never beyond the spec deadline
+  stats.recordResponse('3', 200);
+  assertEqual(static_cast<int>(stats.responseTimeout('3')), SDI12_RESPONSE_TIMEOUT);
+  // other addresses are not affected
+  assertEqual(static_cast<int>(stats.responseTimeout('4')), SDI12_RESPONSE_TIMEOUT);
+  assertEqual(static_cast<int>(stats.responseTimeout('?')), SDI12_RESPONSE_TIMEOUT);
+  stats.recordTimeout('4');
+  assertEqual(static_cast<int>(stats.addresses[4].timeouts), 1);
+}
+
+test(recordTransaction) {
+  Sdi12Stats stats;
+  stats.recordTransaction("3D0!", 120, 1, true);
+  stats.recordTransaction("3D1!", 80, 1, true);
+  stats.recordTransaction("5I!", 100, 3, false);
+  const Sdi12CommandStats &data = stats.commands[SDI12_COMMAND_DATA];
+  assertEqual(static_cast<long>(data.transactions), 2L);
+  assertEqual(static_cast<long>(data.totalTime), 200L);
+  assertEqual(static_cast<long>(stats.averageTime(SDI12_COMMAND_DATA)), 100L);
+  const Sdi12CommandStats &info = stats.commands[SDI12_COMMAND_INFO];
+  assertEqual(static_cast<long>(info.attempts), 3L);
+  assertEqual(static_cast<long>(info.failures), 1L);
+  assertEqual(static_cast<long>(stats.averageTime(SDI12_COMMAND_MEASURE)), 0L);
+  stats.reset();
+  assertEqual(static_cast<long>(stats.commands[SDI12_COMMAND_DATA].transactions), 0L);
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  while(!Serial);
+  // TestRunner::exclude("*");
+  // TestRunner::include("responseTimeout");
+}
+
+void loop() {
+  aunit::TestRunner::run();
+}
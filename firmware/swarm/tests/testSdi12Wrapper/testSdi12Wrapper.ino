@@ -11,7 +11,8 @@ using namespace aunit;
 #include "src/sdi12Wrapper.h"
 
 
-SDI12Measurement sdi12 = SDI12Measurement();
+Sdi12Bus bus = Sdi12Bus(DATA_PIN);
+SDI12Measurement sdi12 = SDI12Measurement(&bus);
 
 
 test(parseResponse) {
@@ -48,6 +49,47 @@ test(testChannel) {
 }
 
 
+/*
+ * Concurrent measurements on the Meter sensors (hardware dependent), should
+ * return the same values as one sensor after the other and take about as
+ * long as the slowest sensor
+ */
+test(concurrentMeasurement) {
+  const char addrs[] = "345";
+  char bfr[256];
+  size_t len;
+  int8_t i;
+  uint8_t collected = 0;
+  Sdi12Values values;
+  unsigned long start = millis();
+  for (uint8_t j=0; j<3; j++) {
+    assertTrue(sdi12.getValues(values, addrs[j]));
+  }
+  const unsigned long sequential = millis() - start;
+  start = millis();
+  assertEqual(sdi12.startMeasurements(addrs, 3), static_cast<uint8_t>(3));
+  while ((i = sdi12.waitForNextReady()) > -1) {
+    len = sdi12.collectData(i, bfr, &values);
+    assertTrue(len > 0);
+    assertEqual(
+      static_cast<int>(values.count),
+      static_cast<int>(sdi12.concurrent[i].numberOfValues));
+    collected++;
+    Serial.print(sdi12.concurrent[i].addr);
+    Serial.print(": ");
+    Serial.write(bfr, len);
+    Serial.println();
+  }
+  const unsigned long elapsed = millis() - start;
+  assertEqual(static_cast<int>(collected), 3);
+  Serial.print("ELAPSED ms: ");
+  Serial.print(elapsed);
+  Serial.print(" SEQUENTIAL ms: ");
+  Serial.println(sequential);
+  assertTrue(elapsed < sequential);
+}
+
+
 // this is highly hardware dependent
 test(nonBlockingSend) {
   sdi12.nonBlockingSend("5C!", 3);
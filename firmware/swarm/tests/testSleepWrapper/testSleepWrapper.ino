@@ -0,0 +1,189 @@
+// this fixes a bug in Aunit.h dependencies
+#line 2 "testSleepWrapper.ino"
+
+#include <AUnitVerbose.h>
+using namespace aunit;
+
+// There is a problem in Arduino; the import from relative paths that
+// are not children of the sketch path is not supported.
+// I am HACKING this with a symlink to the src directory for now.
+
+#include "src/sleepWrapper.h"
+#include "src/tileSleep.h"
+#include "src/loopState.h"
+
+
+/*
+ *  RTC memory in RAM, wake-up cause set by the test
+ */
+class MockSleep: public SleepWrapperBase {
+  public:
+    RetainedState rtc;
+    boolean woke = false;
+    boolean wokeFromDeepSleep() { return woke; };
+    RetainedState *retained() { return &rtc; };
+};
+
+
+RetainedState exampleState() {
+  RetainedState state;
+  memset(&state, 0, sizeof(state));
+  state.messageCounter = 17;
+  state.nextScheduled = 1663027200;
+  state.nextSample = 1663026300;
+  state.measurementFrequencyS = 3600;
+  memcpy(state.availableChannels, "356", 3);
+  state.numberOfChannels = 3;
+  return state;
+}
+
+
+test(roundTrip) {
+  MockSleep sleeper;
+  RetainedState state = exampleState();
+  RetainedState restored;
+  MessageBatch batch;
+  batch.numberOfEpochs = 2;
+  memcpy(state.batch, &batch, sizeof(batch));
+  sleeper.save(state);
+  sleeper.woke = true;
+  assertTrue(sleeper.restore(restored));
+  assertEqual(restored.messageCounter, 17);
+  assertEqual(restored.nextScheduled, 1663027200UL);
+  assertEqual(restored.nextSample, 1663026300UL);
+  assertEqual(restored.measurementFrequencyS, 3600UL);
+  assertEqual(restored.numberOfChannels, 3);
+  assertEqual(memcmp(restored.availableChannels, "356", 3), 0);
+  memcpy(&batch, restored.batch, sizeof(batch));
+  assertEqual(static_cast<int>(batch.numberOfEpochs), 2);
+  // wake-ups are counted in RTC memory
+  assertEqual(static_cast<long>(restored.wakeups), 1L);
+  assertTrue(sleeper.restore(restored));
+  assertEqual(static_cast<long>(restored.wakeups), 2L);
+}
+
+test(loopState) {
+  MockSleep sleeper;
+  int messageCounter = 17;
+  unsigned long nextScheduled = 1663027200;
+  unsigned long nextSample = 1663026300;
+  unsigned long measurementFrequencyS = 3600;
+  char availableChannels[10] = "356";
+  int numberOfChannels = 3;
+  MessageBatch batch;
+  batch.numberOfEpochs = 2;
+  MessageBudget budget;
+  budget.month = 24272;
+  budget.spent = 123;
+  budget.lastSent = 1663020000;
+  MessageAggregate aggregate;
+  aggregate.numberOfSamples = 4;
+  aggregate.firstTimeStamp = 1663024500;
+  TileSleep tileSleep;
+  tileSleep.asleep = true;
+  LocalClock localClock;
+  localClock.fix(1663026000, 1000, 5000);
+  LoopState state = LoopState(
+    messageCounter, nextScheduled, nextSample, measurementFrequencyS,
+    availableChannels, numberOfChannels, batch, budget, aggregate, tileSleep,
+    localClock);
+  const MessageBatch savedBatch = batch;
+  const MessageBudget savedBudget = budget;
+  const MessageAggregate savedAggregate = aggregate;
+  const LocalClock savedClock = localClock;
+  state.save(sleeper);
+  // deep sleep loses all of them
+  messageCounter = 0;
+  nextScheduled = 0;
+  nextSample = 0;
+  measurementFrequencyS = 0;
+  memset(availableChannels, 0, sizeof(availableChannels));
+  numberOfChannels = 0;
+  batch = MessageBatch();
+  budget = MessageBudget();
+  aggregate = MessageAggregate();
+  tileSleep = TileSleep();
+  localClock = LocalClock();
+  assertFalse(state.restore(sleeper));
+  sleeper.woke = true;
+  assertTrue(state.restore(sleeper));
+  assertEqual(messageCounter, 17);
+  assertEqual(nextScheduled, 1663027200UL);
+  assertEqual(nextSample, 1663026300UL);
+  assertEqual(measurementFrequencyS, 3600UL);
+  assertEqual(memcmp(availableChannels, "356", 4), 0);
+  assertEqual(numberOfChannels, 3);
+  assertEqual(memcmp(&batch, &savedBatch, sizeof(batch)), 0);
+  assertEqual(memcmp(&budget, &savedBudget, sizeof(budget)), 0);
+  assertEqual(memcmp(&aggregate, &savedAggregate, sizeof(aggregate)), 0);
+  assertTrue(tileSleep.asleep);
+  assertEqual(memcmp(&localClock, &savedClock, sizeof(localClock)), 0);
+  assertTrue(localClock.valid());
+  assertEqual(static_cast<long>(sleeper.rtc.wakeups), 1L);
+  // the wake-ups counted so far are kept with the next save
+  state.save(sleeper);
+  assertTrue(state.restore(sleeper));
+  assertEqual(static_cast<long>(sleeper.rtc.wakeups), 2L);
+}
+
+test(coldStart) {
+  MockSleep sleeper;
+  RetainedState restored;
+  sleeper.save(exampleState());
+  // power on or reset, RTC memory is still intact
+  assertFalse(sleeper.restore(restored));
+  // garbage after power on
+  sleeper.woke = true;
+  memset(&sleeper.rtc, 0x5a, sizeof(sleeper.rtc));
+  assertFalse(sleeper.restore(restored));
+}
+
+test(corruptedState) {
+  MockSleep sleeper;
+  RetainedState restored;
+  sleeper.save(exampleState());
+  sleeper.woke = true;
+  sleeper.rtc.nextScheduled++;
+  assertFalse(sleeper.restore(restored));
+  // no RTC memory at all
+  SleepWrapperBase none;
+  assertFalse(none.restore(restored));
+}
+
+test(sleepDuration) {
+  // wake up 5 s before the first report after 3600, i.e. the one at 3620
+  assertEqual(SleepWrapperBase::sleepDuration(60, 3600, 20, 5), 3555UL);
+  assertEqual(SleepWrapperBase::sleepDuration(3590, 3600, 20, 5), 25UL);
+  // past the wake-up time already
+  assertEqual(SleepWrapperBase::sleepDuration(3616, 3600, 20, 5), 0UL);
+  assertEqual(SleepWrapperBase::sleepDuration(4000, 3600, 20, 5), 0UL);
+}
+
+test(tileSleep) {
+  TileSleep tileSleep;
+  assertEqual(TileSleep::duration(60, 3600, 20, 5), 3555UL);
+  // not worth waking the tile again
+  assertEqual(TileSleep::duration(3495, 3600, 20, 5), 120UL);
+  assertEqual(TileSleep::duration(3496, 3600, 20, 5), 0UL);
+  assertFalse(tileSleep.asleep);
+  // the MCU wakes after the tile
+  assertEqual(tileSleep.slept(3555), 3555UL + TILE_WAKE_MARGIN);
+  assertTrue(tileSleep.asleep);
+  assertEqual(tileSleep.sleeps, 1UL);
+  assertEqual(tileSleep.sleptS, 3555UL);
+  tileSleep.woke();
+  assertFalse(tileSleep.asleep);
+}
+
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  while(!Serial);
+  // TestRunner::exclude("*");
+  // TestRunner::include("roundTrip");
+}
+
+void loop() {
+  aunit::TestRunner::run();
+}
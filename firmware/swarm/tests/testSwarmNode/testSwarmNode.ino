@@ -21,6 +21,7 @@ class MockedSerialWrapper: public SerialWrapperBase {
     MockedSerialWrapper() {
       idx = 0;
       outIdx = 0;
+      sizeTestData = 0;
     };
     void loadMockedSerialBuffer(const char *testData, const size_t len) {
       // set properties for use in mocked methods
@@ -149,6 +150,45 @@ test(cleanCommandLong) {
 };
 
 
+// same command as formatMessageLong plus cleanCommandLong in one pass
+test(messageCommand) {
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  SwarmNode testNode = SwarmNode(&displ, &wrapper);
+  char testBfr[] =
+    "000000,1630598125,0+0+0.000+0+0+0.13+111.3+0.16+19.8+1.50+101.22+0.650+19.7+0.1+1.1"
+    "+0-0.05+0.12+0.16,4.03";
+  char expected[] =
+    "$TD HD=86400,3030303030302c313633303539383132352c302b302b302e3030302b302b302b302e3"
+    "1332b3131312e332b302e31362b31392e382b312e35302b3130312e32322b302e3635302b31392e372"
+    "b302e312b312e312b302d302e30352b302e31322b302e31362c342e3033*1a\n";
+  char outBfr[sizeof(expected)];
+  size_t len = testNode.messageCommand(testBfr, sizeof(testBfr)-1, outBfr);
+  assertEqual(static_cast<uint16_t>(len), static_cast<uint16_t>(sizeof(expected))-1);
+  for (size_t i=0; i<len; i++) assertEqual(outBfr[i], expected[i]);
+};
+
+
+// binary bytes and a command that does not fit
+test(commandWriter) {
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  SwarmNode testNode = SwarmNode(&displ, &wrapper);
+  char bfr[24];
+  const char bytes[] = {0x00, 0x7f, static_cast<char>(0x80), static_cast<char>(0xff)};
+  CommandWriter writer(bfr, sizeof(bfr));
+  writer.append("$TD ", 4);
+  writer.appendHex(bytes, sizeof(bytes));
+  size_t len = writer.finish();
+  assertEqual(static_cast<int>(len), 16);
+  char checked[24];
+  assertEqual(static_cast<int>(testNode.cleanCommand("$TD 007f80ff", 12, checked)), 16);
+  for (size_t i=0; i<len; i++) assertEqual(bfr[i], checked[i]);
+  CommandWriter small(bfr, 10);
+  small.append("$TD ", 4);
+  small.appendHex(bytes, sizeof(bytes));
+  assertEqual(static_cast<int>(small.finish()), 0);
+};
+
+
 test(sendMessage) {
   MockedSerialWrapper wrapper = MockedSerialWrapper();
   wrapper.loadMockedSerialBuffer("$TD OK,5354468575916*2c\n", 24);
@@ -235,6 +275,141 @@ test(emptySerialBuffer) {
 };
 
 
+test(nmeaReader) {
+  char testData[] = "$TILE BOOT,RUNNING*49\n$DT 20190408195123,V*42\nNo NMEA\n$GN";
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  wrapper.loadMockedSerialBuffer(testData, sizeof(testData)-1);
+  NmeaReader reader = NmeaReader(&wrapper);
+  assertEqual(static_cast<int>(reader.poll()), 3);
+  const NmeaLine *line = reader.peek();
+  assertEqual(static_cast<int>(line->len), 22);
+  assertEqual(line->text, "$TILE BOOT,RUNNING*49\n");
+  assertTrue(line->valid);
+  reader.release();
+  // wrong checksum
+  assertFalse(reader.peek()->valid);
+  reader.release();
+  assertFalse(reader.peek()->valid);
+  reader.release();
+  assertTrue(reader.peek() == NULL);
+  // the start of the next line is kept
+  assertEqual(static_cast<int>(reader.pending()), 3);
+  assertEqual(static_cast<int>(reader.checksumErrors), 1);
+};
+
+
+// more lines than slots are read in order once slots are released
+test(nmeaReaderBurst) {
+  char testData[] = "$A*41\n$B*42\n$C*43\n$D*44\n$E*45\n$F*46\n$G*47\n$H*48\n$I*49\n$J*4a\n";
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  wrapper.loadMockedSerialBuffer(testData, sizeof(testData)-1);
+  NmeaReader reader = NmeaReader(&wrapper);
+  assertEqual(static_cast<int>(reader.poll()), NMEA_LINE_SLOTS);
+  assertTrue(wrapper.available());
+  for (char c='A'; c<='J'; c++) {
+    reader.poll();
+    const NmeaLine *line = reader.peek();
+    assertTrue(line != NULL);
+    assertEqual(line->text[1], c);
+    assertTrue(line->valid);
+    reader.release();
+  }
+  assertEqual(static_cast<int>(reader.poll()), 0);
+};
+
+
+test(waitForTimeStamp) {
+  char testData[] = "$DT 20190408195123,V*42\n$RT RSSI=-102*1e\n$DT 20190408195123,V*41\n";
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  wrapper.loadMockedSerialBuffer(testData, sizeof(testData)-1);
+  SwarmNode testNode = SwarmNode(&displ, &wrapper);
+  // the line with the broken checksum is skipped
+  assertEqual(static_cast<long>(testNode.waitForTimeStamp()), 1554753083L);
+  assertEqual(static_cast<int>(testNode.reader.linesReceived), 3);
+};
+
+
+// a report that waited in the UART does not fix the clock, $DT @ does
+test(attachClock) {
+  char testData[] = "$DT 20190408195123,V*41\n";
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  wrapper.loadMockedSerialBuffer(testData, sizeof(testData)-1);
+  SwarmNode testNode = SwarmNode(&displ, &wrapper);
+  LocalClock clock;
+  testNode.attachClock(&clock);
+  assertEqual(static_cast<long>(testNode.waitForTimeStamp()), 1554753083L);
+  assertFalse(clock.valid());
+  wrapper.loadMockedSerialBuffer(testData, sizeof(testData)-1);
+  assertEqual(static_cast<long>(testNode.queryTime()), 1554753083L);
+  assertTrue(clock.valid());
+  assertEqual(clock.now(millis()), 1554753083UL);
+  assertTrue(clock.trusted(millis()));
+};
+
+
+// count lines handed to a listener
+void countLines(void *context, const uint8_t status, const NmeaLine *line) {
+  (*static_cast<int*>(context))++;
+}
+
+
+// the unsolicited RSSI report goes to the listener, not to the command
+test(queueCommand) {
+  char testData[] = "$RT RSSI=-104*18\n$GS 109,214,10,0,G3*7e\n$RT OK*22\n";
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  wrapper.loadMockedSerialBuffer(testData, sizeof(testData)-1);
+  SwarmNode testNode = SwarmNode(&displ, &wrapper);
+  TileResponse response;
+  char bfr[32];
+  int rssiReports = 0;
+  response.bfr = bfr;
+  response.size = sizeof(bfr);
+  testNode.commands.addListener("$RT", countLines, &rssiReports);
+  assertTrue(
+    testNode.queueCommand("$RT 3600", 8, &response, NULL, NULL, "$RT OK"));
+  assertEqual(static_cast<int>(wrapper.outIdx), 12);
+  assertEqual(static_cast<int>(response.status), TILE_PENDING);
+  assertEqual(static_cast<int>(testNode.poll()), 3);
+  assertEqual(static_cast<int>(response.status), TILE_OK);
+  assertEqual(static_cast<int>(response.len), 10);
+  for (size_t i=0; i<response.len; i++) assertEqual(bfr[i], "$RT OK*22\n"[i]);
+  assertEqual(rssiReports, 1);
+  assertEqual(static_cast<int>(testNode.commands.unsolicited), 2);
+  assertEqual(static_cast<int>(testNode.commands.pending()), 0);
+};
+
+
+test(queueCommandError) {
+  char testData[] = "$TD ERR,E_MSGTOOLONG,0*58\n";
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  wrapper.loadMockedSerialBuffer(testData, sizeof(testData)-1);
+  SwarmNode testNode = SwarmNode(&displ, &wrapper);
+  TileResponse response;
+  assertTrue(testNode.queueMessage("hello", 5, &response));
+  testNode.waitForResponse(&response);
+  assertEqual(static_cast<int>(response.status), TILE_ERROR);
+};
+
+
+test(queueCommandTimeout) {
+  MockedSerialWrapper wrapper = MockedSerialWrapper();
+  SwarmNode testNode = SwarmNode(&displ, &wrapper);
+  TileResponse response;
+  assertTrue(testNode.queueCommand("$DT @", 5, &response, NULL, NULL, NULL, 10));
+  testNode.poll();
+  assertEqual(static_cast<int>(response.status), TILE_PENDING);
+  delay(10);
+  testNode.poll();
+  assertEqual(static_cast<int>(response.status), TILE_TIMEOUT);
+  assertEqual(static_cast<int>(testNode.commands.timeouts), 1);
+  // the queue is bounded
+  for (size_t i=0; i<TILE_MAX_PENDING; i++) {
+    assertTrue(testNode.queueCommand("$DT @", 5));
+  }
+  assertFalse(testNode.queueCommand("$DT @", 5));
+};
+
+
 test(parseTime) {
   MockedSerialWrapper wrapper = MockedSerialWrapper();
   SwarmNode testNode = SwarmNode(&displ, &wrapper);
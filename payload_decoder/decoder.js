@@ -9,22 +9,113 @@
     * akin transformations.
 */
 
-const meterTeras12 = ['calibratedCountsVWC', 'soilTemp_C', 'conductivity'];
+// BEGIN generated by firmware/swarm/host/generateSchema.cpp
+// from firmware/swarm/src/sensorSchema.h, do not edit
+/**
+    * Field names by SDI-12 address
+*/
 const tncSpecificLookup = {
   '50': ['pressure', 'waterTmp'],
   '51': [
-    'solarFluxDensity_W_per_m2', 'precip_mm', 'lightng_ct',
-    'lightngDist_km', 'windSpeed_m_per_s', 'windDir_deg',
-    'maxWindSp_m_per_s', 'airTmp_c', 'vaporPr_kPa',
-    'barometricPr_kPa', 'relHumidity_0_1', 'humSensorTemp_C',
-    'tiltNS_deg', 'tiltWE_deg', 'compass_unused',
-    'windSpeedN_m_per_s', 'windSpeedE_m_per_s', 'windSpeedMax_per_s'],
+    'solarFluxDensity_W_per_m2', 'precip_mm', 'lightng_ct', 'lightngDist_km',
+    'windSpeed_m_per_s', 'windDir_deg', 'maxWindSp_m_per_s', 'airTmp_c',
+    'vaporPr_kPa', 'barometricPr_kPa', 'relHumidity_0_1', 'humSensorTemp_C',
+    'tiltNS_deg', 'tiltWE_deg', 'compass_unused', 'windSpeedN_m_per_s',
+    'windSpeedE_m_per_s', 'windSpeedMax_per_s'],
   '52': ['leafWetness_percent'],
-  '53': meterTeras12,
-  '54': meterTeras12,
-  '55': meterTeras12,
+  '53': ['calibratedCountsVWC', 'soilTemp_C', 'conductivity'],
+  '54': ['calibratedCountsVWC', 'soilTemp_C', 'conductivity'],
+  '55': ['calibratedCountsVWC', 'soilTemp_C', 'conductivity'],
+};
+
+/**
+    * Precision of the fields in tncSpecificLookup, used to decode binary
+    * messages
+*/
+const tncSpecificDecimals = {
+  '50': [4, 4],
+  '51': [0, 3, 0, 0, 2, 1, 2, 1, 2, 2, 3, 1, 1, 1, 0, 2, 2, 2],
+  '52': [2],
+  '53': [2, 1, 0],
+  '54': [2, 1, 0],
+  '55': [2, 1, 0],
+};
+
+/**
+    * Units of the fields in tncSpecificLookup
+*/
+const tncSpecificUnits = {
+  '50': ['psi', 'C'],
+  '51': [
+    'W/m2', 'mm', 'count', 'km', 'm/s', 'deg', 'm/s', 'C', 'kPa', 'kPa', '1',
+    'C', 'deg', 'deg', 'deg', 'm/s', 'm/s', 'm/s'],
+  '52': ['%'],
+  '53': ['count', 'C', 'uS/cm'],
+  '54': ['count', 'C', 'uS/cm'],
+  '55': ['count', 'C', 'uS/cm'],
 };
 
+/**
+    * Valid range of the fields in tncSpecificLookup, readings outside
+    * of it are sensor errors
+*/
+const tncSpecificRanges = {
+  '50': [[-20, 1000], [-5, 50]],
+  '51': [
+    [0, 1750], [0, 400], [0, 65535], [0, 40], [0, 30], [0, 360], [0, 60],
+    [-50, 60], [0, 47], [50, 110], [0, 1], [-50, 60], [-90, 90], [-90, 90],
+    [0, 360], [-60, 60], [-60, 60], [0, 60]],
+  '52': [[0, 100]],
+  '53': [[0, 5000], [-40, 60], [0, 20000]],
+  '54': [[0, 5000], [-40, 60], [0, 20000]],
+  '55': [[0, 5000], [-40, 60], [0, 20000]],
+};
+
+/**
+    * Fields that count or sum up since the last reading, aggregated as
+    * sum and max
+*/
+const tncSpecificAccumulators = {
+  '51': ['precip_mm', 'lightng_ct'],
+};
+
+/**
+    * Angles in degrees, aggregated as circular mean and standard
+    * deviation
+*/
+const tncSpecificDirections = {
+  '51': ['windDir_deg', 'compass_unused'],
+};
+// END generated by firmware/swarm/host/generateSchema.cpp
+
+// first byte of a binary SC message, see message format spec in swarm.ino
+const FRAME_SC_BINARY = 0x01;
+// first byte of a binary message with several epochs
+const FRAME_SC_BATCH = 0x02;
+// first byte of a binary message with statistics of several readings
+const FRAME_SC_SUMMARY = 0x03;
+// first byte of the acknowledgement of a remote configuration command
+const FRAME_CONFIG_ACK = 0x04;
+// status of a remote configuration command, see firmware/swarm/src/downlink.h
+const configStatus = [
+  'applied', 'bad tag', 'replayed', 'bad format', 'bad value',
+  'address failed',
+];
+// flag on the value count of a channel with self-describing values
+const CHANNEL_SELF_DESCRIBING = 0x80;
+// flag on the value count of a channel with values left out for being out
+// of range
+const CHANNEL_OUT_OF_RANGE = 0x40;
+const CHANNEL_FLAGS = CHANNEL_SELF_DESCRIBING | CHANNEL_OUT_OF_RANGE;
+
+/**
+    * Whether bit i of a varint is set, varints may exceed 32 bits
+    * @param {Number} bits
+    * @param {Number} i
+    * @return {Boolean}
+*/
+const bitSet = (bits, i) => Math.floor(bits / 2 ** i) % 2 === 1;
+
 /**
     * Split a SDI-12 line separated by '-' and '+', maintain signage
     * @param {String} sdi12Line
@@ -52,6 +143,32 @@ const rxTimeToUtc = (timeString) => {
 */
 const payloadTimeToUtc = (epoch) => new Date(epoch * 1000);
 
+/**
+    * Read an unsigned LEB128 varint from a binary string. Multiplication
+    * instead of bit shifts since JS bit operations are 32 bit.
+    * @param {String} bytes binary string as returned by atob
+    * @param {Number} pos position of the first byte
+    * @return {Array.<Number>} value and position after the varint
+*/
+const readVarint = (bytes, pos) => {
+  let value = 0;
+  let factor = 1;
+  let byte;
+  do {
+    byte = bytes.charCodeAt(pos++);
+    value += (byte & 0x7f) * factor;
+    factor *= 128;
+  } while (byte & 0x80);
+  return [value, pos];
+};
+
+/**
+    * Reverse zigzag encoding of signed integers
+    * @param {Number} value
+    * @return {Number}
+*/
+const unzigzag = (value) => (value % 2 ? -(value + 1) / 2 : value / 2);
+
 /** end helper functions */
 
 /**
@@ -60,8 +177,16 @@ const payloadTimeToUtc = (epoch) => new Date(epoch * 1000);
     * @param {Array.<string>} lookup A list of field names to use
     * @return {Object}
 */
-const genericSensor = (sdi12Line, lookup=[]) => {
-  const values = sdi12Parse(sdi12Line);
+const genericSensor = (sdi12Line, lookup=[]) =>
+  namedFields(sdi12Parse(sdi12Line), lookup);
+
+/**
+    * Name values according to a lookup, creates fields_{n} as needed
+    * @param {Array.<Number>} values
+    * @param {Array.<string>} lookup A list of field names to use
+    * @return {Object}
+*/
+const namedFields = (values, lookup=[]) => {
   return values.reduce(
       (o, item, idx) => (
         {...o, [lookup[idx] || 'field_' + idx]: item}), {});
@@ -80,6 +205,227 @@ const csMessageParser = (fields) => {
   return ret;
 };
 
+/**
+  * Parsing a binary 'SC' message, see message format spec in swarm.ino
+  * @param {String} bytes binary string as returned by atob
+  * @return {Object}
+*/
+const binaryMessageParser = (bytes) => {
+  let pos = 1;
+  let value;
+  let epoch = 0;
+  const ret = {};
+  [ret.messagesSinceRestart, pos] = readVarint(bytes, pos);
+  for (let i=0; i<4; i++) epoch += bytes.charCodeAt(pos++) * 2 ** (8 * i);
+  ret.payloadTime = payloadTimeToUtc(epoch);
+  [value, pos] = readVarint(bytes, pos);
+  ret.batteryVoltage = value / 100;
+  ret.messageType = 'SC';
+  ret.sensors = {};
+  while (pos + 1 < bytes.length) {
+    const channel = String(bytes.charCodeAt(pos++));
+    const count = bytes.charCodeAt(pos++);
+    const decimals = tncSpecificDecimals[channel] || [];
+    const values = [];
+    let outOfRange = 0;
+    if (count & CHANNEL_OUT_OF_RANGE) {
+      [outOfRange, pos] = readVarint(bytes, pos);
+    }
+    for (let i=0; i<(count & ~CHANNEL_FLAGS); i++) {
+      if (bitSet(outOfRange, i)) {
+        values.push(null);
+        continue;
+      }
+      [value, pos] = readVarint(bytes, pos);
+      if (count & CHANNEL_SELF_DESCRIBING) {
+        values.push(unzigzag(Math.floor(value / 8)) / 10 ** (value % 8));
+      } else {
+        values.push(unzigzag(value) / 10 ** (decimals[i] || 0));
+      }
+    }
+    ret.sensors[channel] = namedFields(values, tncSpecificLookup[channel]);
+  }
+  return ret;
+};
+
+/**
+  * Parsing a batch of 'SC' readings into one record per epoch, see message
+  * format spec in swarm.ino
+  * @param {String} bytes binary string as returned by atob
+  * @return {Object}
+*/
+const batchMessageParser = (bytes) => {
+  let pos = 1;
+  let value;
+  let epoch = 0;
+  let battery;
+  const ret = {};
+  [ret.messagesSinceRestart, pos] = readVarint(bytes, pos);
+  for (let i=0; i<4; i++) epoch += bytes.charCodeAt(pos++) * 2 ** (8 * i);
+  [battery, pos] = readVarint(bytes, pos);
+  ret.payloadTime = payloadTimeToUtc(epoch);
+  ret.batteryVoltage = battery / 100;
+  ret.messageType = 'SC';
+  const numberOfEpochs = bytes.charCodeAt(pos++);
+  const numberOfChannels = bytes.charCodeAt(pos++);
+  // channel layout shared by all epochs
+  const layout = [];
+  for (let i=0; i<numberOfChannels; i++) {
+    const channel = String(bytes.charCodeAt(pos++));
+    const count = bytes.charCodeAt(pos++);
+    const n = count & ~CHANNEL_FLAGS;
+    const flagged = (count & CHANNEL_OUT_OF_RANGE) !== 0;
+    let decimals = tncSpecificDecimals[channel] || [];
+    if (count & CHANNEL_SELF_DESCRIBING) {
+      decimals = [];
+      for (let j=0; j<n; j++) decimals.push(bytes.charCodeAt(pos++));
+    }
+    layout.push({channel, n, flagged, decimals});
+  }
+  // values of the previous epoch, all following epochs are deltas
+  const values = [];
+  ret.records = [];
+  for (let e=0; e<numberOfEpochs; e++) {
+    if (e > 0) {
+      [value, pos] = readVarint(bytes, pos);
+      epoch += value;
+      [value, pos] = readVarint(bytes, pos);
+      battery += unzigzag(value);
+    }
+    const record = {
+      payloadTime: payloadTimeToUtc(epoch),
+      batteryVoltage: battery / 100,
+      sensors: {},
+    };
+    let idx = 0;
+    for (const {channel, n, flagged, decimals} of layout) {
+      const scaled = [];
+      let outOfRange = 0;
+      if (flagged) [outOfRange, pos] = readVarint(bytes, pos);
+      for (let j=0; j<n; j++, idx++) {
+        if (e === 0) values[idx] = 0;
+        // left out, the next delta refers to the value before
+        if (bitSet(outOfRange, j)) {
+          scaled.push(null);
+          continue;
+        }
+        [value, pos] = readVarint(bytes, pos);
+        values[idx] += unzigzag(value);
+        scaled.push(values[idx] / 10 ** (decimals[j] || 0));
+      }
+      record.sensors[channel] = namedFields(
+          scaled, tncSpecificLookup[channel]);
+    }
+    ret.records.push(record);
+  }
+  return ret;
+};
+
+/**
+  * Parsing statistics of several 'SC' readings, see message format spec in
+  * swarm.ino
+  * @param {String} bytes binary string as returned by atob
+  * @return {Object}
+*/
+const summaryMessageParser = (bytes) => {
+  let pos = 1;
+  let value;
+  let epoch = 0;
+  let duration;
+  const ret = {};
+  [ret.messagesSinceRestart, pos] = readVarint(bytes, pos);
+  for (let i=0; i<4; i++) epoch += bytes.charCodeAt(pos++) * 2 ** (8 * i);
+  [duration, pos] = readVarint(bytes, pos);
+  ret.payloadTime = payloadTimeToUtc(epoch);
+  ret.lastSampleTime = payloadTimeToUtc(epoch + duration);
+  [ret.numberOfSamples, pos] = readVarint(bytes, pos);
+  [ret.numberOfRejected, pos] = readVarint(bytes, pos);
+  [value, pos] = readVarint(bytes, pos);
+  ret.batteryVoltage = value / 100;
+  ret.messageType = 'SC';
+  const numberOfChannels = bytes.charCodeAt(pos++);
+  const layout = [];
+  for (let i=0; i<numberOfChannels; i++) {
+    const channel = String(bytes.charCodeAt(pos++));
+    const count = bytes.charCodeAt(pos++);
+    const n = count & ~CHANNEL_FLAGS;
+    const flagged = (count & CHANNEL_OUT_OF_RANGE) !== 0;
+    let decimals = tncSpecificDecimals[channel] || [];
+    let names = tncSpecificLookup[channel] || [];
+    if (count & CHANNEL_SELF_DESCRIBING) {
+      decimals = [];
+      names = [];
+      for (let j=0; j<n; j++) decimals.push(bytes.charCodeAt(pos++));
+    }
+    layout.push({channel, n, flagged, decimals, names});
+  }
+  ret.sensors = {};
+  for (const {channel, n, flagged, decimals, names} of layout) {
+    const accumulators = tncSpecificAccumulators[channel] || [];
+    const directions = tncSpecificDirections[channel] || [];
+    const stats = [];
+    for (let j=0; j<n; j++) {
+      const scale = 10 ** (decimals[j] || 0);
+      let rejected = 0;
+      if (flagged) {
+        [rejected, pos] = readVarint(bytes, pos);
+        // out of range in every sample
+        if (rejected === ret.numberOfSamples) {
+          stats.push(null);
+          continue;
+        }
+      }
+      if (accumulators.includes(names[j])) {
+        let sum;
+        let max;
+        [sum, pos] = readVarint(bytes, pos);
+        [max, pos] = readVarint(bytes, pos);
+        stats.push({sum: unzigzag(sum) / scale, max: unzigzag(max) / scale});
+      } else if (directions.includes(names[j])) {
+        let mean;
+        let stdDev;
+        [mean, pos] = readVarint(bytes, pos);
+        [stdDev, pos] = readVarint(bytes, pos);
+        stats.push({mean: mean / scale, stdDev: stdDev / scale});
+      } else {
+        let min;
+        let mean;
+        let range;
+        let stdDev;
+        [min, pos] = readVarint(bytes, pos);
+        [mean, pos] = readVarint(bytes, pos);
+        [range, pos] = readVarint(bytes, pos);
+        [stdDev, pos] = readVarint(bytes, pos);
+        min = unzigzag(min);
+        stats.push({
+          min: min / scale,
+          mean: (min + mean) / scale,
+          max: (min + range) / scale,
+          stdDev: stdDev / scale,
+        });
+      }
+      if (flagged) stats[stats.length - 1].rejected = rejected;
+    }
+    ret.sensors[channel] = namedFields(stats, names);
+  }
+  return ret;
+};
+
+/**
+  * Parsing the acknowledgement of a remote configuration command, see
+  * message format spec in swarm.ino
+  * @param {String} bytes binary string as returned by atob
+  * @return {Object}
+*/
+const configAckParser = (bytes) => {
+  const ret = {messageType: 'CA'};
+  let pos;
+  [ret.sequence, pos] = readVarint(bytes, 1);
+  const status = bytes.charCodeAt(pos);
+  ret.status = configStatus[status] || String(status);
+  return ret;
+};
+
 /**
     * The decoder function. This function is kept generic, TNC or CHI specific
     * conventions are implemented in tncSpecificLookup
@@ -113,6 +459,25 @@ const decoder = (payload) => {
 
   // parse the base64 payload
   payload = atob(message.data);
+
+  // binary messages start with a frame type rather than a digit
+  if (payload.charCodeAt(0) === FRAME_SC_BINARY) {
+    ret.user = binaryMessageParser(payload);
+    return ret;
+  }
+  if (payload.charCodeAt(0) === FRAME_SC_BATCH) {
+    ret.user = batchMessageParser(payload);
+    return ret;
+  }
+  if (payload.charCodeAt(0) === FRAME_SC_SUMMARY) {
+    ret.user = summaryMessageParser(payload);
+    return ret;
+  }
+  if (payload.charCodeAt(0) === FRAME_CONFIG_ACK) {
+    ret.user = configAckParser(payload);
+    return ret;
+  }
+
   // interpret payload as CSV
   fields = payload.split(',');
   // index since last restart of the device
@@ -133,8 +498,9 @@ const decoder = (payload) => {
 };
 
 module.exports = {
-  payloadTimeToUtc, rxTimeToUtc, sdi12Parse,
-  genericSensor,
-  csMessageParser,
-  decoder,
+  tncSpecificLookup, tncSpecificUnits, tncSpecificRanges,
+  payloadTimeToUtc, rxTimeToUtc, sdi12Parse, readVarint, unzigzag,
+  genericSensor, namedFields,
+  csMessageParser, binaryMessageParser, batchMessageParser,
+  summaryMessageParser, configAckParser, decoder,
 };
@@ -15,6 +15,33 @@ const multipleSensorPayLoad =
   '3418,"deviceType":1,"hiveRxTime":"2021-12-15T04:36:42","len":139,' +
   '"organizationId":2151,"packetId":17466188,"status":0,"userApplicationId":0}';
 
+// same frame as the encodeMessage test in testMessages.ino
+const binaryPayload =
+  '{"data":"AaUElJCrYecCMxI0AAAAugG+JpIE3AHsAcadAYgO2AEEIgBLqwGSBDQBADUD2PEY' +
+  'wgJOOILxARg=","deviceId":3418,"deviceType":1,' +
+  '"hiveRxTime":"2021-12-04T16:02:11","len":56,"organizationId":2151,' +
+  '"packetId":17466189,"status":0,"userApplicationId":0}';
+
+// same frame as the encodeBatch test in testBatch.ino
+const batchPayload =
+  '{"data":"AgyAkKth5wIDAzQBNQM4ggEAANjxGMICTh4DhAcBCvwBAQQEAIQHAAm0AQMBAgI=' +
+  '","deviceId":3418,"deviceType":1,"hiveRxTime":"2021-12-04T16:31:02",' +
+  '"len":47,"organizationId":2151,"packetId":17466190,"status":0,' +
+  '"userApplicationId":0}';
+
+// same frame as the encodeSummary test in testAggregate.ino
+const summaryPayload =
+  '{"data":"AwyAkKtheAMA5gIDNAE1AziCAQAABQoF2PEYctgBbLwCAgMCTgECAR4CAwIDAAEB' +
+  '","deviceId":3418,"deviceType":1,"hiveRxTime":"2021-12-04T16:03:02",' +
+  '"len":48,"organizationId":2151,"packetId":17466191,"status":0,' +
+  '"userApplicationId":0}';
+
+// same frame as the encodeAck test in testDownlink.ino
+const configAckPayload =
+  '{"data":"BKwCAA==","deviceId":3418,"deviceType":1,' +
+  '"hiveRxTime":"2021-12-04T17:00:02","len":4,"organizationId":2151,' +
+  '"packetId":17466192,"status":0,"userApplicationId":0}';
+
 
 test('test csMessageParser with generic parser', () => {
   const testArray = [
@@ -119,6 +146,201 @@ test('multipleSensorPayload', () => {
 });
 
 
+test('varint and zigzag', () => {
+  expect(decoder.readVarint(String.fromCharCode(0xac, 0x02, 0x05), 0))
+      .toStrictEqual([300, 2]);
+  expect(decoder.readVarint(String.fromCharCode(0x05), 0))
+      .toStrictEqual([5, 1]);
+  expect([0, 1, 2, 75].map(decoder.unzigzag)).toStrictEqual([0, -1, 1, -38]);
+});
+
+
+test('binary decoder', () => {
+  expect(decoder.decoder(binaryPayload)).toStrictEqual({
+    swarm: {
+      application: 0,
+      device: 3418,
+      organization: 2151,
+      rxTime: new Date('2021-12-04T16:02:11.000Z'),
+    },
+    user: {
+      messagesSinceRestart: 549,
+      payloadTime: new Date('2021-12-04T16:00:20.000Z'),
+      batteryVoltage: 3.59,
+      messageType: 'SC',
+      sensors: {
+        '51': {
+          'solarFluxDensity_W_per_m2': 26,
+          'precip_mm': 0,
+          'lightng_ct': 0,
+          'lightngDist_km': 0,
+          'windSpeed_m_per_s': 0.93,
+          'windDir_deg': 246.3,
+          'maxWindSp_m_per_s': 2.65,
+          'airTmp_c': 11,
+          'vaporPr_kPa': 1.18,
+          'barometricPr_kPa': 100.83,
+          'relHumidity_0_1': 0.9,
+          'humSensorTemp_C': 10.8,
+          'tiltNS_deg': 0.2,
+          'tiltWE_deg': 1.7,
+          'compass_unused': 0,
+          'windSpeedN_m_per_s': -0.38,
+          'windSpeedE_m_per_s': -0.86,
+          'windSpeedMax_per_s': 2.65},
+        '52': {
+          'leafWetness_percent': 0},
+        '53': {
+          'calibratedCountsVWC': 2038.84,
+          'soilTemp_C': 16.1,
+          'conductivity': 39},
+        '56': {
+          'field_0': 1.5,
+          'field_1': -2}}}});
+});
+
+
+test('batch decoder', () => {
+  const teros12 = (vwc, temp, ec) => ({
+    'calibratedCountsVWC': vwc, 'soilTemp_C': temp, 'conductivity': ec});
+  expect(decoder.decoder(batchPayload).user).toStrictEqual({
+    messagesSinceRestart: 12,
+    payloadTime: new Date('2021-12-04T16:00:00.000Z'),
+    batteryVoltage: 3.59,
+    messageType: 'SC',
+    records: [{
+      payloadTime: new Date('2021-12-04T16:00:00.000Z'),
+      batteryVoltage: 3.59,
+      sensors: {
+        '52': {'leafWetness_percent': 0},
+        '53': teros12(2038.84, 16.1, 39),
+        '56': {'field_0': 1.5, 'field_1': -2}},
+    }, {
+      payloadTime: new Date('2021-12-04T16:15:00.000Z'),
+      batteryVoltage: 3.58,
+      sensors: {
+        '52': {'leafWetness_percent': 0.05},
+        '53': teros12(2040.1, 16, 41),
+        '56': {'field_0': 1.7, 'field_1': -2}},
+    }, {
+      payloadTime: new Date('2021-12-04T16:30:00.000Z'),
+      batteryVoltage: 3.58,
+      sensors: {
+        '52': {'leafWetness_percent': 0},
+        '53': teros12(2041, 15.8, 40),
+        '56': {'field_0': 1.8, 'field_1': -1}},
+    }],
+  });
+});
+
+
+test('summary decoder', () => {
+  expect(decoder.decoder(summaryPayload).user).toStrictEqual({
+    messagesSinceRestart: 12,
+    payloadTime: new Date('2021-12-04T16:00:00.000Z'),
+    lastSampleTime: new Date('2021-12-04T16:02:00.000Z'),
+    numberOfSamples: 3,
+    numberOfRejected: 0,
+    batteryVoltage: 3.58,
+    messageType: 'SC',
+    sensors: {
+      '52': {
+        'leafWetness_percent': {min: 0, mean: 0.05, max: 0.1, stdDev: 0.05}},
+      '53': {
+        'calibratedCountsVWC': {
+          min: 2038.84, mean: 2039.98, max: 2041, stdDev: 1.08},
+        'soilTemp_C': {min: 15.8, mean: 16, max: 16.1, stdDev: 0.2},
+        'conductivity': {min: 39, mean: 40, max: 41, stdDev: 1}},
+      '56': {
+        'field_0': {min: 1.5, mean: 1.7, max: 1.8, stdDev: 0.2},
+        'field_1': {min: -2, mean: -2, max: -1, stdDev: 1}}},
+  });
+});
+
+test('summary decoder with accumulators', () => {
+  // the first fields of an ATMOS 41, precip_mm and lightng_ct as sum and max
+  const bytes = String.fromCharCode(
+      0x03, 0x00, 0, 0, 0, 0, 0x3c, 0x02, 0x00, 0x64, 0x01, 0x33, 0x03,
+      0x00, 0x00, 0x00, 0x00, 0x80, 0x02, 0xfe, 0x01, 0x02, 0x02);
+  expect(decoder.summaryMessageParser(bytes).sensors['51']).toStrictEqual({
+    'solarFluxDensity_W_per_m2': {min: 0, mean: 0, max: 0, stdDev: 0},
+    'precip_mm': {sum: 0.128, max: 0.127},
+    'lightng_ct': {sum: 1, max: 1},
+  });
+});
+
+test('summary decoder with directions', () => {
+  // an ATMOS 41 up to windDir_deg as circular mean and standard deviation
+  const bytes = String.fromCharCode(
+      0x03, 0x00, 0, 0, 0, 0, 0x3c, 0x02, 0x00, 0x64, 0x01, 0x33, 0x06,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x8f, 0x1c, 0x0e);
+  expect(decoder.summaryMessageParser(bytes).sensors['51']).toStrictEqual({
+    'solarFluxDensity_W_per_m2': {min: 0, mean: 0, max: 0, stdDev: 0},
+    'precip_mm': {sum: 0, max: 0},
+    'lightng_ct': {sum: 0, max: 0},
+    'lightngDist_km': {min: 0, mean: 0, max: 0, stdDev: 0},
+    'windSpeed_m_per_s': {min: 0, mean: 0, max: 0, stdDev: 0},
+    'windDir_deg': {mean: 359.9, stdDev: 1.4},
+  });
+});
+
+test('values out of range are null', () => {
+  // same frames as encodeOutOfRange, batchOutOfRange, and outOfRange in the
+  // firmware tests
+  const teros12 = (vwc, temp, ec) => ({
+    'calibratedCountsVWC': vwc, 'soilTemp_C': temp, 'conductivity': ec});
+  const frame = String.fromCharCode(
+      0x01, 0x00, 0x88, 0x97, 0xab, 0x61, 0xe6, 0x02, 0x34, 0x41, 0x01, 0x35,
+      0x43, 0x02, 0xd0, 0xf1, 0x18, 0x4e, 0x38, 0x82, 0xa1, 0x02, 0x08);
+  expect(decoder.binaryMessageParser(frame).sensors).toStrictEqual({
+    '52': {'leafWetness_percent': null},
+    '53': teros12(2038.8, null, 39),
+    '56': {'field_0': 1.8, 'field_1': -1},
+  });
+  const batch = String.fromCharCode(
+      0x02, 0x0c, 0x80, 0x90, 0xab, 0x61, 0xe7, 0x02, 0x03, 0x03, 0x34, 0x41,
+      0x35, 0x43, 0x38, 0x82, 0x01, 0x00, 0x00, 0x00, 0x02, 0xd8, 0xf1, 0x18,
+      0x4e, 0x1e, 0x03, 0x84, 0x07, 0x01, 0x01, 0x00, 0xfc, 0x01, 0xc0, 0x02,
+      0x04, 0x04, 0x00, 0x84, 0x07, 0x00, 0x00, 0x14, 0x00, 0xb4, 0x01, 0x03,
+      0x01, 0x02, 0x02);
+  expect(decoder.batchMessageParser(batch).records.map(
+      (record) => [record.sensors['52'], record.sensors['53']])).toStrictEqual([
+    [{'leafWetness_percent': 0}, teros12(2038.84, null, 39)],
+    [{'leafWetness_percent': null}, teros12(2040.1, 16, 41)],
+    [{'leafWetness_percent': 0.1}, teros12(2041, 15.8, 40)],
+  ]);
+  const summary = String.fromCharCode(
+      0x03, 0x0c, 0x80, 0x90, 0xab, 0x61, 0x88, 0x0e, 0x03, 0x02, 0xe6, 0x02,
+      0x03, 0x34, 0x41, 0x35, 0x43, 0x38, 0x82, 0x01, 0x00, 0x01, 0x00, 0x05,
+      0x0a, 0x07, 0x00, 0xd8, 0xf1, 0x18, 0x72, 0xd8, 0x01, 0x6c, 0x01, 0xbc,
+      0x02, 0x01, 0x02, 0x01, 0x00, 0x4e, 0x01, 0x02, 0x01, 0x1e, 0x02, 0x03,
+      0x02, 0x03, 0x00, 0x01, 0x01);
+  const decoded = decoder.summaryMessageParser(summary);
+  expect(decoded.numberOfRejected).toBe(2);
+  expect(decoded.sensors['52']).toStrictEqual({
+    'leafWetness_percent': {
+      min: 0, mean: 0.05, max: 0.1, stdDev: 0.07, rejected: 1}});
+  expect(decoded.sensors['53']['soilTemp_C']).toStrictEqual(
+      {min: 15.8, mean: 15.9, max: 16, stdDev: 0.1, rejected: 1});
+  // left out of every sample
+  const none = String.fromCharCode(
+      0x03, 0x00, 0, 0, 0, 0, 0x00, 0x01, 0x01, 0x64, 0x01, 0x34, 0x41, 0x01);
+  expect(decoder.summaryMessageParser(none).sensors['52']).toStrictEqual({
+    'leafWetness_percent': null});
+});
+
+test('configuration acknowledgement', () => {
+  expect(decoder.decoder(configAckPayload).user).toStrictEqual({
+    messageType: 'CA',
+    sequence: 300,
+    status: 'applied',
+  });
+  const rejected = String.fromCharCode(0x04, 0x07, 0x04);
+  expect(decoder.configAckParser(rejected).status).toBe('bad value');
+});
+
+
 test('nonsensical input', () => {
   expect(decoder.decoder('quatsch')).toStrictEqual({
     'error': 'JSON parser error',